@@ -0,0 +1,347 @@
+// Benchmark: triangle and vertex reordering (vertexcache.h).
+// Runs the passes of OptimizeMeshOrder one after the other on synthetic
+// meshes with scrambled triangle and vertex order (as scanners and some
+// exporters write them) and on any OBJ files given, and measures after each:
+//   ACMR / ATVR  vertices transformed per triangle / per distinct vertex,
+//                with a VERTEX_CACHE_SIZE-entry FIFO post-transform cache
+//   overdraw     fragments passing the depth test per covered pixel,
+//                rasterized in software from --views directions around the
+//                mesh without back-face culling (as the viewer draws)
+//   overfetch    bytes read from memory per byte of distinct vertices, for
+//                the vertices the post-transform cache misses going through
+//                a 128 KB FIFO of 64-byte lines (1.0 = every line read once)
+// The set of triangles must not change; "[RESULTS DIFFER]" marks a pass
+// that lost or altered one. The viewer runs all passes on each SubMesh and
+// level of detail (timed last, multithreaded).
+//
+// Usage: bench_meshorder [options] [file.obj ...]
+//   --size N         sphere stacks (slices = 2N; default 256)
+//   --views N        overdraw viewpoints (default 16)
+//   --resolution N   overdraw raster size in pixels (default 256)
+//   --threads N      threads for OptimizeMeshOrder, 0 = all (default 0)
+
+#include "objparser.h"
+#include "meshcache.h"
+#include "vertexcache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(const Clock::time_point t0)
+{
+	return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static const float PI = 3.14159265358979f;
+
+// BenchMesh Declarations.
+// One index list over the vertices; the SubMeshes of an OBJ file are
+// concatenated in their drawing order.
+struct BenchMesh
+{
+	std::string name;
+	std::vector<VertexPTN> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// ------------------------------------------------------------------------------------------------
+// Meshes.
+
+// Shuffle the triangles and renumber the vertices at random.
+static void Scramble(BenchMesh& mesh)
+{
+	std::mt19937 rng(4321u);
+	const size_t numTris = mesh.indices.size() / 3;
+	std::vector<size_t> triOrder(numTris);
+	for (size_t t = 0; t < numTris; ++t)
+		triOrder[t] = t;
+	std::shuffle(triOrder.begin(), triOrder.end(), rng);
+	std::vector<unsigned int> remap(mesh.vertices.size());
+	for (size_t v = 0; v < remap.size(); ++v)
+		remap[v] = (unsigned int)v;
+	std::shuffle(remap.begin(), remap.end(), rng);
+
+	std::vector<unsigned int> indices(mesh.indices.size());
+	for (size_t t = 0; t < numTris; ++t) {
+		for (int k = 0; k < 3; ++k)
+			indices[3 * t + k] = remap[mesh.indices[3 * triOrder[t] + k]];
+	}
+	std::vector<VertexPTN> vertices(mesh.vertices.size());
+	for (size_t v = 0; v < vertices.size(); ++v)
+		vertices[remap[v]] = mesh.vertices[v];
+	mesh.indices.swap(indices);
+	mesh.vertices.swap(vertices);
+}
+
+// UV sphere of radius r(theta, phi).
+template <typename Radius>
+static BenchMesh MakeSphere(const char* name, const int stacks, const Radius& radius)
+{
+	BenchMesh mesh;
+	mesh.name = name;
+	const int slices = 2 * stacks;
+	for (int j = 0; j <= stacks; ++j) {
+		for (int i = 0; i <= slices; ++i) {
+			const float theta = PI * j / stacks, phi = 2.0f * PI * i / slices;
+			const glm::vec3 d(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			mesh.vertices.push_back(VertexPTN(d * radius(theta, phi), d, glm::vec2((float)i / slices, (float)j / stacks)));
+		}
+	}
+	const unsigned int row = slices + 1;
+	for (int j = 0; j < stacks; ++j) {
+		for (int i = 0; i < slices; ++i) {
+			const unsigned int a = j * row + i, b = a + 1, c = a + row + 1, d = a + row;
+			const unsigned int quad[6] = { a, b, c, a, c, d };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	Scramble(mesh);
+	return mesh;
+}
+
+// Smooth and convex: overdraw comes from back faces only.
+static BenchMesh MakeScanSphere(const int stacks)
+{
+	return MakeSphere("scan_sphere", stacks, [](float, float) { return 1.0f; });
+}
+
+// Deep folds that hide one another from most directions.
+static BenchMesh MakeFoldedSphere(const int stacks)
+{
+	return MakeSphere("folded_sphere", stacks, [](const float theta, const float phi) {
+		return 1.0f + 0.35f * std::sin(7.0f * theta) * std::sin(9.0f * phi);
+	});
+}
+
+static bool LoadMesh(const std::string& path, BenchMesh& mesh)
+{
+	ObjMeshData data;
+	if (!LoadObjFile(path, data))
+		return false;
+	mesh.name = path.substr(path.find_last_of("/\\") + 1);
+	mesh.vertices = std::move(data.vertices);
+	for (const ObjSubMesh& subMesh : data.subMeshes)
+		mesh.indices.insert(mesh.indices.end(), subMesh.vertexIndices.begin(), subMesh.vertexIndices.end());
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Analysis.
+
+// The triangles as position triples, each rotated to start at its smallest
+// corner (keeping the winding), sorted: equal for equal triangle sets.
+static std::vector<float> GetTriangleSet(const BenchMesh& mesh)
+{
+	const size_t numTris = mesh.indices.size() / 3;
+	std::vector<std::vector<float>> tris(numTris);
+	for (size_t t = 0; t < numTris; ++t) {
+		std::vector<float> corners[3];
+		for (int k = 0; k < 3; ++k) {
+			const VertexPTN& v = mesh.vertices[mesh.indices[3 * t + k]];
+			corners[k] = { v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z,
+						   v.texcoord.x, v.texcoord.y };
+		}
+		int first = 0;
+		for (int k = 1; k < 3; ++k) {
+			if (corners[k] < corners[first])
+				first = k;
+		}
+		for (int k = 0; k < 3; ++k)
+			tris[t].insert(tris[t].end(), corners[(first + k) % 3].begin(), corners[(first + k) % 3].end());
+	}
+	std::sort(tris.begin(), tris.end());
+	std::vector<float> set;
+	for (const std::vector<float>& tri : tris)
+		set.insert(set.end(), tri.begin(), tri.end());
+	return set;
+}
+
+// Fragments shaded per covered pixel, averaged over the views.
+static double AnalyzeOverdraw(const BenchMesh& mesh, const int numViews, const int resolution)
+{
+	glm::vec3 pMin(FLT_MAX), pMax(-FLT_MAX);
+	for (const VertexPTN& v : mesh.vertices) {
+		pMin = glm::min(pMin, v.position);
+		pMax = glm::max(pMax, v.position);
+	}
+	const glm::vec3 center = 0.5f * (pMin + pMax);
+	const float radius = std::max(1e-6f, 0.5f * glm::length(pMax - pMin));
+	std::vector<float> depth((size_t)resolution * resolution);
+	std::vector<glm::vec3> projected(mesh.vertices.size());
+	long long shaded = 0, covered = 0;
+	for (int view = 0; view < numViews; ++view) {
+		// Directions spread evenly over the sphere (Fibonacci lattice).
+		const float z = 1.0f - (2.0f * view + 1.0f) / numViews;
+		const float r = std::sqrt(std::max(0.0f, 1.0f - z * z)), angle = view * 2.39996323f;
+		const glm::vec3 dir(r * std::cos(angle), r * std::sin(angle), z);
+		const glm::vec3 up = (std::fabs(dir.y) < 0.9f) ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+		const glm::vec3 right = glm::normalize(glm::cross(up, dir)), top = glm::cross(dir, right);
+		// Orthographic: x, y in pixels, depth along dir.
+		const float scale = 0.5f * resolution / radius;
+		for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+			const glm::vec3 p = mesh.vertices[v].position - center;
+			projected[v] = glm::vec3(0.5f * resolution + glm::dot(p, right) * scale,
+									 0.5f * resolution + glm::dot(p, top) * scale, glm::dot(p, dir));
+		}
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+			glm::vec3 a = projected[mesh.indices[t]], b = projected[mesh.indices[t + 1]], c = projected[mesh.indices[t + 2]];
+			float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (area == 0.0f)
+				continue;
+			// Both faces are drawn.
+			if (area < 0.0f) {
+				std::swap(b, c);
+				area = -area;
+			}
+			const int x0 = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x))));
+			const int x1 = std::min(resolution - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+			const int y0 = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+			const int y1 = std::min(resolution - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+			for (int y = y0; y <= y1; ++y) {
+				const float py = y + 0.5f;
+				for (int x = x0; x <= x1; ++x) {
+					const float px = x + 0.5f;
+					const float w0 = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+					const float w1 = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+					const float w2 = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+					const float d = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+					float& stored = depth[(size_t)y * resolution + x];
+					if (d < stored) {
+						stored = d;
+						shaded++;
+					}
+				}
+			}
+		}
+		for (const float d : depth)
+			covered += (d < FLT_MAX) ? 1 : 0;
+	}
+	return covered > 0 ? (double)shaded / covered : 0.0;
+}
+
+// Bytes read per byte of distinct vertices.
+static double AnalyzeVertexFetch(const BenchMesh& mesh)
+{
+	const int LINE_BYTES = 64, NUM_LINES = (128 << 10) / LINE_BYTES;
+	const size_t stride = sizeof(VertexPTN);
+	std::vector<int> vertexTimes(mesh.vertices.size(), 0);
+	std::vector<int> lineTimes((mesh.vertices.size() * stride + LINE_BYTES - 1) / LINE_BYTES, 0);
+	std::vector<char> used(mesh.vertices.size(), 0);
+	int vertexTime = VERTEX_CACHE_SIZE + 1, lineTime = NUM_LINES + 1;
+	size_t numDistinct = 0, numLines = 0;
+	for (const unsigned int v : mesh.indices) {
+		if (!used[v]) {
+			used[v] = 1;
+			numDistinct++;
+		}
+		if (vertexTime - vertexTimes[v] <= VERTEX_CACHE_SIZE)
+			continue;
+		vertexTimes[v] = vertexTime++;
+		for (size_t line = v * stride / LINE_BYTES; line <= ((v + 1) * stride - 1) / LINE_BYTES; ++line) {
+			if (lineTime - lineTimes[line] > NUM_LINES) {
+				lineTimes[line] = lineTime++;
+				numLines++;
+			}
+		}
+	}
+	return numDistinct > 0 ? (double)numLines * LINE_BYTES / ((double)numDistinct * stride) : 0.0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+struct Options
+{
+	int size = 256;
+	int views = 16;
+	int resolution = 256;
+	int threads = 0;
+	std::vector<std::string> files;
+};
+
+static void Report(const char* pass, const BenchMesh& mesh, const double ms, const std::vector<float>& triangleSet,
+				   const Options& options)
+{
+	const VertexCacheStats stats = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+	printf("  %-17s %9.2f ms  ACMR %5.3f  ATVR %5.3f  overdraw %5.3f  overfetch %5.3f%s\n", pass, ms, stats.acmr,
+		   stats.atvr, AnalyzeOverdraw(mesh, options.views, options.resolution), AnalyzeVertexFetch(mesh),
+		   GetTriangleSet(mesh) == triangleSet ? "" : "  [RESULTS DIFFER]");
+}
+
+static void Run(BenchMesh mesh, const Options& options)
+{
+	printf("%s: %zu triangles, %zu vertices\n", mesh.name.c_str(), mesh.indices.size() / 3, mesh.vertices.size());
+	const std::vector<float> triangleSet = GetTriangleSet(mesh);
+	MeshCacheData meshData;
+	meshData.vertices = mesh.vertices;
+	meshData.subMeshes.push_back(ObjSubMesh());
+	meshData.subMeshes.back().vertexIndices = mesh.indices;
+	Report("input", mesh, 0.0, triangleSet, options);
+
+	Clock::time_point t0 = Clock::now();
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	Report("vertex cache", mesh, SecondsSince(t0) * 1000.0, triangleSet, options);
+	t0 = Clock::now();
+	OptimizeOverdraw(mesh.indices, mesh.vertices);
+	Report("+ overdraw", mesh, SecondsSince(t0) * 1000.0, triangleSet, options);
+	t0 = Clock::now();
+	OptimizeVertexFetch(mesh.vertices, mesh.indices);
+	Report("+ vertex fetch", mesh, SecondsSince(t0) * 1000.0, triangleSet, options);
+
+	t0 = Clock::now();
+	OptimizeMeshOrder(meshData, options.threads);
+	const double ms = SecondsSince(t0) * 1000.0;
+	const bool same = meshData.vertices.size() == mesh.vertices.size() &&
+					  memcmp(meshData.vertices.data(), mesh.vertices.data(), mesh.vertices.size() * sizeof(VertexPTN)) == 0 &&
+					  meshData.subMeshes[0].vertexIndices == mesh.indices;
+	printf("  %-17s %9.2f ms  (all passes as the viewer runs them)%s\n", "OptimizeMeshOrder", ms,
+		   same ? "" : "  [RESULTS DIFFER]");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--size") && hasValue)
+			options.size = std::max(2, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--views") && hasValue)
+			options.views = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--resolution") && hasValue)
+			options.resolution = std::max(16, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--threads") && hasValue)
+			options.threads = atoi(argv[++i]);
+		else if (argv[i][0] == '-') {
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+		else
+			options.files.push_back(argv[i]);
+	}
+
+	printf("%d-entry vertex cache, %d views at %dx%d\n", VERTEX_CACHE_SIZE, options.views, options.resolution,
+		   options.resolution);
+	Run(MakeScanSphere(options.size), options);
+	Run(MakeFoldedSphere(options.size), options);
+	for (const std::string& file : options.files) {
+		BenchMesh mesh;
+		if (!LoadMesh(file, mesh)) {
+			fprintf(stderr, "cannot load %s\n", file.c_str());
+			return 1;
+		}
+		Run(std::move(mesh), options);
+	}
+	return 0;
+}
@@ -0,0 +1,411 @@
+// Benchmark: mip-chain generation.
+// Builds full mip chains of synthetic 8-bit images with BuildMipLevel (the
+// filter CookTexture uses) and compares it with a plain scalar box filter,
+// single- and multithreaded, with and without gamma-correct filtering. The
+// raw result must match the scalar filter exactly; the gamma-correct result
+// is compared with a double-precision reference.
+// When built with BENCH_WITH_EGL it also times the GL path on a headless
+// context: uploading level 0 and calling glGenerateMipmap, against uploading
+// the CPU-built levels one by one (glFinish is included in both).
+//
+// Usage: bench_mipmap [options]
+//   --sizes LIST             square sizes; WxH for others (e.g. 1023x767)
+//                            (default 1024,2048,4096,64x16,1x64,16x96)
+//   --channels 1,3,4         channel counts
+//   --threads N              threads for the multithreaded runs, 0 = all (default 0)
+//   --repeat N               runs per case, the fastest is reported (default 3)
+
+#include "mipbuilder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#ifdef BENCH_WITH_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(const Clock::time_point t0)
+{
+	return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// MipChain Declarations.
+struct MipChain
+{
+	std::vector<int> widths, heights;
+	std::vector<std::vector<unsigned char>> levels;
+};
+
+static void InitChain(MipChain& chain, const int width, const int height, const int channels)
+{
+	chain.widths.clear();
+	chain.heights.clear();
+	chain.levels.clear();
+	for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+		chain.widths.push_back(w);
+		chain.heights.push_back(h);
+		chain.levels.emplace_back((size_t)w * h * channels);
+		if (w == 1 && h == 1)
+			break;
+	}
+}
+
+typedef std::function<void(const unsigned char*, int, int, int, unsigned char*)> LevelFilter;
+
+static void BuildChain(MipChain& chain, const int channels, const LevelFilter& filter)
+{
+	for (size_t i = 1; i < chain.levels.size(); ++i)
+		filter(chain.levels[i - 1].data(), chain.widths[i - 1], chain.heights[i - 1], channels, chain.levels[i].data());
+}
+
+// ------------------------------------------------------------------------------------------------
+// Scalar references.
+
+static void ScalarRawLevel(const unsigned char* src, const int srcWidth, const int srcHeight, const int channels,
+						   unsigned char* dst)
+{
+	const int dstWidth = std::max(1, srcWidth / 2), dstHeight = std::max(1, srcHeight / 2);
+	for (int y = 0; y < dstHeight; ++y) {
+		const unsigned char* row0 = src + (size_t)std::min(2 * y, srcHeight - 1) * srcWidth * channels;
+		const unsigned char* row1 = src + (size_t)std::min(2 * y + 1, srcHeight - 1) * srcWidth * channels;
+		unsigned char* out = dst + (size_t)y * dstWidth * channels;
+		for (int x = 0; x < dstWidth; ++x) {
+			const int x0 = std::min(2 * x, srcWidth - 1) * channels, x1 = std::min(2 * x + 1, srcWidth - 1) * channels;
+			for (int c = 0; c < channels; ++c) {
+				const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				out[x * channels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+static double ToLinear(const int v)
+{
+	const double s = v / 255.0;
+	return (s <= 0.04045) ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+}
+
+static int ToSRGB(const double linear)
+{
+	const double s = (linear <= 0.0031308) ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+	return std::min(255, (int)(s * 255.0 + 0.5));
+}
+
+static void ReferenceGammaLevel(const unsigned char* src, const int srcWidth, const int srcHeight, const int channels,
+								unsigned char* dst)
+{
+	const int dstWidth = std::max(1, srcWidth / 2), dstHeight = std::max(1, srcHeight / 2);
+	for (int y = 0; y < dstHeight; ++y) {
+		const unsigned char* row0 = src + (size_t)std::min(2 * y, srcHeight - 1) * srcWidth * channels;
+		const unsigned char* row1 = src + (size_t)std::min(2 * y + 1, srcHeight - 1) * srcWidth * channels;
+		unsigned char* out = dst + (size_t)y * dstWidth * channels;
+		for (int x = 0; x < dstWidth; ++x) {
+			const int x0 = std::min(2 * x, srcWidth - 1) * channels, x1 = std::min(2 * x + 1, srcWidth - 1) * channels;
+			for (int c = 0; c < channels; ++c) {
+				const int a = row0[x0 + c], b = row0[x1 + c], d = row1[x0 + c], e = row1[x1 + c];
+				if (channels == 4 && c == 3)
+					out[x * channels + c] = (unsigned char)((a + b + d + e + 2) / 4);
+				else
+					out[x * channels + c] = (unsigned char)ToSRGB((ToLinear(a) + ToLinear(b) + ToLinear(d) + ToLinear(e)) / 4.0);
+			}
+		}
+	}
+}
+
+// Largest per-channel difference over all levels but the first.
+static int MaxDifference(const MipChain& a, const MipChain& b)
+{
+	int maxDiff = 0;
+	for (size_t i = 1; i < a.levels.size(); ++i) {
+		for (size_t k = 0; k < a.levels[i].size(); ++k)
+			maxDiff = std::max(maxDiff, std::abs((int)a.levels[i][k] - (int)b.levels[i][k]));
+	}
+	return maxDiff;
+}
+
+// Smooth gradients with a checker pattern and noise: every level has detail.
+static void FillImage(std::vector<unsigned char>& pixels, const int width, const int height, const int channels)
+{
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> noise(-24, 24);
+	pixels.resize((size_t)width * height * channels);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const int checker = (((x >> 3) ^ (y >> 3)) & 1) ? 64 : 0;
+			for (int c = 0; c < channels; ++c) {
+				const int base = (c == 0) ? x * 255 / width : (c == 1) ? y * 255 / height : 128;
+				pixels[((size_t)y * width + x) * channels + c] = (unsigned char)std::min(255, std::max(0, base + checker - 32 + noise(rng)));
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+
+#ifdef BENCH_WITH_EGL
+typedef void (APIENTRY* GenerateMipmapProc)(GLenum target);
+
+// HeadlessGL Declarations.
+// A surfaceless EGL context with desktop GL.
+struct HeadlessGL
+{
+	HeadlessGL() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), generateMipmap(nullptr) {}
+	~HeadlessGL() {
+		if (context != EGL_NO_CONTEXT) {
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(display, context);
+		}
+		if (display != EGL_NO_DISPLAY)
+			eglTerminate(display);
+	}
+
+	bool Init() {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay != nullptr)
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY)
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		EGLint major = 0, minor = 0;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+			return false;
+		const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLConfig config = nullptr;
+		EGLint numConfigs = 0;
+		eglChooseConfig(display, configAttribs, &config, 1, &numConfigs);
+		context = eglCreateContext(display, numConfigs > 0 ? config : nullptr, EGL_NO_CONTEXT, nullptr);
+		if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+			return false;
+		generateMipmap = (GenerateMipmapProc)eglGetProcAddress("glGenerateMipmap");
+		return generateMipmap != nullptr;
+	}
+
+	EGLDisplay display;
+	EGLContext context;
+	GenerateMipmapProc generateMipmap;
+};
+
+static void GetUploadFormat(const int channels, GLint& internalFormat, GLenum& format)
+{
+	internalFormat = (channels == 1) ? GL_RED : (channels == 3) ? GL_RGB : GL_RGBA;
+	format = (channels == 1) ? GL_RED : (channels == 3) ? GL_BGR : GL_BGRA;
+}
+
+// Upload level 0 and let the driver build the rest.
+static double TimeGLGenerate(const HeadlessGL& gl, const MipChain& chain, const int channels)
+{
+	GLint internalFormat;
+	GLenum format;
+	GetUploadFormat(channels, internalFormat, format);
+	const Clock::time_point t0 = Clock::now();
+	GLuint tex = 0;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, chain.widths[0], chain.heights[0], 0, format, GL_UNSIGNED_BYTE,
+				 chain.levels[0].data());
+	gl.generateMipmap(GL_TEXTURE_2D);
+	glFinish();
+	const double seconds = SecondsSince(t0);
+	glDeleteTextures(1, &tex);
+	return seconds;
+}
+
+// Upload every level of a CPU-built chain.
+static double TimeGLUploadChain(const MipChain& chain, const int channels)
+{
+	GLint internalFormat;
+	GLenum format;
+	GetUploadFormat(channels, internalFormat, format);
+	const Clock::time_point t0 = Clock::now();
+	GLuint tex = 0;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < chain.levels.size(); ++i) {
+		glTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, chain.widths[i], chain.heights[i], 0, format,
+					 GL_UNSIGNED_BYTE, chain.levels[i].data());
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)chain.levels.size() - 1);
+	glFinish();
+	const double seconds = SecondsSince(t0);
+	glDeleteTextures(1, &tex);
+	return seconds;
+}
+#endif
+
+// ------------------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size()) {
+		const size_t comma = std::min(list.find(',', start), list.size());
+		if (comma > start)
+			items.push_back(list.substr(start, comma - start));
+		start = comma + 1;
+	}
+	return items;
+}
+
+static double Fastest(const int repeat, const std::function<double()>& run)
+{
+	double best = 1e30;
+	for (int r = 0; r < repeat; ++r)
+		best = std::min(best, run());
+	return best;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: bench_mipmap [options]\n"
+		"  --sizes LIST             square sizes; WxH for others (e.g. 1023x767)\n"
+		"                           (default 1024,2048,4096,64x16,1x64,16x96)\n"
+		"  --channels 1,3,4         channel counts\n"
+		"  --threads N              threads for the multithreaded runs, 0 = all (default 0)\n"
+		"  --repeat N               runs per case, the fastest is reported (default 3)\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> sizes = SplitList("1024,2048,4096,64x16,1x64,16x96");
+	std::vector<std::string> channelList = SplitList("1,3,4");
+	int numThreads = 0;
+	int repeat = 3;
+	for (int i = 1; i < argc; i += 2) {
+		const std::string key = argv[i];
+		if (key == "--help" || key == "-h") {
+			PrintUsage();
+			return 1;
+		}
+		if (i + 1 == argc) {
+			fprintf(stderr, "missing value for %s\n", key.c_str());
+			PrintUsage();
+			return 1;
+		}
+		const std::string value = argv[i + 1];
+		if (key == "--sizes")
+			sizes = SplitList(value);
+		else if (key == "--channels")
+			channelList = SplitList(value);
+		else if (key == "--threads")
+			numThreads = std::max(0, atoi(value.c_str()));
+		else if (key == "--repeat")
+			repeat = std::max(1, atoi(value.c_str()));
+		else {
+			fprintf(stderr, "unknown option %s\n", key.c_str());
+			PrintUsage();
+			return 1;
+		}
+	}
+	const int mtThreads = numThreads > 0 ? numThreads : (int)std::max(1u, std::thread::hardware_concurrency());
+	printf("SIMD: %s, threads: %d\n", GetMipBuilderSimdName(), mtThreads);
+
+#ifdef BENCH_WITH_EGL
+	HeadlessGL gl;
+	const bool haveGL = gl.Init();
+	if (haveGL)
+		printf("GL: %s | %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+	else
+		printf("GL: no headless context, GL columns skipped\n");
+#endif
+
+	printf("%-11s %2s %6s | %9s %9s %9s %6s | %9s %9s %9s %6s %5s", "size", "ch", "MB",
+		   "scalar", "simd_1t", "simd_mt", "x", "ref_gam", "gam_1t", "gam_mt", "x", "err");
+#ifdef BENCH_WITH_EGL
+	if (haveGL)
+		printf(" | %9s %9s %9s", "gl_gen", "gl_upload", "cpu+upl");
+#endif
+	printf("   (ms)\n");
+
+	int failures = 0;
+	for (const std::string& size : sizes) {
+		int width = atoi(size.c_str()), height = width;
+		const size_t x = size.find('x');
+		if (x != std::string::npos)
+			height = atoi(size.c_str() + x + 1);
+		if (width <= 0 || height <= 0) {
+			fprintf(stderr, "bad size %s\n", size.c_str());
+			return 1;
+		}
+		for (const std::string& ch : channelList) {
+			const int channels = atoi(ch.c_str());
+			if (channels != 1 && channels != 3 && channels != 4) {
+				fprintf(stderr, "bad channel count %s\n", ch.c_str());
+				return 1;
+			}
+
+			MipChain scalar, simd, reference;
+			InitChain(scalar, width, height, channels);
+			FillImage(scalar.levels[0], width, height, channels);
+			simd = scalar;
+			reference = scalar;
+
+			MipBuildOptions raw1, rawMT, gamma1, gammaMT;
+			raw1.gammaCorrect = rawMT.gammaCorrect = false;
+			raw1.numThreads = gamma1.numThreads = 1;
+			rawMT.numThreads = gammaMT.numThreads = mtThreads;
+			const auto simdFilter = [](const MipBuildOptions& options) {
+				return [options](const unsigned char* src, int w, int h, int c, unsigned char* dst) {
+					BuildMipLevel(src, w, h, c, dst, options);
+				};
+			};
+			const auto timeChain = [&](MipChain& chain, const LevelFilter& filter, const int numRuns) {
+				return Fastest(numRuns, [&]() {
+					const Clock::time_point t0 = Clock::now();
+					BuildChain(chain, channels, filter);
+					return SecondsSince(t0);
+				});
+			};
+
+			const double tScalar = timeChain(scalar, ScalarRawLevel, repeat);
+			const double tSimd1 = timeChain(simd, simdFilter(raw1), repeat);
+			const double tSimdMT = timeChain(simd, simdFilter(rawMT), repeat);
+			const bool rawMatches = (MaxDifference(scalar, simd) == 0);
+
+			// The double-precision reference is slow: run it once.
+			const double tRef = timeChain(reference, ReferenceGammaLevel, 1);
+			const double tGamma1 = timeChain(simd, simdFilter(gamma1), repeat);
+			const double tGammaMT = timeChain(simd, simdFilter(gammaMT), repeat);
+			const int gammaError = MaxDifference(reference, simd);
+
+			const double mb = (double)width * height * channels / (1 << 20);
+			printf("%-11s %2d %6.1f | %9.2f %9.2f %9.2f %5.1fx | %9.2f %9.2f %9.2f %5.1fx %5d", size.c_str(), channels, mb,
+				   tScalar * 1e3, tSimd1 * 1e3, tSimdMT * 1e3, tScalar / tSimdMT,
+				   tRef * 1e3, tGamma1 * 1e3, tGammaMT * 1e3, tRef / tGammaMT, gammaError);
+#ifdef BENCH_WITH_EGL
+			if (haveGL) {
+				const double tGen = Fastest(repeat, [&]() { return TimeGLGenerate(gl, simd, channels); });
+				const double tUpload = Fastest(repeat, [&]() { return TimeGLUploadChain(simd, channels); });
+				printf(" | %9.2f %9.2f %9.2f", tGen * 1e3, tUpload * 1e3, (tGammaMT + tUpload) * 1e3);
+			}
+#endif
+			if (!rawMatches) {
+				printf("  MISMATCH (raw filter differs from the scalar reference)");
+				failures++;
+			}
+			if (gammaError > 1) {
+				printf("  MISMATCH (gamma-correct filter off by %d)", gammaError);
+				failures++;
+			}
+			printf("\n");
+			fflush(stdout);
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
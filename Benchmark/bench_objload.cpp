@@ -0,0 +1,483 @@
+// Benchmark: OBJ/MTL loading.
+// Generates synthetic OBJ/MTL files and runs them through the loader path of
+// TriangleMesh::LoadMeshData, without the .meshbin cache. Parse, dedup
+// (BuildObjMesh), MTL reading and normalization are timed separately. Each
+// case runs in its own process so that its peak RSS is its own. Results are
+// printed and written as JSON so runs can be compared across commits.
+//
+// Usage: bench_objload [options]
+//   --sizes 10k,100k,1m   triangle counts, k/m suffixes (10k .. 50m)
+//   --shapes LIST         any of sphere,soup,materials,ngons (default: all)
+//   --threads N           parser threads, 0 = all hardware threads (default 0)
+//   --repeat N            runs per case, the fastest is reported (default 3)
+//   --dir PATH            where generated files are kept (default bench_data)
+//   --out FILE            JSON output (default bench_objload.json)
+//   --label TEXT          stored in the JSON, e.g. a commit hash
+// Generated files are reused when they already exist.
+
+#include "objparser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(const Clock::time_point t0)
+{
+	return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// ------------------------------------------------------------------------------------------------
+// Synthetic OBJ/MTL generators. Each writes <dir>/<shape>_<tris>.obj and its
+// MTL file and returns false if the files cannot be written.
+
+static FILE* OpenForWrite(const std::string& path)
+{
+	FILE* f = fopen(path.c_str(), "wb");
+	if (f != nullptr)
+		setvbuf(f, nullptr, _IOFBF, 1 << 20);
+	return f;
+}
+
+static bool WriteMtl(const std::string& path, const int numMaterials)
+{
+	FILE* f = OpenForWrite(path);
+	if (f == nullptr)
+		return false;
+	for (int m = 0; m < numMaterials; ++m) {
+		const float r = (float)((m * 37) % 64) / 63.0f, g = (float)((m * 11) % 64) / 63.0f;
+		fprintf(f, "newmtl mat%d\nNs 32.0\nKa 0.1 0.1 0.1\nKd %.4f %.4f 0.5\nKs 0.5 0.5 0.5\n\n", m, r, g);
+	}
+	return fclose(f) == 0;
+}
+
+// Tessellated UV sphere with shared, per-vertex positions/UVs/normals.
+static bool WriteSphere(FILE* f, const long long numTris)
+{
+	const int stacks = std::max(2, (int)std::lround(std::sqrt(numTris / 4.0)));
+	const int slices = 2 * stacks;
+	const float pi = 3.14159265358979f;
+	fprintf(f, "usemtl mat0\n");
+	for (int j = 0; j <= stacks; ++j) {
+		for (int i = 0; i <= slices; ++i) {
+			const float theta = pi * j / stacks, phi = 2.0f * pi * i / slices;
+			const float x = std::sin(theta) * std::cos(phi), y = std::cos(theta), z = std::sin(theta) * std::sin(phi);
+			fprintf(f, "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+					2.0f * x, 2.0f * y, 2.0f * z, (float)i / slices, (float)j / stacks, x, y, z);
+		}
+	}
+	const int row = slices + 1;
+	for (int j = 0; j < stacks; ++j) {
+		for (int i = 0; i < slices; ++i) {
+			const int a = j * row + i + 1, b = a + 1, c = a + row + 1, d = a + row;
+			fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n",
+					a, a, a, b, b, b, c, c, c, a, a, a, c, c, c, d, d, d);
+		}
+	}
+	return true;
+}
+
+// Random triangle soup: nothing is shared, every corner is a new vertex.
+static bool WriteSoup(FILE* f, const long long numTris)
+{
+	std::mt19937 rng(12345u);
+	std::uniform_real_distribution<float> pos(-10.0f, 10.0f), uv(0.0f, 1.0f), dir(-1.0f, 1.0f);
+	fprintf(f, "usemtl mat0\n");
+	for (long long t = 0; t < numTris; ++t) {
+		for (int k = 0; k < 3; ++k)
+			fprintf(f, "v %.6f %.6f %.6f\nvt %.6f %.6f\n", pos(rng), pos(rng), pos(rng), uv(rng), uv(rng));
+		fprintf(f, "vn %.6f %.6f %.6f\n", dir(rng), dir(rng), dir(rng));
+		const long long v = 3 * t + 1, n = t + 1;
+		fprintf(f, "f %lld/%lld/%lld %lld/%lld/%lld %lld/%lld/%lld\n", v, v, n, v + 1, v + 1, n, v + 2, v + 2, n);
+	}
+	return true;
+}
+
+// Grid split into many short material runs; materials recur, so SubMeshes
+// must be merged by name.
+static bool WriteMaterials(FILE* f, const long long numTris, const int numMaterials)
+{
+	const int n = std::max(2, (int)std::lround(std::sqrt(numTris / 2.0)));
+	for (int j = 0; j <= n; ++j)
+		for (int i = 0; i <= n; ++i)
+			fprintf(f, "v %.6f %.6f %.6f\nvt %.6f %.6f\n", (float)i / n, (float)j / n, 0.1f * std::sin(0.05f * (i + j)),
+					(float)i / n, (float)j / n);
+	fprintf(f, "vn 0 0 1\n");
+	int current = -1;
+	for (int j = 0; j < n; ++j) {
+		for (int i = 0; i < n; ++i) {
+			const int m = (i / 16 + j * 5) % numMaterials;
+			if (m != current) {
+				fprintf(f, "usemtl mat%d\n", m);
+				current = m;
+			}
+			const int a = j * (n + 1) + i + 1, b = a + 1, c = a + n + 2, d = a + n + 1;
+			fprintf(f, "f %d/%d/1 %d/%d/1 %d/%d/1\nf %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, c, c, a, a, c, c, d, d);
+		}
+	}
+	return true;
+}
+
+// Independent 3- to 8-gons that have to be fan-triangulated, alternating the
+// "v//vn" and "v" corner forms.
+static bool WriteNgons(FILE* f, const long long numTris)
+{
+	const float pi = 3.14159265358979f;
+	const int width = 1024;
+	fprintf(f, "vn 0 0 1\nusemtl mat0\n");
+	long long written = 0, nextVertex = 1;
+	for (long long p = 0; written < numTris; ++p) {
+		const int k = 3 + (int)(p % 6);
+		const float cx = (float)(p % width), cy = (float)(p / width);
+		for (int c = 0; c < k; ++c)
+			fprintf(f, "v %.6f %.6f 0\n", cx + 0.4f * std::cos(2.0f * pi * c / k), cy + 0.4f * std::sin(2.0f * pi * c / k));
+		fputc('f', f);
+		for (int c = 0; c < k; ++c) {
+			if (p % 2 == 0)
+				fprintf(f, " %lld//1", nextVertex + c);
+			else
+				fprintf(f, " %lld", nextVertex + c);
+		}
+		fputc('\n', f);
+		nextVertex += k;
+		written += k - 2;
+	}
+	return true;
+}
+
+static bool GenerateCase(const std::string& objPath, const std::string& mtlName, const std::string& shape,
+						 const long long numTris)
+{
+	const int numMaterials = (shape == "materials") ? 64 : 1;
+	const std::string mtlPath = (std::filesystem::path(objPath).parent_path() / mtlName).string();
+	if (!WriteMtl(mtlPath, numMaterials))
+		return false;
+
+	const std::string tempPath = objPath + ".tmp";
+	FILE* f = OpenForWrite(tempPath);
+	if (f == nullptr)
+		return false;
+	fprintf(f, "# %s, about %lld triangles\nmtllib %s\n", shape.c_str(), numTris, mtlName.c_str());
+	bool ok = false;
+	if (shape == "sphere")
+		ok = WriteSphere(f, numTris);
+	else if (shape == "soup")
+		ok = WriteSoup(f, numTris);
+	else if (shape == "materials")
+		ok = WriteMaterials(f, numTris, numMaterials);
+	else if (shape == "ngons")
+		ok = WriteNgons(f, numTris);
+	ok = (fclose(f) == 0) && ok;
+
+	std::error_code ec;
+	if (ok)
+		std::filesystem::rename(tempPath, objPath, ec);
+	if (!ok || ec) {
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Running a case.
+
+// CaseResult Declarations.
+// Plain data, so a child process can send it back through a pipe.
+struct CaseResult
+{
+	int ok;
+	long long fileBytes;
+	long long numTriangles;
+	long long numVertices;
+	long long numSubMeshes;
+	long long numMaterials;
+	int numThreads;
+	double parseSeconds;
+	double dedupSeconds;
+	double mtlSeconds;
+	double normalizeSeconds;
+	double totalSeconds;
+	double peakRssMB;
+};
+
+static double GetPeakRssMB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0.0;
+	return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+// The same steps as TriangleMesh::LoadMeshData on a cache miss.
+static CaseResult RunCase(const std::string& objPath, const int numThreads, const int repeat)
+{
+	CaseResult best;
+	memset(&best, 0, sizeof(best));
+	ObjLoadOptions options;
+	options.numThreads = numThreads;
+	options.useMeshCache = false;
+	const std::string dir = std::filesystem::path(objPath).parent_path().string();
+
+	for (int r = 0; r < repeat; ++r) {
+		CaseResult res;
+		memset(&res, 0, sizeof(res));
+		ObjMeshData mesh;
+		ObjLoadStats stats;
+		std::vector<ObjMaterial> materials;
+
+		const Clock::time_point start = Clock::now();
+		if (!LoadObjFile(objPath, mesh, &stats, options))
+			return best;
+		Clock::time_point t0 = Clock::now();
+		for (const std::string& mtllib : mesh.mtllibs)
+			if (!LoadMtlFile((std::filesystem::path(dir) / mtllib).string(), materials))
+				return best;
+		res.mtlSeconds = SecondsSince(t0);
+		t0 = Clock::now();
+		const glm::vec3 extent = mesh.bboxMax - mesh.bboxMin;
+		const glm::vec3 center = (mesh.bboxMax + mesh.bboxMin) / 2.0f;
+		NormalizeObjPositions(mesh.vertices, center, extent);
+		res.normalizeSeconds = SecondsSince(t0);
+		res.totalSeconds = SecondsSince(start);
+
+		res.ok = 1;
+		res.fileBytes = (long long)stats.numBytes;
+		res.numTriangles = mesh.numTriangles;
+		res.numVertices = (long long)mesh.vertices.size();
+		res.numSubMeshes = (long long)mesh.subMeshes.size();
+		res.numMaterials = (long long)materials.size();
+		res.numThreads = stats.numThreads;
+		res.parseSeconds = stats.parseSeconds;
+		res.dedupSeconds = stats.buildSeconds;
+		if (!best.ok || res.totalSeconds < best.totalSeconds)
+			best = res;
+	}
+	best.peakRssMB = GetPeakRssMB();
+	return best;
+}
+
+// Run a case in a child process (POSIX) so that peak RSS is per case. On
+// Windows it runs in this process and the reported peak is cumulative.
+static CaseResult RunCaseIsolated(const std::string& objPath, const int numThreads, const int repeat)
+{
+	CaseResult res;
+	memset(&res, 0, sizeof(res));
+#ifdef _WIN32
+	res = RunCase(objPath, numThreads, repeat);
+#else
+	int fds[2];
+	if (pipe(fds) != 0)
+		return RunCase(objPath, numThreads, repeat);
+	fflush(stdout);
+	const pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		const CaseResult childRes = RunCase(objPath, numThreads, repeat);
+		const ssize_t written = write(fds[1], &childRes, sizeof(childRes));
+		_exit(written == (ssize_t)sizeof(childRes) ? 0 : 1);
+	}
+	close(fds[1]);
+	if (pid > 0) {
+		if (read(fds[0], &res, sizeof(res)) != (ssize_t)sizeof(res))
+			res.ok = 0;
+		waitpid(pid, nullptr, 0);
+	}
+	close(fds[0]);
+#endif
+	return res;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size()) {
+		const size_t comma = std::min(list.find(',', start), list.size());
+		if (comma > start)
+			items.push_back(list.substr(start, comma - start));
+		start = comma + 1;
+	}
+	return items;
+}
+
+// Triangle counts --sizes accepts.
+const long long MIN_TRIANGLES = 10000;
+const long long MAX_TRIANGLES = 50000000;
+
+static long long ParseCount(const std::string& s)
+{
+	double value = atof(s.c_str());
+	const char suffix = s.empty() ? '\0' : (char)tolower(s.back());
+	if (suffix == 'k')
+		value *= 1e3;
+	else if (suffix == 'm')
+		value *= 1e6;
+	return (long long)value;
+}
+
+static std::string JsonEscape(const std::string& s)
+{
+	std::string out;
+	for (const char c : s) {
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c >= 0x20)
+			out += c;
+	}
+	return out;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: bench_objload [options]\n"
+		"  --sizes 10k,100k,1m   triangle counts, k/m suffixes (10k .. 50m)\n"
+		"  --shapes LIST         any of sphere,soup,materials,ngons (default: all)\n"
+		"  --threads N           parser threads, 0 = all hardware threads (default 0)\n"
+		"  --repeat N            runs per case, the fastest is reported (default 3)\n"
+		"  --dir PATH            where generated files are kept (default bench_data)\n"
+		"  --out FILE            JSON output (default bench_objload.json)\n"
+		"  --label TEXT          stored in the JSON, e.g. a commit hash\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> sizes = SplitList("10k,100k,1m");
+	std::vector<std::string> shapes = SplitList("sphere,soup,materials,ngons");
+	int numThreads = 0;
+	int repeat = 3;
+	std::string dataDir = "bench_data";
+	std::string outPath = "bench_objload.json";
+	std::string label;
+	for (int i = 1; i < argc; i += 2) {
+		const std::string key = argv[i];
+		if (key == "--help" || key == "-h") {
+			PrintUsage();
+			return 1;
+		}
+		if (i + 1 == argc) {
+			fprintf(stderr, "missing value for %s\n", key.c_str());
+			PrintUsage();
+			return 1;
+		}
+		const std::string value = argv[i + 1];
+		if (key == "--sizes")
+			sizes = SplitList(value);
+		else if (key == "--shapes")
+			shapes = SplitList(value);
+		else if (key == "--threads")
+			numThreads = std::max(0, atoi(value.c_str()));
+		else if (key == "--repeat")
+			repeat = std::max(1, atoi(value.c_str()));
+		else if (key == "--dir")
+			dataDir = value;
+		else if (key == "--out")
+			outPath = value;
+		else if (key == "--label")
+			label = value;
+		else {
+			fprintf(stderr, "unknown option %s\n", key.c_str());
+			PrintUsage();
+			return 1;
+		}
+	}
+	for (const std::string& size : sizes) {
+		const long long numTris = ParseCount(size);
+		if (numTris < MIN_TRIANGLES || numTris > MAX_TRIANGLES) {
+			fprintf(stderr, "size %s is out of range\n", size.c_str());
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(dataDir, ec);
+
+	FILE* json = fopen(outPath.c_str(), "w");
+	if (json == nullptr) {
+		fprintf(stderr, "cannot write %s\n", outPath.c_str());
+		return 1;
+	}
+	fprintf(json, "{\n  \"benchmark\": \"objload\",\n  \"label\": \"%s\",\n  \"hardware_threads\": %u,\n"
+			"  \"loader_threads\": %d,\n  \"repeat\": %d,\n  \"cases\": [",
+			JsonEscape(label).c_str(), std::thread::hardware_concurrency(), numThreads, repeat);
+
+	printf("%-10s %10s %9s %8s %8s %8s %8s %8s %9s %10s %9s\n", "shape", "tris", "MB", "parse", "dedup", "mtl",
+		   "norm", "total", "MB/s", "Mtris/s", "peakMB");
+	bool first = true;
+	int failures = 0;
+	for (const std::string& shape : shapes) {
+		for (const std::string& size : sizes) {
+			const long long numTris = ParseCount(size);
+			const std::string base = shape + "_" + std::to_string(numTris);
+			const std::string objPath = (std::filesystem::path(dataDir) / (base + ".obj")).string();
+			if (!std::filesystem::exists(objPath)) {
+				printf("generating %s ...\n", objPath.c_str());
+				fflush(stdout);
+				if (!GenerateCase(objPath, base + ".mtl", shape, numTris)) {
+					fprintf(stderr, "cannot generate %s\n", objPath.c_str());
+					failures++;
+					continue;
+				}
+			}
+
+			const CaseResult res = RunCaseIsolated(objPath, numThreads, repeat);
+			if (!res.ok) {
+				fprintf(stderr, "failed to load %s\n", objPath.c_str());
+				failures++;
+				continue;
+			}
+			const double mb = res.fileBytes / (1024.0 * 1024.0);
+			const double mbPerSecond = mb / res.totalSeconds;
+			const double trisPerSecond = res.numTriangles / res.totalSeconds;
+			printf("%-10s %10lld %9.1f %8.3f %8.3f %8.3f %8.3f %8.3f %9.1f %10.2f %9.1f\n", shape.c_str(),
+				   res.numTriangles, mb, res.parseSeconds, res.dedupSeconds, res.mtlSeconds, res.normalizeSeconds,
+				   res.totalSeconds, mbPerSecond, trisPerSecond * 1e-6, res.peakRssMB);
+			fflush(stdout);
+
+			fprintf(json, "%s\n    {\"shape\": \"%s\", \"target_triangles\": %lld, \"file_bytes\": %lld, "
+					"\"triangles\": %lld, \"vertices\": %lld, \"submeshes\": %lld, \"materials\": %lld, "
+					"\"threads\": %d, \"parse_s\": %.6f, \"dedup_s\": %.6f, \"mtl_s\": %.6f, \"normalize_s\": %.6f, "
+					"\"total_s\": %.6f, \"mb_per_s\": %.3f, \"tris_per_s\": %.0f, \"peak_rss_mb\": %.1f}",
+					first ? "" : ",", shape.c_str(), numTris, res.fileBytes, res.numTriangles, res.numVertices,
+					res.numSubMeshes, res.numMaterials, res.numThreads, res.parseSeconds, res.dedupSeconds,
+					res.mtlSeconds, res.normalizeSeconds, res.totalSeconds, mbPerSecond, trisPerSecond, res.peakRssMB);
+			first = false;
+		}
+	}
+	fprintf(json, "\n  ]\n}\n");
+	fclose(json);
+	printf("results written to %s\n", outPath.c_str());
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// Benchmark: spherical-harmonics projection of skybox panoramas.
+// Projects synthetic 8-bit equirectangular panoramas (W x W/2, BGR) into
+// band 0-2 SH with ProjectPanoramaToSH9 (what the viewer runs when a skybox
+// has no *.sh9 cache yet), single- and multithreaded, and compares it with
+// a per-texel double-precision reference. The single- and multithreaded
+// results must be identical and agree with the reference to within 1e-4.
+//
+// Usage: bench_shproject [options]
+//   --sizes 2048,4096,8192,16384   panorama widths (height is width / 2)
+//   --threads N                    threads for the multithreaded run, 0 = all (default 0)
+//   --repeat N                     runs per case, the fastest is reported (default 3)
+
+#include "sphericalharmonics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(const Clock::time_point t0)
+{
+	return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static const double PI = 3.14159265358979323846;
+
+// A smooth sky gradient with a bright sun and per-texel noise, so that all
+// nine coefficients are non-trivial.
+static void FillPanorama(std::vector<unsigned char>& pixels, const int width, const int height)
+{
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> noise(-12, 12);
+	for (int y = 0; y < height; ++y) {
+		const double v = (y + 0.5) / height;
+		for (int x = 0; x < width; ++x) {
+			const double u = (x + 0.5) / width;
+			const double du = std::min(std::fabs(u - 0.3), 1.0 - std::fabs(u - 0.3)), dv = v - 0.25;
+			const double sun = std::exp(-(du * du + dv * dv) * 400.0);
+			unsigned char* out = &pixels[((size_t)y * width + x) * 3];
+			const double base[3] = { 200.0 - 120.0 * v, 150.0 - 90.0 * v, 90.0 + 20.0 * v };
+			for (int c = 0; c < 3; ++c) {
+				const int value = (int)(base[c] + 255.0 * sun) + noise(rng);
+				out[c] = (unsigned char)std::min(255, std::max(0, value));
+			}
+		}
+	}
+}
+
+// Straightforward per-texel projection in double precision, with the same
+// direction mapping and basis order as sphericalharmonics.cpp.
+static void ReferenceProject(const std::vector<unsigned char>& pixels, const int width, const int height,
+							 double sh[9][3])
+{
+	memset(sh, 0, sizeof(double) * 27);
+	for (int y = 0; y < height; ++y) {
+		const double theta = PI * (y + 0.5) / height;
+		const double dOmega = (2.0 * PI / width) * (PI / height) * std::sin(theta);
+		for (int x = 0; x < width; ++x) {
+			const double phi = 2.0 * PI * (x + 0.5) / width;
+			const double dx = std::sin(theta) * std::cos(phi), dy = std::cos(theta), dz = std::sin(theta) * std::sin(phi);
+			const double basis[9] = {
+				0.282094791773878,
+				0.488602511902920 * dy,
+				0.488602511902920 * dz,
+				0.488602511902920 * dx,
+				1.092548430592079 * dx * dy,
+				1.092548430592079 * dy * dz,
+				0.315391565252520 * (3.0 * dz * dz - 1.0),
+				1.092548430592079 * dx * dz,
+				0.546274215296040 * (dx * dx - dy * dy)
+			};
+			const unsigned char* in = &pixels[((size_t)y * width + x) * 3];
+			// BGR in memory, RGB in the coefficients.
+			const double rgb[3] = { in[2] / 255.0 * dOmega, in[1] / 255.0 * dOmega, in[0] / 255.0 * dOmega };
+			for (int k = 0; k < 9; ++k)
+				for (int c = 0; c < 3; ++c)
+					sh[k][c] += basis[k] * rgb[c];
+		}
+	}
+}
+
+static double MaxDifference(const SH9Color& a, const double b[9][3])
+{
+	double diff = 0.0;
+	for (int k = 0; k < 9; ++k)
+		for (int c = 0; c < 3; ++c)
+			diff = std::max(diff, std::fabs(a.coeffs[k][c] - b[k][c]));
+	return diff;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size()) {
+		const size_t comma = std::min(list.find(',', start), list.size());
+		if (comma > start)
+			items.push_back(list.substr(start, comma - start));
+		start = comma + 1;
+	}
+	return items;
+}
+
+static double Fastest(const int repeat, const std::function<double()>& run)
+{
+	double best = 1e30;
+	for (int r = 0; r < repeat; ++r)
+		best = std::min(best, run());
+	return best;
+}
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: bench_shproject [options]\n"
+		"  --sizes 2048,4096,8192,16384   panorama widths (height is width / 2)\n"
+		"  --threads N                    threads for the multithreaded run, 0 = all (default 0)\n"
+		"  --repeat N                     runs per case, the fastest is reported (default 3)\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> sizes = SplitList("2048,4096,8192,16384");
+	int numThreads = 0;
+	int repeat = 3;
+	for (int i = 1; i < argc; i += 2) {
+		const std::string key = argv[i];
+		if (key == "--help" || key == "-h") {
+			PrintUsage();
+			return 1;
+		}
+		if (i + 1 == argc) {
+			fprintf(stderr, "missing value for %s\n", key.c_str());
+			PrintUsage();
+			return 1;
+		}
+		const std::string value = argv[i + 1];
+		if (key == "--sizes")
+			sizes = SplitList(value);
+		else if (key == "--threads")
+			numThreads = std::max(0, atoi(value.c_str()));
+		else if (key == "--repeat")
+			repeat = std::max(1, atoi(value.c_str()));
+		else {
+			fprintf(stderr, "unknown option %s\n", key.c_str());
+			PrintUsage();
+			return 1;
+		}
+	}
+	const int mtThreads = numThreads > 0 ? numThreads : (int)std::max(1u, std::thread::hardware_concurrency());
+	printf("SIMD: %s, threads: %d\n", GetSH9SimdName(), mtThreads);
+	printf("%-11s %7s | %9s %9s %9s %6s %6s | %9s\n", "size", "MB", "reference", "sh_1t", "sh_mt", "x", "MT/s", "max_err");
+
+	int failures = 0;
+	for (const std::string& size : sizes) {
+		const int width = atoi(size.c_str()), height = width / 2;
+		if (width < 2) {
+			fprintf(stderr, "bad size %s\n", size.c_str());
+			return 1;
+		}
+		std::vector<unsigned char> pixels((size_t)width * height * 3);
+		FillPanorama(pixels, width, height);
+
+		// The per-texel reference is slow: run it once.
+		double reference[9][3];
+		const Clock::time_point t0 = Clock::now();
+		ReferenceProject(pixels, width, height, reference);
+		const double tRef = SecondsSince(t0);
+
+		SH9Color single, multi;
+		const auto timeProjection = [&](SH9Color& sh, const int threads) {
+			return Fastest(repeat, [&]() {
+				const Clock::time_point t1 = Clock::now();
+				ProjectPanoramaToSH9(pixels.data(), width, height, 3, sh, threads);
+				return SecondsSince(t1);
+			});
+		};
+		const double t1 = timeProjection(single, 1);
+		const double tMT = timeProjection(multi, mtThreads);
+		const bool deterministic = (memcmp(single.coeffs, multi.coeffs, sizeof(single.coeffs)) == 0);
+		const double error = MaxDifference(single, reference);
+
+		const double mb = (double)pixels.size() / (1 << 20);
+		const double texelsPerSecond = (double)width * height / tMT;
+		printf("%-11s %7.1f | %9.2f %9.2f %9.2f %5.1fx %6.0f | %9.2e", (size + "x" + std::to_string(height)).c_str(), mb,
+			   tRef * 1e3, t1 * 1e3, tMT * 1e3, t1 / tMT, texelsPerSecond * 1e-6, error);
+		if (!deterministic) {
+			printf("  MISMATCH (result depends on the thread count)");
+			failures++;
+		}
+		if (error > 1e-4) {
+			printf("  MISMATCH (off the reference by %.2e)", error);
+			failures++;
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+// Microbenchmark: face-corner deduplication.
+// Compares the value-keyed std::unordered_map<VertexPTN, int, hashVertex>
+// used by the original loader (find + operator[]) with the index-triple
+// CornerIndexTable used by BuildObjMesh. Reports hash collision rates and
+// insert throughput.
+//
+// Usage: bench_vertexdedup [gridSize]
+
+#include "objparser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <unordered_set>
+
+// The vertex hash of the original loader, kept here as the baseline.
+struct hashVertex
+{
+	size_t operator()(const VertexPTN& v) const {
+		return std::hash<float>() (v.position[0]) ^ std::hash<float>() (v.position[1]) ^ std::hash<float>() (v.position[2])
+			^ std::hash<float>() (v.normal[0]) ^ std::hash<float>() (v.normal[1]) ^ std::hash<float>() (v.normal[2])
+			^ std::hash<float>() (v.texcoord[0]) ^ std::hash<float>() (v.texcoord[1]);
+	}
+};
+
+// CornerStream Declarations.
+// Attribute arrays plus the triangulated corner list, as ObjChunk stores them.
+struct CornerStream
+{
+	const char* name;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners;
+
+	VertexPTN Fetch(const ObjCorner& c) const {
+		return VertexPTN(positions[c.v - 1], normals[c.vn - 1], uvs[c.vt - 1]);
+	}
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(const Clock::time_point t0)
+{
+	return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static void AddQuad(CornerStream& s, const int a, const int b, const int c, const int d, const int n, const int ta, const int tb, const int tc, const int td)
+{
+	const ObjCorner q[4] = { { a, ta, n }, { b, tb, n }, { c, tc, n }, { d, td, n } };
+	const int tri[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int i = 0; i < 6; ++i)
+		s.corners.push_back(q[tri[i]]);
+}
+
+// CAD-like: the six faces of a cube on a regular grid. Coordinates are
+// symmetric around zero, normals are axis-aligned and UVs repeat per face,
+// which is the worst case for an XOR of per-component hashes.
+static CornerStream MakeCadCube(const int n)
+{
+	CornerStream s;
+	s.name = "cad_cube";
+	for (int j = 0; j <= n; ++j)
+		for (int i = 0; i <= n; ++i)
+			s.uvs.push_back(glm::vec2((float)i / n, (float)j / n));
+	const glm::vec3 axes[6] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1} };
+	for (int f = 0; f < 6; ++f) {
+		const glm::vec3 N = axes[f];
+		const glm::vec3 U = (f < 2) ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+		const glm::vec3 V = glm::cross(N, U);
+		s.normals.push_back(N);
+		const int base = (int)s.positions.size();
+		for (int j = 0; j <= n; ++j)
+			for (int i = 0; i <= n; ++i)
+				s.positions.push_back(N + U * (2.0f * i / n - 1.0f) + V * (2.0f * j / n - 1.0f));
+		for (int j = 0; j < n; ++j) {
+			for (int i = 0; i < n; ++i) {
+				const int a = j * (n + 1) + i, b = a + 1, c = a + n + 2, d = a + n + 1;
+				AddQuad(s, base + a + 1, base + b + 1, base + c + 1, base + d + 1, f + 1, a + 1, b + 1, c + 1, d + 1);
+			}
+		}
+	}
+	return s;
+}
+
+// Scan-like: a tessellated sphere with per-vertex normals and irregular values.
+static CornerStream MakeScanSphere(const int n)
+{
+	CornerStream s;
+	s.name = "scan_sphere";
+	const float pi = 3.14159265358979f;
+	for (int j = 0; j <= n; ++j) {
+		for (int i = 0; i <= 2 * n; ++i) {
+			const float theta = pi * j / n, phi = pi * i / n;
+			const glm::vec3 p(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			s.positions.push_back(p * 0.731f);
+			s.normals.push_back(p);
+			s.uvs.push_back(glm::vec2(0.5f * i / n, (float)j / n));
+		}
+	}
+	const int row = 2 * n + 1;
+	for (int j = 0; j < n; ++j) {
+		for (int i = 0; i < 2 * n; ++i) {
+			const int a = j * row + i + 1, b = a + 1, c = a + row + 1, d = a + row;
+			AddQuad(s, a, b, c, d, 0, a, b, c, d);
+			// Per-vertex normals: the corner's normal index equals its position index.
+			for (int k = 6; k > 0; --k)
+				s.corners[s.corners.size() - k].vn = s.corners[s.corners.size() - k].v;
+		}
+	}
+	return s;
+}
+
+template <typename Key, typename Hasher>
+static double FullHashCollisionRate(const std::vector<Key>& uniqueKeys, const Hasher& hasher)
+{
+	std::unordered_set<size_t> hashes;
+	hashes.reserve(uniqueKeys.size());
+	for (const Key& k : uniqueKeys)
+		hashes.insert(hasher(k));
+	return uniqueKeys.empty() ? 0.0 : 1.0 - (double)hashes.size() / uniqueKeys.size();
+}
+
+static void Run(const CornerStream& s)
+{
+	const size_t numCorners = s.corners.size();
+
+	// Baseline: value-keyed map, find followed by operator[] as in the old loader.
+	std::vector<VertexPTN> baselineVertices;
+	std::unordered_map<VertexPTN, int, hashVertex> record;
+	Clock::time_point t0 = Clock::now();
+	int next = 0;
+	unsigned long long checksum0 = 0;
+	for (const ObjCorner& c : s.corners) {
+		VertexPTN temp = s.Fetch(c);
+		if (record.find(temp) != record.end()) {
+			checksum0 += record[temp];
+		}
+		else {
+			record[temp] = next;
+			baselineVertices.push_back(temp);
+			checksum0 += next++;
+		}
+	}
+	const double baselineSeconds = SecondsSince(t0);
+	// Average number of keys sharing the bucket of a stored key.
+	double bucketLoad = 0.0;
+	for (size_t b = 0; b < record.bucket_count(); ++b)
+		bucketLoad += (double)record.bucket_size(b) * record.bucket_size(b);
+	bucketLoad = record.empty() ? 0.0 : bucketLoad / record.size() - 1.0;
+
+	// Index-triple open-addressing table.
+	std::vector<VertexPTN> tableVertices;
+	t0 = Clock::now();
+	CornerIndexTable table(s.positions.size());
+	unsigned long long checksum1 = 0;
+	for (const ObjCorner& c : s.corners) {
+		bool inserted = false;
+		const int id = table.FindOrInsert(c, (int)tableVertices.size(), inserted);
+		if (inserted)
+			tableVertices.push_back(s.Fetch(c));
+		checksum1 += id;
+	}
+	const double tableSeconds = SecondsSince(t0);
+
+	std::vector<ObjCorner> uniqueCorners;
+	{
+		CornerIndexTable seen(s.positions.size());
+		for (const ObjCorner& c : s.corners) {
+			bool inserted = false;
+			seen.FindOrInsert(c, 0, inserted);
+			if (inserted)
+				uniqueCorners.push_back(c);
+		}
+	}
+
+	printf("%-12s corners=%zu unique=%zu%s\n", s.name, numCorners, tableVertices.size(),
+		   (checksum0 == checksum1 && baselineVertices.size() == tableVertices.size()) ? "" : "  [RESULTS DIFFER]");
+	printf("  %-26s hash collisions %6.2f%%  bucket load %6.3f  %8.2f Mcorners/s\n", "unordered_map+hashVertex",
+		   100.0 * FullHashCollisionRate(baselineVertices, hashVertex()), bucketLoad, numCorners / baselineSeconds * 1e-6);
+	printf("  %-26s hash collisions %6.2f%%  extra probes %5.3f  %8.2f Mcorners/s  (%.1fx)\n", "CornerIndexTable",
+		   100.0 * FullHashCollisionRate(uniqueCorners, CornerIndexTable::Hash),
+		   (double)table.GetNumCollisions() / numCorners, numCorners / tableSeconds * 1e-6, baselineSeconds / tableSeconds);
+}
+
+int main(int argc, char** argv)
+{
+	const int n = (argc > 1) ? std::max(2, atoi(argv[1])) : 256;
+	Run(MakeCadCube(n));
+	Run(MakeScanSphere(n));
+	return 0;
+}
@@ -1,17 +1,44 @@
 ﻿#include "headers.h"
 #include "trianglemesh.h"
+#include "scene.h"
 #include "camera.h"
 #include "shaderprog.h"
 #include "light.h"
 #include "imagetexture.h"
 #include "skybox.h"
+#include "asyncmeshloader.h"
+#include "texturecache.h"
+#include "textureresidency.h"
+#include "framestats.h"
+#include "glresourcetracker.h"
+#include "glstatecache.h"
+#include "uniformblocks.h"
 
 
 // Global variables.
 int screenWidth = 600;
 int screenHeight = 600;
-// Triangle mesh.
-TriangleMesh* mesh = nullptr;
+// Scene: the loaded model, placed sceneGridSize x sceneGridSize times on a
+// grid (drawn instanced; 1 = a single copy).
+Scene* scene = nullptr;
+int sceneGridSize = 1;
+// Skip objects and subMeshes outside the view ('c' toggles), and objects
+// whose bounding sphere covers fewer than minObjectPixels (0 = keep all).
+bool sceneCulling = true;
+float minObjectPixels = 0.0f;
+// Draw coarser levels of detail of large meshes while their error stays
+// within lodErrorPixels on screen (0 = always full detail).
+float lodErrorPixels = 1.0f;
+// OBJ parser threads (0 = all hardware threads); small files are parsed serially.
+int objLoaderThreads = 0;
+// Background loader used by the "Load Model" menu entry.
+AsyncMeshLoader meshLoader;
+// GPU memory budget for image textures in MB (0 = unlimited); least recently
+// used textures are demoted or evicted beyond it.
+int textureBudgetMB = 512;
+// Draw the skybox from a cubemap converted from the panorama (cached next to
+// it as *.cube.texbin) instead of a textured sphere.
+bool skyboxCubemap = true;
 // Lights.
 DirectionalLight* dirLight = nullptr;
 PointLight* pointLight = nullptr;
@@ -38,23 +65,16 @@ float zFar = 1000.0f;
 FillColorShaderProg* fillColorShader = nullptr;
 PhongShadingDemoShaderProg* phongShadingShader = nullptr;
 SkyboxShaderProg* skyboxShader = nullptr;
+VirtualSkyboxShaderProg* skyboxVTShader = nullptr;
+VirtualSkyboxShaderProg* skyboxFeedbackShader = nullptr;
+CubemapSkyboxShaderProg* skyboxCubeShader = nullptr;
+// Camera and light data for phongShadingShader (FrameData uniform block).
+UniformBuffer* frameUniformBuffer = nullptr;
 // UI.
 const float lightMoveSpeed = 0.2f;
 // Skybox.
 Skybox* skybox = nullptr;
 
-// SceneObject.
-struct SceneObject
-{
-    SceneObject() {
-        mesh = nullptr;
-        worldMatrix = glm::mat4x4(1.0f);
-    }
-    TriangleMesh* mesh;
-    glm::mat4x4 worldMatrix;
-};
-SceneObject sceneObj;
-
 // ScenePointLight (for visualization of a point light).
 struct ScenePointLight
 {
@@ -79,6 +99,10 @@ void ProcessSpecialKeysCB(int, int, int);
 void ProcessKeysCB(unsigned char, int, int);
 void SetupRenderState();
 void LoadObjects(const std::string&);
+void LoadObjectsAsync(const std::string&);
+void PlaceObjects(TriangleMesh*);
+void UpdateObjectLoading();
+void resetResourse();
 void CreateCamera();
 void CreateSkybox(const std::string);
 void CreateShaderLib();
@@ -87,10 +111,12 @@ void CreateShaderLib();
 
 void ReleaseResources()
 {
+    // Stop a background load.
+    meshLoader.Cancel();
     // Delete scene objects and lights.
-    if (mesh != nullptr) {
-        delete mesh;
-        mesh = nullptr;
+    if (scene != nullptr) {
+        delete scene;
+        scene = nullptr;
     }
     if (pointLight != nullptr) {
         delete pointLight;
@@ -104,6 +130,10 @@ void ReleaseResources()
         delete spotLight;
         spotLight = nullptr;
     }
+    if (skybox != nullptr) {
+        delete skybox;
+        skybox = nullptr;
+    }
     // Delete camera.
     if (camera != nullptr) {
         delete camera;
@@ -122,6 +152,26 @@ void ReleaseResources()
         delete skyboxShader;
         skyboxShader = nullptr;
     }
+    if (skyboxVTShader != nullptr) {
+        delete skyboxVTShader;
+        skyboxVTShader = nullptr;
+    }
+    if (skyboxFeedbackShader != nullptr) {
+        delete skyboxFeedbackShader;
+        skyboxFeedbackShader = nullptr;
+    }
+    if (skyboxCubeShader != nullptr) {
+        delete skyboxCubeShader;
+        skyboxCubeShader = nullptr;
+    }
+    if (frameUniformBuffer != nullptr) {
+        delete frameUniformBuffer;
+        frameUniformBuffer = nullptr;
+    }
+    // Delete shared textures.
+    ImageTexture::ReleaseDefaultTextures();
+    // Everything the viewer created should be gone by now.
+    GLResourceTracker::GetInstance().ReportLeaks();
 }
 
 static float curObjRotationY = 30.0f;
@@ -131,23 +181,33 @@ bool objRotate = false;
 bool skyboxRotate = false;
 void RenderSceneCB()
 {
+    // Nothing below may allocate once the scene has settled (checked in
+    // Debug builds).
+    FrameStats::GetInstance().BeginFrame();
+    GLStateCache& stateCache = GLStateCache::GetInstance();
+    stateCache.BeginFrame();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Pick up a model loaded in the background.
+    UpdateObjectLoading();
+    TextureResidency::GetInstance().BeginFrame();
     
-    TriangleMesh* pMesh = sceneObj.mesh;
-    if (pMesh != nullptr) {
-        // Update transform.
+    if (!scene->IsEmpty()) {
+        // Update transform; it applies to the whole scene, so the objects
+        // keep their instance data. The grid is scaled to fit.
         if (objRotate) {
             curObjRotationY += 50 * rotStep;
         }
-        glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+        const float scale = 1.5f / (float)sceneGridSize;
+        glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(scale, scale, scale));
         glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), glm::radians(curObjRotationY), glm::vec3(0, 1, 0));
-        sceneObj.worldMatrix = S * R;
+        glm::mat4x4 worldMatrix = S * R;
         // -------------------------------------------------------
 		// Note: if you want to compute lighting in the View Space, 
         //       you might need to change the code below.
 		// -------------------------------------------------------
-        glm::mat4x4 normalMatrix = glm::transpose(glm::inverse(sceneObj.worldMatrix));
-        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * sceneObj.worldMatrix;
+        glm::mat4x4 normalMatrix = glm::transpose(glm::inverse(worldMatrix));
+        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * worldMatrix;
         
         // -------------------------------------------------------
 		// Add your rendering code here.
@@ -155,59 +215,57 @@ void RenderSceneCB()
         phongShadingShader->Bind();
 
         // Transformation matrix.
-        glUniformMatrix4fv(phongShadingShader->GetLocM(), 1, GL_FALSE, glm::value_ptr(sceneObj.worldMatrix));
-        glUniformMatrix4fv(phongShadingShader->GetLocNM(), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-        glUniformMatrix4fv(phongShadingShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(phongShadingShader->GetLocCameraPos(), 1, glm::value_ptr(camera->GetCameraPos()));
-        // Light data.
+        stateCache.SetUniformMatrix4fv(phongShadingShader->GetLocM(), glm::value_ptr(worldMatrix));
+        stateCache.SetUniformMatrix4fv(phongShadingShader->GetLocNM(), glm::value_ptr(normalMatrix));
+        stateCache.SetUniformMatrix4fv(phongShadingShader->GetLocMVP(), glm::value_ptr(MVP));
+        // Camera and light data; uploaded only when they changed. Lights
+        // that do not exist stay black.
+        FrameUniforms frameUniforms;
+        frameUniforms.cameraPos = glm::vec4(camera->GetCameraPos(), 1.0f);
         if (dirLight != nullptr) {
-            glUniform3fv(phongShadingShader->GetLocDirLightDir(), 1, glm::value_ptr(dirLight->GetDirection()));
-            glUniform3fv(phongShadingShader->GetLocDirLightRadiance(), 1, glm::value_ptr(dirLight->GetRadiance()));
+            frameUniforms.dirLightDir = glm::vec4(dirLight->GetDirection(), 0.0f);
+            frameUniforms.dirLightRadiance = glm::vec4(dirLight->GetRadiance(), 0.0f);
         }
         if (pointLight != nullptr) {
-            glUniform3fv(phongShadingShader->GetLocPointLightPos(), 1, glm::value_ptr(pointLight->GetPosition()));
-            glUniform3fv(phongShadingShader->GetLocPointLightIntensity(), 1, glm::value_ptr(pointLight->GetIntensity()));
+            frameUniforms.pointLightPos = glm::vec4(pointLight->GetPosition(), 1.0f);
+            frameUniforms.pointLightIntensity = glm::vec4(pointLight->GetIntensity(), 0.0f);
         }
         if (spotLight != nullptr) {
-            glUniform3fv(phongShadingShader->GetLocSpotLightPos(), 1, glm::value_ptr(spotLight->GetPosition()));
-            glUniform3fv(phongShadingShader->GetLocSpotLightIntensity(), 1, glm::value_ptr(spotLight->GetIntensity()));
-            glUniform3fv(phongShadingShader->GetLocSpotLightDirection(), 1, glm::value_ptr(spotLightDirection));
-            glUniform1f(phongShadingShader->GetLocCutoffPos(), spotLight->GetSpotCutoff());
-            glUniform1f(phongShadingShader->GetLocTotalwidthPos(), spotLight->GetSpotTotalwidth());
+            frameUniforms.spotLightPos = glm::vec4(spotLight->GetPosition(), 1.0f);
+            frameUniforms.spotLightIntensity = glm::vec4(spotLight->GetIntensity(), 0.0f);
+            frameUniforms.spotLightDir = glm::vec4(glm::normalize(spotLightDirection), 0.0f);
+            // The shader compares cosines; take them once here, not per pixel.
+            frameUniforms.spotLightCos = glm::vec4(std::cos(spotLight->GetSpotCutoff()),
+                                                   std::cos(spotLight->GetSpotTotalwidth()), 0.0f, 0.0f);
+        }
+        // Ambient light from the skybox panorama, or the constant ambientLight
+        // without a skybox.
+        SH9Color ambientSH = GetConstantAmbientSH9(ambientLight.r, ambientLight.g, ambientLight.b);
+        glm::mat3x3 ambientRotation = glm::mat3x3(1.0f);
+        if (skybox != nullptr && skybox->HasAmbientSH()) {
+            ambientSH = skybox->GetAmbientSH();
+            glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), skybox->GetRotation(), glm::vec3(0, 1, 0));
+            ambientRotation = glm::transpose(glm::mat3x3(R));
         }
-        glUniform3fv(phongShadingShader->GetLocAmbientLight(), 1, glm::value_ptr(ambientLight));
-
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh->Get_vbo());
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), 0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), (const GLvoid*)12);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), (const GLvoid*)24);
-        for (SubMesh& sm : mesh->GetsubMeshes()) {
-            glUniform3fv(phongShadingShader->GetLocKa(), 1, glm::value_ptr(sm.material->GetKa()));
-            if (sm.material->GetMapKd() != nullptr) {
-                sm.material->GetMapKd()->Bind(GL_TEXTURE0);
-                //glUniform1i(phongShadingShader->GetLocHas(), 1); //use a variable to check if there s MapKd,but now we use another method
-                glUniform1i(phongShadingShader->GetLocMapKd(), 0);  
-                glm::vec3 identity = { 1, 1, 1 };
-                glUniform3fv(phongShadingShader->GetLocKd(), 1, glm::value_ptr(identity));
-            }
-            else{
-                ImageTexture* white = new ImageTexture(); //create a 1x1 white texture
-                white->Bind(GL_TEXTURE0);
-                //glUniform1i(phongShadingShader->GetLocHas(), 0); //use a variable to check if there s MapKd,but now we use another method
-                glUniform3fv(phongShadingShader->GetLocKd(), 1, glm::value_ptr(sm.material->GetKd()));
-            }
-            glUniform3fv(phongShadingShader->GetLocKs(), 1, glm::value_ptr(sm.material->GetKs()));
-            glUniform1f(phongShadingShader->GetLocNs(), sm.material->GetNs());
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sm.iboId);
-            glDrawElements(GL_TRIANGLES, sm.vertexIndices.size(), GL_UNSIGNED_INT, 0);
+        for (int k = 0; k < 9; ++k) {
+            const float* c = ambientSH.coeffs[k];
+            frameUniforms.ambientSH[k] = glm::vec4(c[0], c[1], c[2], 0.0f);
         }
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
-        phongShadingShader->UnBind();
+        for (int k = 0; k < 3; ++k)
+            frameUniforms.ambientRotation[k] = glm::vec4(ambientRotation[k], 0.0f);
+        frameUniformBuffer->Update(0, &frameUniforms, sizeof(FrameUniforms));
+        frameUniformBuffer->Bind(UNIFORM_BLOCK_FRAME, 0, sizeof(FrameUniforms));
+
+        // SubMeshes are batched by texture and drawn once for all objects of
+        // their mesh; materials were uploaded with the model, and textureless
+        // ones sample a shared 1x1 white texture.
+        // Objects and subMeshes outside the view are culled in scene space;
+        // worldMatrix scales uniformly, so projected sizes need no rescaling.
+        SceneView view;
+        view.frustum = camera->GetFrustum(worldMatrix);
+        view.eyePos = glm::vec3(glm::inverse(worldMatrix) * glm::vec4(camera->GetCameraPos(), 1.0f));
+        view.pixelScale = camera->GetProjMatrix()[1][1] * 0.5f * (float)screenHeight;
+        scene->Draw(phongShadingShader, view);
 		// -------------------------------------------------------
     }
     // -------------------------------------------------------------------------------------------
@@ -219,11 +277,10 @@ void RenderSceneCB()
         pointLightObj.worldMatrix = T;
         glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * pointLightObj.worldMatrix;
         fillColorShader->Bind();
-        glUniformMatrix4fv(fillColorShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(pointLightObj.visColor));
+        stateCache.SetUniformMatrix4fv(fillColorShader->GetLocMVP(), glm::value_ptr(MVP));
+        stateCache.SetUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(pointLightObj.visColor));
         // Render the point light.
         pointLight->Draw();
-        fillColorShader->UnBind();
     }
     SpotLight* spotLight = (SpotLight*)(spotLightObj.light);
     if (spotLight != nullptr) {
@@ -231,11 +288,10 @@ void RenderSceneCB()
         spotLightObj.worldMatrix = T;
         glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * spotLightObj.worldMatrix;
         fillColorShader->Bind();
-        glUniformMatrix4fv(fillColorShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(spotLightObj.visColor));
+        stateCache.SetUniformMatrix4fv(fillColorShader->GetLocMVP(), glm::value_ptr(MVP));
+        stateCache.SetUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(spotLightObj.visColor));
         // Render the spot light.
         spotLight->Draw();
-        fillColorShader->UnBind();
     }
     // -------------------------------------------------------------------------------------------
 
@@ -248,11 +304,12 @@ void RenderSceneCB()
         }
         skybox->SetRotation(skyboxRotationY);
         // -------------------------------------------------------
-        skybox->Render(camera, skyboxShader);
+        skybox->Render(camera, skyboxShader, skyboxVTShader, skyboxFeedbackShader, skyboxCubeShader);
     }
     // -------------------------------------------------------------------------------------------
 
     glutSwapBuffers();
+    FrameStats::GetInstance().EndFrame();
 }
 
 void ReshapeCB(int w, int h)
@@ -261,6 +318,8 @@ void ReshapeCB(int w, int h)
     screenWidth = w;
     screenHeight = h;
     glViewport(0, 0, screenWidth, screenHeight);
+    // Size-dependent targets (skybox feedback) are recreated.
+    FrameStats::GetInstance().Invalidate();
     // Adjust camera and projection.
     float aspectRatio = (float)screenWidth / (float)screenHeight;
     camera->UpdateProjection(fovy, aspectRatio, zNear, zFar);
@@ -346,19 +405,38 @@ void ProcessKeysCB(unsigned char key, int x, int y)
         skyboxRotate = !skyboxRotate;
     }
     // press "e" to change if object should rotate
-    if (key == 'e' && sceneObj.mesh != nullptr) {
+    if (key == 'e' && !scene->IsEmpty()) {
         objRotate = !objRotate;
     }
     // press "`"(~) to delete skybox
     if (key == '`') {
         delete skybox;
         skybox = nullptr;
+        FrameStats::GetInstance().Invalidate();
+    }
+    // press "c" to switch view culling on or off
+    if (key == 'c') {
+        sceneCulling = !sceneCulling;
+        scene->SetCulling(sceneCulling);
+    }
+    // press "t" to print texture and GL memory, culling and frame statistics
+    if (key == 't') {
+        scene->ShowCullStats();
+        TextureCache::GetInstance().ShowStats();
+        TextureResidency::GetInstance().ShowStats();
+        if (skybox != nullptr && skybox->IsStreamed())
+            skybox->GetVirtualTexture()->ShowStats();
+        GLResourceTracker::GetInstance().ShowStats();
+        GLStateCache::GetInstance().ShowStats();
+        FrameStats::GetInstance().ShowStats();
     }
 }
 
 void SetupRenderState()
 {
     glEnable(GL_DEPTH_TEST);
+    // Filter cubemaps across face edges.
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     glm::vec4 clearColor = glm::vec4(0.44f, 0.57f, 0.75f, 1.00f);
     glClearColor(
@@ -376,10 +454,64 @@ void LoadObjects(const std::string& modelPath)
     //       the model dynamically.
 	// -------------------------------------------------------
 
-    mesh = new TriangleMesh();
+    TriangleMesh* mesh = new TriangleMesh();
+    ObjLoadOptions loadOptions;
+    loadOptions.numThreads = objLoaderThreads;
+    mesh->SetLoadOptions(loadOptions);
     mesh->LoadFromFile(modelPath, true);
     mesh->ShowInfo();
-    sceneObj.mesh = mesh;    
+    PlaceObjects(mesh);
+    FrameStats::GetInstance().Invalidate();
+}
+
+void PlaceObjects(TriangleMesh* mesh)
+{
+    // The new model replaces the old one.
+    resetResourse();
+    scene->AddMesh(mesh);
+    // Models are normalized to unit size; leave a gap between the copies.
+    const float spacing = 1.25f;
+    const float offset = 0.5f * spacing * (float)(sceneGridSize - 1);
+    for (int z = 0; z < sceneGridSize; ++z) {
+        for (int x = 0; x < sceneGridSize; ++x) {
+            glm::vec3 position = glm::vec3(spacing * x - offset, 0.0f, spacing * z - offset);
+            scene->AddObject(mesh, glm::translate(glm::mat4x4(1.0f), position));
+        }
+    }
+    scene->ShowInfo();
+}
+
+void LoadObjectsAsync(const std::string& modelPath)
+{
+    // The current model stays on screen until the new one can be drawn.
+    ObjLoadOptions loadOptions;
+    loadOptions.numThreads = objLoaderThreads;
+    meshLoader.Start(modelPath, true, loadOptions);
+}
+
+void UpdateObjectLoading()
+{
+    TriangleMesh* loaded = meshLoader.Update();
+    if (loaded != nullptr) {
+        loaded->ShowInfo();
+        PlaceObjects(loaded);
+    }
+
+    // Uploads and the new mesh's first frames allocate.
+    if (meshLoader.IsLoading() || loaded != nullptr)
+        FrameStats::GetInstance().Invalidate();
+
+    // Show the progress in the window title.
+    static int shownPercent = -1;
+    const int percent = meshLoader.IsLoading() ? (int)(100.0f * meshLoader.GetProgress()) : -1;
+    if (percent != shownPercent) {
+        FrameStats::GetInstance().Invalidate();
+        shownPercent = percent;
+        std::string title = "Texture Mapping";
+        if (percent >= 0)
+            title += " - Loading " + std::to_string(percent) + "%";
+        glutSetWindowTitle(title.c_str());
+    }
 }
 
 void CreateLights()
@@ -417,6 +549,7 @@ void CreateSkybox(const std::string texFilePath)
     const int numStacks = 18;
     const float radius = 50.0f;
     skybox = new Skybox(texFilePath, numSlices, numStacks, radius);
+    FrameStats::GetInstance().Invalidate();
 }
 
 void CreateShaderLib()
@@ -432,16 +565,27 @@ void CreateShaderLib()
     skyboxShader = new SkyboxShaderProg();
     if (!skyboxShader->LoadFromFiles("shaders/skybox.vs", "shaders/skybox.fs"))
         exit(1);
+
+    skyboxVTShader = new VirtualSkyboxShaderProg();
+    if (!skyboxVTShader->LoadFromFiles("shaders/skybox.vs", "shaders/skybox_vt.fs"))
+        exit(1);
+
+    skyboxFeedbackShader = new VirtualSkyboxShaderProg();
+    if (!skyboxFeedbackShader->LoadFromFiles("shaders/skybox.vs", "shaders/skybox_vt_feedback.fs"))
+        exit(1);
+
+    skyboxCubeShader = new CubemapSkyboxShaderProg();
+    if (!skyboxCubeShader->LoadFromFiles("shaders/skybox_cube.vs", "shaders/skybox_cube.fs"))
+        exit(1);
+
+    frameUniformBuffer = new UniformBuffer();
+    frameUniformBuffer->Create(sizeof(FrameUniforms), nullptr, "Frame uniforms");
 }
 // method related to careate pop-up menu
 void resetResourse()
 {
     // Release memory if needed.
-    // Add your code here.
-    if (mesh != NULL) {
-        delete mesh;
-        mesh = new TriangleMesh();
-    }
+    scene->Clear();
 }
 
 void processMenuEvents(int option) {
@@ -454,7 +598,7 @@ void processMenuEvents(int option) {
         ofn.lpstrFile = szFile;
         ofn.hwndOwner = NULL;
         ofn.nMaxFile = sizeof(szFile) / sizeof(wchar_t);
-        ofn.lpstrFilter = L"OBJ Files\0*.obj\0All Files\0*.*\0";
+        ofn.lpstrFilter = L"OBJ Files\0*.obj;*.obj.gz;*.obj.zst\0All Files\0*.*\0";
         ofn.nFilterIndex = 1;
         ofn.lpstrFileTitle = NULL;
         ofn.nMaxFileTitle = 0;
@@ -466,8 +610,7 @@ void processMenuEvents(int option) {
             char filePath[300];
             WideCharToMultiByte(CP_UTF8, 0, szFile, -1, filePath, 300, NULL, NULL);
             std::string file(filePath);
-            resetResourse();
-            LoadObjects(file);
+            LoadObjectsAsync(file);
         }
     }
     if (option == 2) {
@@ -478,7 +621,7 @@ void processMenuEvents(int option) {
         ofn.lpstrFile = szFile;
         ofn.hwndOwner = NULL;
         ofn.nMaxFile = sizeof(szFile) / sizeof(wchar_t);
-        ofn.lpstrFilter = L"PNG Files\0*.png\0All Files\0*.*\0";
+        ofn.lpstrFilter = L"Image Files\0*.png;*.jpg;*.jpeg\0All Files\0*.*\0";
         ofn.nFilterIndex = 1;
         ofn.lpstrFileTitle = NULL;
         ofn.nMaxFileTitle = 0;
@@ -494,6 +637,9 @@ void processMenuEvents(int option) {
             CreateSkybox(file);
         }
     }
+    if (option == 3) {
+        meshLoader.Cancel();
+    }
 }
 
 void createGLUTMenus() {
@@ -508,6 +654,7 @@ void createGLUTMenus() {
     //add entries to our menu
     glutAddMenuEntry("Load Model", 1);
     glutAddMenuEntry("Load Skybox", 2);
+    glutAddMenuEntry("Cancel Loading", 3);
 
     // attach the menu to the right button
     glutAttachMenu(GLUT_RIGHT_BUTTON);
@@ -537,7 +684,12 @@ int main(int argc, char** argv)
 
     // Initialization.
     SetupRenderState();
-    LoadObjects("..\\TestModels_HW3\\Koffing\\Koffing.obj");
+    TextureResidency::GetInstance().SetBudget((size_t)textureBudgetMB << 20);
+    Skybox::SetUseCubemap(skyboxCubemap);
+    scene = new Scene();
+    scene->SetCulling(sceneCulling);
+    scene->SetMinPixelSize(minObjectPixels);
+    scene->SetLODErrorPixels(lodErrorPixels);
     LoadObjects("..\\TestModels_HW3\\Gengar\\Gengar.obj");
     CreateLights();
     CreateCamera();
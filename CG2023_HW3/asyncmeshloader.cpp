@@ -0,0 +1,85 @@
+#include "asyncmeshloader.h"
+
+AsyncMeshLoader::AsyncMeshLoader()
+	: workerDone(false)
+{
+	workerSucceeded = false;
+	uploading = nullptr;
+	uploadBudget = 16u << 20;
+}
+
+AsyncMeshLoader::~AsyncMeshLoader()
+{
+	Cancel();
+	if (worker.joinable())
+		worker.join();
+}
+
+void AsyncMeshLoader::Start(const std::string& path, const bool normalized, const ObjLoadOptions& options)
+{
+	Cancel();
+	if (worker.joinable())
+		worker.join();
+	FinishUploads();
+
+	filePath = path;
+	textureDecoder.Clear();
+	progress.Reset();
+	meshData = MeshCacheData();
+	workerDone = false;
+	workerSucceeded = false;
+	worker = std::thread([this, path, normalized, options]() {
+		workerSucceeded = TriangleMesh::LoadMeshData(path, normalized, options, meshData, &progress, &textureDecoder);
+		workerDone = true;
+	});
+}
+
+void AsyncMeshLoader::Cancel()
+{
+	progress.Cancel();
+}
+
+TriangleMesh* AsyncMeshLoader::Update()
+{
+	if (uploading != nullptr && uploading->CreateSubMeshBuffers(uploadBudget))
+		uploading = nullptr;
+
+	if (!worker.joinable() || !workerDone)
+		return nullptr;
+	// Let the remaining texture decodes finish off the GL thread.
+	if (workerSucceeded && !textureDecoder.IsIdle())
+		return nullptr;
+	worker.join();
+	if (!workerSucceeded) {
+		std::cerr << "[WARNING] Model not loaded: " << filePath << std::endl;
+		meshData = MeshCacheData();
+		textureDecoder.Clear();
+		return nullptr;
+	}
+
+	TriangleMesh* mesh = new TriangleMesh();
+	mesh->SetMeshData(meshData, &textureDecoder);
+	meshData = MeshCacheData();
+	textureDecoder.Clear();
+	mesh->CreateVertexBuffer();
+	if (!mesh->CreateSubMeshBuffers(uploadBudget))
+		uploading = mesh;
+	return mesh;
+}
+
+float AsyncMeshLoader::GetProgress() const
+{
+	if (uploading != nullptr)
+		return OBJ_PROGRESS_BUILT + (1.0f - OBJ_PROGRESS_BUILT) * 0.5f;
+	return worker.joinable() ? progress.Get() : 1.0f;
+}
+
+void AsyncMeshLoader::FinishUploads()
+{
+	// The previous mesh is about to be replaced; it must be complete before
+	// its owner may delete it.
+	if (uploading != nullptr) {
+		uploading->CreateSubMeshBuffers((size_t)-1);
+		uploading = nullptr;
+	}
+}
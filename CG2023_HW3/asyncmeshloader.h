@@ -0,0 +1,61 @@
+#ifndef ASYNC_MESH_LOADER_H
+#define ASYNC_MESH_LOADER_H
+
+#include "headers.h"
+#include "trianglemesh.h"
+#include "texturedecoder.h"
+
+#include <thread>
+#include <atomic>
+
+// AsyncMeshLoader Declarations.
+// Loads a TriangleMesh without blocking the render loop. File reading and
+// parsing run on a worker thread and texture images decode on the
+// TextureDecoder's threads; everything that needs GL (texture uploads,
+// buffers) is done in Update(), which must be called once per frame on the
+// GL thread.
+class AsyncMeshLoader
+{
+public:
+	// AsyncMeshLoader Public Methods.
+	AsyncMeshLoader();
+	~AsyncMeshLoader();
+
+	// Start loading a model. A load that is still running is cancelled first.
+	void Start(const std::string& filePath, const bool normalized, const ObjLoadOptions& options);
+	// Ask the worker to stop; it gives up at the next chunk of work.
+	void Cancel();
+
+	// Advance the GL side of the load. Returns the new mesh once its vertex
+	// buffer and first SubMesh are on the GPU (once per load; the caller owns
+	// it from then on). Its remaining SubMeshes keep uploading, about
+	// uploadBudget bytes per call, and become visible as they arrive.
+	TriangleMesh* Update();
+
+	// True from Start until the mesh is fully uploaded, failed or cancelled.
+	bool IsLoading() const { return worker.joinable() || uploading != nullptr; }
+	// Progress of the current load in [0, 1].
+	float GetProgress() const;
+	const std::string& GetFilePath() const { return filePath; }
+
+	void SetUploadBudget(const size_t bytesPerFrame) { uploadBudget = bytesPerFrame; }
+
+private:
+	// AsyncMeshLoader Private Methods.
+	void FinishUploads();
+
+	// AsyncMeshLoader Private Data.
+	std::string filePath;
+	std::thread worker;
+	std::atomic<bool> workerDone;
+	bool workerSucceeded;
+	ObjLoadProgress progress;
+	MeshCacheData meshData;
+	// Decodes the textures while the worker parses the geometry.
+	TextureDecoder textureDecoder;
+	// Handed-out mesh whose SubMesh buffers are not all created yet.
+	TriangleMesh* uploading;
+	size_t uploadBudget;
+};
+
+#endif
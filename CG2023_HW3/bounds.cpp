@@ -0,0 +1,119 @@
+#include "bounds.h"
+
+// C++ STL headers.
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+void AABB::Reset()
+{
+	pMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	pMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+void AABB::Expand(const glm::vec3& p)
+{
+	pMin = glm::min(pMin, p);
+	pMax = glm::max(pMax, p);
+}
+
+void AABB::Expand(const AABB& box)
+{
+	pMin = glm::min(pMin, box.pMin);
+	pMax = glm::max(pMax, box.pMax);
+}
+
+AABB AABB::Transform(const glm::mat4x4& m) const
+{
+	if (IsEmpty())
+		return *this;
+	// Transform the center and add up the extents the columns contribute
+	// (Arvo), instead of transforming all eight corners.
+	const glm::vec3 center = glm::vec3(m * glm::vec4(GetCenter(), 1.0f));
+	const glm::vec3 halfExtent = 0.5f * (pMax - pMin);
+	glm::vec3 newHalfExtent = glm::vec3(0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < 3; ++i)
+		newHalfExtent += glm::abs(glm::vec3(m[i])) * halfExtent[i];
+	AABB box;
+	box.pMin = center - newHalfExtent;
+	box.pMax = center + newHalfExtent;
+	return box;
+}
+
+BoundingSphere BoundingSphere::Transform(const glm::mat4x4& m) const
+{
+	BoundingSphere sphere;
+	sphere.center = glm::vec3(m * glm::vec4(center, 1.0f));
+	// Scaled by the longest axis.
+	const float scale2 = std::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+								  std::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])),
+										   glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))));
+	sphere.radius = radius * std::sqrt(scale2);
+	return sphere;
+}
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; ++i)
+		planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void Frustum::Extract(const glm::mat4x4& clipMatrix)
+{
+	// Rows of the matrix; GLM stores columns.
+	const glm::mat4x4 rows = glm::transpose(clipMatrix);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (int i = 0; i < 6; ++i) {
+		const float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+			planes[i] /= length;
+	}
+}
+
+Frustum Frustum::Transform(const glm::mat4x4& m) const
+{
+	// dot(plane, m * p) = dot(transpose(m) * plane, p).
+	const glm::mat4x4 mT = glm::transpose(m);
+	Frustum frustum;
+	for (int i = 0; i < 6; ++i) {
+		frustum.planes[i] = mT * planes[i];
+		const float length = glm::length(glm::vec3(frustum.planes[i]));
+		if (length > 0.0f)
+			frustum.planes[i] /= length;
+	}
+	return frustum;
+}
+
+FrustumTest Frustum::Test(const AABB& box) const
+{
+	if (box.IsEmpty())
+		return FRUSTUM_OUTSIDE;
+	const glm::vec3 center = box.GetCenter();
+	const glm::vec3 halfExtent = 0.5f * (box.pMax - box.pMin);
+	FrustumTest result = FRUSTUM_INSIDE;
+	for (int i = 0; i < 6; ++i) {
+		const glm::vec3 normal = glm::vec3(planes[i]);
+		// Signed distance of the center, and the box's reach along normal.
+		const float distance = glm::dot(normal, center) + planes[i].w;
+		const float reach = glm::dot(glm::abs(normal), halfExtent);
+		if (distance < -reach)
+			return FRUSTUM_OUTSIDE;
+		if (distance < reach)
+			result = FRUSTUM_INTERSECTS;
+	}
+	return result;
+}
+
+bool Frustum::IsOutside(const BoundingSphere& sphere) const
+{
+	for (int i = 0; i < 6; ++i) {
+		if (glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+			return true;
+	}
+	return false;
+}
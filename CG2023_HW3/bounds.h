@@ -0,0 +1,68 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+// GLM.
+#include <glm.hpp>
+
+// AABB Declarations.
+// Axis-aligned box; empty (pMin > pMax) until a point is added.
+struct AABB
+{
+	AABB() { Reset(); }
+
+	void Reset();
+	bool IsEmpty() const { return pMin.x > pMax.x; }
+	void Expand(const glm::vec3& p);
+	void Expand(const AABB& box);
+	glm::vec3 GetCenter() const { return 0.5f * (pMin + pMax); }
+	// The box around this one transformed by m.
+	AABB Transform(const glm::mat4x4& m) const;
+	bool operator==(const AABB& box) const { return pMin == box.pMin && pMax == box.pMax; }
+
+	glm::vec3 pMin;
+	glm::vec3 pMax;
+};
+
+// BoundingSphere Declarations.
+struct BoundingSphere
+{
+	BoundingSphere() {
+		center = glm::vec3(0.0f, 0.0f, 0.0f);
+		radius = 0.0f;
+	}
+
+	// The sphere around this one transformed by m.
+	BoundingSphere Transform(const glm::mat4x4& m) const;
+
+	glm::vec3 center;
+	float radius;
+};
+
+// FrustumTest Declarations.
+enum FrustumTest
+{
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECTS,
+	FRUSTUM_INSIDE
+};
+
+// Frustum Declarations.
+// The six clip planes of a projection, each as (inward unit normal, d) with
+// dot(normal, p) + d >= 0 inside.
+struct Frustum
+{
+	Frustum();
+
+	// Extract the planes from a clip matrix (Gribb and Hartmann). Given
+	// proj * view * world, the planes are in the space world maps from.
+	void Extract(const glm::mat4x4& clipMatrix);
+	// The planes in the space m maps from.
+	Frustum Transform(const glm::mat4x4& m) const;
+	FrustumTest Test(const AABB& box) const;
+	bool IsOutside(const BoundingSphere& sphere) const;
+
+	// Left, right, bottom, top, near, far.
+	glm::vec4 planes[6];
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "bvh.h"
+
+// C++ STL headers.
+#include <algorithm>
+
+BVH::BVH()
+{
+}
+
+void BVH::Clear()
+{
+	nodes.clear();
+	primBounds.clear();
+	primIndices.clear();
+	primLeaf.clear();
+}
+
+void BVH::Build(const std::vector<AABB>& boxes)
+{
+	Clear();
+	if (boxes.empty())
+		return;
+	primBounds = boxes;
+	primIndices.resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i)
+		primIndices[i] = (int)i;
+	primLeaf.assign(boxes.size(), -1);
+	// A binary tree with leaves of one or more primitives has fewer than
+	// twice as many nodes as primitives.
+	nodes.reserve(2 * boxes.size());
+	BuildNode(0, (int)boxes.size(), -1);
+}
+
+int BVH::BuildNode(const int first, const int count, const int parent)
+{
+	const int index = (int)nodes.size();
+	nodes.push_back(BVHNode());
+	BVHNode node;
+	node.first = first;
+	node.count = count;
+	node.left = -1;
+	node.right = -1;
+	node.parent = parent;
+	AABB centroids;
+	for (int i = first; i < first + count; ++i) {
+		node.bounds.Expand(primBounds[primIndices[i]]);
+		centroids.Expand(primBounds[primIndices[i]].GetCenter());
+	}
+
+	const glm::vec3 extent = centroids.pMax - centroids.pMin;
+	const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+	if (count <= MAX_LEAF_PRIMITIVES || extent[axis] <= 0.0f) {
+		for (int i = first; i < first + count; ++i)
+			primLeaf[primIndices[i]] = index;
+		nodes[index] = node;
+		return index;
+	}
+	// Split at the median centroid.
+	const int half = count / 2;
+	std::nth_element(primIndices.begin() + first, primIndices.begin() + first + half,
+					 primIndices.begin() + first + count, [this, axis](const int a, const int b) {
+						 return primBounds[a].GetCenter()[axis] < primBounds[b].GetCenter()[axis];
+					 });
+	node.left = BuildNode(first, half, index);
+	node.right = BuildNode(first + half, count - half, index);
+	nodes[index] = node;
+	return index;
+}
+
+void BVH::Refit(const int primitive, const AABB& box)
+{
+	if (primitive < 0 || primitive >= (int)primLeaf.size())
+		return;
+	primBounds[primitive] = box;
+	int index = primLeaf[primitive];
+	while (index >= 0) {
+		BVHNode& node = nodes[index];
+		AABB bounds;
+		if (node.left < 0) {
+			for (int i = node.first; i < node.first + node.count; ++i)
+				bounds.Expand(primBounds[primIndices[i]]);
+		}
+		else {
+			bounds.Expand(nodes[node.left].bounds);
+			bounds.Expand(nodes[node.right].bounds);
+		}
+		// The ancestors already enclose it.
+		if (bounds == node.bounds)
+			break;
+		node.bounds = bounds;
+		index = node.parent;
+	}
+}
+
+void BVH::AddAll(const BVHNode& node, std::vector<BVHHit>& hits) const
+{
+	for (int i = node.first; i < node.first + node.count; ++i)
+		hits.push_back({ primIndices[i], true });
+}
+
+void BVH::Cull(const Frustum& frustum, std::vector<BVHHit>& hits) const
+{
+	if (nodes.empty())
+		return;
+	// Median splits keep the depth near log2 of the primitive count.
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const BVHNode& node = nodes[stack[--stackSize]];
+		const FrustumTest test = frustum.Test(node.bounds);
+		if (test == FRUSTUM_OUTSIDE)
+			continue;
+		if (test == FRUSTUM_INSIDE) {
+			AddAll(node, hits);
+			continue;
+		}
+		if (node.left >= 0 && stackSize + 2 <= 64) {
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = node.left;
+			continue;
+		}
+		// A leaf: test its primitives one by one.
+		for (int i = node.first; i < node.first + node.count; ++i) {
+			const FrustumTest primTest = frustum.Test(primBounds[primIndices[i]]);
+			if (primTest != FRUSTUM_OUTSIDE)
+				hits.push_back({ primIndices[i], primTest == FRUSTUM_INSIDE });
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "headers.h"
+#include "bounds.h"
+
+// BVHHit Declarations.
+// A primitive that passed BVH::Cull.
+struct BVHHit
+{
+	int primitive;
+	// Entirely within the frustum; its parts need no further tests.
+	bool inside;
+};
+
+// BVH Declarations.
+// Bounding volume hierarchy over a set of boxes (primitive i is box i).
+// Built top-down by splitting at the median centroid of the longest axis;
+// boxes that move are refit in place, which keeps the tree valid but lets it
+// loosen, so callers rebuild after large changes.
+class BVH
+{
+public:
+	// BVH Public Methods.
+	BVH();
+
+	void Build(const std::vector<AABB>& boxes);
+	void Clear();
+	bool IsBuilt() const { return !nodes.empty(); }
+	// Change the box of a primitive and grow or shrink its ancestors.
+	void Refit(const int primitive, const AABB& box);
+	// Append the primitives that are not outside frustum to hits. Subtrees
+	// entirely inside are taken without testing their primitives.
+	void Cull(const Frustum& frustum, std::vector<BVHHit>& hits) const;
+
+	int GetNumNodes() const { return (int)nodes.size(); }
+
+private:
+	// BVHNode Declarations.
+	struct BVHNode
+	{
+		AABB bounds;
+		// The node's primitives are primIndices[first, first + count); leaves
+		// have no children (left = right = -1).
+		int first;
+		int count;
+		int left;
+		int right;
+		int parent;
+	};
+
+	// BVH Private Methods.
+	int BuildNode(const int first, const int count, const int parent);
+	void AddAll(const BVHNode& node, std::vector<BVHHit>& hits) const;
+
+	// BVH Private Data.
+	static const int MAX_LEAF_PRIMITIVES = 4;
+	std::vector<BVHNode> nodes;
+	std::vector<AABB> primBounds;
+	// Primitives in tree order; every node covers a contiguous range.
+	std::vector<int> primIndices;
+	// The leaf holding each primitive.
+	std::vector<int> primLeaf;
+};
+
+#endif
@@ -15,6 +15,13 @@ Camera::Camera(const float aspectRatio)
 Camera::~Camera() 
 {}
 
+Frustum Camera::GetFrustum(const glm::mat4x4& worldMatrix) const
+{
+	Frustum frustum;
+	frustum.Extract(projMatrix * viewMatrix * worldMatrix);
+	return frustum;
+}
+
 void Camera::UpdateView(const glm::vec3 newPos, const glm::vec3 newTarget, const glm::vec3 up)
 {
 	position = newPos;
@@ -2,6 +2,7 @@
 #define CAMERA_H
 
 #include "headers.h"
+#include "bounds.h"
 
 // Camera Declarations.
 class Camera {
@@ -13,6 +14,8 @@ public:
 	glm::vec3& GetCameraPos() { return position; }
 	glm::mat4x4& GetViewMatrix() { return viewMatrix; }
 	glm::mat4x4& GetProjMatrix() { return projMatrix; }
+	// The view frustum in the space worldMatrix maps from.
+	Frustum GetFrustum(const glm::mat4x4& worldMatrix) const;
 
 	void UpdateView(const glm::vec3 newPos, const glm::vec3 newTarget, const glm::vec3 up);
 	void UpdateProjection(const float fovyInDegree, const float aspectRatio, const float zNear, const float zFar);
@@ -0,0 +1,104 @@
+#include "cubemap.h"
+
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+const float PI = 3.14159265358979f;
+
+// Bilinear sample of the panorama at (u, v) in [0, 1], added to sum; u
+// wraps around, v is clamped at the poles.
+void AddPanoramaSample(const unsigned char* src, const int width, const int height, const int channels,
+					   const float u, const float v, float* sum)
+{
+	const float x = u * width - 0.5f, y = std::min(std::max(v * height - 0.5f, 0.0f), (float)(height - 1));
+	const int x0 = (int)std::floor(x), y0 = (int)y;
+	const float fx = x - x0, fy = y - y0;
+	const int xa = (x0 % width + width) % width, xb = (xa + 1) % width;
+	const int y1 = std::min(y0 + 1, height - 1);
+	const unsigned char* r0 = src + (size_t)y0 * width * channels;
+	const unsigned char* r1 = src + (size_t)y1 * width * channels;
+	for (int c = 0; c < channels; ++c) {
+		const float top = r0[xa * channels + c] + fx * (r0[xb * channels + c] - r0[xa * channels + c]);
+		const float bottom = r1[xa * channels + c] + fx * (r1[xb * channels + c] - r1[xa * channels + c]);
+		sum[c] += top + fy * (bottom - top);
+	}
+}
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+int GetCubemapFaceSize(const int panoramaWidth)
+{
+	int size = 1;
+	while (size * 2 <= panoramaWidth / 4 && size * 2 <= CUBEMAP_MAX_FACE_SIZE)
+		size *= 2;
+	return size;
+}
+
+void GetCubemapDirection(const int face, const float s, const float t, float dir[3])
+{
+	// The major axis and the (sc, tc) axes of each face, from the GL spec.
+	const float a = 2.0f * s - 1.0f, b = 2.0f * t - 1.0f;
+	switch (face) {
+	case 0: dir[0] = 1.0f; dir[1] = -b; dir[2] = -a; break;
+	case 1: dir[0] = -1.0f; dir[1] = -b; dir[2] = a; break;
+	case 2: dir[0] = a; dir[1] = 1.0f; dir[2] = b; break;
+	case 3: dir[0] = a; dir[1] = -1.0f; dir[2] = -b; break;
+	case 4: dir[0] = a; dir[1] = -b; dir[2] = 1.0f; break;
+	default: dir[0] = -a; dir[1] = -b; dir[2] = -1.0f; break;
+	}
+}
+
+bool ConvertEquirectToCubemap(const unsigned char* src, const int width, const int height, const int channels,
+							  const int faceSize, unsigned char* dst, const int numThreads)
+{
+	if (width <= 0 || height <= 0 || faceSize <= 0 || (channels != 1 && channels != 3 && channels != 4))
+		return false;
+
+	// Rows of all six faces are handed out to the threads in batches.
+	const int numRows = 6 * faceSize;
+	const int rowsPerJob = std::max(1, (1 << 14) / faceSize);
+	const int numJobs = (numRows + rowsPerJob - 1) / rowsPerJob;
+	int threads = numThreads > 0 ? numThreads : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, numJobs));
+
+	std::atomic<int> nextJob(0);
+	const auto worker = [&]() {
+		for (int job = nextJob++; job < numJobs; job = nextJob++) {
+			const int rowEnd = std::min(numRows, (job + 1) * rowsPerJob);
+			for (int row = job * rowsPerJob; row < rowEnd; ++row) {
+				const int face = row / faceSize, j = row % faceSize;
+				unsigned char* out = dst + (size_t)row * faceSize * channels;
+				for (int i = 0; i < faceSize; ++i) {
+					float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (int k = 0; k < 4; ++k) {
+						float dir[3];
+						GetCubemapDirection(face, (i + 0.25f + 0.5f * (k & 1)) / faceSize,
+											(j + 0.25f + 0.5f * (k >> 1)) / faceSize, dir);
+						const float len = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+						float u = std::atan2(dir[2], dir[0]) / (2.0f * PI);
+						if (u < 0.0f)
+							u += 1.0f;
+						const float v = std::acos(std::min(std::max(dir[1] / len, -1.0f), 1.0f)) / PI;
+						AddPanoramaSample(src, width, height, channels, u, v, sum);
+					}
+					for (int c = 0; c < channels; ++c)
+						out[i * channels + c] = (unsigned char)std::min(255.0f, sum[c] * 0.25f + 0.5f);
+				}
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; ++t)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread& th : pool)
+		th.join();
+	return true;
+}
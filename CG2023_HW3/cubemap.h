@@ -0,0 +1,30 @@
+#ifndef CUBEMAP_H
+#define CUBEMAP_H
+
+// C++ STL headers.
+#include <cstddef>
+
+// Equirectangular panorama to cubemap conversion.
+// Faces are in GL order (+X, -X, +Y, -Y, +Z, -Z), each stored top row first
+// (the order glTexImage2D takes them for GL_TEXTURE_CUBE_MAP_POSITIVE_X + i),
+// one after the other, so the six faces form a faceSize x 6 * faceSize
+// image. The panorama is mapped the way the sphere skybox maps it: the top
+// row is straight up and u = 0 faces +X, turning towards +Z. No GL calls, so
+// it is safe on any thread.
+const int CUBEMAP_MAX_FACE_SIZE = 2048;
+
+// Face size for a panorama: the power of two closest below a quarter of its
+// width (a face spans 90 degrees), at most CUBEMAP_MAX_FACE_SIZE.
+int GetCubemapFaceSize(const int panoramaWidth);
+
+// Direction (not normalized) through the point (s, t) in [0, 1] of a face.
+void GetCubemapDirection(const int face, const float s, const float t, float dir[3]);
+
+// Resample an 8-bit panorama (1, 3 or 4 channels, rows tightly packed, top
+// row first) into dst, which must hold 6 * faceSize * faceSize pixels. Each
+// texel averages 2x2 bilinear samples; rows are split across numThreads
+// threads (0 = one per hardware thread).
+bool ConvertEquirectToCubemap(const unsigned char* src, const int width, const int height, const int channels,
+							  const int faceSize, unsigned char* dst, const int numThreads = 0);
+
+#endif
@@ -0,0 +1,275 @@
+#include "decompressstream.h"
+#include "mappedfile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#ifdef OBJ_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef OBJ_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+bool IsGzipMagic(const char* data, const size_t size)
+{
+	return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+bool IsZstdMagic(const char* data, const size_t size)
+{
+	return size >= 4 && (unsigned char)data[0] == 0x28 && (unsigned char)data[1] == 0xb5
+		&& (unsigned char)data[2] == 0x2f && (unsigned char)data[3] == 0xfd;
+}
+
+bool FileExists(const std::string& filePath)
+{
+	std::ifstream ifs(filePath, std::ios::binary);
+	return ifs.is_open();
+}
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+CompressionFormat DetectCompression(const char* data, const size_t size)
+{
+	if (IsGzipMagic(data, size))
+		return COMPRESSION_GZIP;
+	if (IsZstdMagic(data, size))
+		return COMPRESSION_ZSTD;
+	return COMPRESSION_NONE;
+}
+
+bool IsCompressionSupported(const CompressionFormat format)
+{
+	switch (format) {
+	case COMPRESSION_NONE:
+		return true;
+#ifdef OBJ_WITH_ZLIB
+	case COMPRESSION_GZIP:
+		return true;
+#endif
+#ifdef OBJ_WITH_ZSTD
+	case COMPRESSION_ZSTD:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* GetCompressionName(const CompressionFormat format)
+{
+	switch (format) {
+	case COMPRESSION_GZIP:
+		return "gzip";
+	case COMPRESSION_ZSTD:
+		return "zstd";
+	default:
+		return "none";
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+
+DecompressStream::DecompressStream()
+{
+	format = COMPRESSION_NONE;
+	input = nullptr;
+	inputSize = 0;
+	consumed = 0;
+	finished = true;
+	error = false;
+	state = nullptr;
+}
+
+DecompressStream::~DecompressStream()
+{
+	Close();
+}
+
+bool DecompressStream::Open(const char* data, const size_t size)
+{
+	Close();
+	format = DetectCompression(data, size);
+	input = data;
+	inputSize = size;
+	consumed = 0;
+	finished = false;
+	error = false;
+
+	switch (format) {
+	case COMPRESSION_NONE:
+		return true;
+#ifdef OBJ_WITH_ZLIB
+	case COMPRESSION_GZIP: {
+		z_stream* zs = new z_stream();
+		// 16 + MAX_WBITS: expect a gzip header and trailer.
+		if (inflateInit2(zs, 16 + MAX_WBITS) != Z_OK) {
+			delete zs;
+			break;
+		}
+		state = zs;
+		return true;
+	}
+#endif
+#ifdef OBJ_WITH_ZSTD
+	case COMPRESSION_ZSTD: {
+		ZSTD_DStream* zds = ZSTD_createDStream();
+		if (zds == nullptr)
+			break;
+		ZSTD_initDStream(zds);
+		state = zds;
+		return true;
+	}
+#endif
+	default:
+		break;
+	}
+	finished = true;
+	error = true;
+	return false;
+}
+
+void DecompressStream::Close()
+{
+	if (state != nullptr) {
+#ifdef OBJ_WITH_ZLIB
+		if (format == COMPRESSION_GZIP) {
+			inflateEnd((z_stream*)state);
+			delete (z_stream*)state;
+		}
+#endif
+#ifdef OBJ_WITH_ZSTD
+		if (format == COMPRESSION_ZSTD)
+			ZSTD_freeDStream((ZSTD_DStream*)state);
+#endif
+		state = nullptr;
+	}
+	finished = true;
+}
+
+size_t DecompressStream::Read(char* dst, const size_t capacity)
+{
+	if (finished || capacity == 0)
+		return 0;
+
+	size_t produced = 0;
+	if (format == COMPRESSION_NONE) {
+		produced = std::min(capacity, inputSize - consumed);
+		memcpy(dst, input + consumed, produced);
+		consumed += produced;
+		finished = (consumed == inputSize);
+		return produced;
+	}
+
+#ifdef OBJ_WITH_ZLIB
+	if (format == COMPRESSION_GZIP) {
+		z_stream* zs = (z_stream*)state;
+		while (produced < capacity && !finished) {
+			// avail_in/avail_out are 32-bit; feed at most 1 GB at a time.
+			const size_t inChunk = std::min(inputSize - consumed, (size_t)1 << 30);
+			const size_t outChunk = std::min(capacity - produced, (size_t)1 << 30);
+			zs->next_in = (Bytef*)(input + consumed);
+			zs->avail_in = (uInt)inChunk;
+			zs->next_out = (Bytef*)(dst + produced);
+			zs->avail_out = (uInt)outChunk;
+			const int ret = inflate(zs, Z_NO_FLUSH);
+			consumed += inChunk - zs->avail_in;
+			produced += outChunk - zs->avail_out;
+			if (ret == Z_STREAM_END) {
+				// Another gzip member may follow (e.g. from pigz or cat).
+				if (IsGzipMagic(input + consumed, inputSize - consumed))
+					inflateReset(zs);
+				else
+					finished = true;
+			}
+			else if (ret != Z_OK || (inChunk == 0 && zs->avail_out != 0)) {
+				// Corrupt or truncated data.
+				finished = true;
+				error = true;
+			}
+		}
+		return produced;
+	}
+#endif
+#ifdef OBJ_WITH_ZSTD
+	if (format == COMPRESSION_ZSTD) {
+		ZSTD_DStream* zds = (ZSTD_DStream*)state;
+		ZSTD_inBuffer in = { input, inputSize, consumed };
+		ZSTD_outBuffer out = { dst, capacity, 0 };
+		while (out.pos < out.size) {
+			const size_t ret = ZSTD_decompressStream(zds, &out, &in);
+			if (ZSTD_isError(ret)) {
+				finished = true;
+				error = true;
+				break;
+			}
+			if (in.pos == in.size && out.pos < out.size) {
+				// All input consumed and the decoder has nothing buffered:
+				// the last frame must be complete (ret == 0).
+				finished = true;
+				error = (ret != 0);
+				break;
+			}
+		}
+		consumed = in.pos;
+		return out.pos;
+	}
+#endif
+	finished = true;
+	error = true;
+	return 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+std::string FindInputFile(const std::string& filePath)
+{
+	if (FileExists(filePath))
+		return filePath;
+	const char* const suffixes[] = { ".gz", ".zst" };
+	for (const char* suffix : suffixes) {
+		if (FileExists(filePath + suffix))
+			return filePath + suffix;
+	}
+	return filePath;
+}
+
+bool ReadInputFile(const std::string& filePath, std::string& content)
+{
+	MappedFile file;
+	std::string raw;
+	const char* data = nullptr;
+	size_t size = 0;
+	if (file.Open(filePath)) {
+		data = file.GetData();
+		size = file.GetSize();
+	}
+	else {
+		// Not mappable (e.g. a pipe): read it into memory instead.
+		std::ifstream ifs(filePath, std::ios::binary);
+		if (!ifs.is_open())
+			return false;
+		raw.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		data = raw.data();
+		size = raw.size();
+	}
+
+	DecompressStream stream;
+	if (!stream.Open(data, size))
+		return false;
+	content.clear();
+	size_t numRead = 0;
+	while (!stream.IsFinished()) {
+		content.resize(std::max(content.size() * 2, (size_t)1 << 16));
+		numRead += stream.Read(&content[numRead], content.size() - numRead);
+	}
+	content.resize(numRead);
+	return !stream.HasError();
+}
@@ -0,0 +1,69 @@
+#ifndef DECOMPRESS_STREAM_H
+#define DECOMPRESS_STREAM_H
+
+// C++ STL headers.
+#include <string>
+#include <cstddef>
+
+// Compressed inputs (*.obj.gz, *.obj.zst, *.mtl.gz, ...).
+// The format is detected from the leading magic bytes, not the file name.
+// gzip needs zlib (define OBJ_WITH_ZLIB) and zstd needs libzstd (define
+// OBJ_WITH_ZSTD); without them such files are reported as unsupported.
+enum CompressionFormat
+{
+	COMPRESSION_NONE,
+	COMPRESSION_GZIP,
+	COMPRESSION_ZSTD
+};
+
+CompressionFormat DetectCompression(const char* data, const size_t size);
+bool IsCompressionSupported(const CompressionFormat format);
+const char* GetCompressionName(const CompressionFormat format);
+
+// DecompressStream Declarations.
+// Incremental decoder over a compressed buffer held in memory (usually a
+// MappedFile). Concatenated gzip members and zstd frames are decoded in turn.
+class DecompressStream
+{
+public:
+	// DecompressStream Public Methods.
+	DecompressStream();
+	~DecompressStream();
+
+	// Start decoding [data, data + size). The buffer must outlive the stream.
+	bool Open(const char* data, const size_t size);
+	void Close();
+
+	// Decode up to capacity bytes into dst. Returns the number of bytes
+	// written; 0 means the end of the input or an error (see HasError).
+	size_t Read(char* dst, const size_t capacity);
+
+	bool IsFinished() const { return finished; }
+	bool HasError() const { return error; }
+	CompressionFormat GetFormat() const { return format; }
+	// Compressed bytes consumed so far, for progress reporting.
+	size_t GetConsumed() const { return consumed; }
+
+private:
+	// Non-copyable: owns the decoder state.
+	DecompressStream(const DecompressStream&) = delete;
+	DecompressStream& operator=(const DecompressStream&) = delete;
+
+	// DecompressStream Private Data.
+	CompressionFormat format;
+	const char* input;
+	size_t inputSize;
+	size_t consumed;
+	bool finished;
+	bool error;
+	void* state;
+};
+
+// If filePath does not exist but a compressed sibling (filePath + ".gz" or
+// ".zst") does, return that one; otherwise return filePath unchanged.
+std::string FindInputFile(const std::string& filePath);
+
+// Read a whole file into memory, decompressing it if needed.
+bool ReadInputFile(const std::string& filePath, std::string& content);
+
+#endif
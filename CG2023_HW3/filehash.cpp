@@ -0,0 +1,110 @@
+#include "filehash.h"
+#include "mappedfile.h"
+
+#include <cstring>
+
+namespace {
+
+const uint64_t PRIME1 = 11400714785074694791ULL;
+const uint64_t PRIME2 = 14029467366897019727ULL;
+const uint64_t PRIME3 = 1609587929392839161ULL;
+const uint64_t PRIME4 = 9650029242287828579ULL;
+const uint64_t PRIME5 = 2870177450012600261ULL;
+
+inline uint64_t Rotl(const uint64_t x, const int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Read64(const unsigned char* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint32_t Read32(const unsigned char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint64_t Round(uint64_t acc, const uint64_t input)
+{
+	acc += input * PRIME2;
+	acc = Rotl(acc, 31);
+	return acc * PRIME1;
+}
+
+inline uint64_t MergeRound(uint64_t acc, const uint64_t val)
+{
+	acc ^= Round(0, val);
+	return acc * PRIME1 + PRIME4;
+}
+
+} // namespace
+
+uint64_t HashBytes(const void* data, const size_t size, const uint64_t seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* const end = p + size;
+	uint64_t h;
+
+	if (size >= 32) {
+		// Four independent lanes over 32-byte stripes.
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+		const unsigned char* const limit = end - 32;
+		do {
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+		h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+		h = MergeRound(h, v1);
+		h = MergeRound(h, v2);
+		h = MergeRound(h, v3);
+		h = MergeRound(h, v4);
+	}
+	else {
+		h = seed + PRIME5;
+	}
+	h += (uint64_t)size;
+
+	// Tail.
+	for (; p + 8 <= end; p += 8) {
+		h ^= Round(0, Read64(p));
+		h = Rotl(h, 27) * PRIME1 + PRIME4;
+	}
+	if (p + 4 <= end) {
+		h ^= (uint64_t)Read32(p) * PRIME1;
+		h = Rotl(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; ++p) {
+		h ^= (*p) * PRIME5;
+		h = Rotl(h, 11) * PRIME1;
+	}
+
+	// Final avalanche.
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+bool HashFile(const std::string& filePath, uint64_t& hash, const uint64_t seed)
+{
+	MappedFile file;
+	if (!file.Open(filePath))
+		return false;
+	hash = HashBytes(file.GetData(), file.GetSize(), seed);
+	return true;
+}
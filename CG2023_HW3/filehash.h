@@ -0,0 +1,16 @@
+#ifndef FILEHASH_H
+#define FILEHASH_H
+
+// C++ STL headers.
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// 64-bit non-cryptographic hash of a byte range (XXH64 algorithm).
+// Used to detect when cached data is stale, not for security.
+uint64_t HashBytes(const void* data, const size_t size, const uint64_t seed = 0);
+
+// Hash the whole content of a file. Returns false if it cannot be read.
+bool HashFile(const std::string& filePath, uint64_t& hash, const uint64_t seed = 0);
+
+#endif
@@ -0,0 +1,108 @@
+#include "framestats.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#ifdef FRAME_STATS
+namespace {
+
+// Allocations are only counted on the thread between BeginFrame and
+// EndFrame; the loader threads allocate freely.
+thread_local bool countAllocations = false;
+thread_local uint64_t numAllocations = 0;
+
+} // namespace
+
+// The replaceable allocation functions. The array and nothrow forms call
+// these, so they are counted too.
+void* operator new(std::size_t size)
+{
+	if (countAllocations)
+		numAllocations++;
+	void* p = std::malloc(size != 0 ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+#endif
+
+std::atomic<uint64_t> FrameStats::numGLObjects(0);
+
+FrameStats& FrameStats::GetInstance()
+{
+	static FrameStats instance;
+	return instance;
+}
+
+FrameStats::FrameStats()
+{
+	framesSinceChange = 0;
+	numFrames = 0;
+	numSteadyFrames = 0;
+}
+
+bool FrameStats::IsEnabled() const
+{
+#ifdef FRAME_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void FrameStats::BeginFrame()
+{
+#ifdef FRAME_STATS
+	frameStart.numAllocations = numAllocations;
+	frameStart.numGLObjects = numGLObjects;
+	countAllocations = true;
+#endif
+}
+
+void FrameStats::EndFrame()
+{
+#ifdef FRAME_STATS
+	countAllocations = false;
+	lastFrame.numAllocations = numAllocations - frameStart.numAllocations;
+	lastFrame.numGLObjects = numGLObjects - frameStart.numGLObjects;
+	numFrames++;
+	if (!IsSteady()) {
+		framesSinceChange++;
+		return;
+	}
+	numSteadyFrames++;
+	if (lastFrame.numAllocations != 0 || lastFrame.numGLObjects != 0) {
+		std::cerr << "[ERROR] Frame " << numFrames << " of an unchanged scene made " << lastFrame.numAllocations
+				  << " heap allocations and created " << lastFrame.numGLObjects << " GL objects" << std::endl;
+		assert(lastFrame.numAllocations == 0 && lastFrame.numGLObjects == 0);
+	}
+#endif
+}
+
+void FrameStats::Invalidate()
+{
+	framesSinceChange = 0;
+}
+
+void FrameStats::ShowStats() const
+{
+	if (!IsEnabled()) {
+		std::cout << "Frame stats: off (Debug builds or FRAME_STATS only)" << std::endl;
+		return;
+	}
+	std::cout << "Frame stats: last frame " << lastFrame.numAllocations << " heap allocations, "
+			  << lastFrame.numGLObjects << " GL objects created; " << numSteadyFrames << " of " << numFrames
+			  << " frames checked" << (IsSteady() ? "" : " (warming up)") << std::endl;
+}
@@ -0,0 +1,77 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+// C++ STL headers.
+#include <atomic>
+#include <cstdint>
+
+// Frame statistics are gathered in Debug builds, or whenever FRAME_STATS is
+// defined; otherwise every method does nothing.
+#if defined(_DEBUG) && !defined(FRAME_STATS)
+#define FRAME_STATS
+#endif
+
+// FrameStatsCounts Declarations.
+struct FrameStatsCounts
+{
+	FrameStatsCounts() { numAllocations = 0; numGLObjects = 0; }
+
+	uint64_t numAllocations;
+	uint64_t numGLObjects;
+};
+
+// FrameStats Declarations.
+// Checks that drawing a scene that does not change is allocation-free.
+// Between BeginFrame and EndFrame it counts the heap allocations (operator
+// new) made on the render thread and the GL objects created (as reported
+// to the GLResourceTracker). Once the scene has been left alone for a few
+// frames, a frame that allocates or creates anything is reported and fails
+// an assert. Work that is expected to allocate (loading a model or skybox,
+// resizing the window) calls Invalidate to start the warm-up again. GL
+// thread only, apart from CountGLObjects.
+class FrameStats
+{
+public:
+	// FrameStats Public Methods.
+	static FrameStats& GetInstance();
+
+	// Call at the start and at the end of every frame.
+	void BeginFrame();
+	void EndFrame();
+	void Invalidate();
+
+	// Called by GLResourceTracker::TrackCreate.
+	static void CountGLObjects(const int count)
+	{
+#ifdef FRAME_STATS
+		numGLObjects += count;
+#else
+		(void)count;
+#endif
+	}
+
+	bool IsEnabled() const;
+	// True once the scene has not changed for the warm-up frames.
+	bool IsSteady() const { return framesSinceChange >= WARMUP_FRAMES; }
+	FrameStatsCounts GetLastFrame() const { return lastFrame; }
+	void ShowStats() const;
+
+private:
+	// FrameStats Private Methods.
+	FrameStats();
+	FrameStats(const FrameStats&) = delete;
+	FrameStats& operator=(const FrameStats&) = delete;
+
+	// FrameStats Private Data.
+	// Frames a change may take to settle: the virtual texture reads its
+	// feedback two frames late and the loaders upload over several frames.
+	static const int WARMUP_FRAMES = 8;
+	int framesSinceChange;
+	uint64_t numFrames;
+	uint64_t numSteadyFrames;
+	FrameStatsCounts lastFrame;
+	FrameStatsCounts frameStart;
+	static std::atomic<uint64_t> numGLObjects;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "glresourcetracker.h"
+#include "framestats.h"
+#include "glstatecache.h"
+
+// C++ STL headers.
+#include <algorithm>
+
+namespace {
+
+// Only this many leaks are listed one by one.
+const int MAX_LISTED_LEAKS = 64;
+
+const char* GetFileName(const char* path)
+{
+	const char* name = path;
+	for (const char* p = path; *p != '\0'; ++p)
+		if (*p == '/' || *p == '\\')
+			name = p + 1;
+	return name;
+}
+
+} // namespace
+
+GLResourceTracker& GLResourceTracker::GetInstance()
+{
+	static GLResourceTracker instance;
+	return instance;
+}
+
+GLResourceTracker::GLResourceTracker()
+{
+	numCreated = 0;
+	numDeleted = 0;
+}
+
+void GLResourceTracker::TrackCreate(const GLResourceType type, const GLuint* ids, const int count,
+									const std::string& owner, const char* file, const int line)
+{
+	FrameStats::CountGLObjects(count);
+	for (int i = 0; i < count; ++i) {
+		if (ids[i] == 0)
+			continue;
+		Entry& entry = entries[MakeKey(type, ids[i])];
+		entry.type = type;
+		entry.id = ids[i];
+		entry.bytes = 0;
+		entry.owner = owner;
+		entry.file = file;
+		entry.line = line;
+		entry.serial = numCreated++;
+	}
+}
+
+void GLResourceTracker::TrackDelete(const GLResourceType type, const GLuint* ids, const int count)
+{
+	GLStateCache& stateCache = GLStateCache::GetInstance();
+	for (int i = 0; i < count; ++i) {
+		// Deleting 0 is a no-op in GL too.
+		if (ids[i] == 0)
+			continue;
+		if (entries.erase(MakeKey(type, ids[i])) != 0)
+			numDeleted++;
+		// GL unbinds deleted objects; keep the state cache in step.
+		switch (type) {
+		case GL_RESOURCE_BUFFER: stateCache.OnDeleteBuffer(ids[i]); break;
+		case GL_RESOURCE_TEXTURE: stateCache.OnDeleteTexture(ids[i]); break;
+		case GL_RESOURCE_VERTEX_ARRAY: stateCache.OnDeleteVertexArray(ids[i]); break;
+		case GL_RESOURCE_PROGRAM: stateCache.OnDeleteProgram(ids[i]); break;
+		default: break;
+		}
+	}
+}
+
+void GLResourceTracker::SetBytes(const GLResourceType type, const GLuint id, const size_t bytes)
+{
+	auto it = entries.find(MakeKey(type, id));
+	if (it != entries.end())
+		it->second.bytes = bytes;
+}
+
+GLResourceStats GLResourceTracker::GetStats() const
+{
+	GLResourceStats stats;
+	for (const auto& it : entries) {
+		stats.numLive[it.second.type]++;
+		stats.liveBytes[it.second.type] += it.second.bytes;
+	}
+	stats.numCreated = numCreated;
+	stats.numDeleted = numDeleted;
+	return stats;
+}
+
+void GLResourceTracker::ShowStats() const
+{
+	const GLResourceStats stats = GetStats();
+	size_t totalBytes = 0;
+	std::cout << "GL objects:";
+	for (int i = 0; i < GL_RESOURCE_TYPE_COUNT; ++i) {
+		std::cout << " " << stats.numLive[i] << " " << GetTypeName((GLResourceType)i) << "s";
+		if (stats.liveBytes[i] != 0)
+			std::cout << " (" << stats.liveBytes[i] / (1024.0 * 1024.0) << " MB)";
+		std::cout << (i + 1 < GL_RESOURCE_TYPE_COUNT ? "," : "");
+		totalBytes += stats.liveBytes[i];
+	}
+	std::cout << "; " << totalBytes / (1024.0 * 1024.0) << " MB live (" << stats.numCreated << " created, "
+			  << stats.numDeleted << " deleted)" << std::endl;
+}
+
+int GLResourceTracker::ReportLeaks() const
+{
+	if (entries.empty()) {
+		std::cout << "GL objects: no leaks" << std::endl;
+		return 0;
+	}
+	std::vector<const Entry*> leaks;
+	for (const auto& it : entries)
+		leaks.push_back(&it.second);
+	std::sort(leaks.begin(), leaks.end(), [](const Entry* a, const Entry* b) { return a->serial < b->serial; });
+
+	size_t leakedBytes = 0;
+	for (const Entry* leak : leaks)
+		leakedBytes += leak->bytes;
+	std::cerr << "[WARNING] " << leaks.size() << " GL objects leaked (" << leakedBytes / (1024.0 * 1024.0)
+			  << " MB):" << std::endl;
+	for (size_t i = 0; i < leaks.size() && i < (size_t)MAX_LISTED_LEAKS; ++i) {
+		const Entry* leak = leaks[i];
+		std::cerr << "  " << GetTypeName(leak->type) << " " << leak->id << ", " << leak->bytes << " bytes, "
+				  << leak->owner << " (" << GetFileName(leak->file) << ":" << leak->line << ")" << std::endl;
+	}
+	if (leaks.size() > (size_t)MAX_LISTED_LEAKS)
+		std::cerr << "  ... and " << leaks.size() - MAX_LISTED_LEAKS << " more" << std::endl;
+	return (int)leaks.size();
+}
+
+const char* GLResourceTracker::GetTypeName(const GLResourceType type)
+{
+	switch (type) {
+	case GL_RESOURCE_BUFFER: return "buffer";
+	case GL_RESOURCE_TEXTURE: return "texture";
+	case GL_RESOURCE_FRAMEBUFFER: return "framebuffer";
+	case GL_RESOURCE_VERTEX_ARRAY: return "vertex array";
+	case GL_RESOURCE_PROGRAM: return "program";
+	case GL_RESOURCE_SHADER: return "shader";
+	default: return "object";
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef GL_RESOURCE_TRACKER_H
+#define GL_RESOURCE_TRACKER_H
+
+#include "headers.h"
+
+// GLResourceType Declarations.
+enum GLResourceType
+{
+	GL_RESOURCE_BUFFER,
+	GL_RESOURCE_TEXTURE,
+	GL_RESOURCE_FRAMEBUFFER,
+	GL_RESOURCE_VERTEX_ARRAY,
+	GL_RESOURCE_PROGRAM,
+	GL_RESOURCE_SHADER,
+	GL_RESOURCE_TYPE_COUNT
+};
+
+// GLResourceStats Declarations.
+struct GLResourceStats
+{
+	GLResourceStats() {
+		for (int i = 0; i < GL_RESOURCE_TYPE_COUNT; ++i) {
+			numLive[i] = 0;
+			liveBytes[i] = 0;
+		}
+		numCreated = 0;
+		numDeleted = 0;
+	}
+
+	// Per GLResourceType.
+	int numLive[GL_RESOURCE_TYPE_COUNT];
+	size_t liveBytes[GL_RESOURCE_TYPE_COUNT];
+	// Since start.
+	uint64_t numCreated;
+	uint64_t numDeleted;
+};
+
+// GLResourceTracker Declarations.
+// Keeps a record of every live GL object the viewer creates: where it was
+// created, by whom and how much GPU memory it holds. Code that creates a GL
+// object reports it with GL_TRACK_CREATE right after glGen*/glCreate*, its
+// storage with SetBytes after glBufferData/glTexImage*, and its deletion
+// with TrackDelete next to glDelete*. Whatever is still alive at shutdown is
+// listed as leaked. GL thread only.
+class GLResourceTracker
+{
+public:
+	// GLResourceTracker Public Methods.
+	static GLResourceTracker& GetInstance();
+
+	void TrackCreate(const GLResourceType type, const GLuint* ids, const int count, const std::string& owner,
+					 const char* file, const int line);
+	void TrackDelete(const GLResourceType type, const GLuint* ids, const int count);
+	// GPU memory of one object (replaces the previous value).
+	void SetBytes(const GLResourceType type, const GLuint id, const size_t bytes);
+
+	GLResourceStats GetStats() const;
+	void ShowStats() const;
+	// Print every object that is still alive, oldest first; returns how many.
+	int ReportLeaks() const;
+
+	static const char* GetTypeName(const GLResourceType type);
+
+private:
+	// Entry Declarations.
+	struct Entry
+	{
+		GLResourceType type;
+		GLuint id;
+		size_t bytes;
+		std::string owner;
+		const char* file;
+		int line;
+		// Creation order.
+		uint64_t serial;
+	};
+
+	// GLResourceTracker Private Methods.
+	GLResourceTracker();
+	GLResourceTracker(const GLResourceTracker&) = delete;
+	GLResourceTracker& operator=(const GLResourceTracker&) = delete;
+	static uint64_t MakeKey(const GLResourceType type, const GLuint id) { return ((uint64_t)type << 32) | id; }
+
+	// GLResourceTracker Private Data.
+	std::unordered_map<uint64_t, Entry> entries;
+	uint64_t numCreated;
+	uint64_t numDeleted;
+};
+
+// Record the count GL objects of type just created in ids, with the source
+// line that created them.
+#define GL_TRACK_CREATE(type, ids, count, owner) \
+	GLResourceTracker::GetInstance().TrackCreate((type), (ids), (count), (owner), __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,270 @@
+#include "glstatecache.h"
+
+// C++ STL headers.
+#include <cstring>
+
+GLStateCache& GLStateCache::GetInstance()
+{
+	static GLStateCache instance;
+	return instance;
+}
+
+GLStateCache::GLStateCache()
+{
+	Invalidate();
+}
+
+void GLStateCache::UseProgram(const GLuint prog)
+{
+	if (prog == program) {
+		removed.numPrograms++;
+		return;
+	}
+	glUseProgram(prog);
+	program = prog;
+	issued.numPrograms++;
+}
+
+void GLStateCache::BindVertexArray(const GLuint va)
+{
+	if (va == vertexArray) {
+		removed.numVertexArrays++;
+		return;
+	}
+	glBindVertexArray(va);
+	vertexArray = va;
+	issued.numVertexArrays++;
+}
+
+void GLStateCache::BindBuffer(const GLenum target, const GLuint buffer)
+{
+	if (target == GL_ARRAY_BUFFER || target == GL_DRAW_INDIRECT_BUFFER) {
+		GLuint& bound = (target == GL_ARRAY_BUFFER) ? arrayBuffer : drawIndirectBuffer;
+		if (buffer == bound) {
+			removed.numBuffers++;
+			return;
+		}
+		bound = buffer;
+	}
+	else if (target == GL_ELEMENT_ARRAY_BUFFER && vertexArray != UNKNOWN) {
+		auto it = elementBuffers.find(vertexArray);
+		if (it != elementBuffers.end() && it->second == buffer) {
+			removed.numBuffers++;
+			return;
+		}
+		elementBuffers[vertexArray] = buffer;
+	}
+	glBindBuffer(target, buffer);
+	issued.numBuffers++;
+}
+
+void GLStateCache::BindBufferRange(const GLenum target, const GLuint index, const GLuint buffer, const size_t offset,
+								   const size_t size)
+{
+	if (target == GL_UNIFORM_BUFFER && index < (GLuint)MAX_UNIFORM_BUFFERS) {
+		BufferRange& bound = uniformBuffers[index];
+		if (bound.buffer == buffer && bound.offset == offset && bound.size == size) {
+			removed.numBuffers++;
+			return;
+		}
+		bound.buffer = buffer;
+		bound.offset = offset;
+		bound.size = size;
+	}
+	glBindBufferRange(target, index, buffer, (GLintptr)offset, (GLsizeiptr)size);
+	issued.numBuffers++;
+}
+
+void GLStateCache::BindTexture(const GLenum unit, const GLenum target, const GLuint texture)
+{
+	// No need to switch units for a texture that is bound already.
+	const GLuint* bound = GetTextureSlot(unit, target);
+	if (bound != nullptr && *bound == texture) {
+		removed.numTextures++;
+		return;
+	}
+	ActiveTexture(unit);
+	BindTexture(target, texture);
+}
+
+void GLStateCache::BindTexture(const GLenum target, const GLuint texture)
+{
+	GLuint* bound = GetTextureSlot(activeUnit, target);
+	if (bound != nullptr) {
+		if (*bound == texture) {
+			removed.numTextures++;
+			return;
+		}
+		*bound = texture;
+	}
+	glBindTexture(target, texture);
+	issued.numTextures++;
+}
+
+void GLStateCache::ActiveTexture(const GLenum unit)
+{
+	if (unit == activeUnit) {
+		removed.numTextures++;
+		return;
+	}
+	glActiveTexture(unit);
+	activeUnit = unit;
+	issued.numTextures++;
+}
+
+void GLStateCache::SetUniform1i(const GLint location, const GLint value)
+{
+	if (IsUniformSet(location, &value, 1))
+		return;
+	glUniform1i(location, value);
+}
+
+void GLStateCache::SetUniform1f(const GLint location, const GLfloat value)
+{
+	if (IsUniformSet(location, &value, 1))
+		return;
+	glUniform1f(location, value);
+}
+
+void GLStateCache::SetUniform3fv(const GLint location, const GLsizei count, const GLfloat* values)
+{
+	if (IsUniformSet(location, values, 3 * count))
+		return;
+	glUniform3fv(location, count, values);
+}
+
+void GLStateCache::SetUniformMatrix3fv(const GLint location, const GLfloat* values)
+{
+	if (IsUniformSet(location, values, 9))
+		return;
+	glUniformMatrix3fv(location, 1, GL_FALSE, values);
+}
+
+void GLStateCache::SetUniformMatrix4fv(const GLint location, const GLfloat* values)
+{
+	if (IsUniformSet(location, values, 16))
+		return;
+	glUniformMatrix4fv(location, 1, GL_FALSE, values);
+}
+
+GLuint* GLStateCache::GetTextureSlot(const GLenum unit, const GLenum target)
+{
+	const int index = (int)(unit - GL_TEXTURE0);
+	if (unit == UNKNOWN || index < 0 || index >= MAX_TEXTURE_UNITS)
+		return nullptr;
+	switch (target) {
+	case GL_TEXTURE_2D: return &textures2D[index];
+	case GL_TEXTURE_CUBE_MAP: return &texturesCube[index];
+	case GL_TEXTURE_BUFFER: return &texturesBuffer[index];
+	default: return nullptr;
+	}
+}
+
+bool GLStateCache::IsUniformSet(const GLint location, const void* values, const int numValues)
+{
+	// GL ignores location -1; nothing to send, and no call saved either.
+	if (location < 0)
+		return true;
+	if (program != UNKNOWN && numValues <= 32) {
+		UniformValue& cached = uniforms[((uint64_t)program << 32) | (uint32_t)location];
+		const size_t numBytes = sizeof(uint32_t) * numValues;
+		if (cached.numValues == numValues && memcmp(cached.values, values, numBytes) == 0) {
+			removed.numUniforms++;
+			return true;
+		}
+		cached.numValues = numValues;
+		memcpy(cached.values, values, numBytes);
+	}
+	issued.numUniforms++;
+	return false;
+}
+
+void GLStateCache::OnDeleteProgram(const GLuint prog)
+{
+	// A program in use is only deleted once another is used.
+	if (prog == program)
+		program = UNKNOWN;
+	for (auto it = uniforms.begin(); it != uniforms.end();) {
+		if ((GLuint)(it->first >> 32) == prog)
+			it = uniforms.erase(it);
+		else
+			++it;
+	}
+}
+
+void GLStateCache::OnDeleteVertexArray(const GLuint va)
+{
+	if (va == vertexArray)
+		vertexArray = 0;
+	elementBuffers.erase(va);
+}
+
+void GLStateCache::OnDeleteBuffer(const GLuint buffer)
+{
+	if (buffer == arrayBuffer)
+		arrayBuffer = 0;
+	if (buffer == drawIndirectBuffer)
+		drawIndirectBuffer = 0;
+	// Other vertex arrays keep the deleted buffer attached; its name may be
+	// reused for a new one.
+	for (auto& it : elementBuffers) {
+		if (it.second == buffer)
+			it.second = (it.first == vertexArray) ? 0 : UNKNOWN;
+	}
+	for (int i = 0; i < MAX_UNIFORM_BUFFERS; ++i) {
+		if (uniformBuffers[i].buffer == buffer)
+			uniformBuffers[i].buffer = 0;
+	}
+}
+
+void GLStateCache::OnDeleteTexture(const GLuint texture)
+{
+	for (int i = 0; i < MAX_TEXTURE_UNITS; ++i) {
+		if (textures2D[i] == texture)
+			textures2D[i] = 0;
+		if (texturesCube[i] == texture)
+			texturesCube[i] = 0;
+		if (texturesBuffer[i] == texture)
+			texturesBuffer[i] = 0;
+	}
+}
+
+void GLStateCache::Invalidate()
+{
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	arrayBuffer = UNKNOWN;
+	drawIndirectBuffer = UNKNOWN;
+	elementBuffers.clear();
+	for (int i = 0; i < MAX_UNIFORM_BUFFERS; ++i)
+		uniformBuffers[i].buffer = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (int i = 0; i < MAX_TEXTURE_UNITS; ++i) {
+		textures2D[i] = UNKNOWN;
+		texturesCube[i] = UNKNOWN;
+		texturesBuffer[i] = UNKNOWN;
+	}
+	uniforms.clear();
+}
+
+void GLStateCache::BeginFrame()
+{
+	lastIssued = issued;
+	lastRemoved = removed;
+	issued = GLStateCounts();
+	removed = GLStateCounts();
+}
+
+void GLStateCache::ShowStats() const
+{
+	const GLStateCounts& i = lastIssued;
+	const GLStateCounts& r = lastRemoved;
+	const int numIssued = i.numPrograms + i.numVertexArrays + i.numBuffers + i.numTextures + i.numUniforms;
+	const int numRemoved = r.numPrograms + r.numVertexArrays + r.numBuffers + r.numTextures + r.numUniforms;
+	std::cout << "GL state: last frame " << numIssued << " calls issued, " << numRemoved << " redundant removed"
+			  << " (programs " << i.numPrograms << "/" << r.numPrograms
+			  << ", vertex arrays " << i.numVertexArrays << "/" << r.numVertexArrays
+			  << ", buffers " << i.numBuffers << "/" << r.numBuffers
+			  << ", textures " << i.numTextures << "/" << r.numTextures
+			  << ", uniforms " << i.numUniforms << "/" << r.numUniforms << ")" << std::endl;
+}
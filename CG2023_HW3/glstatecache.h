@@ -0,0 +1,125 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include "headers.h"
+
+// C++ STL headers.
+#include <cstdint>
+
+// GLStateCounts Declarations.
+struct GLStateCounts
+{
+	GLStateCounts() {
+		numPrograms = 0; numVertexArrays = 0; numBuffers = 0; numTextures = 0; numUniforms = 0;
+	}
+
+	int numPrograms;
+	int numVertexArrays;
+	int numBuffers;
+	// Texture bindings and active texture unit changes.
+	int numTextures;
+	int numUniforms;
+};
+
+// GLStateCache Declarations.
+// Remembers the bound program, vertex array, array and element buffers,
+// textures per unit and the uniform values of each program, and drops the
+// GL calls that would not change any of them. All binding of these goes
+// through the cache so that it never goes stale; objects deleted through
+// the GLResourceTracker are forgotten (GL unbinds them too). Counts the
+// calls issued and removed per frame. GL thread only.
+class GLStateCache
+{
+public:
+	// GLStateCache Public Methods.
+	static GLStateCache& GetInstance();
+
+	void UseProgram(const GLuint program);
+	void BindVertexArray(const GLuint vertexArray);
+	// GL_ARRAY_BUFFER, GL_DRAW_INDIRECT_BUFFER and GL_ELEMENT_ARRAY_BUFFER
+	// (which belongs to the bound vertex array) are cached; other targets
+	// are passed through.
+	void BindBuffer(const GLenum target, const GLuint buffer);
+	// Indexed GL_UNIFORM_BUFFER bindings are cached; other targets are
+	// passed through. Also binds the buffer to the generic target.
+	void BindBufferRange(const GLenum target, const GLuint index, const GLuint buffer, const size_t offset,
+						 const size_t size);
+	// Bind to unit (GL_TEXTURE0 + i), or to the active unit.
+	void BindTexture(const GLenum unit, const GLenum target, const GLuint texture);
+	void BindTexture(const GLenum target, const GLuint texture);
+	void ActiveTexture(const GLenum unit);
+
+	// Uniforms of the program in use. Location -1 is ignored as by GL.
+	void SetUniform1i(const GLint location, const GLint value);
+	void SetUniform1f(const GLint location, const GLfloat value);
+	void SetUniform3fv(const GLint location, const GLsizei count, const GLfloat* values);
+	void SetUniformMatrix3fv(const GLint location, const GLfloat* values);
+	void SetUniformMatrix4fv(const GLint location, const GLfloat* values);
+
+	// Called by the GLResourceTracker when objects are deleted.
+	void OnDeleteProgram(const GLuint program);
+	void OnDeleteVertexArray(const GLuint vertexArray);
+	void OnDeleteBuffer(const GLuint buffer);
+	void OnDeleteTexture(const GLuint texture);
+	// Forget everything, e.g. after GL state was changed behind the cache.
+	void Invalidate();
+
+	// Call once per frame; the counts of the frame before are kept.
+	void BeginFrame();
+	const GLStateCounts& GetIssued() const { return lastIssued; }
+	const GLStateCounts& GetRemoved() const { return lastRemoved; }
+	void ShowStats() const;
+
+private:
+	// BufferRange Declarations.
+	struct BufferRange
+	{
+		GLuint buffer;
+		size_t offset;
+		size_t size;
+	};
+
+	// UniformValue Declarations.
+	struct UniformValue
+	{
+		UniformValue() { numValues = 0; }
+
+		int numValues;
+		// Raw bits; large enough for the 9 vec3 of the ambient SH.
+		uint32_t values[32];
+	};
+
+	// GLStateCache Private Methods.
+	GLStateCache();
+	GLStateCache(const GLStateCache&) = delete;
+	GLStateCache& operator=(const GLStateCache&) = delete;
+	// True if the uniform already holds the values; records them if not.
+	bool IsUniformSet(const GLint location, const void* values, const int numValues);
+	// Binding of target on unit (GL_TEXTURE0 + i); nullptr if not cached.
+	GLuint* GetTextureSlot(const GLenum unit, const GLenum target);
+
+	// GLStateCache Private Data.
+	static const int MAX_TEXTURE_UNITS = 16;
+	static const int MAX_UNIFORM_BUFFERS = 8;
+	// Binding points that are not known (e.g. after Invalidate) hold this.
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+	GLuint program;
+	GLuint vertexArray;
+	GLuint arrayBuffer;
+	GLuint drawIndirectBuffer;
+	// Element buffer per vertex array.
+	std::unordered_map<GLuint, GLuint> elementBuffers;
+	BufferRange uniformBuffers[MAX_UNIFORM_BUFFERS];
+	GLenum activeUnit;
+	GLuint textures2D[MAX_TEXTURE_UNITS];
+	GLuint texturesCube[MAX_TEXTURE_UNITS];
+	GLuint texturesBuffer[MAX_TEXTURE_UNITS];
+	// Keyed by program and location.
+	std::unordered_map<uint64_t, UniformValue> uniforms;
+	GLStateCounts issued;
+	GLStateCounts removed;
+	GLStateCounts lastIssued;
+	GLStateCounts lastRemoved;
+};
+
+#endif
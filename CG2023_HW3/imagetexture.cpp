@@ -1,4 +1,12 @@
 #include "imagetexture.h"
+#include "filehash.h"
+#include "textureresidency.h"
+#include "glresourcetracker.h"
+#include "glstatecache.h"
+
+std::atomic<bool> ImageTexture::blockCompression(false);
+std::atomic<bool> ImageTexture::gammaCorrectMips(true);
+ImageTexture* ImageTexture::defaultWhite = nullptr;
 
 ImageTexture::ImageTexture(const std::string filePath)
 	: texFilePath(filePath)
@@ -6,51 +14,129 @@ ImageTexture::ImageTexture(const std::string filePath)
 	imageWidth = 0;
 	imageHeight = 0;
 	numChannels = 0;
+	numBytes = 0;
+	baseLevel = 0;
+	residentBytes = 0;
 	textureObj = 0;
 
 	// Try to load texture image.
-	texImage = cv::imread(texFilePath);
-	if (texImage.rows == 0 || texImage.cols == 0) {
+	CookedTexture image;
+	if (!LoadImageData(texFilePath, image)) {
+		std::cerr << "[ERROR] Failed to load image texture: " << filePath << std::endl;
+		return;
+	}
+	CreateTexture(image);
+	TextureResidency::GetInstance().Register(this);
+}
+
+ImageTexture::ImageTexture(const std::string filePath, const CookedTexture& image)
+	: texFilePath(filePath)
+{
+	imageWidth = 0;
+	imageHeight = 0;
+	numChannels = 0;
+	numBytes = 0;
+	baseLevel = 0;
+	residentBytes = 0;
+	textureObj = 0;
+
+	if (image.IsEmpty()) {
 		std::cerr << "[ERROR] Failed to load image texture: " << filePath << std::endl;
 		return;
 	}
-	imageWidth = texImage.cols;
-	imageHeight = texImage.rows;
-	numChannels = texImage.channels();
+	CreateTexture(image);
+	TextureResidency::GetInstance().Register(this);
+}
+
+bool ImageTexture::LoadImageData(const std::string& filePath, CookedTexture& image)
+{
+	TextureCookOptions options;
+	// Only ask for BC1 if this GL can sample it.
+	options.blockCompress = blockCompression && GLEW_EXT_texture_compression_s3tc;
+	options.mips.gammaCorrect = gammaCorrectMips;
+	uint64_t sourceHash = 0;
+	const bool hashed = HashFile(filePath, sourceHash);
+	if (hashed && ReadCookedTexture(filePath, sourceHash, options, image))
+		return true;
+
+	cv::Mat decoded;
+	if (!DecodeImage(filePath, decoded))
+		return false;
+	if (!decoded.isContinuous())
+		decoded = decoded.clone();
+	if (!CookTexture(decoded.ptr(), decoded.cols, decoded.rows, decoded.channels(), options, image))
+		return false;
+	if (hashed && !WriteCookedTexture(filePath, sourceHash, image))
+		std::cerr << "[WARNING] Failed to write cooked texture: " << GetCookedTexturePath(filePath) << std::endl;
+	return true;
+}
 
+bool ImageTexture::DecodeImage(const std::string& filePath, cv::Mat& image)
+{
+	image = cv::imread(filePath);
+	if (image.rows == 0 || image.cols == 0)
+		return false;
 	// Flip texture in vertical direction.
 	// OpenCV has smaller y coordinate on top; while OpenGL has larger.
-	cv::flip(texImage, texImage, 0);
+	cv::flip(image, image, 0);
+	return true;
+}
+
+void ImageTexture::CreateTexture(const CookedTexture& image, const int firstLevel)
+{
+	imageWidth = image.width;
+	imageHeight = image.height;
+	numChannels = image.channels;
+	numBytes = image.GetNumBytes();
+	levelBytes.clear();
+	for (const CookedTexture::CookedLevel& level : image.levels)
+		levelBytes.push_back(level.size);
+	baseLevel = firstLevel;
+	residentBytes = GetBytesFromLevel(firstLevel);
 
 	glGenTextures(1, &textureObj);
-    glBindTexture(GL_TEXTURE_2D, textureObj);
-    switch (numChannels) {
-	case 1:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, imageWidth, imageHeight, 
-						0, GL_RED, GL_UNSIGNED_BYTE, texImage.ptr());
-		break;
-	case 3:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 
-						0, GL_BGR, GL_UNSIGNED_BYTE, texImage.ptr());
-		break;
-	case 4:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 
-						0, GL_BGRA, GL_UNSIGNED_BYTE, texImage.ptr());
-		break;
-	default:
-		std::cerr << "[ERROR] Unsupport texture format" << std::endl;
-		break;
+	GL_TRACK_CREATE(GL_RESOURCE_TEXTURE, &textureObj, 1, "ImageTexture " + texFilePath);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_TEXTURE, textureObj, residentBytes);
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, textureObj);
+	// Cooked rows are tightly packed.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Upload every level of the precomputed mip chain from firstLevel on.
+	for (size_t i = firstLevel; i < image.levels.size(); ++i) {
+		const CookedTexture::CookedLevel& level = image.levels[i];
+		const GLint lod = (GLint)i - firstLevel;
+		if (image.format == COOKED_FORMAT_BC1) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, lod, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, level.width, level.height,
+									0, (GLsizei)level.size, image.GetLevelData(i));
+			continue;
+		}
+		switch (numChannels) {
+		case 1:
+			glTexImage2D(GL_TEXTURE_2D, lod, GL_RED, level.width, level.height,
+							0, GL_RED, GL_UNSIGNED_BYTE, image.GetLevelData(i));
+			break;
+		case 3:
+			glTexImage2D(GL_TEXTURE_2D, lod, GL_RGB, level.width, level.height,
+							0, GL_BGR, GL_UNSIGNED_BYTE, image.GetLevelData(i));
+			break;
+		case 4:
+			glTexImage2D(GL_TEXTURE_2D, lod, GL_RGBA, level.width, level.height,
+							0, GL_BGRA, GL_UNSIGNED_BYTE, image.GetLevelData(i));
+			break;
+		default:
+			std::cerr << "[ERROR] Unsupport texture format" << std::endl;
+			break;
+		}
 	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1 - firstLevel);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	
-	glGenerateMipmap(GL_TEXTURE_2D);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, 0);
 }
 
 //If no mapKd, create a pure white texture and make it a mapKd.
@@ -59,10 +145,15 @@ ImageTexture::ImageTexture()
 	imageWidth = 1;
 	imageHeight = 1;
 	numChannels = 0;
+	numBytes = 4;
+	baseLevel = 0;
+	residentBytes = 4;
 	textureObj = 0;
 
 	glGenTextures(1, &textureObj);
-	glBindTexture(GL_TEXTURE_2D, textureObj);
+	GL_TRACK_CREATE(GL_RESOURCE_TEXTURE, &textureObj, 1, "ImageTexture (white)");
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_TEXTURE, textureObj, numBytes);
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, textureObj);
 	// build an 1x1 white texture
 	unsigned char whitePixel[] = { 255, 255, 255, 255 };
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, whitePixel);
@@ -75,24 +166,76 @@ ImageTexture::ImageTexture()
 
 	glGenerateMipmap(GL_TEXTURE_2D);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, 0);
 }
 
 ImageTexture::~ImageTexture()
 {
+	TextureResidency::GetInstance().Unregister(this);
+	GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_TEXTURE, &textureObj, 1);
 	glDeleteTextures(1, &textureObj);
 	texImage.release();
 }
 
+ImageTexture* ImageTexture::GetDefaultWhite()
+{
+	if (defaultWhite == nullptr)
+		defaultWhite = new ImageTexture();
+	return defaultWhite;
+}
+
+void ImageTexture::ReleaseDefaultTextures()
+{
+	delete defaultWhite;
+	defaultWhite = nullptr;
+}
+
 void ImageTexture::Bind(GLenum textureUnit)
 {
-	glActiveTexture(textureUnit);
-    glBindTexture(GL_TEXTURE_2D, textureObj);
+	// Restore the texture if it was demoted or evicted.
+	TextureResidency::GetInstance().Touch(this);
+	GLStateCache::GetInstance().BindTexture(textureUnit, GL_TEXTURE_2D, textureObj);
+}
+
+size_t ImageTexture::GetBytesFromLevel(const int level) const
+{
+	size_t bytes = 0;
+	for (size_t i = std::max(level, 0); i < levelBytes.size(); ++i)
+		bytes += levelBytes[i];
+	return bytes;
+}
+
+bool ImageTexture::SetBaseLevel(const int level)
+{
+	if (level == baseLevel)
+		return true;
+	if (level >= GetNumLevels()) {
+		GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_TEXTURE, &textureObj, 1);
+		glDeleteTextures(1, &textureObj);
+		textureObj = 0;
+		baseLevel = GetNumLevels();
+		residentBytes = 0;
+		// Nothing on the GPU; no reason to keep the preview copy either.
+		texImage.release();
+		return true;
+	}
+	CookedTexture image;
+	if (!LoadImageData(texFilePath, image) || image.levels.size() != levelBytes.size()) {
+		std::cerr << "[ERROR] Failed to reload image texture: " << texFilePath << std::endl;
+		return false;
+	}
+	GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_TEXTURE, &textureObj, 1);
+	glDeleteTextures(1, &textureObj);
+	CreateTexture(image, level);
+	return true;
 }
 
 void ImageTexture::Preview()
 {
 	std::string windowText = "[DEBUG] TexturePreview: " + texFilePath;
+	// Cooked textures are uploaded without keeping the decoded image.
+	if (texImage.empty() && !DecodeImage(texFilePath, texImage))
+		return;
 	cv::Mat previewImg = cv::Mat(texImage.rows, texImage.cols, texImage.type());
 	cv::cvtColor(texImage, previewImg, cv::COLOR_BGR2RGB);
 	cv::imshow(windowText, previewImg);
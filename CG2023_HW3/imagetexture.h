@@ -2,6 +2,10 @@
 #define IMAGE_TEXTURE_H
 
 #include "headers.h"
+#include "texturecook.h"
+
+// C++ STL headers.
+#include <atomic>
 
 // Texture Declarations.
 class ImageTexture
@@ -9,21 +13,68 @@ class ImageTexture
 public:
 	// Texture Public Methods.
 	ImageTexture(const std::string filePath);
+	// Upload a texture prepared by LoadImageData (e.g. on another thread).
+	ImageTexture(const std::string filePath, const CookedTexture& image);
+	// A 1x1 white texture.
 	ImageTexture();
 	~ImageTexture();
 
+	// The 1x1 white texture bound for materials without map_Kd, shared by
+	// all of them and created on first use. Release it before the GL
+	// context goes away.
+	static ImageTexture* GetDefaultWhite();
+	static void ReleaseDefaultTextures();
+
 	void Bind(GLenum textureUnit);
 	void Preview();
 	std::string GetPath() const { return texFilePath; }
 
+	// Get the full mip chain of an image file: from its cooked *.texbin if
+	// that is up to date, else by decoding the image and cooking it (the
+	// *.texbin is written for the next run). No GL calls, so it is safe on
+	// any thread. Returns false if the image cannot be read.
+	static bool LoadImageData(const std::string& filePath, CookedTexture& image);
+	// Read an image file and flip it to GL row order.
+	static bool DecodeImage(const std::string& filePath, cv::Mat& image);
+	// Store newly cooked textures as BC1 when the GL supports it (3-channel
+	// images only; off by default).
+	static void SetBlockCompression(const bool enable) { blockCompression = enable; }
+	// Filter the mips of newly cooked textures in linear light (on by
+	// default); see MipBuildOptions::gammaCorrect.
+	static void SetGammaCorrectMips(const bool enable) { gammaCorrectMips = enable; }
+	static bool GetGammaCorrectMips() { return gammaCorrectMips; }
+	// GPU memory of the texture including its mipmaps.
+	size_t GetNumBytes() const { return numBytes; }
+
+	// Residency (see TextureResidency). Only the mips from the base level on
+	// are on the GPU; a base level of GetNumLevels() means none are.
+	int GetNumLevels() const { return (int)levelBytes.size(); }
+	int GetBaseLevel() const { return baseLevel; }
+	size_t GetResidentBytes() const { return residentBytes; }
+	size_t GetBytesFromLevel(const int level) const;
+	// Re-upload the mips from level on (read back from the cooked file), or
+	// free the texture for a level past the last. Returns false if the image
+	// cannot be read any more.
+	bool SetBaseLevel(const int level);
+
 private:
+	// Texture Private Methods.
+	void CreateTexture(const CookedTexture& image, const int firstLevel = 0);
+
 	// Texture Private Data.
 	std::string texFilePath;
 	GLuint textureObj;
 	int imageWidth;
 	int imageHeight;
 	int numChannels;
+	size_t numBytes;
+	std::vector<size_t> levelBytes;
+	int baseLevel;
+	size_t residentBytes;
 	cv::Mat texImage;
+	static std::atomic<bool> blockCompression;
+	static std::atomic<bool> gammaCorrectMips;
+	static ImageTexture* defaultWhite;
 };
 
 #endif
@@ -2,6 +2,8 @@
 #define LIGHT_H
 
 #include "headers.h"
+#include "glresourcetracker.h"
+#include "glstatecache.h"
 
 
 // VertexP Declarations.
@@ -27,17 +29,20 @@ public:
 		intensity = I;
 		CreateVisGeometry();
 	}
+	~PointLight() {
+		GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_VERTEX_ARRAY, &vaoId, 1);
+		glDeleteVertexArrays(1, &vaoId);
+		GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_BUFFER, &vboId, 1);
+		glDeleteBuffers(1, &vboId);
+	}
 
 	glm::vec3 GetPosition()  const { return position;  }
 	glm::vec3 GetIntensity() const { return intensity; }
 	
 	void Draw() {
 		glPointSize(16.0f);
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vboId);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexP), 0);
+		GLStateCache::GetInstance().BindVertexArray(vaoId);
 		glDrawArrays(GL_POINTS, 0, 1);
-		glDisableVertexAttribArray(0);
 		glPointSize(1.0f);
 	}
 
@@ -51,12 +56,22 @@ protected:
 	void CreateVisGeometry() {
 		VertexP lightVtx = glm::vec3(0, 0, 0);
 		const int numVertex = 1;
+		GLStateCache& stateCache = GLStateCache::GetInstance();
+		glGenVertexArrays(1, &vaoId);
+		GL_TRACK_CREATE(GL_RESOURCE_VERTEX_ARRAY, &vaoId, 1, "PointLight");
+		stateCache.BindVertexArray(vaoId);
 		glGenBuffers(1, &vboId);
-		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+		GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &vboId, 1, "PointLight");
+		stateCache.BindBuffer(GL_ARRAY_BUFFER, vboId);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexP) * numVertex, &lightVtx, GL_STATIC_DRAW);
+		GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, vboId, sizeof(VertexP) * numVertex);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexP), 0);
+		stateCache.BindVertexArray(0);
 	}
 
 	// PointLight Private Data.
+	GLuint vaoId;
 	GLuint vboId;
 	glm::vec3 position;
 	glm::vec3 intensity;
@@ -75,7 +90,7 @@ public:
 		// -------------------------------------------------------
 		// Add your initialization code here.
 		// -------------------------------------------------------
-		CreateVisGeometry();
+		// PointLight() has created the visual geometry already.
 	}
 	SpotLight(const glm::vec3 p, const glm::vec3 I, const glm::vec3 D, const float cutoffDeg, const float totalWidthDeg) {
 		position = p;
@@ -86,7 +101,7 @@ public:
 		cutoff = glm::radians(cutoffDeg);
 		totalwidth = glm::radians(totalWidthDeg);
 		// -------------------------------------------------------
-		CreateVisGeometry();
+		// PointLight() has created the visual geometry already.
 	}
 
 	// -------------------------------------------------------
@@ -0,0 +1,111 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	data = nullptr;
+	size = 0;
+	opened = false;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	fileDesc = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+#ifdef _WIN32
+	fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+							 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx((HANDLE)fileHandle, &fileSize)) {
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	opened = true;
+	// An empty file cannot be mapped, but it is still a valid (empty) file.
+	if (size == 0)
+		return true;
+
+	mappingHandle = CreateFileMappingA((HANDLE)fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == nullptr) {
+		Close();
+		return false;
+	}
+	data = (const char*)MapViewOfFile((HANDLE)mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		Close();
+		return false;
+	}
+#else
+	fileDesc = open(filePath.c_str(), O_RDONLY);
+	if (fileDesc < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fileDesc, &st) != 0 || !S_ISREG(st.st_mode)) {
+		Close();
+		return false;
+	}
+	size = (size_t)st.st_size;
+	opened = true;
+	if (size == 0)
+		return true;
+
+	void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDesc, 0);
+	if (p == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	// The parsers scan front to back.
+	madvise(p, size, MADV_SEQUENTIAL);
+	data = (const char*)p;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != nullptr)
+		CloseHandle((HANDLE)mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle((HANDLE)fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != nullptr)
+		munmap((void*)data, size);
+	if (fileDesc >= 0)
+		close(fileDesc);
+	fileDesc = -1;
+#endif
+	data = nullptr;
+	size = 0;
+	opened = false;
+}
@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+// C++ STL headers.
+#include <string>
+#include <cstddef>
+
+// MappedFile Declarations.
+// Read-only memory mapping of a whole file. The mapped bytes are not
+// null-terminated; always use GetSize() to find the end.
+class MappedFile
+{
+public:
+	// MappedFile Public Methods.
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const std::string& filePath);
+	void Close();
+
+	bool IsOpen() const { return opened; }
+	const char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	// Non-copyable: the mapping is released in the destructor.
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// MappedFile Private Data.
+	const char* data;
+	size_t size;
+	bool opened;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDesc;
+#endif
+};
+
+#endif
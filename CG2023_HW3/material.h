@@ -5,6 +5,9 @@
 #include "shaderprog.h"
 #include "imagetexture.h"
 
+// C++ STL headers.
+#include <memory>
+
 // Material Declarations.
 class Material
 {
@@ -33,7 +36,6 @@ public:
 		Kd = glm::vec3(0.0f, 0.0f, 0.0f);
 		Ks = glm::vec3(0.0f, 0.0f, 0.0f);
 		Ns = 0.0f;
-		mapKd = nullptr;
 	};
 	~PhongMaterial() {};
 
@@ -41,13 +43,14 @@ public:
 	void SetKd(const glm::vec3 kd) { Kd = kd; }
 	void SetKs(const glm::vec3 ks) { Ks = ks; }
 	void SetNs(const float n) { Ns = n; }
-	void SetMapKd(ImageTexture* tex) { mapKd = tex; }
+	// Textures are shared through the TextureCache.
+	void SetMapKd(const std::shared_ptr<ImageTexture>& tex) { mapKd = tex; }
 
 	const glm::vec3 GetKa() const { return Ka; }
 	const glm::vec3 GetKd() const { return Kd; }
 	const glm::vec3 GetKs() const { return Ks; }
 	const float GetNs() const { return Ns; }
-	ImageTexture* GetMapKd() const { return mapKd; }
+	ImageTexture* GetMapKd() const { return mapKd.get(); }
 
 private:
 	// PhongMaterial Private Data.
@@ -55,7 +58,7 @@ private:
 	glm::vec3 Kd;
 	glm::vec3 Ks;
 	float Ns;
-	ImageTexture* mapKd;
+	std::shared_ptr<ImageTexture> mapKd;
 };
 
 // ------------------------------------------------------------------------------------------------
@@ -0,0 +1,317 @@
+#include "meshcache.h"
+#include "mappedfile.h"
+#include "filehash.h"
+#include "meshsimplify.h"
+
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+static_assert(sizeof(VertexPTN) == 32, "VertexPTN is stored in the cache as raw bytes");
+
+namespace {
+
+// MeshCacheHeader Declarations.
+// Followed by: MTL paths, materials, SubMeshes (name, count, indices), vertices,
+// LODs (error, triangle count, then count and indices per SubMesh).
+// Strings are stored as a uint32_t length and the bytes; paths are relative
+// to the OBJ directory when they lie inside it.
+struct MeshCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t vertexStride;
+	uint64_t sourceHash;
+	uint32_t normalized;
+	int32_t numTriangles;
+	uint32_t numVertices;
+	uint32_t numSubMeshes;
+	uint32_t numMaterials;
+	uint32_t numMtlPaths;
+	uint32_t numLODs;
+	float objCenter[3];
+	float objExtent[3];
+	// ACMR and ATVR before and after reordering.
+	float vertexCacheStats[4];
+};
+
+const char MESH_CACHE_MAGIC[8] = { 'M', 'E', 'S', 'H', 'B', 'I', 'N', '\0' };
+
+std::string GetDirectory(const std::string& filePath)
+{
+	size_t part = filePath.rfind("\\");
+	return filePath.substr(0, part + 1);
+}
+
+std::string ToRelative(const std::string& path, const std::string& dir)
+{
+	if (!dir.empty() && path.compare(0, dir.size(), dir) == 0)
+		return path.substr(dir.size());
+	return path;
+}
+
+std::string FromRelative(const std::string& path, const std::string& dir)
+{
+	if (path.empty() || path.find(':') != std::string::npos || path[0] == '\\' || path[0] == '/')
+		return path;
+	return dir + path;
+}
+
+// Combine the OBJ hash with the content of every MTL file.
+bool ComputeSourceHash(const uint64_t objHash, const std::vector<std::string>& mtlPaths, uint64_t& sourceHash)
+{
+	std::vector<uint64_t> hashes;
+	hashes.push_back(objHash);
+	for (const std::string& mtlPath : mtlPaths) {
+		uint64_t h = 0;
+		if (!HashFile(mtlPath, h))
+			return false;
+		hashes.push_back(h);
+	}
+	sourceHash = HashBytes(hashes.data(), hashes.size() * sizeof(uint64_t), MESH_CACHE_VERSION);
+	return true;
+}
+
+// MeshCacheReader Declarations.
+// Bounds-checked cursor over the mapped cache file.
+class MeshCacheReader
+{
+public:
+	MeshCacheReader(const char* begin, const char* end) : p(begin), end(end), ok(true) {}
+
+	bool Read(void* dst, const size_t n) {
+		if (!ok || (size_t)(end - p) < n)
+			return ok = false;
+		memcpy(dst, p, n);
+		p += n;
+		return true;
+	}
+	bool ReadString(std::string& str) {
+		uint32_t len = 0;
+		if (!Read(&len, sizeof(len)) || (size_t)(end - p) < len)
+			return ok = false;
+		str.assign(p, len);
+		p += len;
+		return true;
+	}
+	template <typename T>
+	bool ReadArray(std::vector<T>& dst, const size_t count) {
+		if (!ok || (size_t)(end - p) / sizeof(T) < count)
+			return ok = false;
+		dst.resize(count);
+		return count == 0 || Read(dst.data(), count * sizeof(T));
+	}
+	// Fail unless count items of at least minBytes each are left, so that
+	// counts from a corrupt file are not allocated.
+	bool CanHold(const size_t count, const size_t minBytes) {
+		if (!ok || (size_t)(end - p) / minBytes < count)
+			return ok = false;
+		return true;
+	}
+	bool IsOk() const { return ok; }
+
+private:
+	const char* p;
+	const char* end;
+	bool ok;
+};
+
+// True if every index refers to one of numVertices vertices.
+bool IndicesInRange(const std::vector<unsigned int>& indices, const size_t numVertices)
+{
+	for (const unsigned int index : indices) {
+		if (index >= numVertices)
+			return false;
+	}
+	return true;
+}
+
+void WriteString(std::ofstream& ofs, const std::string& str)
+{
+	const uint32_t len = (uint32_t)str.size();
+	ofs.write((const char*)&len, sizeof(len));
+	ofs.write(str.data(), len);
+}
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+MeshCacheData::MeshCacheData()
+{
+	numTriangles = 0;
+	objCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+	objExtent = glm::vec3(0.0f, 0.0f, 0.0f);
+	normalized = false;
+}
+
+std::string GetMeshCachePath(const std::string& objPath)
+{
+	return objPath + ".meshbin";
+}
+
+bool ReadMeshCache(const std::string& objPath, const uint64_t objHash, const bool normalized, MeshCacheData& data)
+{
+	MappedFile file;
+	if (!file.Open(GetMeshCachePath(objPath)))
+		return false;
+	MeshCacheReader reader(file.GetData(), file.GetData() + file.GetSize());
+
+	MeshCacheHeader header;
+	if (!reader.Read(&header, sizeof(header))
+		|| memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0
+		|| header.version != MESH_CACHE_VERSION
+		|| header.vertexStride != sizeof(VertexPTN)
+		|| (header.normalized != 0) != normalized
+		|| header.numLODs >= (uint32_t)MAX_MESH_LODS)
+		return false;
+
+	const std::string dir = GetDirectory(objPath);
+	if (!reader.CanHold(header.numMtlPaths, sizeof(uint32_t)))
+		return false;
+	data.mtlPaths.resize(header.numMtlPaths);
+	for (std::string& mtlPath : data.mtlPaths) {
+		if (!reader.ReadString(mtlPath))
+			return false;
+		mtlPath = FromRelative(mtlPath, dir);
+	}
+	uint64_t sourceHash = 0;
+	if (!ComputeSourceHash(objHash, data.mtlPaths, sourceHash) || sourceHash != header.sourceHash)
+		return false;
+
+	// Two strings and the colours at least.
+	const size_t minMaterialBytes = 2 * sizeof(uint32_t) + 3 * sizeof(glm::vec3) + sizeof(float);
+	if (!reader.CanHold(header.numMaterials, minMaterialBytes))
+		return false;
+	data.materials.resize(header.numMaterials);
+	for (ObjMaterial& m : data.materials) {
+		reader.ReadString(m.name);
+		reader.Read(&m.Ka, sizeof(m.Ka));
+		reader.Read(&m.Kd, sizeof(m.Kd));
+		reader.Read(&m.Ks, sizeof(m.Ks));
+		reader.Read(&m.Ns, sizeof(m.Ns));
+		reader.ReadString(m.mapKd);
+		m.mapKd = FromRelative(m.mapKd, dir);
+	}
+	// A name and an index count at least.
+	if (!reader.CanHold(header.numSubMeshes, 2 * sizeof(uint32_t)))
+		return false;
+	data.subMeshes.resize(header.numSubMeshes);
+	for (ObjSubMesh& sm : data.subMeshes) {
+		uint32_t count = 0;
+		reader.ReadString(sm.materialName);
+		reader.Read(&count, sizeof(count));
+		reader.ReadArray(sm.vertexIndices, count);
+	}
+	reader.ReadArray(data.vertices, header.numVertices);
+	for (const ObjSubMesh& sm : data.subMeshes) {
+		if (!IndicesInRange(sm.vertexIndices, header.numVertices))
+			return false;
+	}
+	data.lods.resize(header.numLODs);
+	for (MeshLODData& lod : data.lods) {
+		reader.Read(&lod.error, sizeof(lod.error));
+		reader.Read(&lod.numTriangles, sizeof(lod.numTriangles));
+		lod.subMeshIndices.resize(header.numSubMeshes);
+		for (std::vector<unsigned int>& indices : lod.subMeshIndices) {
+			uint32_t count = 0;
+			reader.Read(&count, sizeof(count));
+			reader.ReadArray(indices, count);
+		}
+	}
+	if (!reader.IsOk())
+		return false;
+	// The triangle counts pick the LODs and size their draws.
+	for (const MeshLODData& lod : data.lods) {
+		size_t numIndices = 0;
+		for (const std::vector<unsigned int>& indices : lod.subMeshIndices) {
+			if (!IndicesInRange(indices, header.numVertices))
+				return false;
+			numIndices += indices.size();
+		}
+		if (numIndices % 3 != 0 || lod.numTriangles < 0 || numIndices / 3 != (size_t)lod.numTriangles)
+			return false;
+	}
+
+	data.numTriangles = header.numTriangles;
+	data.objCenter = glm::vec3(header.objCenter[0], header.objCenter[1], header.objCenter[2]);
+	data.objExtent = glm::vec3(header.objExtent[0], header.objExtent[1], header.objExtent[2]);
+	data.normalized = normalized;
+	data.vertexCacheBefore.acmr = header.vertexCacheStats[0];
+	data.vertexCacheBefore.atvr = header.vertexCacheStats[1];
+	data.vertexCacheAfter.acmr = header.vertexCacheStats[2];
+	data.vertexCacheAfter.atvr = header.vertexCacheStats[3];
+	return true;
+}
+
+bool WriteMeshCache(const std::string& objPath, const uint64_t objHash, const MeshCacheData& data)
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(VertexPTN);
+	if (!ComputeSourceHash(objHash, data.mtlPaths, header.sourceHash))
+		return false;
+	header.normalized = data.normalized ? 1 : 0;
+	header.numTriangles = data.numTriangles;
+	header.numVertices = (uint32_t)data.vertices.size();
+	header.numSubMeshes = (uint32_t)data.subMeshes.size();
+	header.numMaterials = (uint32_t)data.materials.size();
+	header.numMtlPaths = (uint32_t)data.mtlPaths.size();
+	header.numLODs = (uint32_t)data.lods.size();
+	for (int i = 0; i < 3; ++i) {
+		header.objCenter[i] = data.objCenter[i];
+		header.objExtent[i] = data.objExtent[i];
+	}
+	header.vertexCacheStats[0] = data.vertexCacheBefore.acmr;
+	header.vertexCacheStats[1] = data.vertexCacheBefore.atvr;
+	header.vertexCacheStats[2] = data.vertexCacheAfter.acmr;
+	header.vertexCacheStats[3] = data.vertexCacheAfter.atvr;
+
+	const std::string cachePath = GetMeshCachePath(objPath);
+	const std::string tempPath = cachePath + ".tmp";
+	const std::string dir = GetDirectory(objPath);
+	{
+		std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+		if (!ofs.is_open())
+			return false;
+		ofs.write((const char*)&header, sizeof(header));
+		for (const std::string& mtlPath : data.mtlPaths)
+			WriteString(ofs, ToRelative(mtlPath, dir));
+		for (const ObjMaterial& m : data.materials) {
+			WriteString(ofs, m.name);
+			ofs.write((const char*)&m.Ka, sizeof(m.Ka));
+			ofs.write((const char*)&m.Kd, sizeof(m.Kd));
+			ofs.write((const char*)&m.Ks, sizeof(m.Ks));
+			ofs.write((const char*)&m.Ns, sizeof(m.Ns));
+			WriteString(ofs, ToRelative(m.mapKd, dir));
+		}
+		for (const ObjSubMesh& sm : data.subMeshes) {
+			const uint32_t count = (uint32_t)sm.vertexIndices.size();
+			WriteString(ofs, sm.materialName);
+			ofs.write((const char*)&count, sizeof(count));
+			ofs.write((const char*)sm.vertexIndices.data(), count * sizeof(unsigned int));
+		}
+		ofs.write((const char*)data.vertices.data(), data.vertices.size() * sizeof(VertexPTN));
+		for (const MeshLODData& lod : data.lods) {
+			ofs.write((const char*)&lod.error, sizeof(lod.error));
+			ofs.write((const char*)&lod.numTriangles, sizeof(lod.numTriangles));
+			for (const std::vector<unsigned int>& indices : lod.subMeshIndices) {
+				const uint32_t count = (uint32_t)indices.size();
+				ofs.write((const char*)&count, sizeof(count));
+				ofs.write((const char*)indices.data(), count * sizeof(unsigned int));
+			}
+		}
+		if (!ofs.good())
+			return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, cachePath, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,69 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "objparser.h"
+#include "bounds.h"
+#include "vertexcache.h"
+
+// C++ STL headers.
+#include <cstdint>
+
+// Binary mesh cache (*.meshbin).
+// A cache file sits next to its OBJ file and holds the fully processed mesh:
+// deduplicated vertices, per-SubMesh index lists, material records, the
+// bounding box and the simplified levels of detail, all in the order of
+// OptimizeMeshOrder (vertexcache.h). It is keyed by a hash of the OBJ and
+// all of its MTL files, so editing any of them invalidates it. Bump
+// MESH_CACHE_VERSION whenever the layout or the meaning of the stored data
+// changes.
+const uint32_t MESH_CACHE_VERSION = 5;
+
+// MeshLODData Declarations.
+// A simplified level of a mesh (see meshsimplify.h): the indices of each
+// SubMesh into the mesh's own vertices.
+struct MeshLODData
+{
+	MeshLODData() { error = 0.0f; numTriangles = 0; }
+
+	// Geometric error against the full mesh, in model units.
+	float error;
+	int numTriangles;
+	std::vector<std::vector<unsigned int>> subMeshIndices;
+};
+
+// MeshCacheData Declarations.
+struct MeshCacheData
+{
+	MeshCacheData();
+
+	std::vector<VertexPTN> vertices;
+	std::vector<ObjSubMesh> subMeshes;
+	std::vector<ObjMaterial> materials;
+	// MTL files the materials were read from (their content is part of the key).
+	std::vector<std::string> mtlPaths;
+	int numTriangles;
+	glm::vec3 objCenter;
+	glm::vec3 objExtent;
+	bool normalized;
+	// Simplified levels, coarser and coarser.
+	std::vector<MeshLODData> lods;
+	// Of the full-detail SubMeshes in file order and after reordering (see
+	// vertexcache.h).
+	VertexCacheStats vertexCacheBefore;
+	VertexCacheStats vertexCacheAfter;
+	// Bounds of each SubMesh; computed after loading, not stored in the file.
+	std::vector<AABB> subMeshBoxes;
+	std::vector<BoundingSphere> subMeshSpheres;
+};
+
+// The cache file used for an OBJ file.
+std::string GetMeshCachePath(const std::string& objPath);
+
+// Memory-map the cache of objPath and load it if it matches objHash (the
+// HashFile of the OBJ), the current MTL contents and the normalization flag.
+bool ReadMeshCache(const std::string& objPath, const uint64_t objHash, const bool normalized, MeshCacheData& data);
+
+// Write the cache of objPath. The file is written aside and renamed into place.
+bool WriteMeshCache(const std::string& objPath, const uint64_t objHash, const MeshCacheData& data);
+
+#endif
@@ -0,0 +1,481 @@
+#include "meshsimplify.h"
+
+// C++ STL headers.
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Quadric Declarations.
+// Sum of squared distances to a set of planes: v^T A v + 2 b.v + c, with
+// the symmetric A stored as its upper triangle.
+struct Quadric
+{
+	Quadric() { for (int i = 0; i < 10; ++i) q[i] = 0.0; }
+
+	// The plane dot(n, p) + d = 0, n of unit length.
+	void AddPlane(const glm::dvec3& n, const double d) {
+		q[0] += n.x * n.x; q[1] += n.x * n.y; q[2] += n.x * n.z;
+		q[3] += n.y * n.y; q[4] += n.y * n.z; q[5] += n.z * n.z;
+		q[6] += n.x * d; q[7] += n.y * d; q[8] += n.z * d;
+		q[9] += d * d;
+	}
+	void Add(const Quadric& other) { for (int i = 0; i < 10; ++i) q[i] += other.q[i]; }
+	double Evaluate(const glm::vec3& p) const {
+		const double x = p.x, y = p.y, z = p.z;
+		return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z
+			 + q[3] * y * y + 2.0 * q[4] * y * z + q[5] * z * z
+			 + 2.0 * (q[6] * x + q[7] * y + q[8] * z) + q[9];
+	}
+
+	double q[10];
+};
+
+// Simplifier Declarations.
+// The mesh being simplified; Simplify may be called with smaller and
+// smaller targets, each continuing from the last.
+class Simplifier
+{
+public:
+	Simplifier(const std::vector<VertexPTN>& vertices, const std::vector<ObjSubMesh>& subMeshes);
+
+	// Collapse until at most targetTriangles remain or no collapse is left.
+	// Returns false if progress was cancelled.
+	bool Simplify(const int targetTriangles, const ObjLoadProgress* progress);
+	int GetNumTriangles() const { return numTriangles; }
+	// Square root of the largest collapse cost so far.
+	float GetError() const { return (float)std::sqrt(maxCost); }
+	void GetLevel(MeshLODData& level, const size_t numSubMeshes) const;
+
+private:
+	// Queue the cheapest collapse of v, only among those CanCollapse allows
+	// if validate, replacing the one queued before.
+	void PushBest(const uint32_t v, const bool validate);
+	double GetCost(const uint32_t from, const uint32_t to) const;
+	bool CanCollapse(const uint32_t from, const uint32_t to);
+	void ApplyCollapse(const uint32_t from, const uint32_t to);
+	// The queue: a binary min-heap of vertices by collapseCosts, with each
+	// vertex's place in heapPlaces, so that one vertex has one entry.
+	void HeapUpdate(const uint32_t v);
+	void HeapRemove(const uint32_t v);
+	void HeapMove(const size_t place, const uint32_t v) { heap[place] = v; heapPlaces[v] = (int)place; }
+	void SiftUp(size_t place);
+	void SiftDown(size_t place);
+	bool Contains(const uint32_t tri, const uint32_t v) const {
+		return indices[3 * tri] == v || indices[3 * tri + 1] == v || indices[3 * tri + 2] == v;
+	}
+	glm::vec3 GetNormal(const uint32_t tri, const uint32_t from, const uint32_t to) const;
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> triSubMesh;
+	std::vector<char> triAlive;
+	std::vector<std::vector<uint32_t>> vertexTris;
+	std::vector<Quadric> quadrics;
+	std::vector<char> locked;
+	std::vector<char> vertexAlive;
+	// The cheapest collapse of each queued vertex.
+	std::vector<double> collapseCosts;
+	std::vector<uint32_t> collapseTargets;
+	// Reused by PushBest and ApplyCollapse.
+	std::vector<uint32_t> neighbours;
+	std::vector<uint32_t> changed;
+	std::vector<std::pair<double, uint32_t>> candidates;
+	// Stamps for the neighbour sets of CanCollapse.
+	std::vector<uint32_t> marks;
+	uint32_t markStamp;
+	std::vector<uint32_t> heap;
+	std::vector<int> heapPlaces;
+	int numTriangles;
+	double maxCost;
+};
+
+Simplifier::Simplifier(const std::vector<VertexPTN>& vertices, const std::vector<ObjSubMesh>& subMeshes)
+{
+	const size_t numVertices = vertices.size();
+	positions.resize(numVertices);
+	for (size_t v = 0; v < numVertices; ++v)
+		positions[v] = vertices[v].position;
+	numTriangles = 0;
+	maxCost = 0.0;
+	markStamp = 0;
+	for (size_t s = 0; s < subMeshes.size(); ++s) {
+		const std::vector<unsigned int>& subIndices = subMeshes[s].vertexIndices;
+		for (size_t i = 0; i + 2 < subIndices.size(); i += 3) {
+			indices.insert(indices.end(), subIndices.begin() + i, subIndices.begin() + i + 3);
+			triSubMesh.push_back((uint32_t)s);
+		}
+	}
+	const size_t numTris = triSubMesh.size();
+	triAlive.assign(numTris, 1);
+	vertexTris.resize(numVertices);
+	quadrics.resize(numVertices);
+	locked.assign(numVertices, 0);
+	vertexAlive.assign(numVertices, 1);
+	collapseCosts.assign(numVertices, 0.0);
+	collapseTargets.assign(numVertices, 0);
+	heapPlaces.assign(numVertices, -1);
+	marks.assign(numVertices, 0);
+
+	// Vertices used by two SubMeshes lie on a material border.
+	std::vector<int> vertexSubMesh(numVertices, -1);
+	for (size_t t = 0; t < numTris; ++t) {
+		const uint32_t* tri = &indices[3 * t];
+		if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+			triAlive[t] = 0;
+			continue;
+		}
+		numTriangles++;
+		for (int k = 0; k < 3; ++k) {
+			vertexTris[tri[k]].push_back((uint32_t)t);
+			if (vertexSubMesh[tri[k]] < 0)
+				vertexSubMesh[tri[k]] = (int)triSubMesh[t];
+			else if (vertexSubMesh[tri[k]] != (int)triSubMesh[t])
+				locked[tri[k]] = 1;
+		}
+		const glm::dvec3 p0 = positions[tri[0]];
+		const glm::dvec3 e1 = glm::dvec3(positions[tri[1]]) - p0;
+		const glm::dvec3 e2 = glm::dvec3(positions[tri[2]]) - p0;
+		const glm::dvec3 n = glm::cross(e1, e2);
+		const double length = glm::length(n);
+		if (length > 0.0) {
+			const glm::dvec3 unit = n / length;
+			for (int k = 0; k < 3; ++k)
+				quadrics[tri[k]].AddPlane(unit, -glm::dot(unit, p0));
+		}
+	}
+
+	// Vertices split by a UV or normal seam share their position.
+	std::vector<uint32_t> order(numVertices);
+	for (size_t v = 0; v < numVertices; ++v)
+		order[v] = (uint32_t)v;
+	auto lessPosition = [this](const uint32_t a, const uint32_t b) {
+		const glm::vec3& pa = positions[a];
+		const glm::vec3& pb = positions[b];
+		return pa.x < pb.x || (pa.x == pb.x && (pa.y < pb.y || (pa.y == pb.y && pa.z < pb.z)));
+	};
+	std::sort(order.begin(), order.end(), lessPosition);
+	for (size_t i = 1; i < numVertices; ++i) {
+		if (positions[order[i]] == positions[order[i - 1]]) {
+			locked[order[i]] = 1;
+			locked[order[i - 1]] = 1;
+		}
+	}
+
+	// Edges with a single triangle lie on an open boundary.
+	std::vector<uint64_t> edges;
+	edges.reserve(3 * (size_t)numTriangles);
+	for (size_t t = 0; t < numTris; ++t) {
+		if (!triAlive[t])
+			continue;
+		for (int k = 0; k < 3; ++k) {
+			const uint64_t a = indices[3 * t + k], b = indices[3 * t + (k + 1) % 3];
+			edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size();) {
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+		if (j - i == 1) {
+			locked[(uint32_t)(edges[i] >> 32)] = 1;
+			locked[(uint32_t)edges[i]] = 1;
+		}
+		i = j;
+	}
+
+	for (size_t v = 0; v < numVertices; ++v) {
+		if (!vertexTris[v].empty())
+			PushBest((uint32_t)v, false);
+	}
+}
+
+double Simplifier::GetCost(const uint32_t from, const uint32_t to) const
+{
+	Quadric q = quadrics[from];
+	q.Add(quadrics[to]);
+	return std::max(q.Evaluate(positions[to]), 0.0);
+}
+
+void Simplifier::PushBest(const uint32_t v, const bool validate)
+{
+	if (locked[v])
+		return;
+	markStamp += 2;
+	neighbours.clear();
+	for (const uint32_t t : vertexTris[v]) {
+		for (int k = 0; k < 3; ++k) {
+			const uint32_t n = indices[3 * t + k];
+			if (n != v && marks[n] != markStamp) {
+				marks[n] = markStamp;
+				neighbours.push_back(n);
+			}
+		}
+	}
+	if (neighbours.empty()) {
+		HeapRemove(v);
+		return;
+	}
+	if (!validate) {
+		// The cheapest; checked once it comes up.
+		collapseCosts[v] = DBL_MAX;
+		for (const uint32_t n : neighbours) {
+			const double cost = GetCost(v, n);
+			if (cost < collapseCosts[v]) {
+				collapseCosts[v] = cost;
+				collapseTargets[v] = n;
+			}
+		}
+	} else {
+		candidates.clear();
+		for (const uint32_t n : neighbours)
+			candidates.push_back(std::make_pair(GetCost(v, n), n));
+		std::sort(candidates.begin(), candidates.end());
+		size_t i = 0;
+		while (i < candidates.size() && !CanCollapse(v, candidates[i].second))
+			i++;
+		if (i == candidates.size()) {
+			HeapRemove(v);
+			return;
+		}
+		collapseCosts[v] = candidates[i].first;
+		collapseTargets[v] = candidates[i].second;
+	}
+	HeapUpdate(v);
+}
+
+void Simplifier::HeapUpdate(const uint32_t v)
+{
+	if (heapPlaces[v] < 0) {
+		heap.push_back(v);
+		heapPlaces[v] = (int)heap.size() - 1;
+	}
+	SiftUp((size_t)heapPlaces[v]);
+	SiftDown((size_t)heapPlaces[v]);
+}
+
+void Simplifier::HeapRemove(const uint32_t v)
+{
+	const int place = heapPlaces[v];
+	if (place < 0)
+		return;
+	heapPlaces[v] = -1;
+	const uint32_t last = heap.back();
+	heap.pop_back();
+	if (last == v)
+		return;
+	HeapMove((size_t)place, last);
+	SiftUp((size_t)place);
+	SiftDown((size_t)heapPlaces[last]);
+}
+
+void Simplifier::SiftUp(size_t place)
+{
+	const uint32_t v = heap[place];
+	while (place > 0) {
+		const size_t parent = (place - 1) / 2;
+		if (collapseCosts[heap[parent]] <= collapseCosts[v])
+			break;
+		HeapMove(place, heap[parent]);
+		place = parent;
+	}
+	HeapMove(place, v);
+}
+
+void Simplifier::SiftDown(size_t place)
+{
+	const uint32_t v = heap[place];
+	for (;;) {
+		size_t child = 2 * place + 1;
+		if (child >= heap.size())
+			break;
+		if (child + 1 < heap.size() && collapseCosts[heap[child + 1]] < collapseCosts[heap[child]])
+			child++;
+		if (collapseCosts[v] <= collapseCosts[heap[child]])
+			break;
+		HeapMove(place, heap[child]);
+		place = child;
+	}
+	HeapMove(place, v);
+}
+
+glm::vec3 Simplifier::GetNormal(const uint32_t tri, const uint32_t from, const uint32_t to) const
+{
+	glm::vec3 p[3];
+	for (int k = 0; k < 3; ++k) {
+		const uint32_t v = indices[3 * tri + k];
+		p[k] = positions[(v == from) ? to : v];
+	}
+	return glm::cross(p[1] - p[0], p[2] - p[0]);
+}
+
+bool Simplifier::CanCollapse(const uint32_t from, const uint32_t to)
+{
+	// Link condition: the only neighbours both vertices share are the third
+	// vertices of the triangles on the edge, or the surface would pinch.
+	markStamp += 2;
+	const uint32_t neighbour = markStamp, counted = markStamp + 1;
+	for (const uint32_t t : vertexTris[to]) {
+		if (!triAlive[t])
+			continue;
+		for (int k = 0; k < 3; ++k)
+			marks[indices[3 * t + k]] = neighbour;
+	}
+	int numEdgeTris = 0;
+	int numShared = 0;
+	for (const uint32_t t : vertexTris[from]) {
+		if (!triAlive[t])
+			continue;
+		if (Contains(t, to)) {
+			numEdgeTris++;
+			continue;
+		}
+		for (int k = 0; k < 3; ++k) {
+			const uint32_t v = indices[3 * t + k];
+			if (v != from && marks[v] == neighbour) {
+				marks[v] = counted;
+				numShared++;
+			}
+		}
+	}
+	// Vertices of the edge triangles were counted only if another triangle
+	// of from reaches them too.
+	for (const uint32_t t : vertexTris[from]) {
+		if (!triAlive[t] || !Contains(t, to))
+			continue;
+		for (int k = 0; k < 3; ++k) {
+			const uint32_t v = indices[3 * t + k];
+			if (v != from && v != to && marks[v] == neighbour) {
+				marks[v] = counted;
+				numShared++;
+			}
+		}
+	}
+	if (numEdgeTris == 0 || numShared != numEdgeTris)
+		return false;
+
+	// No remaining triangle may flip or collapse to a sliver.
+	for (const uint32_t t : vertexTris[from]) {
+		if (!triAlive[t] || Contains(t, to))
+			continue;
+		const glm::vec3 before = GetNormal(t, from, from);
+		const glm::vec3 after = GetNormal(t, from, to);
+		const float lengths = glm::length(before) * glm::length(after);
+		if (lengths <= 0.0f || glm::dot(before, after) < 0.2f * lengths)
+			return false;
+	}
+	return true;
+}
+
+void Simplifier::ApplyCollapse(const uint32_t from, const uint32_t to)
+{
+	for (const uint32_t t : vertexTris[from]) {
+		if (!triAlive[t])
+			continue;
+		if (Contains(t, to)) {
+			triAlive[t] = 0;
+			numTriangles--;
+			continue;
+		}
+		for (int k = 0; k < 3; ++k) {
+			if (indices[3 * t + k] == from)
+				indices[3 * t + k] = to;
+		}
+		vertexTris[to].push_back(t);
+	}
+	std::vector<uint32_t>().swap(vertexTris[from]);
+	std::vector<uint32_t>& toTris = vertexTris[to];
+	toTris.erase(std::remove_if(toTris.begin(), toTris.end(), [this](const uint32_t t) { return !triAlive[t]; }),
+				 toTris.end());
+	quadrics[to].Add(quadrics[from]);
+	vertexAlive[from] = 0;
+	maxCost = std::max(maxCost, collapseCosts[from]);
+	HeapRemove(from);
+
+	// to and its neighbours have new costs (and may have lost from as their
+	// cheapest target).
+	markStamp += 2;
+	changed.assign(1, to);
+	marks[to] = markStamp;
+	for (const uint32_t t : toTris) {
+		for (int k = 0; k < 3; ++k) {
+			const uint32_t v = indices[3 * t + k];
+			if (marks[v] != markStamp) {
+				marks[v] = markStamp;
+				changed.push_back(v);
+			}
+		}
+	}
+	for (const uint32_t v : changed) {
+		// Only the cost onto to changed for a neighbour still queued with
+		// another target.
+		if (v != to && heapPlaces[v] >= 0 && collapseTargets[v] != from && collapseTargets[v] != to) {
+			const double cost = GetCost(v, to);
+			if (cost < collapseCosts[v]) {
+				collapseCosts[v] = cost;
+				collapseTargets[v] = to;
+				HeapUpdate(v);
+			}
+			continue;
+		}
+		PushBest(v, false);
+	}
+}
+
+bool Simplifier::Simplify(const int targetTriangles, const ObjLoadProgress* progress)
+{
+	int numCollapses = 0;
+	while (numTriangles > targetTriangles && !heap.empty()) {
+		const uint32_t from = heap[0], to = collapseTargets[from];
+		// Queue the cheapest one that is allowed instead; a change further
+		// away may have made it pinch or flip.
+		if (!CanCollapse(from, to)) {
+			PushBest(from, true);
+			continue;
+		}
+		ApplyCollapse(from, to);
+		if ((++numCollapses & 0xFFFF) == 0 && progress != nullptr && progress->IsCancelled())
+			return false;
+	}
+	return true;
+}
+
+void Simplifier::GetLevel(MeshLODData& level, const size_t numSubMeshes) const
+{
+	level.error = GetError();
+	level.numTriangles = numTriangles;
+	level.subMeshIndices.assign(numSubMeshes, std::vector<unsigned int>());
+	for (size_t t = 0; t < triSubMesh.size(); ++t) {
+		if (triAlive[t]) {
+			std::vector<unsigned int>& subIndices = level.subMeshIndices[triSubMesh[t]];
+			subIndices.insert(subIndices.end(), indices.begin() + 3 * t, indices.begin() + 3 * t + 3);
+		}
+	}
+}
+
+} // namespace
+
+bool BuildMeshLODs(MeshCacheData& meshData, const ObjLoadProgress* progress)
+{
+	meshData.lods.clear();
+	if (meshData.numTriangles < MESH_LOD_MIN_TRIANGLES)
+		return true;
+	Simplifier simplifier(meshData.vertices, meshData.subMeshes);
+	const int fullTriangles = simplifier.GetNumTriangles();
+	int previousTriangles = fullTriangles;
+	for (int k = 0; k < MAX_MESH_LODS - 1; ++k) {
+		if (!simplifier.Simplify((int)(MESH_LOD_RATIOS[k] * fullTriangles), progress))
+			return false;
+		const int numTriangles = simplifier.GetNumTriangles();
+		// Not worth the extra indices.
+		if (numTriangles > previousTriangles * 3 / 4)
+			break;
+		meshData.lods.push_back(MeshLODData());
+		simplifier.GetLevel(meshData.lods.back(), meshData.subMeshes.size());
+		previousTriangles = numTriangles;
+	}
+	return true;
+}
@@ -0,0 +1,28 @@
+#ifndef MESHSIMPLIFY_H
+#define MESHSIMPLIFY_H
+
+#include "meshcache.h"
+
+// Mesh simplification into level-of-detail chains.
+// Edges are collapsed in order of their quadric error (Garland and
+// Heckbert), always moving a vertex onto one of its neighbours: every level
+// indexes the mesh's own vertices, so normals and texture coordinates stay
+// exact and the levels share one vertex buffer. Vertices on a SubMesh
+// (material) border, on a UV or normal seam (a position shared by several
+// vertices) or on an open boundary never move, which keeps those borders in
+// place. No GL calls, so it is safe on any thread.
+
+// Full detail plus up to four simplified levels.
+const int MAX_MESH_LODS = 5;
+// Triangle count of each simplified level relative to the full mesh.
+const float MESH_LOD_RATIOS[MAX_MESH_LODS - 1] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+// Smaller meshes are always drawn at full detail.
+const int MESH_LOD_MIN_TRIANGLES = 4096;
+
+// Simplify meshData (vertices and subMeshes) into meshData.lods, coarsest
+// last. The chain ends early at a level that would not save a quarter of
+// the triangles of the one before, e.g. once only locked vertices remain.
+// Returns false if progress was cancelled.
+bool BuildMeshLODs(MeshCacheData& meshData, const ObjLoadProgress* progress = nullptr);
+
+#endif
@@ -0,0 +1,322 @@
+#include "mipbuilder.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIP_SIMD_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIP_SIMD_NEON
+#endif
+
+namespace {
+
+// Filtering works on 14-bit values, so the sum of a 2x2 footprint fits in
+// 16 bits. Raw bytes are scaled up by RAW_SHIFT; sRGB bytes are decoded to
+// linear light through a table.
+const int LINEAR_BITS = 14;
+const int LINEAR_MAX = (1 << LINEAR_BITS) - 1;
+const int RAW_SHIFT = LINEAR_BITS - 8;
+
+// GammaTables Declarations.
+struct GammaTables
+{
+	GammaTables() {
+		for (int i = 0; i < 256; ++i) {
+			const double s = i / 255.0;
+			const double linear = (s <= 0.04045) ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+			for (int c = 0; c < 3; ++c)
+				decode[c * 256 + i] = (int32_t)(linear * LINEAR_MAX + 0.5);
+			decode[3 * 256 + i] = i << RAW_SHIFT;
+		}
+		for (int i = 0; i <= LINEAR_MAX; ++i) {
+			const double linear = (double)i / LINEAR_MAX;
+			const double s = (linear <= 0.0031308) ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+			encode[i] = (uint8_t)std::min(255.0, s * 255.0 + 0.5);
+		}
+	}
+
+	// Indexed by channel * 256 + value; channel 3 (alpha) is not gamma encoded.
+	int32_t decode[4 * 256];
+	uint8_t encode[LINEAR_MAX + 1];
+};
+
+const GammaTables& GetGammaTables()
+{
+	static const GammaTables tables;
+	return tables;
+}
+
+// out = (a + b) << RAW_SHIFT
+void SumRawRows(const uint8_t* a, const uint8_t* b, uint16_t* out, const size_t n)
+{
+	size_t i = 0;
+#if defined(MIP_SIMD_AVX2)
+	for (; i + 16 <= n; i += 16) {
+		const __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+		const __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_slli_epi16(_mm256_add_epi16(va, vb), RAW_SHIFT));
+	}
+#elif defined(MIP_SIMD_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+		const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_slli_epi16(lo, RAW_SHIFT));
+		_mm_storeu_si128((__m128i*)(out + i + 8), _mm_slli_epi16(hi, RAW_SHIFT));
+	}
+#elif defined(MIP_SIMD_NEON)
+	for (; i + 16 <= n; i += 16) {
+		const uint8x16_t va = vld1q_u8(a + i), vb = vld1q_u8(b + i);
+		vst1q_u16(out + i, vshlq_n_u16(vaddl_u8(vget_low_u8(va), vget_low_u8(vb)), RAW_SHIFT));
+		vst1q_u16(out + i + 8, vshlq_n_u16(vaddl_u8(vget_high_u8(va), vget_high_u8(vb)), RAW_SHIFT));
+	}
+#endif
+	for (; i < n; ++i)
+		out[i] = (uint16_t)((a[i] + b[i]) << RAW_SHIFT);
+}
+
+// out = a + b
+void AddRows(const uint16_t* a, const uint16_t* b, uint16_t* out, const size_t n)
+{
+	size_t i = 0;
+#if defined(MIP_SIMD_AVX2)
+	for (; i + 16 <= n; i += 16) {
+		const __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+		const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_add_epi16(va, vb));
+	}
+#elif defined(MIP_SIMD_SSE2)
+	for (; i + 8 <= n; i += 8) {
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_add_epi16(va, vb));
+	}
+#elif defined(MIP_SIMD_NEON)
+	for (; i + 8 <= n; i += 8)
+		vst1q_u16(out + i, vaddq_u16(vld1q_u16(a + i), vld1q_u16(b + i)));
+#endif
+	for (; i < n; ++i)
+		out[i] = (uint16_t)(a[i] + b[i]);
+}
+
+// Decode a row of sRGB bytes to linear light. Only 4-channel rows have an
+// alpha channel that skips the curve.
+void DecodeGammaRow(const uint8_t* src, uint16_t* out, const size_t n, const int channels)
+{
+	const int32_t* decode = GetGammaTables().decode;
+	size_t i = 0;
+#if defined(MIP_SIMD_AVX2)
+	// 8 lanes hold two whole RGBA pixels, so the table offsets line up.
+	const __m256i offsets = (channels == 4) ? _mm256_setr_epi32(0, 256, 512, 768, 0, 256, 512, 768) : _mm256_setzero_si256();
+	for (; i + 16 <= n; i += 16) {
+		const __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m256i idx0 = _mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), offsets);
+		const __m256i idx1 = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), offsets);
+		const __m256i v0 = _mm256_i32gather_epi32((const int*)decode, idx0, 4);
+		const __m256i v1 = _mm256_i32gather_epi32((const int*)decode, idx1, 4);
+		// packus works per 128-bit lane; put the quarters back in order.
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1), 0xD8);
+		_mm256_storeu_si256((__m256i*)(out + i), packed);
+	}
+#endif
+	if (channels == 4) {
+		for (; i < n; i += 4) {
+			out[i] = (uint16_t)decode[src[i]];
+			out[i + 1] = (uint16_t)decode[src[i + 1]];
+			out[i + 2] = (uint16_t)decode[src[i + 2]];
+			out[i + 3] = (uint16_t)(src[i + 3] << RAW_SHIFT);
+		}
+	}
+	else {
+		for (; i < n; ++i)
+			out[i] = (uint16_t)decode[src[i]];
+	}
+}
+
+// Scalar packing of output pixels from x on; see PackRawPixels.
+template<int CHANNELS, bool GAMMA>
+void PackPixelsFrom(const uint16_t* pairs, uint8_t* dst, const int x, const int dstWidth)
+{
+	const uint8_t* encode = GetGammaTables().encode;
+	for (int i = x; i < dstWidth; ++i) {
+		const uint16_t* p = pairs + (size_t)2 * i * CHANNELS;
+		uint8_t* out = dst + (size_t)i * CHANNELS;
+		for (int c = 0; c < CHANNELS; ++c) {
+			if (GAMMA && (CHANNELS != 4 || c != 3))
+				out[c] = encode[(p[c] + 2) >> 2];
+			else
+				out[c] = (uint8_t)((p[c] + (1 << (RAW_SHIFT + 1))) >> (RAW_SHIFT + 2));
+		}
+	}
+}
+
+template<bool GAMMA>
+void PackPixelsFrom(const uint16_t* pairs, uint8_t* dst, const int x, const int dstWidth, const int channels)
+{
+	switch (channels) {
+	case 1:
+		PackPixelsFrom<1, GAMMA>(pairs, dst, x, dstWidth);
+		break;
+	case 3:
+		PackPixelsFrom<3, GAMMA>(pairs, dst, x, dstWidth);
+		break;
+	default:
+		PackPixelsFrom<4, GAMMA>(pairs, dst, x, dstWidth);
+		break;
+	}
+}
+
+// dst[x * channels + c] = pairs[2 * x * channels + c] / 4, back to 8 bits.
+// Used for raw filtering, where every value is a multiple of 1 << RAW_SHIFT.
+void PackRawPixels(const uint16_t* pairs, uint8_t* dst, const int dstWidth, const int channels)
+{
+	int x = 0;
+#if defined(MIP_SIMD_SSE2)
+	const __m128i round = _mm_set1_epi16(1 << (RAW_SHIFT + 1));
+	if (channels == 1) {
+		// Keep the even 16-bit lanes.
+		const __m128i even = _mm_set1_epi32(0xFFFF);
+		for (; x + 16 <= dstWidth; x += 16) {
+			__m128i v[4];
+			for (int k = 0; k < 4; ++k)
+				v[k] = _mm_and_si128(_mm_srli_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(pairs + 2 * x) + k), round), RAW_SHIFT + 2), even);
+			const __m128i lo = _mm_packs_epi32(v[0], v[1]), hi = _mm_packs_epi32(v[2], v[3]);
+			_mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(lo, hi));
+		}
+	}
+	else if (channels == 4) {
+		// Keep the even pixels (64-bit halves).
+		for (; x + 4 <= dstWidth; x += 4) {
+			__m128i v[4];
+			for (int k = 0; k < 4; ++k)
+				v[k] = _mm_srli_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(pairs + 8 * x) + k), round), RAW_SHIFT + 2);
+			const __m128i lo = _mm_unpacklo_epi64(v[0], v[1]), hi = _mm_unpacklo_epi64(v[2], v[3]);
+			_mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_packus_epi16(lo, hi));
+		}
+	}
+#elif defined(MIP_SIMD_NEON)
+	if (channels == 1) {
+		for (; x + 8 <= dstWidth; x += 8) {
+			const uint16x8x2_t v = vld2q_u16(pairs + 2 * x);
+			vst1_u8(dst + x, vrshrn_n_u16(v.val[0], RAW_SHIFT + 2));
+		}
+	}
+	else if (channels == 4) {
+		for (; x + 2 <= dstWidth; x += 2) {
+			const uint16x8_t v0 = vld1q_u16(pairs + 8 * x), v1 = vld1q_u16(pairs + 8 * x + 8);
+			vst1_u8(dst + 4 * x, vrshrn_n_u16(vcombine_u16(vget_low_u16(v0), vget_low_u16(v1)), RAW_SHIFT + 2));
+		}
+	}
+#endif
+	PackPixelsFrom<false>(pairs, dst, x, dstWidth, channels);
+}
+
+// Same as PackRawPixels for linear-light values: average, then re-encode
+// colour channels to sRGB.
+void PackGammaPixels(const uint16_t* pairs, uint8_t* dst, const int dstWidth, const int channels)
+{
+	PackPixelsFrom<true>(pairs, dst, 0, dstWidth, channels);
+}
+
+// RowScratch Declarations.
+struct RowScratch
+{
+	std::vector<uint16_t> line0, line1, sum, pairs;
+};
+
+void FilterRow(const uint8_t* row0, const uint8_t* row1, const int srcWidth, const int channels,
+			   uint8_t* dst, const int dstWidth, const bool gammaCorrect, RowScratch& scratch)
+{
+	// Vertical sums, with one pixel of room so that horizontal neighbours can
+	// be read at a fixed offset of one pixel. A 1-pixel row is read as two
+	// pixels wide.
+	const size_t n = (size_t)srcWidth * channels;
+	const size_t m = (size_t)2 * dstWidth * channels;
+	scratch.sum.resize(std::max(n, m) + channels);
+	if (gammaCorrect) {
+		scratch.line0.resize(n);
+		scratch.line1.resize(n);
+		DecodeGammaRow(row0, scratch.line0.data(), n, channels);
+		DecodeGammaRow(row1, scratch.line1.data(), n, channels);
+		AddRows(scratch.line0.data(), scratch.line1.data(), scratch.sum.data(), n);
+	}
+	else {
+		SumRawRows(row0, row1, scratch.sum.data(), n);
+	}
+	if (srcWidth == 1)
+		std::copy(scratch.sum.begin(), scratch.sum.begin() + channels, scratch.sum.begin() + channels);
+
+	// Horizontal sums at every pixel; the even ones are the 2x2 footprints.
+	scratch.pairs.resize(m);
+	AddRows(scratch.sum.data(), scratch.sum.data() + channels, scratch.pairs.data(), m);
+
+	if (gammaCorrect)
+		PackGammaPixels(scratch.pairs.data(), dst, dstWidth, channels);
+	else
+		PackRawPixels(scratch.pairs.data(), dst, dstWidth, channels);
+}
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+void BuildMipLevel(const unsigned char* src, const int srcWidth, const int srcHeight, const int channels,
+				   unsigned char* dst, const MipBuildOptions& options)
+{
+	const int dstWidth = std::max(1, srcWidth / 2), dstHeight = std::max(1, srcHeight / 2);
+	const size_t srcPitch = (size_t)srcWidth * channels, dstPitch = (size_t)dstWidth * channels;
+	if (options.gammaCorrect)
+		GetGammaTables();
+
+	// Jobs of at least 64 KB of output, so small levels stay on one thread.
+	const int rowsPerJob = (int)std::max((size_t)1, ((size_t)1 << 16) / dstPitch);
+	const int numJobs = (dstHeight + rowsPerJob - 1) / rowsPerJob;
+	int numThreads = options.numThreads > 0 ? options.numThreads : (int)std::thread::hardware_concurrency();
+	numThreads = std::max(1, std::min(numThreads, numJobs));
+
+	std::atomic<int> nextJob(0);
+	const auto worker = [&]() {
+		RowScratch scratch;
+		for (int job = nextJob++; job < numJobs; job = nextJob++) {
+			const int yEnd = std::min(dstHeight, (job + 1) * rowsPerJob);
+			for (int y = job * rowsPerJob; y < yEnd; ++y) {
+				const int y0 = std::min(2 * y, srcHeight - 1), y1 = std::min(2 * y + 1, srcHeight - 1);
+				FilterRow(src + y0 * srcPitch, src + y1 * srcPitch, srcWidth, channels,
+						  dst + y * dstPitch, dstWidth, options.gammaCorrect, scratch);
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < numThreads; ++t)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread& th : pool)
+		th.join();
+}
+
+const char* GetMipBuilderSimdName()
+{
+#if defined(MIP_SIMD_AVX2)
+	return "AVX2";
+#elif defined(MIP_SIMD_SSE2)
+	return "SSE2";
+#elif defined(MIP_SIMD_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
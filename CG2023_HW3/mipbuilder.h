@@ -0,0 +1,36 @@
+#ifndef MIPBUILDER_H
+#define MIPBUILDER_H
+
+// C++ STL headers.
+#include <cstddef>
+
+// CPU mip-chain filtering.
+// Levels are built with a 2x2 box filter on 8-bit images of 1, 3 or 4
+// channels. The inner loops use AVX2 when the compiler targets it
+// (/arch:AVX2, -mavx2), otherwise SSE2 on x86/x64 and NEON on ARM; rows are
+// split across threads. No GL calls, so it is safe on any thread.
+
+// MipBuildOptions Declarations.
+struct MipBuildOptions
+{
+	MipBuildOptions() { gammaCorrect = true; numThreads = 0; }
+
+	// Average in linear light: colour channels are decoded from sRGB before
+	// filtering and re-encoded after it; the 4th channel (alpha) is always
+	// averaged as is. Without it the stored values are averaged directly.
+	bool gammaCorrect;
+	// 0 = one per hardware thread.
+	int numThreads;
+};
+
+// Half-size an image (rows tightly packed) into dst, which must hold
+// max(1, srcWidth / 2) x max(1, srcHeight / 2) pixels. For odd sizes the
+// last row or column is dropped, except that a 1-pixel side is averaged
+// with itself.
+void BuildMipLevel(const unsigned char* src, const int srcWidth, const int srcHeight, const int channels,
+				   unsigned char* dst, const MipBuildOptions& options);
+
+// The instruction set the filter was compiled for: "AVX2", "SSE2", "NEON" or "scalar".
+const char* GetMipBuilderSimdName();
+
+#endif
@@ -0,0 +1,721 @@
+#include "objparser.h"
+#include "mappedfile.h"
+#include "decompressstream.h"
+
+#include <cfloat>
+#include <cstring>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+// Pointer-based tokenizer helpers. All of them work on [p, end) and never
+// look past end, so the text does not need to be null-terminated.
+namespace {
+
+inline bool IsBlank(const char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline const char* SkipBlanks(const char* p, const char* end)
+{
+	while (p < end && IsBlank(*p)) ++p;
+	return p;
+}
+
+inline const char* SkipLine(const char* p, const char* end)
+{
+	const char* nl = (const char*)memchr(p, '\n', end - p);
+	return nl ? nl + 1 : end;
+}
+
+inline const char* TokenEnd(const char* p, const char* end)
+{
+	while (p < end && *p != '\n' && !IsBlank(*p)) ++p;
+	return p;
+}
+
+inline bool TokenIs(const char* p, const char* q, const char* keyword, const size_t len)
+{
+	return (size_t)(q - p) == len && memcmp(p, keyword, len) == 0;
+}
+
+// Same rules as "iss >> value": skip blanks, stop at the first invalid
+// character, and yield 0 when nothing could be read.
+inline const char* ReadFloat(const char* p, const char* end, float& value)
+{
+	p = SkipBlanks(p, end);
+	if (p < end && *p == '+') ++p;
+	std::from_chars_result r = std::from_chars(p, end, value);
+	if (r.ec != std::errc()) {
+		value = 0.0f;
+		return p;
+	}
+	return r.ptr;
+}
+
+inline const char* ReadInt(const char* p, const char* end, int& value)
+{
+	if (p < end && *p == '+') ++p;
+	std::from_chars_result r = std::from_chars(p, end, value);
+	if (r.ec != std::errc()) {
+		value = 0;
+		return p;
+	}
+	return r.ptr;
+}
+
+// Parse a face corner "v", "v/vt", "v//vn" or "v/vt/vn" in [p, q).
+inline void ReadCorner(const char* p, const char* q, ObjCorner& c)
+{
+	c.v = c.vt = c.vn = 0;
+	p = ReadInt(p, q, c.v);
+	if (p < q && *p == '/') {
+		++p;
+		if (p < q && *p != '/')
+			p = ReadInt(p, q, c.vt);
+		if (p < q && *p == '/')
+			ReadInt(p + 1, q, c.vn);
+	}
+}
+
+template <typename T>
+inline void AppendRange(std::vector<T>& dst, const std::vector<T>& src)
+{
+	dst.insert(dst.end(), src.begin(), src.end());
+}
+
+// Run job(i) for i in [0, count) on numThreads threads (the caller included).
+template <typename Job>
+void RunOnWorkers(const int numThreads, const size_t count, const Job& job)
+{
+	std::atomic<size_t> nextIndex(0);
+	const auto worker = [&]() {
+		for (size_t i = nextIndex++; i < count; i = nextIndex++)
+			job(i);
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < numThreads; ++t)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread& th : pool)
+		th.join();
+}
+
+// BlockQueue Declarations.
+// Bounded FIFO of text blocks from the decompression thread to the parser.
+class BlockQueue
+{
+public:
+	explicit BlockQueue(const size_t capacity) : capacity(capacity), producerDone(false), consumerDone(false) {}
+
+	// Wait for room. Returns false if the consumer has stopped.
+	bool Push(std::vector<char>& block) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [&]() { return consumerDone || blocks.size() < capacity; });
+		if (consumerDone)
+			return false;
+		blocks.push_back(std::move(block));
+		notEmpty.notify_one();
+		return true;
+	}
+	// Wait for a block. Returns false once the producer is done and the queue is empty.
+	bool Pop(std::vector<char>& block) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [&]() { return producerDone || !blocks.empty(); });
+		if (blocks.empty())
+			return false;
+		block = std::move(blocks.front());
+		blocks.erase(blocks.begin());
+		notFull.notify_one();
+		return true;
+	}
+	void FinishProducing() {
+		std::lock_guard<std::mutex> lock(mutex);
+		producerDone = true;
+		notEmpty.notify_all();
+	}
+	void FinishConsuming() {
+		std::lock_guard<std::mutex> lock(mutex);
+		consumerDone = true;
+		notFull.notify_all();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+	std::vector<std::vector<char>> blocks;
+	const size_t capacity;
+	bool producerDone;
+	bool consumerDone;
+};
+
+// Decompressed text is handed to the parser in blocks of about this size,
+// cut after the last complete line.
+const size_t STREAM_BLOCK_SIZE = 16u << 20;
+
+// Decompression thread: fill line-aligned blocks until the input ends.
+void DecompressBlocks(DecompressStream& stream, BlockQueue& queue, std::atomic<size_t>& consumed)
+{
+	std::vector<char> carry;
+	while (!stream.IsFinished()) {
+		// A line longer than a block makes the next block grow.
+		std::vector<char> block(std::max(STREAM_BLOCK_SIZE, carry.size() * 2));
+		std::copy(carry.begin(), carry.end(), block.begin());
+		size_t size = carry.size();
+		while (size < block.size() && !stream.IsFinished()) {
+			size += stream.Read(block.data() + size, block.size() - size);
+			consumed = stream.GetConsumed();
+		}
+		block.resize(size);
+
+		carry.clear();
+		if (!stream.IsFinished()) {
+			const auto lineEnd = std::find(block.rbegin(), block.rend(), '\n');
+			if (lineEnd == block.rend()) {
+				carry.swap(block);
+				continue;
+			}
+			carry.assign(lineEnd.base(), block.end());
+			block.erase(lineEnd.base(), block.end());
+		}
+		if (!queue.Push(block))
+			break;
+	}
+	queue.FinishProducing();
+}
+
+// Decompress [data, data + size) on a separate thread and parse the text
+// block by block as it arrives. numBytes receives the decompressed size.
+bool ParseCompressedObjText(const char* data, const size_t size, ObjChunk& chunk, const ObjLoadOptions& options,
+							ObjLoadProgress* progress, int& numThreads, size_t& numBytes)
+{
+	DecompressStream stream;
+	if (!stream.Open(data, size))
+		return false;
+
+	// Two blocks in flight keep both threads busy without holding much text.
+	BlockQueue queue(2);
+	std::atomic<size_t> consumed(0);
+	std::thread decoder([&]() { DecompressBlocks(stream, queue, consumed); });
+
+	std::vector<char> block;
+	numBytes = 0;
+	while (queue.Pop(block)) {
+		if (progress != nullptr && progress->IsCancelled())
+			break;
+		numThreads = ParseObjTextParallel(block.data(), block.data() + block.size(), chunk, options);
+		numBytes += block.size();
+		if (progress != nullptr)
+			progress->Set(OBJ_PROGRESS_PARSED * (float)consumed.load() / (float)size);
+	}
+	queue.FinishConsuming();
+	decoder.join();
+	if (progress != nullptr && progress->IsCancelled())
+		return false;
+	return !stream.HasError();
+}
+
+template <typename T>
+inline const T* FetchAttribute(const std::vector<T>& attrs, const int index)
+{
+	return (index > 0 && index <= (int)attrs.size()) ? &attrs[index - 1] : nullptr;
+}
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+ObjChunk::ObjChunk()
+{
+	Clear();
+}
+
+void ObjChunk::Clear()
+{
+	positions.clear();
+	uvs.clear();
+	normals.clear();
+	corners.clear();
+	faceSizes.clear();
+	materialSwitches.clear();
+	mtllibs.clear();
+	bboxMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	bboxMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+ObjMeshData::ObjMeshData()
+{
+	numTriangles = 0;
+	bboxMin = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	bboxMax = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+ObjMaterial::ObjMaterial()
+{
+	name = "Default";
+	Ka = glm::vec3(0.0f, 0.0f, 0.0f);
+	Kd = glm::vec3(0.0f, 0.0f, 0.0f);
+	Ks = glm::vec3(0.0f, 0.0f, 0.0f);
+	Ns = 0.0f;
+}
+
+CornerIndexTable::CornerIndexTable(const size_t expectedSize)
+{
+	count = 0;
+	numCollisions = 0;
+	mask = 0;
+	// Keep the load factor at or below 1/2.
+	size_t capacity = 16;
+	while (capacity < expectedSize * 2)
+		capacity <<= 1;
+	Rehash(capacity);
+}
+
+size_t CornerIndexTable::Hash(const ObjCorner& c)
+{
+	// Pack the triple into 64 bits and run the murmur3 finalizer over it, so
+	// small and symmetric indices spread over all bits.
+	uint64_t h = (uint64_t)(uint32_t)c.v * 0x9E3779B97F4A7C15ULL;
+	h ^= ((uint64_t)(uint32_t)c.vt << 32 | (uint32_t)c.vn) + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+int CornerIndexTable::FindOrInsert(const ObjCorner& c, const int newIndex, bool& inserted)
+{
+	if ((count + 1) * 2 > slots.size())
+		Rehash(slots.size() * 2);
+	for (size_t i = Hash(c) & mask;; i = (i + 1) & mask) {
+		Slot& slot = slots[i];
+		if (slot.index < 0) {
+			slot.key = c;
+			slot.index = newIndex;
+			count++;
+			inserted = true;
+			return newIndex;
+		}
+		if (slot.key.v == c.v && slot.key.vt == c.vt && slot.key.vn == c.vn) {
+			inserted = false;
+			return slot.index;
+		}
+		numCollisions++;
+	}
+}
+
+void CornerIndexTable::Rehash(const size_t newCapacity)
+{
+	std::vector<Slot> old(newCapacity);
+	old.swap(slots);
+	for (Slot& slot : slots)
+		slot.index = -1;
+	mask = newCapacity - 1;
+	for (const Slot& s : old) {
+		if (s.index < 0)
+			continue;
+		size_t i = Hash(s.key) & mask;
+		while (slots[i].index >= 0)
+			i = (i + 1) & mask;
+		slots[i] = s;
+	}
+}
+
+double ObjLoadStats::GetMBPerSecond() const
+{
+	const double seconds = parseSeconds + buildSeconds;
+	if (seconds <= 0.0)
+		return 0.0;
+	return (double)numBytes / (1024.0 * 1024.0) / seconds;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void ParseObjText(const char* begin, const char* end, ObjChunk& chunk)
+{
+	const char* p = begin;
+	while (p < end) {
+		p = SkipBlanks(p, end);
+		const char* q = TokenEnd(p, end);
+		const size_t len = q - p;
+
+		if (len == 1 && *p == 'v') { //position
+			glm::vec3 pos;
+			q = ReadFloat(q, end, pos.x);
+			q = ReadFloat(q, end, pos.y);
+			q = ReadFloat(q, end, pos.z);
+			chunk.bboxMin = glm::min(chunk.bboxMin, pos);
+			chunk.bboxMax = glm::max(chunk.bboxMax, pos);
+			chunk.positions.push_back(pos);
+		}
+		else if (len == 2 && p[0] == 'v' && p[1] == 't') { //texture
+			glm::vec2 uv;
+			q = ReadFloat(q, end, uv.x);
+			q = ReadFloat(q, end, uv.y);
+			chunk.uvs.push_back(uv);
+		}
+		else if (len == 2 && p[0] == 'v' && p[1] == 'n') { //normal
+			glm::vec3 n;
+			q = ReadFloat(q, end, n.x);
+			q = ReadFloat(q, end, n.y);
+			q = ReadFloat(q, end, n.z);
+			chunk.normals.push_back(n);
+		}
+		else if (len == 1 && *p == 'f') { //face
+			int cnt = 0;
+			for (;;) {
+				const char* t = SkipBlanks(q, end);
+				q = TokenEnd(t, end);
+				if (t == q)
+					break;
+				ObjCorner c;
+				ReadCorner(t, q, c);
+				chunk.corners.push_back(c);
+				cnt++;
+			}
+			chunk.faceSizes.push_back(cnt);
+		}
+		else if (TokenIs(p, q, "usemtl", 6)) {
+			const char* t = SkipBlanks(q, end);
+			q = TokenEnd(t, end);
+			ObjMaterialSwitch ms;
+			ms.firstFace = chunk.faceSizes.size();
+			ms.name.assign(t, q);
+			chunk.materialSwitches.push_back(ms);
+		}
+		else if (TokenIs(p, q, "mtllib", 6)) {
+			const char* t = SkipBlanks(q, end);
+			q = TokenEnd(t, end);
+			chunk.mtllibs.push_back(std::string(t, q));
+		}
+		p = SkipLine(q, end);
+	}
+}
+
+int ParseObjTextParallel(const char* begin, const char* end, ObjChunk& chunk, const ObjLoadOptions& options,
+						 ObjLoadProgress* progress)
+{
+	int numThreads = options.numThreads;
+	if (numThreads <= 0)
+		numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	const size_t size = end - begin;
+	if (numThreads == 1 || size < options.serialThreshold) {
+		if (progress == nullptr) {
+			ParseObjText(begin, end, chunk);
+			return 1;
+		}
+		// Parse line-aligned slices in order so progress can be reported.
+		const size_t sliceSize = 4u << 20;
+		for (const char* p = begin; p < end && !progress->IsCancelled();) {
+			const char* q = ((size_t)(end - p) <= sliceSize) ? end : SkipLine(p + sliceSize - 1, end);
+			ParseObjText(p, q, chunk);
+			p = q;
+			progress->Set(OBJ_PROGRESS_PARSED * (float)(p - begin) / (float)size);
+		}
+		return 1;
+	}
+
+	// Oversplit a little so that threads that finish early can pick up more work.
+	const size_t numSplits = (size_t)numThreads * 4;
+	std::vector<const char*> bounds;
+	bounds.push_back(begin);
+	for (size_t i = 1; i < numSplits; ++i) {
+		const char* p = std::max(begin + size * i / numSplits, bounds.back());
+		p = (p == begin) ? p : SkipLine(p - 1, end);
+		if (p >= end)
+			break;
+		if (p != bounds.back())
+			bounds.push_back(p);
+	}
+	bounds.push_back(end);
+
+	const size_t numChunks = bounds.size() - 1;
+	std::vector<ObjChunk> parts(numChunks);
+	std::atomic<size_t> bytesParsed(0);
+	RunOnWorkers(numThreads, numChunks, [&](const size_t i) {
+		if (progress != nullptr && progress->IsCancelled())
+			return;
+		ParseObjText(bounds[i], bounds[i + 1], parts[i]);
+		if (progress != nullptr) {
+			const size_t done = bytesParsed += (size_t)(bounds[i + 1] - bounds[i]);
+			progress->Set(OBJ_PROGRESS_PARSED * (float)done / (float)size);
+		}
+	});
+	if (progress != nullptr && progress->IsCancelled())
+		return numThreads;
+
+	// Merge in file order. Faces use absolute attribute indices, so plain
+	// concatenation keeps them valid; only usemtl anchors need rebasing.
+	size_t numPositions = chunk.positions.size(), numUVs = chunk.uvs.size(), numNormals = chunk.normals.size();
+	size_t numCorners = chunk.corners.size(), numFaces = chunk.faceSizes.size();
+	for (const ObjChunk& part : parts) {
+		numPositions += part.positions.size();
+		numUVs += part.uvs.size();
+		numNormals += part.normals.size();
+		numCorners += part.corners.size();
+		numFaces += part.faceSizes.size();
+	}
+	chunk.positions.reserve(numPositions);
+	chunk.uvs.reserve(numUVs);
+	chunk.normals.reserve(numNormals);
+	chunk.corners.reserve(numCorners);
+	chunk.faceSizes.reserve(numFaces);
+	for (ObjChunk& part : parts) {
+		const size_t faceOffset = chunk.faceSizes.size();
+		for (ObjMaterialSwitch& ms : part.materialSwitches) {
+			ms.firstFace += faceOffset;
+			chunk.materialSwitches.push_back(std::move(ms));
+		}
+		AppendRange(chunk.mtllibs, part.mtllibs);
+		AppendRange(chunk.positions, part.positions);
+		AppendRange(chunk.uvs, part.uvs);
+		AppendRange(chunk.normals, part.normals);
+		AppendRange(chunk.corners, part.corners);
+		AppendRange(chunk.faceSizes, part.faceSizes);
+		chunk.bboxMin = glm::min(chunk.bboxMin, part.bboxMin);
+		chunk.bboxMax = glm::max(chunk.bboxMax, part.bboxMax);
+		// Release the part right away to keep the peak memory down.
+		part = ObjChunk();
+	}
+	return numThreads;
+}
+
+void BuildObjMesh(const ObjChunk& chunk, ObjMeshData& mesh, ObjLoadProgress* progress)
+{
+	mesh.mtllibs = chunk.mtllibs;
+	mesh.bboxMin = chunk.bboxMin;
+	mesh.bboxMax = chunk.bboxMax;
+
+	CornerIndexTable record(chunk.positions.size());
+	mesh.vertices.reserve(chunk.positions.size());
+	std::unordered_map<std::string, int> subMeshByName;
+	// Faces before the first "usemtl" keep their vertices but belong to no SubMesh.
+	std::vector<unsigned int> orphan;
+	std::vector<unsigned int>* ts = &orphan;
+
+	size_t nextSwitch = 0;
+	const ObjCorner* corner = chunk.corners.data();
+	const size_t numFaces = chunk.faceSizes.size();
+	for (size_t f = 0; f <= numFaces; ++f) {
+		while (nextSwitch < chunk.materialSwitches.size() && chunk.materialSwitches[nextSwitch].firstFace == f) {
+			const std::string& name = chunk.materialSwitches[nextSwitch++].name;
+			std::unordered_map<std::string, int>::iterator it = subMeshByName.find(name);
+			if (it == subMeshByName.end()) {
+				it = subMeshByName.emplace(name, (int)mesh.subMeshes.size()).first;
+				mesh.subMeshes.push_back(ObjSubMesh());
+				mesh.subMeshes.back().materialName = name;
+			}
+			ts = &mesh.subMeshes[it->second].vertexIndices;
+		}
+		if (f == numFaces)
+			break;
+		if (progress != nullptr && (f & 0xFFFF) == 0) {
+			if (progress->IsCancelled())
+				return;
+			progress->Set(OBJ_PROGRESS_PARSED + (OBJ_PROGRESS_BUILT - OBJ_PROGRESS_PARSED) * (float)f / (float)numFaces);
+		}
+
+		int TriangleVertex_1st = -1, last = -1;
+		const int cnt = chunk.faceSizes[f];
+		for (int k = 0; k < cnt; ++k, ++corner) {
+			bool inserted = false;
+			const int id = record.FindOrInsert(*corner, (int)mesh.vertices.size(), inserted);
+			if (inserted) {
+				VertexPTN temp;
+				if (const glm::vec3* pos = FetchAttribute(chunk.positions, corner->v))
+					temp.position = *pos;
+				if (const glm::vec2* uv = FetchAttribute(chunk.uvs, corner->vt))
+					temp.texcoord = *uv;
+				if (const glm::vec3* n = FetchAttribute(chunk.normals, corner->vn))
+					temp.normal = *n;
+				mesh.vertices.push_back(temp);
+			}
+
+			if (k == 0) {
+				TriangleVertex_1st = id;
+			}
+			else if (k > 2) { // polygon subvision
+				ts->push_back(TriangleVertex_1st);
+				ts->push_back(last);
+				mesh.numTriangles++;
+			}
+			ts->push_back(id);
+			last = id;
+		}
+		mesh.numTriangles++;
+	}
+}
+
+bool LoadObjFile(const std::string& filePath, ObjMeshData& mesh, ObjLoadStats* stats, const ObjLoadOptions& options,
+				 ObjLoadProgress* progress)
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point t0 = Clock::now();
+
+	MappedFile file;
+	std::string fallback;
+	const char* begin = nullptr;
+	size_t size = 0;
+	if (file.Open(filePath)) {
+		begin = file.GetData();
+		size = file.GetSize();
+	}
+	else {
+		// Not mappable (e.g. a pipe): read it into memory instead.
+		std::ifstream ifs(filePath, std::ios::binary);
+		if (!ifs.is_open())
+			return false;
+		fallback.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		begin = fallback.data();
+		size = fallback.size();
+	}
+
+	ObjChunk chunk;
+	int numThreads = 1;
+	size_t numBytes = size;
+	const CompressionFormat compression = DetectCompression(begin, size);
+	if (compression == COMPRESSION_NONE) {
+		numThreads = ParseObjTextParallel(begin, begin + size, chunk, options, progress);
+	}
+	else if (!IsCompressionSupported(compression)) {
+		std::cerr << "[WARNING] " << filePath << " is " << GetCompressionName(compression)
+				  << "-compressed, but this build has no " << GetCompressionName(compression) << " support" << std::endl;
+		return false;
+	}
+	else if (!ParseCompressedObjText(begin, size, chunk, options, progress, numThreads, numBytes)) {
+		return false;
+	}
+	if (progress != nullptr && progress->IsCancelled())
+		return false;
+	const Clock::time_point t1 = Clock::now();
+	BuildObjMesh(chunk, mesh, progress);
+	const Clock::time_point t2 = Clock::now();
+	if (progress != nullptr) {
+		if (progress->IsCancelled())
+			return false;
+		progress->Set(OBJ_PROGRESS_BUILT);
+	}
+
+	if (stats != nullptr) {
+		stats->numBytes = numBytes;
+		stats->numThreads = numThreads;
+		stats->parseSeconds = std::chrono::duration<double>(t1 - t0).count();
+		stats->buildSeconds = std::chrono::duration<double>(t2 - t1).count();
+	}
+	return true;
+}
+
+std::vector<std::string> PeekObjMtllibs(const std::string& filePath, const size_t maxBytes)
+{
+	std::vector<std::string> mtllibs;
+	MappedFile file;
+	if (!file.Open(filePath))
+		return mtllibs;
+
+	const char* p = file.GetData();
+	size_t size = std::min(file.GetSize(), maxBytes);
+	std::string head;
+	if (DetectCompression(file.GetData(), file.GetSize()) != COMPRESSION_NONE) {
+		DecompressStream stream;
+		if (!stream.Open(file.GetData(), file.GetSize()))
+			return mtllibs;
+		head.resize(maxBytes);
+		size = 0;
+		while (size < head.size() && !stream.IsFinished())
+			size += stream.Read(&head[size], head.size() - size);
+		p = head.data();
+	}
+
+	const char* const end = p + size;
+	while (p < end) {
+		p = SkipBlanks(p, end);
+		const char* q = TokenEnd(p, end);
+		// A name cut off at maxBytes is left to the full parse.
+		if (TokenIs(p, q, "mtllib", 6) && SkipLine(q, end) < end) {
+			const char* t = SkipBlanks(q, end);
+			q = TokenEnd(t, end);
+			mtllibs.push_back(std::string(t, q));
+		}
+		p = SkipLine(q, end);
+	}
+	return mtllibs;
+}
+
+void NormalizeObjPositions(std::vector<VertexPTN>& vertices, const glm::vec3& center, const glm::vec3& extent)
+{
+	const float maximal_extent_axis = std::max(extent.x, std::max(extent.y, extent.z));
+	for (VertexPTN& v : vertices) {
+		v.position[0] = (v.position[0] - center[0]) / maximal_extent_axis;
+		v.position[1] = (v.position[1] - center[1]) / maximal_extent_axis;
+		v.position[2] = (v.position[2] - center[2]) / maximal_extent_axis;
+	}
+}
+
+bool LoadMtlFile(const std::string& mtlPath, std::vector<ObjMaterial>& materials)
+{
+	MappedFile file;
+	if (!file.Open(mtlPath))
+		return false;
+	const char* p = file.GetData();
+	const char* end = p + file.GetSize();
+	std::string text;
+	if (DetectCompression(p, file.GetSize()) != COMPRESSION_NONE) {
+		if (!ReadInputFile(mtlPath, text))
+			return false;
+		p = text.data();
+		end = p + text.size();
+	}
+
+	// As in the original reader, a "newmtl" only renames the record being
+	// built: unset properties are inherited from the previous material.
+	ObjMaterial temp;
+	while (p < end) {
+		p = SkipBlanks(p, end);
+		const char* q = TokenEnd(p, end);
+		if (TokenIs(p, q, "newmtl", 6)) {
+			const char* t = SkipBlanks(q, end);
+			q = TokenEnd(t, end);
+			if (temp.name != "Default")
+				materials.push_back(temp);
+			temp.name.assign(t, q);
+		}
+		else if (TokenIs(p, q, "Ns", 2)) {
+			q = ReadFloat(q, end, temp.Ns);
+		}
+		else if (TokenIs(p, q, "Ka", 2)) {
+			q = ReadFloat(q, end, temp.Ka.x);
+			q = ReadFloat(q, end, temp.Ka.y);
+			q = ReadFloat(q, end, temp.Ka.z);
+		}
+		else if (TokenIs(p, q, "Kd", 2)) {
+			q = ReadFloat(q, end, temp.Kd.x);
+			q = ReadFloat(q, end, temp.Kd.y);
+			q = ReadFloat(q, end, temp.Kd.z);
+		}
+		else if (TokenIs(p, q, "Ks", 2)) {
+			q = ReadFloat(q, end, temp.Ks.x);
+			q = ReadFloat(q, end, temp.Ks.y);
+			q = ReadFloat(q, end, temp.Ks.z);
+		}
+		else if (TokenIs(p, q, "map_Kd", 6)) {
+			const char* t = SkipBlanks(q, end);
+			q = TokenEnd(t, end);
+			size_t part = mtlPath.rfind("\\");
+			temp.mapKd = mtlPath.substr(0, part + 1) + std::string(t, q);
+		}
+		p = SkipLine(q, end);
+	}
+	materials.push_back(temp);
+	return true;
+}
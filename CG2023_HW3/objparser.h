@@ -0,0 +1,226 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+// GLM.
+#include <glm.hpp>
+
+// C++ STL headers.
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <atomic>
+
+// VertexPTN Declarations.
+struct VertexPTN
+{
+	VertexPTN() {
+		position = glm::vec3(0.0f, 0.0f, 0.0f);
+		normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		texcoord = glm::vec2(0.0f, 0.0f);
+	}
+	VertexPTN(glm::vec3 p, glm::vec3 n, glm::vec2 uv) {
+		position = p;
+		normal = n;
+		texcoord = uv;
+	}
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texcoord;
+	bool operator==(const VertexPTN& v2) const {
+		return (position == v2.position) && (normal == v2.normal) && (texcoord == v2.texcoord);
+	}
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// ObjCorner Declarations.
+// One face corner as written in the file: 1-based indices, 0 if the field is absent.
+struct ObjCorner
+{
+	int v;
+	int vt;
+	int vn;
+};
+
+// CornerIndexTable Declarations.
+// Open-addressing hash table (linear probing) that maps the (v, vt, vn) index
+// triple of a face corner to its vertex index, with a single probe sequence
+// per lookup-or-insert.
+class CornerIndexTable
+{
+public:
+	// CornerIndexTable Public Methods.
+	CornerIndexTable(const size_t expectedSize = 0);
+
+	// Return the vertex index of c. If c is new, store newIndex for it,
+	// set inserted and return newIndex.
+	int FindOrInsert(const ObjCorner& c, const int newIndex, bool& inserted);
+
+	size_t GetSize() const { return count; }
+	size_t GetCapacity() const { return slots.size(); }
+	// Occupied slots skipped over while probing, summed over all calls.
+	unsigned long long GetNumCollisions() const { return numCollisions; }
+
+	static size_t Hash(const ObjCorner& c);
+
+private:
+	// CornerIndexTable Private Methods.
+	void Rehash(const size_t newCapacity);
+
+	// CornerIndexTable Private Data.
+	struct Slot
+	{
+		ObjCorner key;
+		int index;	// -1 if the slot is empty.
+	};
+	std::vector<Slot> slots;
+	size_t mask;
+	size_t count;
+	unsigned long long numCollisions;
+};
+
+// ObjMaterialSwitch Declarations.
+// A "usemtl" record; it applies to faces starting at firstFace.
+struct ObjMaterialSwitch
+{
+	size_t firstFace;
+	std::string name;
+};
+
+// ObjChunk Declarations.
+// Raw records of a piece of OBJ text, in file order.
+struct ObjChunk
+{
+	ObjChunk();
+	void Clear();
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners;
+	std::vector<int> faceSizes;
+	std::vector<ObjMaterialSwitch> materialSwitches;
+	std::vector<std::string> mtllibs;
+	glm::vec3 bboxMin;
+	glm::vec3 bboxMax;
+};
+
+// ObjSubMesh Declarations.
+// Triangle indices of one "usemtl" group, before any GL resource exists.
+struct ObjSubMesh
+{
+	std::string materialName;
+	std::vector<unsigned int> vertexIndices;
+};
+
+// ObjMeshData Declarations.
+// Deduplicated and triangulated result of an OBJ file.
+struct ObjMeshData
+{
+	ObjMeshData();
+
+	std::vector<VertexPTN> vertices;
+	std::vector<ObjSubMesh> subMeshes;
+	std::vector<std::string> mtllibs;
+	int numTriangles;
+	glm::vec3 bboxMin;
+	glm::vec3 bboxMax;
+};
+
+// ObjMaterial Declarations.
+// A "newmtl" record of an MTL file. mapKd is the resolved image path, or empty.
+struct ObjMaterial
+{
+	ObjMaterial();
+
+	std::string name;
+	glm::vec3 Ka;
+	glm::vec3 Kd;
+	glm::vec3 Ks;
+	float Ns;
+	std::string mapKd;
+};
+
+// ObjLoadOptions Declarations.
+struct ObjLoadOptions
+{
+	ObjLoadOptions() { numThreads = 0; serialThreshold = 8u << 20; useMeshCache = true; }
+
+	// Worker threads used for tokenizing; 0 means one per hardware thread.
+	int numThreads;
+	// Inputs smaller than this many bytes are parsed on the calling thread.
+	size_t serialThreshold;
+	// Read/write the binary *.meshbin cache next to the OBJ file.
+	bool useMeshCache;
+};
+
+// ObjLoadProgress Declarations.
+// Progress of a load in [0, 1] plus a cancel request, shared between the
+// loading thread and its observers.
+struct ObjLoadProgress
+{
+	ObjLoadProgress() : fraction(0.0f), cancelRequested(false) {}
+
+	void Reset() { fraction.store(0.0f); cancelRequested.store(false); }
+	void Set(const float f) { fraction.store(f, std::memory_order_relaxed); }
+	float Get() const { return fraction.load(std::memory_order_relaxed); }
+	void Cancel() { cancelRequested.store(true); }
+	bool IsCancelled() const { return cancelRequested.load(std::memory_order_relaxed); }
+
+	std::atomic<float> fraction;
+	std::atomic<bool> cancelRequested;
+};
+
+// Share of the progress bar covered by tokenizing; corner deduplication
+// covers the rest up to OBJ_PROGRESS_BUILT and the caller the remainder.
+const float OBJ_PROGRESS_PARSED = 0.6f;
+const float OBJ_PROGRESS_BUILT = 0.9f;
+
+// ObjLoadStats Declarations.
+struct ObjLoadStats
+{
+	ObjLoadStats() { numBytes = 0; numThreads = 1; parseSeconds = 0.0; buildSeconds = 0.0; }
+	double GetMBPerSecond() const;
+
+	size_t numBytes;
+	int numThreads;
+	double parseSeconds;
+	double buildSeconds;
+};
+
+// Tokenize the complete lines in [begin, end) and append their records to chunk.
+void ParseObjText(const char* begin, const char* end, ObjChunk& chunk);
+
+// Split [begin, end) into newline-aligned chunks, tokenize them on a worker
+// pool and merge the records in file order. The result is identical to a
+// single ParseObjText call over the same range. Returns the threads used.
+// Progress and cancellation are checked per chunk when progress is given.
+int ParseObjTextParallel(const char* begin, const char* end, ObjChunk& chunk, const ObjLoadOptions& options,
+						 ObjLoadProgress* progress = nullptr);
+
+// Deduplicate face corners into vertices and triangulate faces (fan order).
+// Corners are identified by their (v, vt, vn) index triple.
+void BuildObjMesh(const ObjChunk& chunk, ObjMeshData& mesh, ObjLoadProgress* progress = nullptr);
+
+// Memory-map an OBJ file and run ParseObjTextParallel + BuildObjMesh on it.
+// gzip/zstd input is decompressed on a separate thread and parsed block by
+// block as it arrives (see decompressstream.h); stats->numBytes is then the
+// decompressed size. Returns false if the file cannot be read or the load
+// was cancelled.
+bool LoadObjFile(const std::string& filePath, ObjMeshData& mesh, ObjLoadStats* stats = nullptr,
+				 const ObjLoadOptions& options = ObjLoadOptions(), ObjLoadProgress* progress = nullptr);
+
+// Return the mtllib names in the first maxBytes of an OBJ file (decompressed
+// if needed). Exporters put them at the top, so MTL and texture loading can
+// start before the geometry is parsed; the full parse still reports all of them.
+std::vector<std::string> PeekObjMtllibs(const std::string& filePath, const size_t maxBytes = 1u << 20);
+
+// Move center to the origin and scale the largest axis of extent to 1.
+void NormalizeObjPositions(std::vector<VertexPTN>& vertices, const glm::vec3& center, const glm::vec3& extent);
+
+// Read the material records of an MTL file (optionally compressed),
+// appending them to materials.
+bool LoadMtlFile(const std::string& mtlPath, std::vector<ObjMaterial>& materials);
+
+#endif
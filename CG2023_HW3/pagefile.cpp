@@ -0,0 +1,315 @@
+#include "pagefile.h"
+#include "mappedfile.h"
+#include "mipbuilder.h"
+
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+// PageFileHeader Declarations.
+// Followed by numLevels PageLevelRecords; the pages start at the next
+// 4 KB boundary.
+struct PageFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t channels;
+	uint64_t sourceHash;
+	uint32_t tileSize;
+	uint32_t border;
+	uint32_t numLevels;
+	uint32_t reserved;
+};
+
+struct PageLevelRecord
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint64_t firstPage;
+};
+
+const char PAGE_FILE_MAGIC[8] = { 'V', 'T', 'P', 'A', 'G', 'E', 'S', '\0' };
+
+size_t AlignUp(const size_t n, const size_t alignment)
+{
+	return (n + alignment - 1) / alignment * alignment;
+}
+
+// The level chain of a width x height image, down to a single tile.
+std::vector<PageFile::PageLevel> GetLevels(const int width, const int height)
+{
+	std::vector<PageFile::PageLevel> levels;
+	size_t firstPage = 0;
+	for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+		PageFile::PageLevel level;
+		level.width = w;
+		level.height = h;
+		level.tilesX = (w + PAGE_TILE_SIZE - 1) / PAGE_TILE_SIZE;
+		level.tilesY = (h + PAGE_TILE_SIZE - 1) / PAGE_TILE_SIZE;
+		level.firstPage = firstPage;
+		levels.push_back(level);
+		firstPage += (size_t)level.tilesX * level.tilesY;
+		if (level.tilesX == 1 && level.tilesY == 1)
+			break;
+	}
+	return levels;
+}
+
+// Copy one tile and its border out of a level.
+void CutPage(const unsigned char* pixels, const int width, const int height, const int channels,
+			 const int tileX, const int tileY, unsigned char* page)
+{
+	const int pageSize = PageFile::GetPageSize();
+	const int x0 = tileX * PAGE_TILE_SIZE - PAGE_BORDER, y0 = tileY * PAGE_TILE_SIZE - PAGE_BORDER;
+	for (int j = 0; j < pageSize; ++j) {
+		const int y = std::min(std::max(y0 + j, 0), height - 1);
+		const unsigned char* row = pixels + (size_t)y * width * channels;
+		unsigned char* out = page + (size_t)j * pageSize * channels;
+		if (x0 >= 0 && x0 + pageSize <= width) {
+			memcpy(out, row + (size_t)x0 * channels, (size_t)pageSize * channels);
+			continue;
+		}
+		for (int i = 0; i < pageSize; ++i) {
+			const int x = ((x0 + i) % width + width) % width;
+			memcpy(out + (size_t)i * channels, row + (size_t)x * channels, channels);
+		}
+	}
+}
+
+bool ReadBigEndian(std::ifstream& ifs, const int numBytes, uint32_t& value)
+{
+	unsigned char bytes[4];
+	if (!ifs.read((char*)bytes, numBytes))
+		return false;
+	value = 0;
+	for (int i = 0; i < numBytes; ++i)
+		value = (value << 8) | bytes[i];
+	return true;
+}
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+PageFile::PageFile()
+{
+	channels = 0;
+	dataOffset = 0;
+}
+
+PageFile::~PageFile()
+{
+	Close();
+}
+
+bool PageFile::Open(const std::string& imagePath, const uint64_t sourceHash)
+{
+	Close();
+	std::unique_ptr<MappedFile> mapped(new MappedFile());
+	if (!mapped->Open(GetPageFilePath(imagePath)) || mapped->GetSize() < sizeof(PageFileHeader))
+		return false;
+	const size_t fileSize = mapped->GetSize();
+
+	PageFileHeader header;
+	memcpy(&header, mapped->GetData(), sizeof(header));
+	if (memcmp(header.magic, PAGE_FILE_MAGIC, sizeof(PAGE_FILE_MAGIC)) != 0
+		|| header.version != PAGE_FILE_VERSION
+		|| header.sourceHash != sourceHash
+		|| header.tileSize != (uint32_t)PAGE_TILE_SIZE || header.border != (uint32_t)PAGE_BORDER
+		|| (header.channels != 1 && header.channels != 3 && header.channels != 4)
+		|| header.numLevels == 0 || header.numLevels > 32
+		|| fileSize < sizeof(header) + header.numLevels * sizeof(PageLevelRecord))
+		return false;
+
+	PageLevelRecord first;
+	memcpy(&first, mapped->GetData() + sizeof(header), sizeof(first));
+	if (first.width == 0 || first.height == 0 || first.width > (1u << 20) || first.height > (1u << 20))
+		return false;
+	const std::vector<PageLevel> expected = GetLevels((int)first.width, (int)first.height);
+	if (expected.size() != header.numLevels)
+		return false;
+	for (uint32_t i = 0; i < header.numLevels; ++i) {
+		PageLevelRecord record;
+		memcpy(&record, mapped->GetData() + sizeof(header) + i * sizeof(record), sizeof(record));
+		const PageLevel& level = expected[i];
+		if ((int)record.width != level.width || (int)record.height != level.height
+			|| (int)record.tilesX != level.tilesX || (int)record.tilesY != level.tilesY
+			|| record.firstPage != level.firstPage)
+			return false;
+	}
+
+	channels = (int)header.channels;
+	const PageLevel& last = expected.back();
+	const size_t numPages = last.firstPage + (size_t)last.tilesX * last.tilesY;
+	const size_t offset = AlignUp(sizeof(header) + header.numLevels * sizeof(PageLevelRecord), 4096);
+	if (fileSize < offset || (fileSize - offset) / GetPageBytes() < numPages) {
+		channels = 0;
+		return false;
+	}
+	dataOffset = offset;
+	levels = expected;
+	file = std::move(mapped);
+	return true;
+}
+
+void PageFile::Close()
+{
+	levels.clear();
+	file.reset();
+	channels = 0;
+	dataOffset = 0;
+}
+
+const unsigned char* PageFile::GetPage(const int level, const int tileX, const int tileY) const
+{
+	const PageLevel& l = levels[level];
+	const size_t page = l.firstPage + (size_t)tileY * l.tilesX + tileX;
+	return (const unsigned char*)file->GetData() + dataOffset + page * GetPageBytes();
+}
+
+void PageFile::ReadLevel(const int level, unsigned char* pixels) const
+{
+	const PageLevel& l = levels[level];
+	const int pageSize = GetPageSize();
+	for (int ty = 0; ty < l.tilesY; ++ty) {
+		for (int tx = 0; tx < l.tilesX; ++tx) {
+			const unsigned char* page = GetPage(level, tx, ty);
+			const int x0 = tx * PAGE_TILE_SIZE, y0 = ty * PAGE_TILE_SIZE;
+			const int w = std::min(PAGE_TILE_SIZE, l.width - x0), h = std::min(PAGE_TILE_SIZE, l.height - y0);
+			for (int j = 0; j < h; ++j) {
+				memcpy(pixels + ((size_t)(y0 + j) * l.width + x0) * channels,
+					   page + ((size_t)(PAGE_BORDER + j) * pageSize + PAGE_BORDER) * channels, (size_t)w * channels);
+			}
+		}
+	}
+}
+
+std::string GetPageFilePath(const std::string& imagePath)
+{
+	return imagePath + ".vtpages";
+}
+
+bool WritePageFile(const std::string& imagePath, const uint64_t sourceHash,
+				   const unsigned char* pixels, const int width, const int height, const int channels)
+{
+	if (width <= 0 || height <= 0 || (channels != 1 && channels != 3 && channels != 4))
+		return false;
+	const std::vector<PageFile::PageLevel> levels = GetLevels(width, height);
+
+	PageFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PAGE_FILE_MAGIC, sizeof(PAGE_FILE_MAGIC));
+	header.version = PAGE_FILE_VERSION;
+	header.channels = (uint32_t)channels;
+	header.sourceHash = sourceHash;
+	header.tileSize = PAGE_TILE_SIZE;
+	header.border = PAGE_BORDER;
+	header.numLevels = (uint32_t)levels.size();
+	std::vector<PageLevelRecord> records;
+	for (const PageFile::PageLevel& level : levels) {
+		PageLevelRecord record;
+		record.width = (uint32_t)level.width;
+		record.height = (uint32_t)level.height;
+		record.tilesX = (uint32_t)level.tilesX;
+		record.tilesY = (uint32_t)level.tilesY;
+		record.firstPage = level.firstPage;
+		records.push_back(record);
+	}
+
+	const std::string pagePath = GetPageFilePath(imagePath);
+	const std::string tempPath = pagePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	{
+		std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+		if (!ofs.is_open())
+			return false;
+		ofs.write((const char*)&header, sizeof(header));
+		ofs.write((const char*)records.data(), records.size() * sizeof(PageLevelRecord));
+		const size_t tablesEnd = sizeof(header) + records.size() * sizeof(PageLevelRecord);
+		const std::vector<char> padding(AlignUp(tablesEnd, 4096) - tablesEnd, 0);
+		ofs.write(padding.data(), padding.size());
+
+		// Pages level by level; each level is filtered from the previous one.
+		const int pageSize = PageFile::GetPageSize();
+		std::vector<unsigned char> page((size_t)pageSize * pageSize * channels);
+		std::vector<unsigned char> current, next;
+		const unsigned char* levelPixels = pixels;
+		MipBuildOptions mipOptions;
+		for (size_t i = 0; i < levels.size() && ofs.good(); ++i) {
+			const PageFile::PageLevel& level = levels[i];
+			for (int ty = 0; ty < level.tilesY; ++ty) {
+				for (int tx = 0; tx < level.tilesX; ++tx) {
+					CutPage(levelPixels, level.width, level.height, channels, tx, ty, page.data());
+					ofs.write((const char*)page.data(), page.size());
+				}
+			}
+			if (i + 1 < levels.size()) {
+				next.resize((size_t)levels[i + 1].width * levels[i + 1].height * channels);
+				BuildMipLevel(levelPixels, level.width, level.height, channels, next.data(), mipOptions);
+				current.swap(next);
+				levelPixels = current.data();
+			}
+		}
+		if (!ofs.good())
+			return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, pagePath, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
+
+bool ReadImageSize(const std::string& imagePath, int& width, int& height)
+{
+	std::ifstream ifs(imagePath, std::ios::binary);
+	unsigned char magic[8];
+	if (!ifs.read((char*)magic, sizeof(magic)))
+		return false;
+
+	// PNG: the IHDR chunk comes first and starts with the size.
+	const unsigned char pngMagic[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	if (memcmp(magic, pngMagic, sizeof(pngMagic)) == 0) {
+		uint32_t w = 0, h = 0;
+		ifs.seekg(16);
+		if (!ReadBigEndian(ifs, 4, w) || !ReadBigEndian(ifs, 4, h) || w == 0 || h == 0 || w > (1u << 30) || h > (1u << 30))
+			return false;
+		width = (int)w;
+		height = (int)h;
+		return true;
+	}
+
+	// JPEG: walk the segments up to the first start-of-frame.
+	if (magic[0] != 0xff || magic[1] != 0xd8)
+		return false;
+	ifs.seekg(2);
+	while (ifs) {
+		uint32_t marker = 0, length = 0;
+		if (!ReadBigEndian(ifs, 2, marker) || (marker >> 8) != 0xff)
+			return false;
+		marker &= 0xff;
+		if (marker == 0xd8 || marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+			continue;
+		if (!ReadBigEndian(ifs, 2, length) || length < 2)
+			return false;
+		const bool isFrame = marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+		if (isFrame) {
+			uint32_t precision = 0, h = 0, w = 0;
+			if (!ReadBigEndian(ifs, 1, precision) || !ReadBigEndian(ifs, 2, h) || !ReadBigEndian(ifs, 2, w) || w == 0 || h == 0)
+				return false;
+			width = (int)w;
+			height = (int)h;
+			return true;
+		}
+		ifs.seekg(length - 2, std::ios::cur);
+	}
+	return false;
+}
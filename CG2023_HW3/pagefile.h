@@ -0,0 +1,88 @@
+#ifndef PAGEFILE_H
+#define PAGEFILE_H
+
+// C++ STL headers.
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+class MappedFile;
+
+// Page files (*.vtpages).
+// A page file holds an image cut into square tiles for virtual texturing,
+// for every mip level down to the one that fits in a single tile. Each page
+// is one tile plus a border of PAGE_BORDER texels copied from its
+// neighbours, so it can be filtered on its own: columns wrap around (the
+// images are equirectangular panoramas) and rows are clamped. Pages all have
+// the same size and are stored level by level, rows of tiles top to bottom,
+// pixel rows top to bottom, with the channel order of the source (OpenCV:
+// BGR/BGRA). Like *.texbin files they are keyed by a hash of the source
+// image. Bump PAGE_FILE_VERSION whenever the layout changes.
+const uint32_t PAGE_FILE_VERSION = 1;
+const int PAGE_TILE_SIZE = 128;
+const int PAGE_BORDER = 2;
+
+// PageFile Declarations.
+class PageFile
+{
+public:
+	// PageLevel Declarations.
+	struct PageLevel
+	{
+		int width;
+		int height;
+		int tilesX;
+		int tilesY;
+		// Index of the level's first page.
+		size_t firstPage;
+	};
+
+	// PageFile Public Methods.
+	PageFile();
+	~PageFile();
+
+	// Map the page file of imagePath if it was made from an image with sourceHash.
+	bool Open(const std::string& imagePath, const uint64_t sourceHash);
+	void Close();
+	bool IsOpen() const { return !levels.empty(); }
+
+	int GetWidth() const { return levels.empty() ? 0 : levels[0].width; }
+	int GetHeight() const { return levels.empty() ? 0 : levels[0].height; }
+	int GetChannels() const { return channels; }
+	int GetNumLevels() const { return (int)levels.size(); }
+	const PageLevel& GetLevel(const int level) const { return levels[level]; }
+	// Side of a page in texels, border included.
+	static int GetPageSize() { return PAGE_TILE_SIZE + 2 * PAGE_BORDER; }
+	size_t GetPageBytes() const { return (size_t)GetPageSize() * GetPageSize() * channels; }
+	// Pixels of one page; the data stays valid while the file is open.
+	const unsigned char* GetPage(const int level, const int tileX, const int tileY) const;
+	// Put a whole level back together from its pages, top row first;
+	// pixels must hold width * height * channels bytes of the level.
+	void ReadLevel(const int level, unsigned char* pixels) const;
+
+private:
+	PageFile(const PageFile&) = delete;
+	PageFile& operator=(const PageFile&) = delete;
+
+	// PageFile Private Data.
+	std::unique_ptr<MappedFile> file;
+	std::vector<PageLevel> levels;
+	int channels;
+	size_t dataOffset;
+};
+
+// The page file used for a source image.
+std::string GetPageFilePath(const std::string& imagePath);
+
+// Cut an 8-bit image (1, 3 or 4 channels, rows tightly packed, top row
+// first) into the page file of imagePath, building the mip levels with
+// gamma-correct filtering. The file is written aside and renamed into place.
+bool WritePageFile(const std::string& imagePath, const uint64_t sourceHash,
+				   const unsigned char* pixels, const int width, const int height, const int channels);
+
+// Width and height of a PNG or JPEG image from its header, without decoding it.
+bool ReadImageSize(const std::string& imagePath, int& width, int& height);
+
+#endif
@@ -0,0 +1,244 @@
+#include "scene.h"
+
+// C++ STL headers.
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+Scene::Scene()
+{
+	bvhDirty = false;
+	culling = true;
+	minPixelSize = 0.0f;
+	lodErrorPixels = 0.0f;
+}
+
+Scene::~Scene()
+{
+	Clear();
+}
+
+void Scene::AddMesh(TriangleMesh* mesh)
+{
+	SceneMesh sceneMesh;
+	sceneMesh.mesh = mesh;
+	// No objects yet; the mesh's default instance must not be drawn.
+	sceneMesh.dirty = true;
+	meshes.push_back(sceneMesh);
+}
+
+int Scene::AddObject(TriangleMesh* mesh, const glm::mat4x4& worldMatrix)
+{
+	int meshIndex = 0;
+	while (meshIndex < (int)meshes.size() && meshes[meshIndex].mesh != mesh)
+		meshIndex++;
+	if (meshIndex == (int)meshes.size()) {
+		std::cerr << "[ERROR] Scene::AddObject: the mesh was not added to the scene" << std::endl;
+		return -1;
+	}
+	SceneObject object;
+	object.meshIndex = meshIndex;
+	object.worldMatrix = worldMatrix;
+	UpdateBounds(object);
+	objects.push_back(object);
+	meshes[meshIndex].dirty = true;
+	bvhDirty = true;
+	return (int)objects.size() - 1;
+}
+
+void Scene::SetWorldMatrix(const int object, const glm::mat4x4& worldMatrix)
+{
+	SceneObject& sceneObj = objects[object];
+	if (sceneObj.worldMatrix == worldMatrix)
+		return;
+	sceneObj.worldMatrix = worldMatrix;
+	UpdateBounds(sceneObj);
+	meshes[sceneObj.meshIndex].dirty = true;
+	if (!bvhDirty)
+		bvh.Refit(object, sceneObj.bounds);
+}
+
+void Scene::Clear()
+{
+	for (SceneMesh& sceneMesh : meshes)
+		delete sceneMesh.mesh;
+	meshes.clear();
+	objects.clear();
+	bvh.Clear();
+	bvhDirty = false;
+	cullStats = SceneCullStats();
+}
+
+void Scene::UpdateBounds(SceneObject& object)
+{
+	const TriangleMesh* mesh = meshes[object.meshIndex].mesh;
+	object.bounds = mesh->GetBounds().Transform(object.worldMatrix);
+	object.sphere = mesh->GetBoundingSphere().Transform(object.worldMatrix);
+	const glm::mat4x4& m = object.worldMatrix;
+	object.scale = std::sqrt(std::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+									  std::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])),
+											   glm::dot(glm::vec3(m[2]), glm::vec3(m[2])))));
+}
+
+void Scene::CullObjects(const SceneView& view)
+{
+	for (SceneMesh& sceneMesh : meshes) {
+		sceneMesh.visibleObjects.clear();
+		sceneMesh.partialObjects.clear();
+	}
+	cullStats.numObjects = (int)objects.size();
+	if (!culling) {
+		for (int i = 0; i < (int)objects.size(); ++i)
+			meshes[objects[i].meshIndex].visibleObjects.push_back(i);
+		cullStats.numVisibleObjects = (int)objects.size();
+		return;
+	}
+
+	if (bvhDirty) {
+		objectBoxes.clear();
+		for (const SceneObject& object : objects)
+			objectBoxes.push_back(object.bounds);
+		bvh.Build(objectBoxes);
+		bvhDirty = false;
+	}
+	hits.clear();
+	bvh.Cull(view.frustum, hits);
+	cullStats.numFrustumCulled = (int)objects.size() - (int)hits.size();
+	for (const BVHHit& hit : hits) {
+		const SceneObject& object = objects[hit.primitive];
+		if (minPixelSize > 0.0f) {
+			// Projected diameter of the bounding sphere; the camera may be
+			// inside it.
+			const float distance = glm::length(object.sphere.center - view.eyePos);
+			if (distance > object.sphere.radius &&
+				2.0f * object.sphere.radius * view.pixelScale < minPixelSize * distance) {
+				cullStats.numSmallCulled++;
+				continue;
+			}
+		}
+		SceneMesh& sceneMesh = meshes[object.meshIndex];
+		sceneMesh.visibleObjects.push_back(hit.primitive);
+		if (!hit.inside)
+			sceneMesh.partialObjects.push_back(hit.primitive);
+		cullStats.numVisibleObjects++;
+	}
+}
+
+void Scene::CullSubMeshes(SceneMesh& sceneMesh, const SceneView& view)
+{
+	TriangleMesh* mesh = sceneMesh.mesh;
+	const int numSubMeshes = mesh->GetNumSubMeshes();
+	// An object inside the view shows every SubMesh; testing them for many
+	// objects costs more than drawing them.
+	const bool test = culling && sceneMesh.partialObjects.size() == sceneMesh.visibleObjects.size() &&
+					  (int)sceneMesh.visibleObjects.size() <= MAX_SUBMESH_CULL_OBJECTS;
+	// The view frustum in the model space of each object.
+	Frustum frustums[MAX_SUBMESH_CULL_OBJECTS];
+	const int numFrustums = test ? (int)sceneMesh.partialObjects.size() : 0;
+	for (int k = 0; k < numFrustums; ++k)
+		frustums[k] = view.frustum.Transform(objects[sceneMesh.partialObjects[k]].worldMatrix);
+	const std::vector<SubMesh>& subMeshes = mesh->GetsubMeshes();
+	for (int i = 0; i < numSubMeshes; ++i) {
+		bool visible = !test;
+		for (int k = 0; k < numFrustums && !visible; ++k)
+			visible = frustums[k].Test(subMeshes[i].bounds) != FRUSTUM_OUTSIDE;
+		mesh->SetSubMeshVisible(i, visible);
+		cullStats.numSubMeshesCulled += visible ? 0 : 1;
+	}
+	cullStats.numSubMeshes += numSubMeshes;
+}
+
+void Scene::SelectLODs(SceneMesh& sceneMesh, const SceneView& view)
+{
+	const TriangleMesh* mesh = sceneMesh.mesh;
+	const int numLODs = mesh->GetNumLODs();
+	for (const int i : sceneMesh.visibleObjects) {
+		SceneObject& object = objects[i];
+		int lod = 0;
+		if (lodErrorPixels > 0.0f && numLODs > 1) {
+			// Pixels per model unit at the nearest point of the bounding
+			// sphere; full detail with the camera inside it.
+			const float distance = glm::length(object.sphere.center - view.eyePos) - object.sphere.radius;
+			const float pixels = (distance > 0.0f) ? object.scale * view.pixelScale / distance : FLT_MAX;
+			lod = std::min(object.lod, numLODs - 1);
+			while (lod > 0 && mesh->GetLODError(lod) * pixels > lodErrorPixels)
+				lod--;
+			while (lod + 1 < numLODs && mesh->GetLODError(lod + 1) * pixels < lodErrorPixels * (1.0f - LOD_HYSTERESIS))
+				lod++;
+		}
+		if (lod != object.lod) {
+			object.lod = lod;
+			sceneMesh.dirty = true;
+		}
+		cullStats.numLODObjects[lod]++;
+		cullStats.numTriangles += mesh->GetLODTriangles(lod);
+	}
+}
+
+void Scene::UpdateInstances(SceneMesh& sceneMesh)
+{
+	// Nothing to upload if the same objects are visible and none moved or
+	// changed level.
+	if (!sceneMesh.dirty && sceneMesh.visibleObjects == sceneMesh.uploadedObjects)
+		return;
+	// Grouped by level, each level's instances in one range.
+	int lodCounts[MAX_MESH_LODS] = {};
+	for (const int i : sceneMesh.visibleObjects)
+		lodCounts[objects[i].lod]++;
+	int lodNext[MAX_MESH_LODS];
+	int first = 0;
+	for (int lod = 0; lod < MAX_MESH_LODS; ++lod) {
+		lodNext[lod] = first;
+		first += lodCounts[lod];
+	}
+	sceneMesh.instances.resize(sceneMesh.visibleObjects.size());
+	for (const int i : sceneMesh.visibleObjects) {
+		const SceneObject& object = objects[i];
+		MeshInstance& instance = sceneMesh.instances[lodNext[object.lod]++];
+		instance.worldMatrix = object.worldMatrix;
+		instance.normalMatrix = glm::transpose(glm::inverse(glm::mat3x3(object.worldMatrix)));
+	}
+	sceneMesh.mesh->SetInstances(sceneMesh.instances.data(), (int)sceneMesh.instances.size(), lodCounts);
+	sceneMesh.uploadedObjects.swap(sceneMesh.visibleObjects);
+	sceneMesh.dirty = false;
+}
+
+void Scene::Draw(const PhongShadingDemoShaderProg* shader, const SceneView& view)
+{
+	cullStats = SceneCullStats();
+	CullObjects(view);
+	for (SceneMesh& sceneMesh : meshes) {
+		if (!sceneMesh.visibleObjects.empty()) {
+			CullSubMeshes(sceneMesh, view);
+			SelectLODs(sceneMesh, view);
+		}
+		UpdateInstances(sceneMesh);
+		sceneMesh.mesh->Draw(shader);
+	}
+}
+
+void Scene::ShowInfo() const
+{
+	std::cout << "Scene: " << objects.size() << " objects of " << meshes.size() << " meshes" << std::endl;
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		const TriangleMesh* mesh = meshes[i].mesh;
+		int numObjects = 0;
+		for (const SceneObject& object : objects)
+			numObjects += (object.meshIndex == (int)i) ? 1 : 0;
+		std::cout << "Mesh " << i << ": " << numObjects << " instances of " << mesh->GetNumSubMeshes()
+				  << " subMeshes, " << (long long)numObjects * mesh->GetNumTriangles() << " triangles" << std::endl;
+	}
+}
+
+void Scene::ShowCullStats() const
+{
+	const SceneCullStats& s = cullStats;
+	std::cout << "Scene culling " << (culling ? "on" : "off") << ": last frame " << s.numVisibleObjects << " of "
+			  << s.numObjects << " objects visible (" << s.numFrustumCulled << " outside the view, "
+			  << s.numSmallCulled << " below " << minPixelSize << " pixels), " << s.numSubMeshesCulled << " of "
+			  << s.numSubMeshes << " subMeshes culled, BVH of " << bvh.GetNumNodes() << " nodes" << std::endl;
+	std::cout << "Levels of detail within " << lodErrorPixels << " pixels: objects per level";
+	for (int lod = 0; lod < MAX_MESH_LODS; ++lod)
+		std::cout << " " << s.numLODObjects[lod];
+	std::cout << ", " << s.numTriangles << " triangles drawn" << std::endl;
+}
@@ -0,0 +1,169 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "headers.h"
+#include "trianglemesh.h"
+#include "shaderprog.h"
+#include "bounds.h"
+#include "bvh.h"
+
+// SceneObject Declarations.
+// A placed copy of one of the Scene's meshes.
+struct SceneObject
+{
+	SceneObject() {
+		meshIndex = -1;
+		worldMatrix = glm::mat4x4(1.0f);
+		scale = 1.0f;
+		lod = 0;
+	}
+	int meshIndex;
+	glm::mat4x4 worldMatrix;
+	// The mesh bounds in scene space.
+	AABB bounds;
+	BoundingSphere sphere;
+	// Longest axis of worldMatrix, scaling the mesh's LOD errors.
+	float scale;
+	// Level of detail it was last drawn at.
+	int lod;
+};
+
+// SceneView Declarations.
+// The camera as seen from the scene, for culling.
+struct SceneView
+{
+	SceneView() {
+		eyePos = glm::vec3(0.0f, 0.0f, 0.0f);
+		pixelScale = 0.0f;
+	}
+	// In scene space (Camera::GetFrustum with the scene's world matrix).
+	Frustum frustum;
+	glm::vec3 eyePos;
+	// Projected size in pixels of a unit length at unit distance, i.e.
+	// proj[1][1] * viewport height / 2, in scene units.
+	float pixelScale;
+};
+
+// SceneCullStats Declarations.
+struct SceneCullStats
+{
+	SceneCullStats() {
+		numObjects = 0; numVisibleObjects = 0; numFrustumCulled = 0; numSmallCulled = 0;
+		numSubMeshes = 0; numSubMeshesCulled = 0;
+		for (int lod = 0; lod < MAX_MESH_LODS; ++lod)
+			numLODObjects[lod] = 0;
+		numTriangles = 0;
+	}
+
+	int numObjects;
+	int numVisibleObjects;
+	int numFrustumCulled;
+	// Below the pixel threshold.
+	int numSmallCulled;
+	// SubMeshes of the meshes drawn, and those hidden as outside the view.
+	int numSubMeshes;
+	int numSubMeshesCulled;
+	// Visible objects at each level of detail, and the triangles drawn.
+	int numLODObjects[MAX_MESH_LODS];
+	long long numTriangles;
+};
+
+// Scene Declarations.
+// Any number of SceneObjects sharing a few TriangleMeshes. The objects of
+// a mesh are drawn as instances of it: each SubMesh once for all of them,
+// with their matrices streamed from the mesh's instance buffer. Objects
+// outside the view (found with a BVH over the objects, refit as they move)
+// and, optionally, objects smaller than a few pixels are left out of the
+// instances; the SubMeshes of a mesh with few partly visible objects are
+// culled one by one. Each visible object picks the coarsest level of detail
+// of its mesh whose error projects to at most a set number of pixels, its
+// instance being drawn with that level's indices. Instances are only
+// re-uploaded when the set of visible objects of a mesh changes, one of them
+// moves or changes level.
+class Scene
+{
+public:
+	// Scene Public Methods.
+	Scene();
+	~Scene();
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	// Take ownership of mesh (with its buffers created); it is deleted by
+	// Clear or with the Scene.
+	void AddMesh(TriangleMesh* mesh);
+	// Place a copy of mesh, which must have been added. Returns the index of
+	// the new object.
+	int AddObject(TriangleMesh* mesh, const glm::mat4x4& worldMatrix);
+	void SetWorldMatrix(const int object, const glm::mat4x4& worldMatrix);
+	// Delete all objects and meshes.
+	void Clear();
+
+	// Culling is on by default; objects are dropped below minPixelSize
+	// pixels (projected bounding sphere diameter; 0 = never).
+	void SetCulling(const bool enable) { culling = enable; }
+	bool IsCulling() const { return culling; }
+	void SetMinPixelSize(const float pixels) { minPixelSize = pixels; }
+	// Coarser levels of detail are used while their error stays within
+	// pixels on screen (0 = always full detail).
+	void SetLODErrorPixels(const float pixels) { lodErrorPixels = pixels; }
+	// Draw the objects seen from view with shader (already in use), one
+	// mesh at a time.
+	void Draw(const PhongShadingDemoShaderProg* shader, const SceneView& view);
+
+	bool IsEmpty() const { return objects.empty(); }
+	int GetNumObjects() const { return (int)objects.size(); }
+	int GetNumMeshes() const { return (int)meshes.size(); }
+	const SceneObject& GetObject(const int object) const { return objects[object]; }
+	TriangleMesh* GetMesh(const int meshIndex) const { return meshes[meshIndex].mesh; }
+	// Of the last Draw.
+	const SceneCullStats& GetCullStats() const { return cullStats; }
+	void ShowInfo() const;
+	void ShowCullStats() const;
+
+private:
+	// SceneMesh Declarations.
+	struct SceneMesh
+	{
+		TriangleMesh* mesh;
+		// Objects to draw this frame, and those in the instance buffer. All
+		// lists are kept between frames so that they do not allocate.
+		std::vector<int> visibleObjects;
+		std::vector<int> uploadedObjects;
+		// Visible objects that cross the frustum boundary.
+		std::vector<int> partialObjects;
+		std::vector<MeshInstance> instances;
+		// Instance data is stale: objects were added or moved.
+		bool dirty;
+	};
+
+	// Scene Private Methods.
+	void UpdateBounds(SceneObject& object);
+	// Sort the objects seen from view into the meshes' visibleObjects.
+	void CullObjects(const SceneView& view);
+	void CullSubMeshes(SceneMesh& sceneMesh, const SceneView& view);
+	// Update the level of detail of the visible objects of sceneMesh.
+	void SelectLODs(SceneMesh& sceneMesh, const SceneView& view);
+	void UpdateInstances(SceneMesh& sceneMesh);
+
+	// Scene Private Data.
+	// SubMeshes are tested for each partly visible object up to this many.
+	static const int MAX_SUBMESH_CULL_OBJECTS = 8;
+	// A coarser level must be this much below the pixel error to be taken,
+	// so that objects near a switching distance do not flicker between two.
+	static constexpr float LOD_HYSTERESIS = 0.25f;
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneObject> objects;
+	BVH bvh;
+	// Objects were added since the BVH was built.
+	bool bvhDirty;
+	bool culling;
+	float minPixelSize;
+	float lodErrorPixels;
+	// Reused by CullObjects.
+	std::vector<AABB> objectBoxes;
+	std::vector<BVHHit> hits;
+	SceneCullStats cullStats;
+};
+
+#endif
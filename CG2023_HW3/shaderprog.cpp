@@ -1,4 +1,6 @@
 #include "shaderprog.h"
+#include "glresourcetracker.h"
+#include "uniformblocks.h"
 
 #define MAX_BUFFER_SIZE 1024
 
@@ -6,6 +8,7 @@ ShaderProg::ShaderProg()
 {
     // Create OpenGL shader program.
     shaderProgId = glCreateProgram();
+    GL_TRACK_CREATE(GL_RESOURCE_PROGRAM, &shaderProgId, 1, "ShaderProg");
     if (shaderProgId == 0) {
         std::cerr << "[ERROR] Failed to create shader program" << std::endl;
         exit(1);
@@ -16,6 +19,7 @@ ShaderProg::ShaderProg()
 
 ShaderProg::~ShaderProg()
 {
+    GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_PROGRAM, &shaderProgId, 1);
     glDeleteProgram(shaderProgId);
 }
 
@@ -32,6 +36,8 @@ bool ShaderProg::LoadFromFiles(const std::string vsFilePath, const std::string f
     // Load the fragment shader from a source file and attach it to the shader program.
     if (!LoadShaderTextFromFile(fsFilePath, fs)) {
         std::cerr << "[ERROR] Failed to load vertex shader source: " << fsFilePath << std::endl;
+        GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_SHADER, &vsId, 1);
+        glDeleteShader(vsId);
         return false;
     };
     GLuint fsId = AddShader(fs, GL_FRAGMENT_SHADER);
@@ -40,6 +46,14 @@ bool ShaderProg::LoadFromFiles(const std::string vsFilePath, const std::string f
     GLint success = 0;
     GLchar errorLog[MAX_BUFFER_SIZE] = { 0 };
     glLinkProgram(shaderProgId);
+
+    // Now the program already has all stage information, we can delete the shaders now
+    // (also when linking failed; they are freed once the program is).
+    GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_SHADER, &vsId, 1);
+    glDeleteShader(vsId);
+    GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_SHADER, &fsId, 1);
+    glDeleteShader(fsId);
+
     glGetProgramiv(shaderProgId, GL_LINK_STATUS, &success);
     if (success == 0) {
         glGetProgramInfoLog(shaderProgId, sizeof(errorLog), NULL, errorLog);
@@ -47,9 +61,9 @@ bool ShaderProg::LoadFromFiles(const std::string vsFilePath, const std::string f
         return false;
     }
 
-    // Now the program already has all stage information, we can delete the shaders now.
-    glDeleteShader(vsId);
-    glDeleteShader(fsId);
+    // Update the location of uniform variables. Samplers of different types
+    // get their texture units there too, before validation checks them.
+    GetUniformVariableLocation();
 
     // Validate program.
     glValidateProgram(shaderProgId);
@@ -60,9 +74,6 @@ bool ShaderProg::LoadFromFiles(const std::string vsFilePath, const std::string f
         return false;
     }
 
-    // Update the location of uniform variables.
-    GetUniformVariableLocation();
-
     return true;
 }
 
@@ -74,6 +85,7 @@ void ShaderProg::GetUniformVariableLocation()
 GLuint ShaderProg::AddShader(const std::string& sourceText, GLenum shaderType)
 {
     GLuint shaderObj = glCreateShader(shaderType);
+    GL_TRACK_CREATE(GL_RESOURCE_SHADER, &shaderObj, 1, "ShaderProg");
     if (shaderObj == 0) {
         std::cerr << "[ERROR] Failed to create shader with type " << shaderType << std::endl;
         exit(0);
@@ -133,26 +145,10 @@ PhongShadingDemoShaderProg::PhongShadingDemoShaderProg()
 {
     locM = -1;
     locNM = -1;
-    locCameraPos = -1;
-    locKa = -1;
-    locKd = -1;
-    locKs = -1;
-    locNs = -1;
-    locAmbientLight = -1;
-    locDirLightDir = -1;
-	locDirLightRadiance = -1;
-	locPointLightPos = -1;
-	locPointLightIntensity = -1;
-    // -------------------------------------------------------
-	// Add your code for initializing the data of spot light.
-	// -------------------------------------------------------
+    locDrawBase = -1;
+    locDrawMaterials = -1;
     // -------------------------------------------------------
 	// Add your code for initializing the data of textures.
-    SpotlightPos = -1;
-    SpotlightDirection = -1;
-    SpotlightintensityPos = -1;
-    CutoffPos = -1;
-    TotalwidthPos = -1;
     locMapKd = -1;
     //use a variable to check if there s MapKd,but now we use another method
     //hasMapKdLocation = -1;
@@ -167,31 +163,24 @@ void PhongShadingDemoShaderProg::GetUniformVariableLocation()
     ShaderProg::GetUniformVariableLocation();
     locM = glGetUniformLocation(shaderProgId, "worldMatrix");
     locNM = glGetUniformLocation(shaderProgId, "normalMatrix");
-    locCameraPos = glGetUniformLocation(shaderProgId, "cameraPos");
-    locKa = glGetUniformLocation(shaderProgId, "Ka");
-    locKd = glGetUniformLocation(shaderProgId, "Kd");
-    locKs = glGetUniformLocation(shaderProgId, "Ks");
-    locNs = glGetUniformLocation(shaderProgId, "Ns");
-    locAmbientLight = glGetUniformLocation(shaderProgId, "ambientLight");
-    locDirLightDir = glGetUniformLocation(shaderProgId, "dirLightDir");
-	locDirLightRadiance = glGetUniformLocation(shaderProgId, "dirLightRadiance");
-	locPointLightPos = glGetUniformLocation(shaderProgId, "pointLightPos");
-	locPointLightIntensity = glGetUniformLocation(shaderProgId, "pointLightIntensity");
-    // -------------------------------------------------------
-	// Add your code for getting the location of data of spot light.
-    SpotlightPos = glGetUniformLocation(shaderProgId, "SpotLightPos");
-    SpotlightintensityPos = glGetUniformLocation(shaderProgId, "SpotLightIntensity");
-    SpotlightDirection = glGetUniformLocation(shaderProgId, "SpotlightDirection");
-    CutoffPos = glGetUniformLocation(shaderProgId, "Cutoff");
-    TotalwidthPos = glGetUniformLocation(shaderProgId, "Totalwidth");
-	// -------------------------------------------------------
+    // Camera and light data.
+    const GLuint frameBlock = glGetUniformBlockIndex(shaderProgId, "FrameData");
+    if (frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(shaderProgId, frameBlock, UNIFORM_BLOCK_FRAME);
+    // Material data per draw.
+    locDrawBase = glGetUniformLocation(shaderProgId, "drawBase");
+    locDrawMaterials = glGetUniformLocation(shaderProgId, "drawMaterials");
     // -------------------------------------------------------
 	// Add your code for getting the location of texture variable.
     locMapKd = glGetUniformLocation(shaderProgId, "mapKd");
     //use a variable to check if there s MapKd,but now we use another method
     //hasMapKdLocation = glGetUniformLocation(shaderProgId, "hasMapKd");
 	// -------------------------------------------------------
-
+    // The texture units TriangleMesh::Draw binds them to.
+    GLStateCache& stateCache = GLStateCache::GetInstance();
+    stateCache.UseProgram(shaderProgId);
+    stateCache.SetUniform1i(locMapKd, 0);
+    stateCache.SetUniform1i(locDrawMaterials, 1);
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -209,3 +198,55 @@ void SkyboxShaderProg::GetUniformVariableLocation()
     ShaderProg::GetUniformVariableLocation();
     locMapKd = glGetUniformLocation(shaderProgId, "mapKd");
 }
+
+// ------------------------------------------------------------------------------------------------
+
+VirtualSkyboxShaderProg::VirtualSkyboxShaderProg()
+{
+    locPageCache = -1;
+    locIndirection = -1;
+    locLevelSize = -1;
+    locLevelOffset = -1;
+    locNumLevels = -1;
+    locPagesPerSide = -1;
+    locCacheSize = -1;
+    locTileSize = -1;
+    locPageBorder = -1;
+    locLodBias = -1;
+}
+
+VirtualSkyboxShaderProg::~VirtualSkyboxShaderProg()
+{}
+
+void VirtualSkyboxShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locPageCache = glGetUniformLocation(shaderProgId, "pageCache");
+    locIndirection = glGetUniformLocation(shaderProgId, "indirection");
+    locLevelSize = glGetUniformLocation(shaderProgId, "levelSize");
+    locLevelOffset = glGetUniformLocation(shaderProgId, "levelOffset");
+    locNumLevels = glGetUniformLocation(shaderProgId, "numLevels");
+    locPagesPerSide = glGetUniformLocation(shaderProgId, "pagesPerSide");
+    locCacheSize = glGetUniformLocation(shaderProgId, "cacheSize");
+    locTileSize = glGetUniformLocation(shaderProgId, "tileSize");
+    locPageBorder = glGetUniformLocation(shaderProgId, "pageBorder");
+    locLodBias = glGetUniformLocation(shaderProgId, "lodBias");
+}
+
+// ------------------------------------------------------------------------------------------------
+
+CubemapSkyboxShaderProg::CubemapSkyboxShaderProg()
+{
+    locInvViewProj = -1;
+    locCubemap = -1;
+}
+
+CubemapSkyboxShaderProg::~CubemapSkyboxShaderProg()
+{}
+
+void CubemapSkyboxShaderProg::GetUniformVariableLocation()
+{
+    ShaderProg::GetUniformVariableLocation();
+    locInvViewProj = glGetUniformLocation(shaderProgId, "invViewProj");
+    locCubemap = glGetUniformLocation(shaderProgId, "cubemap");
+}
@@ -2,6 +2,7 @@
 #define SHADER_PROGRAM_H
 
 #include "headers.h"
+#include "glstatecache.h"
 
 // ShaderProg Declarations.
 class ShaderProg
@@ -12,8 +13,8 @@ public:
 	~ShaderProg();
 
 	bool LoadFromFiles(const std::string vsFilePath, const std::string fsFilePath);
-	void Bind() { glUseProgram(shaderProgId); };
-	void UnBind() { glUseProgram(0); };
+	void Bind() { GLStateCache::GetInstance().UseProgram(shaderProgId); };
+	void UnBind() { GLStateCache::GetInstance().UseProgram(0); };
 
 	GLint GetLocMVP() const { return locMVP; }
 
@@ -66,24 +67,11 @@ public:
 
 	GLint GetLocM() const { return locM; }
 	GLint GetLocNM() const { return locNM; }
-	GLint GetLocCameraPos() const { return locCameraPos; }
-	GLint GetLocKa() const { return locKa; }
-	GLint GetLocKd() const { return locKd; }
-	GLint GetLocKs() const { return locKs; }
-	GLint GetLocNs() const { return locNs; }
-	GLint GetLocAmbientLight() const { return locAmbientLight; }
-	GLint GetLocDirLightDir() const { return locDirLightDir; }
-	GLint GetLocDirLightRadiance() const { return locDirLightRadiance; }
-	GLint GetLocPointLightPos() const { return locPointLightPos; }
-	GLint GetLocPointLightIntensity() const { return locPointLightIntensity; }
-	// -------------------------------------------------------
-	// Add your methods for spot light.
-	GLint GetLocSpotLightPos() const { return SpotlightPos; };
-	GLint GetLocSpotLightIntensity() const { return SpotlightintensityPos; };
-	GLint GetLocSpotLightDirection() const { return SpotlightDirection; };
-	GLint GetLocCutoffPos() const { return CutoffPos; };
-	GLint GetLocTotalwidthPos() const { return TotalwidthPos; };
-	// -------------------------------------------------------
+	// Camera and light data (spot light included) come from the FrameData
+	// uniform block (see uniformblocks.h). The material of a draw is read
+	// from the drawMaterials buffer texture at drawBase + gl_DrawIDARB.
+	GLint GetLocDrawBase() const { return locDrawBase; }
+	GLint GetLocDrawMaterials() const { return locDrawMaterials; }
 	// -------------------------------------------------------
 	// Add your methods for supporting textures.
 	GLint GetLocMapKd() const { return locMapKd; };
@@ -100,26 +88,9 @@ private:
 	// Transformation matrix.
 	GLint locM;
 	GLint locNM;
-	GLint locCameraPos;
-	// Material properties.
-	GLint locKa;
-	GLint locKd;
-	GLint locKs;
-	GLint locNs;
-	// Light data.
-	GLint locAmbientLight;
-	GLint locDirLightDir;
-	GLint locDirLightRadiance;
-	GLint locPointLightPos;
-	GLint locPointLightIntensity;
-	// -------------------------------------------------------
-	// Add your data for spot light.
-	GLint SpotlightPos;
-	GLint SpotlightintensityPos;
-	GLint SpotlightDirection;
-	GLint CutoffPos;
-	GLint TotalwidthPos;
-	// -------------------------------------------------------
+	// Material data per draw.
+	GLint locDrawBase;
+	GLint locDrawMaterials;
 	// Texture data.
 	GLint locMapKd;
 	// -------------------------------------------------------
@@ -150,4 +121,69 @@ private:
 	GLint locMapKd;
 };
 
+// ------------------------------------------------------------------------------------------------
+
+// VirtualSkyboxShaderProg Declarations.
+// Skybox sampled through a virtual texture (see VirtualTexture); used both
+// for drawing and for the tile feedback pass.
+class VirtualSkyboxShaderProg : public ShaderProg
+{
+public:
+	// VirtualSkyboxShaderProg Public Methods.
+	VirtualSkyboxShaderProg();
+	~VirtualSkyboxShaderProg();
+
+	GLint GetLocPageCache() const { return locPageCache; }
+	GLint GetLocIndirection() const { return locIndirection; }
+	GLint GetLocLevelSize() const { return locLevelSize; }
+	GLint GetLocLevelOffset() const { return locLevelOffset; }
+	GLint GetLocNumLevels() const { return locNumLevels; }
+	GLint GetLocPagesPerSide() const { return locPagesPerSide; }
+	GLint GetLocCacheSize() const { return locCacheSize; }
+	GLint GetLocTileSize() const { return locTileSize; }
+	GLint GetLocPageBorder() const { return locPageBorder; }
+	GLint GetLocLodBias() const { return locLodBias; }
+
+protected:
+	// VirtualSkyboxShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// VirtualSkyboxShaderProg Private Data.
+	GLint locPageCache;
+	GLint locIndirection;
+	GLint locLevelSize;
+	GLint locLevelOffset;
+	GLint locNumLevels;
+	GLint locPagesPerSide;
+	GLint locCacheSize;
+	GLint locTileSize;
+	GLint locPageBorder;
+	GLint locLodBias;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// CubemapSkyboxShaderProg Declarations.
+// Skybox drawn as a fullscreen triangle that looks up a cubemap.
+class CubemapSkyboxShaderProg : public ShaderProg
+{
+public:
+	// CubemapSkyboxShaderProg Public Methods.
+	CubemapSkyboxShaderProg();
+	~CubemapSkyboxShaderProg();
+
+	GLint GetLocInvViewProj() const { return locInvViewProj; }
+	GLint GetLocCubemap() const { return locCubemap; }
+
+protected:
+	// CubemapSkyboxShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// CubemapSkyboxShaderProg Private Data.
+	GLint locInvViewProj;
+	GLint locCubemap;
+};
+
 #endif
@@ -6,6 +6,7 @@
 in vec3 iPosWorld;
 in vec3 iNormalWorld;
 in vec2 iTexCoord;
+flat in int iDrawIndex;
 // --------------------------------------------------------
 
 // --------------------------------------------------------
@@ -13,30 +14,41 @@ in vec2 iTexCoord;
 uniform sampler2D mapKd;
 //uniform bool hasMapKd;
 
-uniform mat4 worldMatrix;
-uniform mat4 normalMatrix;
-uniform vec3 cameraPos;
-
-uniform vec3 Ka;
-uniform vec3 Kd;
-uniform vec3 Ks;
-uniform float Ns;
-// Light data.
-uniform vec3 ambientLight;
-uniform vec3 dirLightDir;
-uniform vec3 dirLightRadiance;
-uniform vec3 pointLightPos;
-uniform vec3 pointLightIntensity;
-uniform vec3 SpotLightPos;
-uniform vec3 SpotLightIntensity;
-uniform vec3 SpotlightDirection;
-uniform float Cutoff;
-uniform float Totalwidth;
+// Camera and light data, once per frame (FrameUniforms in uniformblocks.h).
+layout (std140) uniform FrameData
+{
+    vec3 cameraPos;
+    vec3 dirLightDir;
+    vec3 dirLightRadiance;
+    vec3 pointLightPos;
+    vec3 pointLightIntensity;
+    vec3 SpotLightPos;
+    vec3 SpotLightIntensity;
+    // Normalized.
+    vec3 SpotlightDirection;
+    // x = cos(cutoff), y = cos(total width).
+    vec2 SpotLightCos;
+    // Ambient light as 2nd-order spherical harmonics (see sphericalharmonics.h),
+    // in the frame of the skybox panorama.
+    vec3 ambientSH[9];
+    mat3 ambientRotation;
+};
+// Material properties of each draw, uploaded with the model: Ka, Kd and
+// Ks with Ns in w (MaterialUniforms in uniformblocks.h).
+uniform samplerBuffer drawMaterials;
 // --------------------------------------------------------
 
 out vec4 FragColor;
 
 // --------------------------------------------------------
+vec3 AmbientSH(vec3 N)
+{
+    vec3 n = ambientRotation * N;
+    return ambientSH[0]
+         + ambientSH[1] * n.y + ambientSH[2] * n.z + ambientSH[3] * n.x
+         + ambientSH[4] * (n.x * n.y) + ambientSH[5] * (n.y * n.z) + ambientSH[6] * (3.0 * n.z * n.z - 1.0)
+         + ambientSH[7] * (n.x * n.z) + ambientSH[8] * (n.x * n.x - n.y * n.y);
+}
 vec3 Diffuse(vec3 Kd, vec3 I, vec3 N, vec3 lightDir)
 {
     return Kd * I * max(0, dot(N, lightDir));
@@ -59,13 +71,18 @@ vec3 Specular(vec3 Ks, vec3 I, vec3 N, vec3 lightDir, vec3 view,float Ns, const
 
 void main()
 {
+    vec3 Ka = texelFetch(drawMaterials, 3 * iDrawIndex).rgb;
+    vec3 Kd = texelFetch(drawMaterials, 3 * iDrawIndex + 1).rgb;
+    vec4 KsNs = texelFetch(drawMaterials, 3 * iDrawIndex + 2);
+    vec3 Ks = KsNs.xyz;
+    float Ns = KsNs.w;
     vec3 N=normalize(iNormalWorld);
     vec3 view = normalize(cameraPos - iPosWorld);
     vec3 texColor;
     texColor = texture2D(mapKd, iTexCoord).rgb;
    
     // Ambient light.
-    vec3 ambient = Ka * ambientLight;
+    vec3 ambient = Ka * max(AmbientSH(N), 0.0);
     // -------------------------------------------------------------
     // Directional light.
     vec3 diffuse;
@@ -101,9 +118,10 @@ void main()
     // -------------------------------------------------------------
     // Spotlight.
     vec3 vssLightDir = normalize(SpotLightPos - iPosWorld);
-    float COStheta = (dot(vssLightDir,-SpotlightDirection))/(length(vssLightDir)*length(SpotlightDirection));
-    float COScutoff = cos(Cutoff);
-    float COStotalwidth = cos(Totalwidth);
+    // Both directions are normalized.
+    float COStheta = dot(vssLightDir, -SpotlightDirection);
+    float COScutoff = SpotLightCos.x;
+    float COStotalwidth = SpotLightCos.y;
     float attenuation_Spot;
     if(COStheta >= COScutoff)
     {
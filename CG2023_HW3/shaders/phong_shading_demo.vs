@@ -1,13 +1,20 @@
 #version 330 core
+// gl_DrawIDARB for multi-draws; without it every draw is drawn on its own.
+#extension GL_ARB_shader_draw_parameters : enable
 
 layout (location = 0) in vec3 Position;
 layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec2 TexCoord;
+// Placement of the instance within the scene (see MeshInstance).
+layout (location = 3) in mat4 instanceWorldMatrix;
+layout (location = 7) in mat3 instanceNormalMatrix;
 
-// Transformation matrix.
+// Transformation matrix of the whole scene.
 uniform mat4 worldMatrix;
 uniform mat4 normalMatrix;
 uniform mat4 MVP;
+// Index of the first draw of a (multi-)draw call.
+uniform int drawBase;
 // --------------------------------------------------------
 // Add more uniform variables if needed.
 // --------------------------------------------------------
@@ -16,6 +23,8 @@ uniform mat4 MVP;
 out vec3 iPosWorld;
 out vec3 iNormalWorld;
 out vec2 iTexCoord;
+// Selects the material of the draw.
+flat out int iDrawIndex;
 // --------------------------------------------------------
 // Add your data for interpolation.
 // --------------------------------------------------------
@@ -24,12 +33,18 @@ void main()
 {
     // --------------------------------------------------------
     // Add your implementation.
-    gl_Position = MVP * vec4(Position, 1.0);
+    vec4 positionScene = instanceWorldMatrix * vec4(Position, 1.0);
+    gl_Position = MVP * positionScene;
 
-    vec4 positionTmp = worldMatrix * vec4(Position, 1.0);
+    vec4 positionTmp = worldMatrix * positionScene;
     
     iPosWorld = positionTmp.xyz / positionTmp.w;
-    iNormalWorld = (normalMatrix * vec4(Normal, 0.0)).xyz;
+    iNormalWorld = (normalMatrix * vec4(instanceNormalMatrix * Normal, 0.0)).xyz;
     iTexCoord = TexCoord;
+#ifdef GL_ARB_shader_draw_parameters
+    iDrawIndex = drawBase + gl_DrawIDARB;
+#else
+    iDrawIndex = drawBase;
+#endif
     // --------------------------------------------------------
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 iDirection;
+
+uniform samplerCube cubemap;
+
+out vec4 FragColor;
+
+
+void main()
+{
+    FragColor = texture(cubemap, iDirection);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Inverse of projection * view rotation * skybox rotation.
+uniform mat4 invViewProj;
+
+out vec3 iDirection;
+
+
+void main()
+{
+    // One triangle covering the screen, made from the vertex index: (-1, -1),
+    // (3, -1), (-1, 3). It sits at the far plane, behind everything drawn.
+    vec2 p = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2)) * 2.0 - 1.0;
+    gl_Position = vec4(p, 1.0, 1.0);
+
+    // The far plane point maps to w > 0, so xyz already points the right way.
+    iDirection = (invViewProj * gl_Position).xyz;
+}
@@ -0,0 +1,50 @@
+#version 330 core
+
+in vec2 iTexCoord;
+
+// Virtual texture (see virtualtexture.h).
+// Pages of the panorama that are resident on the GPU.
+uniform sampler2D pageCache;
+// Per level and tile: (page slot, level of that page, its tile x, its tile y).
+uniform usampler2D indirection;
+uniform vec2 levelSize[16];
+uniform ivec2 levelOffset[16];
+uniform int numLevels;
+uniform int pagesPerSide;
+uniform vec2 cacheSize;
+uniform float tileSize;
+uniform float pageBorder;
+uniform float lodBias;
+
+out vec4 FragColor;
+
+
+// Finest level the pixel footprint needs.
+int ComputeLevel(vec2 uv)
+{
+    vec2 dx = dFdx(uv * levelSize[0]);
+    vec2 dy = dFdy(uv * levelSize[0]);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + lodBias;
+    return int(clamp(floor(lod), 0.0, float(numLevels - 1)));
+}
+
+ivec2 TileAt(vec2 uv, int level)
+{
+    ivec2 numTiles = ivec2(ceil(levelSize[level] / tileSize));
+    return clamp(ivec2(floor(uv * levelSize[level] / tileSize)), ivec2(0), numTiles - 1);
+}
+
+void main()
+{
+    // The panorama is stored top row first, like the sphere's texcoords.
+    vec2 uv = clamp(iTexCoord, 0.0, 1.0);
+    int level = ComputeLevel(uv);
+    uvec4 entry = texelFetch(indirection, levelOffset[level] + TileAt(uv, level), 0);
+
+    // Position inside the page that is mapped (possibly a coarser level).
+    int mapped = int(entry.g);
+    vec2 inTile = uv * levelSize[mapped] / tileSize - vec2(entry.ba);
+    vec2 page = vec2(float(int(entry.r) % pagesPerSide), float(int(entry.r) / pagesPerSide));
+    vec2 texel = page * (tileSize + 2.0 * pageBorder) + pageBorder + inTile * tileSize;
+    FragColor = textureLod(pageCache, texel / cacheSize, 0.0);
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+in vec2 iTexCoord;
+
+// Same level selection as skybox_vt.fs; lodBias makes up for the smaller
+// feedback target.
+uniform vec2 levelSize[16];
+uniform int numLevels;
+uniform float tileSize;
+uniform float lodBias;
+
+out vec4 FragColor;
+
+
+int ComputeLevel(vec2 uv)
+{
+    vec2 dx = dFdx(uv * levelSize[0]);
+    vec2 dy = dFdy(uv * levelSize[0]);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + lodBias;
+    return int(clamp(floor(lod), 0.0, float(numLevels - 1)));
+}
+
+ivec2 TileAt(vec2 uv, int level)
+{
+    ivec2 numTiles = ivec2(ceil(levelSize[level] / tileSize));
+    return clamp(ivec2(floor(uv * levelSize[level] / tileSize)), ivec2(0), numTiles - 1);
+}
+
+void main()
+{
+    // Write the tile this pixel needs: the low 8 bits of x and y, then the
+    // level (4 bits) and the next 2 bits of x and y. Alpha 0 = no request.
+    vec2 uv = clamp(iTexCoord, 0.0, 1.0);
+    int level = ComputeLevel(uv);
+    ivec2 tile = TileAt(uv, level);
+    int high = level | (((tile.x >> 8) & 3) << 4) | (((tile.y >> 8) & 3) << 6);
+    FragColor = vec4(float(tile.x & 255), float(tile.y & 255), float(high), 255.0) / 255.0;
+}
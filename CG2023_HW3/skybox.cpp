@@ -1,11 +1,37 @@
 #include "skybox.h"
+#include "cubemap.h"
+#include "filehash.h"
+#include "glresourcetracker.h"
+#include "glstatecache.h"
+
+bool Skybox::useCubemap = true;
 
 Skybox::Skybox(const std::string& texImagePath, const int nSlices, const int nStacks, const float radius)
 {
 	rotationY = 0.0f;
 
-	// Load panorama.
-	panorama = new ImageTexture(texImagePath);
+	// Load panorama. Huge ones are streamed tile by tile instead.
+	panorama = nullptr;
+	virtualTexture = nullptr;
+	cubemapTex = 0;
+	hasAmbientSH = false;
+	// Hashed once for the page file, the cooked cubemap and the SH cache.
+	uint64_t sourceHash = 0;
+	const bool hashed = HashFile(texImagePath, sourceHash);
+	if (hashed && VirtualTexture::ShouldStream(texImagePath)) {
+		virtualTexture = new VirtualTexture();
+		if (!virtualTexture->Load(texImagePath, sourceHash)) {
+			delete virtualTexture;
+			virtualTexture = nullptr;
+		}
+	}
+	CookedTexture faces;
+	cv::Mat decoded;
+	if (virtualTexture == nullptr && useCubemap && LoadCubemapFaces(texImagePath, hashed, sourceHash, faces, decoded))
+		CreateCubemap(faces);
+	if (virtualTexture == nullptr && cubemapTex == 0)
+		panorama = new ImageTexture(texImagePath);
+	LoadAmbientSH(texImagePath, hashed, sourceHash, decoded);
 	// panorama->Preview();
 
 	// Create material.
@@ -15,65 +41,246 @@ Skybox::Skybox(const std::string& texImagePath, const int nSlices, const int nSt
 	// Create sphere geometry.
 	CreateSphere3D(nSlices, nStacks, radius, vertices, indices);
 
+	// Create the vertex array that holds the sphere's layout.
+	GLStateCache& stateCache = GLStateCache::GetInstance();
+	glGenVertexArrays(1, &vaoId);
+	GL_TRACK_CREATE(GL_RESOURCE_VERTEX_ARRAY, &vaoId, 1, "Skybox");
+	stateCache.BindVertexArray(vaoId);
 	// Create vertex buffer.
 	glGenBuffers(1, &vboId);
-    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &vboId, 1, "Skybox");
+	stateCache.BindBuffer(GL_ARRAY_BUFFER, vboId);
     glBufferData(GL_ARRAY_BUFFER, sizeof(VertexPT) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, vboId, sizeof(VertexPT) * vertices.size());
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPT), 0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (const GLvoid*)12);
 	// Create index buffer.
 	glGenBuffers(1, &iboId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &iboId, 1, "Skybox");
+	stateCache.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &(indices[0]), GL_STATIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, iboId, sizeof(unsigned int) * indices.size());
+	stateCache.BindVertexArray(0);
 }
 
 Skybox::~Skybox()
 {
 	vertices.clear();
+	GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_VERTEX_ARRAY, &vaoId, 1);
+	glDeleteVertexArrays(1, &vaoId);
+	GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_BUFFER, &vboId, 1);
 	glDeleteBuffers(1, &vboId);
 	indices.clear();
+	GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_BUFFER, &iboId, 1);
 	glDeleteBuffers(1, &iboId);
 
 	if (panorama) {
 		delete panorama;
 		panorama = nullptr;
 	}
+	if (virtualTexture) {
+		delete virtualTexture;
+		virtualTexture = nullptr;
+	}
+	if (cubemapTex != 0) {
+		GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_TEXTURE, &cubemapTex, 1);
+		glDeleteTextures(1, &cubemapTex);
+		cubemapTex = 0;
+	}
+	hasAmbientSH = false;
 	if (material) {
 		delete material;
 		material = nullptr;
 	}
 }
 
-void Skybox::Render(Camera* camera, SkyboxShaderProg* shader)
+void Skybox::Render(Camera* camera, SkyboxShaderProg* shader,
+					VirtualSkyboxShaderProg* vtShader, VirtualSkyboxShaderProg* feedbackShader,
+					CubemapSkyboxShaderProg* cubeShader)
 {
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPT), 0);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (const GLvoid*)12);
-
-	shader->Bind();
-	
 	// Set transform.
 	// -------------------------------------------------------
 	// TODO: modify code here to rotate the skybox.
 	glm::mat4x4 R = rotate(glm::mat4(1.0f), rotationY, glm::vec3(0, 1, 0));
 	glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * R;
 	// -------------------------------------------------------
-	glUniformMatrix4fv(shader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+
+	if (cubemapTex != 0) {
+		if (cubeShader == nullptr)
+			return;
+		// Directions from the camera only: drop the view translation. The
+		// inverse also takes the rotation out, so SetRotation turns the sky.
+		const glm::mat4x4 viewRotation = glm::mat4x4(glm::mat3x3(camera->GetViewMatrix()));
+		const glm::mat4x4 invViewProj = glm::inverse(camera->GetProjMatrix() * viewRotation * R);
+		GLint depthFunc = GL_LESS;
+		glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+		// The triangle is at depth 1, equal to the cleared depth.
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+
+		GLStateCache& stateCache = GLStateCache::GetInstance();
+		cubeShader->Bind();
+		stateCache.SetUniformMatrix4fv(cubeShader->GetLocInvViewProj(), glm::value_ptr(invViewProj));
+		stateCache.BindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, cubemapTex);
+		stateCache.SetUniform1i(cubeShader->GetLocCubemap(), 0);
+		stateCache.BindVertexArray(vaoId);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		glDepthMask(GL_TRUE);
+		glDepthFunc(depthFunc);
+		return;
+	}
+
+	if (virtualTexture != nullptr) {
+		if (vtShader == nullptr || feedbackShader == nullptr)
+			return;
+		virtualTexture->Update();
+		// Find out which tiles this view needs.
+		virtualTexture->BeginFeedback();
+		feedbackShader->Bind();
+		GLStateCache::GetInstance().SetUniformMatrix4fv(feedbackShader->GetLocMVP(), glm::value_ptr(MVP));
+		virtualTexture->Bind(feedbackShader, true);
+		DrawSphere();
+		virtualTexture->EndFeedback();
+
+		vtShader->Bind();
+		GLStateCache::GetInstance().SetUniformMatrix4fv(vtShader->GetLocMVP(), glm::value_ptr(MVP));
+		virtualTexture->Bind(vtShader, false);
+		DrawSphere();
+		return;
+	}
+
+	shader->Bind();
+	GLStateCache::GetInstance().SetUniformMatrix4fv(shader->GetLocMVP(), glm::value_ptr(MVP));
 	// Set material properties.
 	if (material->GetMapKd() != nullptr) {
 		material->GetMapKd()->Bind(GL_TEXTURE0);
-        glUniform1i(shader->GetLocMapKd(), 0);
+		GLStateCache::GetInstance().SetUniform1i(shader->GetLocMapKd(), 0);
 	}
+	DrawSphere();
+}
 
-	// Draw.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+void Skybox::DrawSphere()
+{
+	// The vertex array holds the attribute setup and the index buffer.
+	GLStateCache::GetInstance().BindVertexArray(vaoId);
 	glDrawElements(GL_TRIANGLES, (GLsizei)(indices.size()), GL_UNSIGNED_INT, 0);
+}
+
+bool Skybox::LoadCubemapFaces(const std::string& imagePath, const bool hashed, const uint64_t sourceHash,
+							  CookedTexture& faces, cv::Mat& panorama)
+{
+	TextureCookOptions options;
+	options.mips.gammaCorrect = ImageTexture::GetGammaCorrectMips();
+	const std::string cubePath = imagePath + ".cube";
+	if (hashed && ReadCookedTexture(cubePath, sourceHash, options, faces))
+		return true;
+
+	// The panorama is used top row first, like the faces.
+	panorama = cv::imread(imagePath);
+	if (panorama.rows == 0 || panorama.cols == 0 || panorama.depth() != CV_8U)
+		return false;
+	if (!panorama.isContinuous())
+		panorama = panorama.clone();
+	const int faceSize = GetCubemapFaceSize(panorama.cols);
+	std::vector<unsigned char> pixels((size_t)6 * faceSize * faceSize * panorama.channels());
+	if (!ConvertEquirectToCubemap(panorama.ptr(), panorama.cols, panorama.rows, panorama.channels(), faceSize, pixels.data()))
+		return false;
+	// The 2x2 box filter keeps the faces apart in every level down to 1x1
+	// faces (faceSize is a power of two); the levels after that are unused.
+	if (!CookTexture(pixels.data(), faceSize, 6 * faceSize, panorama.channels(), options, faces))
+		return false;
+	if (hashed && !WriteCookedTexture(cubePath, sourceHash, faces))
+		std::cerr << "[WARNING] Failed to write cooked cubemap: " << GetCookedTexturePath(cubePath) << std::endl;
+	return true;
+}
+
+void Skybox::LoadAmbientSH(const std::string& imagePath, const bool hashed, const uint64_t sourceHash, cv::Mat& panorama)
+{
+	// SH only hold low frequencies; a streamed panorama is projected from a
+	// level of its page file at most this wide instead of being decoded.
+	const int MAX_STREAMED_WIDTH = 4096;
 
-	shader->UnBind();
+	SH9Color radiance;
+	if (!hashed || !ReadSH9Cache(imagePath, sourceHash, radiance)) {
+		bool projected = false;
+		if (virtualTexture != nullptr) {
+			const PageFile& pages = virtualTexture->GetPageFile();
+			int level = 0;
+			while (level + 1 < pages.GetNumLevels() && pages.GetLevel(level).width > MAX_STREAMED_WIDTH)
+				++level;
+			const PageFile::PageLevel& l = pages.GetLevel(level);
+			std::vector<unsigned char> pixels((size_t)l.width * l.height * pages.GetChannels());
+			pages.ReadLevel(level, pixels.data());
+			projected = ProjectPanoramaToSH9(pixels.data(), l.width, l.height, pages.GetChannels(), radiance);
+		}
+		else {
+			if (panorama.empty())
+				panorama = cv::imread(imagePath);
+			if (!panorama.empty() && panorama.depth() == CV_8U) {
+				if (!panorama.isContinuous())
+					panorama = panorama.clone();
+				projected = ProjectPanoramaToSH9(panorama.ptr(), panorama.cols, panorama.rows, panorama.channels(), radiance);
+			}
+		}
+		if (!projected)
+			return;
+		if (hashed && !WriteSH9Cache(imagePath, sourceHash, radiance))
+			std::cerr << "[WARNING] Failed to write SH cache: " << GetSH9CachePath(imagePath) << std::endl;
+	}
+	ambientSH = GetAmbientSH9(radiance);
+	hasAmbientSH = true;
+}
 
-	glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
+void Skybox::CreateCubemap(const CookedTexture& faces)
+{
+	if (faces.format != COOKED_FORMAT_RAW8 || faces.height != 6 * faces.width)
+		return;
+	GLenum internalFormat = GL_RGB, format = GL_BGR;
+	if (faces.channels == 1) {
+		internalFormat = GL_RED;
+		format = GL_RED;
+	}
+	else if (faces.channels == 4) {
+		internalFormat = GL_RGBA;
+		format = GL_BGRA;
+	}
+
+	glGenTextures(1, &cubemapTex);
+	GL_TRACK_CREATE(GL_RESOURCE_TEXTURE, &cubemapTex, 1, "Skybox cubemap");
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_CUBE_MAP, cubemapTex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	int maxLevel = 0;
+	size_t numBytes = 0;
+	for (size_t i = 0; i < faces.levels.size(); ++i) {
+		const CookedTexture::CookedLevel& level = faces.levels[i];
+		if (level.width != (faces.width >> i))
+			break;
+		const size_t faceBytes = (size_t)level.width * level.width * faces.channels;
+		for (int face = 0; face < 6; ++face) {
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, (GLint)i, internalFormat, level.width, level.width,
+							0, format, GL_UNSIGNED_BYTE, faces.GetLevelData(i) + face * faceBytes);
+		}
+		maxLevel = (int)i;
+		numBytes += 6 * faceBytes;
+		if (level.width == 1)
+			break;
+	}
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_TEXTURE, cubemapTex, numBytes);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, maxLevel);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	if (faces.channels == 1) {
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_SWIZZLE_B, GL_RED);
+	}
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
 void Skybox::CreateSphere3D(const int nSlices, const int nStacks, const float radius, 
@@ -3,6 +3,9 @@
 
 #include "headers.h"
 #include "imagetexture.h"
+#include "virtualtexture.h"
+#include "texturecook.h"
+#include "sphericalharmonics.h"
 #include "shaderprog.h"
 #include "material.h"
 #include "camera.h"
@@ -32,19 +35,51 @@ public:
 	Skybox(const std::string& texImagePath, const int nSlices, 
 			const int nStacks, const float radius);
 	~Skybox();
-	void Render(Camera* camera, SkyboxShaderProg* shader);
+	// Panoramas big enough to stream (see VirtualTexture::ShouldStream) are
+	// drawn with vtShader, after a feedback pass with feedbackShader. In
+	// cubemap mode the sky is drawn with cubeShader at the far plane; draw it
+	// after the opaque geometry so that covered pixels fail the depth test.
+	void Render(Camera* camera, SkyboxShaderProg* shader,
+				VirtualSkyboxShaderProg* vtShader = nullptr, VirtualSkyboxShaderProg* feedbackShader = nullptr,
+				CubemapSkyboxShaderProg* cubeShader = nullptr);
 	
 	void SetRotation(const float newRotation) { rotationY = newRotation; }
 	
 	ImageTexture* GetTexture() { return panorama; };
+	bool IsStreamed() const { return virtualTexture != nullptr; }
+	bool IsCubemap() const { return cubemapTex != 0; }
+	// Ambient light from the panorama (see GetAmbientSH9), in its own frame:
+	// rotate normals by the inverse of GetRotation() before evaluating it.
+	bool HasAmbientSH() const { return hasAmbientSH; }
+	const SH9Color& GetAmbientSH() const { return ambientSH; }
+	VirtualTexture* GetVirtualTexture() { return virtualTexture; }
 	float GetRotation() const  { return rotationY; }
 
+	// Convert panoramas (other than streamed ones) to a cubemap when loaded,
+	// instead of drawing them on a sphere. On by default.
+	static void SetUseCubemap(const bool enable) { useCubemap = enable; }
+
 private:
 	// Skybox Private Methods.
 	static void CreateSphere3D(const int nSlices, const int nStacks, const float radius, 
 					std::vector<VertexPT>& vertices, std::vector<unsigned int>& indices);
+	void DrawSphere();
+	// Get the cubemap faces of a panorama as one image (see cubemap.h) with
+	// its mips: from the cooked <image>.cube.texbin if it is up to date,
+	// else by converting the panorama and cooking the result.
+	// panorama receives the decoded image if it had to be decoded.
+	// sourceHash is the HashFile of the image; the caches are neither read
+	// nor written unless hashed.
+	static bool LoadCubemapFaces(const std::string& imagePath, const bool hashed, const uint64_t sourceHash,
+								 CookedTexture& faces, cv::Mat& panorama);
+	// Project the panorama onto SH, or read them from <image>.sh9.
+	void LoadAmbientSH(const std::string& imagePath, const bool hashed, const uint64_t sourceHash, cv::Mat& panorama);
+	void CreateCubemap(const CookedTexture& faces);
 
 	// Skybox Private Data.
+	// The sphere's vertex layout and index buffer live in vaoId; the
+	// cubemap triangle needs no vertices but draws with it bound too.
+	GLuint vaoId;
 	GLuint vboId;
 	GLuint iboId;
 	std::vector<VertexPT> vertices;
@@ -52,8 +87,13 @@ private:
 	
 	SkyboxMaterial* material;
 	ImageTexture* panorama;
+	VirtualTexture* virtualTexture;
+	GLuint cubemapTex;
+	SH9Color ambientSH;
+	bool hasAmbientSH;
 
 	float rotationY;
+	static bool useCubemap;
 };
 
 #endif
@@ -0,0 +1,342 @@
+#include "sphericalharmonics.h"
+
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SH_SIMD_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SH_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SH_SIMD_NEON
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Constants of the real SH basis: Y0 = K0, Y1..3 = K1 (y, z, x),
+// Y4, Y5, Y7 = K2A (xy, yz, xz), Y6 = K2B (3z^2 - 1), Y8 = K2C (x^2 - y^2).
+const double K0 = 0.282094791773878;
+const double K1 = 0.488602511902920;
+const double K2A = 1.092548430592079;
+const double K2B = 0.315391565252520;
+const double K2C = 0.546274215296040;
+const double BASIS_SCALE[9] = { K0, K1, K1, K1, K2A, K2A, K2B, K2A, K2C };
+
+// Per column of the panorama: cos(phi), sin(phi), cos^2(phi) and
+// cos(phi) sin(phi).
+struct ColumnTables
+{
+	explicit ColumnTables(const int width) {
+		cosPhi.resize(width);
+		sinPhi.resize(width);
+		cos2Phi.resize(width);
+		cosSinPhi.resize(width);
+		for (int x = 0; x < width; ++x) {
+			const double phi = 2.0 * PI * (x + 0.5) / width;
+			cosPhi[x] = (float)std::cos(phi);
+			sinPhi[x] = (float)std::sin(phi);
+			cos2Phi[x] = (float)(std::cos(phi) * std::cos(phi));
+			cosSinPhi[x] = (float)(std::cos(phi) * std::sin(phi));
+		}
+	}
+
+	std::vector<float> cosPhi;
+	std::vector<float> sinPhi;
+	std::vector<float> cos2Phi;
+	std::vector<float> cosSinPhi;
+};
+
+#if defined(SH_SIMD_AVX2)
+float HorizontalSum(const __m256 v)
+{
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+#elif defined(SH_SIMD_SSE2)
+float HorizontalSum(const __m128 v)
+{
+	__m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+#elif defined(SH_SIMD_NEON)
+float HorizontalSum(const float32x4_t v)
+{
+	const float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+	return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+// Sums over a row of plane[x] times 1, cos, sin, cos^2 and cos sin of phi.
+void SumRowMoments(const float* plane, const ColumnTables& tables, const int width, double moments[5])
+{
+	const float* c = tables.cosPhi.data();
+	const float* s = tables.sinPhi.data();
+	const float* cc = tables.cos2Phi.data();
+	const float* cs = tables.cosSinPhi.data();
+	float sums[5] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	int x = 0;
+#if defined(SH_SIMD_AVX2)
+	__m256 m0 = _mm256_setzero_ps(), m1 = m0, m2 = m0, m3 = m0, m4 = m0;
+	for (; x + 8 <= width; x += 8) {
+		const __m256 v = _mm256_loadu_ps(plane + x);
+		m0 = _mm256_add_ps(m0, v);
+		m1 = _mm256_add_ps(m1, _mm256_mul_ps(v, _mm256_loadu_ps(c + x)));
+		m2 = _mm256_add_ps(m2, _mm256_mul_ps(v, _mm256_loadu_ps(s + x)));
+		m3 = _mm256_add_ps(m3, _mm256_mul_ps(v, _mm256_loadu_ps(cc + x)));
+		m4 = _mm256_add_ps(m4, _mm256_mul_ps(v, _mm256_loadu_ps(cs + x)));
+	}
+	sums[0] = HorizontalSum(m0);
+	sums[1] = HorizontalSum(m1);
+	sums[2] = HorizontalSum(m2);
+	sums[3] = HorizontalSum(m3);
+	sums[4] = HorizontalSum(m4);
+#elif defined(SH_SIMD_SSE2)
+	__m128 m0 = _mm_setzero_ps(), m1 = m0, m2 = m0, m3 = m0, m4 = m0;
+	for (; x + 4 <= width; x += 4) {
+		const __m128 v = _mm_loadu_ps(plane + x);
+		m0 = _mm_add_ps(m0, v);
+		m1 = _mm_add_ps(m1, _mm_mul_ps(v, _mm_loadu_ps(c + x)));
+		m2 = _mm_add_ps(m2, _mm_mul_ps(v, _mm_loadu_ps(s + x)));
+		m3 = _mm_add_ps(m3, _mm_mul_ps(v, _mm_loadu_ps(cc + x)));
+		m4 = _mm_add_ps(m4, _mm_mul_ps(v, _mm_loadu_ps(cs + x)));
+	}
+	sums[0] = HorizontalSum(m0);
+	sums[1] = HorizontalSum(m1);
+	sums[2] = HorizontalSum(m2);
+	sums[3] = HorizontalSum(m3);
+	sums[4] = HorizontalSum(m4);
+#elif defined(SH_SIMD_NEON)
+	float32x4_t m0 = vdupq_n_f32(0.0f), m1 = m0, m2 = m0, m3 = m0, m4 = m0;
+	for (; x + 4 <= width; x += 4) {
+		const float32x4_t v = vld1q_f32(plane + x);
+		m0 = vaddq_f32(m0, v);
+		m1 = vmlaq_f32(m1, v, vld1q_f32(c + x));
+		m2 = vmlaq_f32(m2, v, vld1q_f32(s + x));
+		m3 = vmlaq_f32(m3, v, vld1q_f32(cc + x));
+		m4 = vmlaq_f32(m4, v, vld1q_f32(cs + x));
+	}
+	sums[0] = HorizontalSum(m0);
+	sums[1] = HorizontalSum(m1);
+	sums[2] = HorizontalSum(m2);
+	sums[3] = HorizontalSum(m3);
+	sums[4] = HorizontalSum(m4);
+#endif
+	for (; x < width; ++x) {
+		sums[0] += plane[x];
+		sums[1] += plane[x] * c[x];
+		sums[2] += plane[x] * s[x];
+		sums[3] += plane[x] * cc[x];
+		sums[4] += plane[x] * cs[x];
+	}
+	for (int k = 0; k < 5; ++k)
+		moments[k] = sums[k];
+}
+
+// SH9CacheHeader Declarations.
+struct SH9CacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t sourceHash;
+	float coeffs[9][3];
+};
+
+const char SH9_CACHE_MAGIC[8] = { 'S', 'H', '9', 'C', 'A', 'C', 'H', 'E' };
+// Bump whenever the projection changes.
+const uint32_t SH9_CACHE_VERSION = 1;
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+SH9Color::SH9Color()
+{
+	memset(coeffs, 0, sizeof(coeffs));
+}
+
+bool ProjectPanoramaToSH9(const unsigned char* pixels, const int width, const int height, const int channels,
+						  SH9Color& sh, const int numThreads)
+{
+	if (width <= 0 || height <= 0 || (channels != 1 && channels != 3 && channels != 4))
+		return false;
+	const ColumnTables tables(width);
+	// Source channel of red, green and blue.
+	const int sourceChannel[3] = { channels == 1 ? 0 : 2, channels == 1 ? 0 : 1, 0 };
+	const int numPlanes = channels == 1 ? 1 : 3;
+
+	// Each row's contribution is kept apart and summed in order at the end,
+	// so the thread count does not change the result.
+	std::vector<double> rowCoeffs((size_t)height * 27, 0.0);
+	const int rowsPerJob = std::max(1, (1 << 16) / width);
+	const int numJobs = (height + rowsPerJob - 1) / rowsPerJob;
+	int threads = numThreads > 0 ? numThreads : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, numJobs));
+
+	std::atomic<int> nextJob(0);
+	const auto worker = [&]() {
+		std::vector<float> planes((size_t)numPlanes * width);
+		for (int job = nextJob++; job < numJobs; job = nextJob++) {
+			const int yEnd = std::min(height, (job + 1) * rowsPerJob);
+			for (int y = job * rowsPerJob; y < yEnd; ++y) {
+				const unsigned char* row = pixels + (size_t)y * width * channels;
+				for (int p = 0; p < numPlanes; ++p) {
+					float* plane = &planes[(size_t)p * width];
+					const int source = sourceChannel[p];
+					for (int x = 0; x < width; ++x)
+						plane[x] = row[x * channels + source];
+				}
+
+				// Row at polar angle theta from +Y: directions
+				// (sin theta cos phi, cos theta, sin theta sin phi), each texel
+				// covering a solid angle of (2 pi / width) (pi / height) sin theta.
+				const double theta = PI * (y + 0.5) / height;
+				const double sinT = std::sin(theta), cosT = std::cos(theta);
+				const double weight = (2.0 * PI / width) * (PI / height) * sinT / 255.0;
+				double* out = &rowCoeffs[(size_t)y * 27];
+				for (int c = 0; c < 3; ++c) {
+					double m[5];
+					SumRowMoments(&planes[(size_t)(channels == 1 ? 0 : c) * width], tables, width, m);
+					const double m1 = m[0], mc = m[1], ms = m[2], mcc = m[3], mcs = m[4];
+					const double mss = m1 - mcc;
+					const double basis[9] = {
+						m1,
+						cosT * m1,
+						sinT * ms,
+						sinT * mc,
+						sinT * cosT * mc,
+						cosT * sinT * ms,
+						3.0 * sinT * sinT * mss - m1,
+						sinT * sinT * mcs,
+						sinT * sinT * mcc - cosT * cosT * m1
+					};
+					for (int k = 0; k < 9; ++k)
+						out[k * 3 + c] = weight * BASIS_SCALE[k] * basis[k];
+				}
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; ++t)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread& th : pool)
+		th.join();
+
+	double sums[27] = { 0.0 };
+	for (int y = 0; y < height; ++y)
+		for (int i = 0; i < 27; ++i)
+			sums[i] += rowCoeffs[(size_t)y * 27 + i];
+	for (int k = 0; k < 9; ++k)
+		for (int c = 0; c < 3; ++c)
+			sh.coeffs[k][c] = (float)sums[k * 3 + c];
+	return true;
+}
+
+SH9Color GetAmbientSH9(const SH9Color& radiance)
+{
+	// Cosine lobe convolution (Ramamoorthi and Hanrahan): A0 = pi,
+	// A1 = 2 pi / 3, A2 = pi / 4, all divided by pi for a diffuse surface.
+	const double bandScale[3] = { 1.0, 2.0 / 3.0, 0.25 };
+	const int band[9] = { 0, 1, 1, 1, 2, 2, 2, 2, 2 };
+	SH9Color ambient;
+	for (int k = 0; k < 9; ++k)
+		for (int c = 0; c < 3; ++c)
+			ambient.coeffs[k][c] = (float)(radiance.coeffs[k][c] * bandScale[band[k]] * BASIS_SCALE[k]);
+	return ambient;
+}
+
+SH9Color GetConstantAmbientSH9(const float r, const float g, const float b)
+{
+	SH9Color ambient;
+	ambient.coeffs[0][0] = r;
+	ambient.coeffs[0][1] = g;
+	ambient.coeffs[0][2] = b;
+	return ambient;
+}
+
+void EvaluateSH9(const SH9Color& sh, const float x, const float y, const float z, float rgb[3])
+{
+	const float basis[9] = { 1.0f, y, z, x, x * y, y * z, 3.0f * z * z - 1.0f, x * z, x * x - y * y };
+	for (int c = 0; c < 3; ++c) {
+		double sum = 0.0;
+		for (int k = 0; k < 9; ++k)
+			sum += sh.coeffs[k][c] * BASIS_SCALE[k] * basis[k];
+		rgb[c] = (float)sum;
+	}
+}
+
+std::string GetSH9CachePath(const std::string& imagePath)
+{
+	return imagePath + ".sh9";
+}
+
+bool ReadSH9Cache(const std::string& imagePath, const uint64_t sourceHash, SH9Color& sh)
+{
+	std::ifstream ifs(GetSH9CachePath(imagePath), std::ios::binary);
+	SH9CacheHeader header;
+	if (!ifs.read((char*)&header, sizeof(header)))
+		return false;
+	if (memcmp(header.magic, SH9_CACHE_MAGIC, sizeof(SH9_CACHE_MAGIC)) != 0
+		|| header.version != SH9_CACHE_VERSION
+		|| header.sourceHash != sourceHash)
+		return false;
+	memcpy(sh.coeffs, header.coeffs, sizeof(sh.coeffs));
+	return true;
+}
+
+bool WriteSH9Cache(const std::string& imagePath, const uint64_t sourceHash, const SH9Color& sh)
+{
+	SH9CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SH9_CACHE_MAGIC, sizeof(SH9_CACHE_MAGIC));
+	header.version = SH9_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	memcpy(header.coeffs, sh.coeffs, sizeof(header.coeffs));
+
+	const std::string cachePath = GetSH9CachePath(imagePath);
+	const std::string tempPath = cachePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	{
+		std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+		if (!ofs.is_open())
+			return false;
+		ofs.write((const char*)&header, sizeof(header));
+		if (!ofs.good())
+			return false;
+	}
+	std::error_code ec;
+	std::filesystem::rename(tempPath, cachePath, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
+
+const char* GetSH9SimdName()
+{
+#if defined(SH_SIMD_AVX2)
+	return "AVX2";
+#elif defined(SH_SIMD_SSE2)
+	return "SSE2";
+#elif defined(SH_SIMD_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,53 @@
+#ifndef SPHERICALHARMONICS_H
+#define SPHERICALHARMONICS_H
+
+// C++ STL headers.
+#include <string>
+#include <cstdint>
+
+// Spherical-harmonics ambient lighting.
+// A panorama is projected onto the 9 real SH basis functions of bands 0-2,
+// which is enough to reproduce diffuse lighting from it to within a few
+// percent. Directions use the sphere skybox's mapping of the panorama
+// (see cubemap.h). The pixel values are integrated as stored, not decoded
+// from sRGB, because the phong shader also uses texture and light colours
+// as they are. No GL calls, so it is safe on any thread.
+
+// SH9Color Declarations.
+struct SH9Color
+{
+	SH9Color();
+
+	// Coefficient k of red, green and blue.
+	float coeffs[9][3];
+};
+
+// Project an 8-bit panorama (1, 3 or 4 channels, rows tightly packed, top
+// row first, OpenCV channel order; alpha is ignored) into radiance SH. Rows
+// are split across numThreads threads (0 = one per hardware thread); the
+// result does not depend on the thread count.
+bool ProjectPanoramaToSH9(const unsigned char* pixels, const int width, const int height, const int channels,
+						  SH9Color& sh, const int numThreads = 0);
+
+// Turn radiance SH into the ambient term of a diffuse surface, ready for
+// phong_shading_demo.fs: the cosine lobe and 1/pi are applied and the basis
+// constants folded in, so the shader only needs the polynomial terms of
+// the normal. The ambient of a constant environment equals its radiance.
+SH9Color GetAmbientSH9(const SH9Color& radiance);
+
+// Ambient SH of a constant environment (already as GetAmbientSH9 returns it).
+SH9Color GetConstantAmbientSH9(const float r, const float g, const float b);
+
+// Radiance of sh in direction (x, y, z) (unit length).
+void EvaluateSH9(const SH9Color& sh, const float x, const float y, const float z, float rgb[3]);
+
+// Radiance SH cached next to the panorama (<image>.sh9), keyed by a hash of
+// the image. The file is written aside and renamed into place.
+std::string GetSH9CachePath(const std::string& imagePath);
+bool ReadSH9Cache(const std::string& imagePath, const uint64_t sourceHash, SH9Color& sh);
+bool WriteSH9Cache(const std::string& imagePath, const uint64_t sourceHash, const SH9Color& sh);
+
+// The instruction set the projection was compiled for: "AVX2", "SSE2", "NEON" or "scalar".
+const char* GetSH9SimdName();
+
+#endif
@@ -0,0 +1,79 @@
+#include "texturecache.h"
+#include "texturedecoder.h"
+
+#include <filesystem>
+
+TextureCache& TextureCache::GetInstance()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+std::shared_ptr<ImageTexture> TextureCache::Acquire(const std::string& filePath, TextureDecoder* decoder)
+{
+	const std::string key = GetKey(filePath);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::shared_ptr<ImageTexture> texture = textures[key].lock();
+		if (texture != nullptr) {
+			stats.numHits++;
+			return texture;
+		}
+	}
+
+	// Miss: upload the image decoded in the background, or decode it now.
+	// A texture that failed to load is cached too, as long as something
+	// holds it, so the image is not retried for every material of a model.
+	CookedTexture image;
+	ImageTexture* created = nullptr;
+	if (decoder != nullptr && decoder->Take(filePath, image))
+		created = new ImageTexture(filePath, image);
+	else
+		created = new ImageTexture(filePath);
+	std::shared_ptr<ImageTexture> texture(created, [this, key](ImageTexture* tex) { Release(key, tex); });
+
+	std::lock_guard<std::mutex> lock(mutex);
+	textures[key] = texture;
+	stats.numMisses++;
+	stats.numResident++;
+	stats.residentBytes += texture->GetNumBytes();
+	return texture;
+}
+
+bool TextureCache::IsResident(const std::string& filePath)
+{
+	const std::string key = GetKey(filePath);
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = textures.find(key);
+	return it != textures.end() && !it->second.expired();
+}
+
+void TextureCache::ShowStats() const
+{
+	std::cout << "Texture cache: " << stats.numResident << " resident ("
+			  << stats.residentBytes / (1024.0 * 1024.0) << " MB), "
+			  << stats.numHits << " hits, " << stats.numMisses << " misses" << std::endl;
+}
+
+std::string TextureCache::GetKey(const std::string& filePath)
+{
+	// "a\..\tex.png" and "tex.png" must hit the same entry.
+	std::error_code ec;
+	const std::filesystem::path canonical = std::filesystem::weakly_canonical(filePath, ec);
+	if (ec)
+		return filePath;
+	return canonical.lexically_normal().make_preferred().string();
+}
+
+void TextureCache::Release(const std::string& key, ImageTexture* texture)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.numResident--;
+		stats.residentBytes -= texture->GetNumBytes();
+		auto it = textures.find(key);
+		if (it != textures.end() && it->second.expired())
+			textures.erase(it);
+	}
+	delete texture;
+}
@@ -0,0 +1,59 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "headers.h"
+#include "imagetexture.h"
+
+// C++ STL headers.
+#include <memory>
+#include <mutex>
+
+class TextureDecoder;
+
+// TextureCacheStats Declarations.
+struct TextureCacheStats
+{
+	TextureCacheStats() { numHits = 0; numMisses = 0; numResident = 0; residentBytes = 0; }
+
+	int numHits;
+	int numMisses;
+	// Textures currently alive and their estimated GPU memory (with mipmaps).
+	int numResident;
+	size_t residentBytes;
+};
+
+// TextureCache Declarations.
+// Image textures shared by file path. Every material that refers to the same
+// image gets a handle to the same ImageTexture, decoded and uploaded once;
+// the GL texture is deleted when the last handle goes away. Textures are
+// created and released on the GL thread; IsResident may be called anywhere.
+class TextureCache
+{
+public:
+	// TextureCache Public Methods.
+	static TextureCache& GetInstance();
+
+	// Return the texture of filePath, loading it on a miss. The image is
+	// taken from decoder when it was requested there, else decoded here.
+	std::shared_ptr<ImageTexture> Acquire(const std::string& filePath, TextureDecoder* decoder = nullptr);
+	// True if a live texture exists for filePath (no need to decode it).
+	bool IsResident(const std::string& filePath);
+
+	const TextureCacheStats& GetStats() const { return stats; }
+	void ShowStats() const;
+
+private:
+	// TextureCache Private Methods.
+	TextureCache() {}
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+	static std::string GetKey(const std::string& filePath);
+	void Release(const std::string& key, ImageTexture* texture);
+
+	// TextureCache Private Data.
+	std::mutex mutex;
+	std::unordered_map<std::string, std::weak_ptr<ImageTexture>> textures;
+	TextureCacheStats stats;
+};
+
+#endif
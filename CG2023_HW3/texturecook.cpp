@@ -0,0 +1,322 @@
+#include "texturecook.h"
+#include "mappedfile.h"
+
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+// CookedTextureHeader Declarations.
+// Followed by numLevels CookedLevelRecords, then the level data (each level
+// starts at a 16-byte aligned offset from the start of the file).
+struct CookedTextureHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	uint64_t sourceHash;
+	int32_t width;
+	int32_t height;
+	int32_t channels;
+	uint32_t numLevels;
+	uint32_t flags;
+};
+
+// CookedTextureHeader::flags
+const uint32_t COOKED_FLAG_GAMMA_CORRECT = 1;
+
+struct CookedLevelRecord
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;
+	uint64_t size;
+};
+
+const char COOKED_TEXTURE_MAGIC[8] = { 'T', 'E', 'X', 'B', 'I', 'N', '\0', '\0' };
+
+size_t AlignUp(const size_t n, const size_t alignment)
+{
+	return (n + alignment - 1) / alignment * alignment;
+}
+
+size_t GetLevelSize(const CookedTextureFormat format, const int width, const int height, const int channels)
+{
+	if (format == COOKED_FORMAT_BC1)
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+	return (size_t)width * height * channels;
+}
+
+uint16_t PackRGB565(const int r, const int g, const int b)
+{
+	return (uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+void UnpackRGB565(const uint16_t c, int rgb[3])
+{
+	const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Encode one 4x4 block of RGB pixels as BC1: the endpoints are the corners of
+// the (slightly inset) bounding box, each pixel takes the nearest palette entry.
+void EncodeBC1Block(const unsigned char block[16][3], unsigned char out[8])
+{
+	int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < 3; ++c) {
+			lo[c] = std::min(lo[c], (int)block[i][c]);
+			hi[c] = std::max(hi[c], (int)block[i][c]);
+		}
+	}
+	for (int c = 0; c < 3; ++c) {
+		const int inset = (hi[c] - lo[c]) / 16;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+	uint16_t c0 = PackRGB565(hi[0], hi[1], hi[2]);
+	uint16_t c1 = PackRGB565(lo[0], lo[1], lo[2]);
+	uint32_t indices = 0;
+	if (c0 < c1)
+		std::swap(c0, c1);
+	if (c0 != c1) {
+		// Four-colour mode (c0 > c1): c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1.
+		int palette[4][3];
+		UnpackRGB565(c0, palette[0]);
+		UnpackRGB565(c1, palette[1]);
+		for (int c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; ++i) {
+			int best = 0, bestDist = 1 << 30;
+			for (int k = 0; k < 4; ++k) {
+				int dist = 0;
+				for (int c = 0; c < 3; ++c)
+					dist += (block[i][c] - palette[k][c]) * (block[i][c] - palette[k][c]);
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = k;
+				}
+			}
+			indices |= (uint32_t)best << (2 * i);
+		}
+	}
+	memcpy(out, &c0, 2);
+	memcpy(out + 2, &c1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+// BGR input (OpenCV order); blocks past the edge repeat the last row/column.
+void EncodeBC1(const unsigned char* src, const int width, const int height, unsigned char* dst)
+{
+	unsigned char block[16][3];
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+			for (int i = 0; i < 16; ++i) {
+				const int x = std::min(bx + i % 4, width - 1), y = std::min(by + i / 4, height - 1);
+				const unsigned char* p = src + ((size_t)y * width + x) * 3;
+				block[i][0] = p[2];
+				block[i][1] = p[1];
+				block[i][2] = p[0];
+			}
+			EncodeBC1Block(block, dst);
+			dst += 8;
+		}
+	}
+}
+
+} // namespace
+
+// ------------------------------------------------------------------------------------------------
+
+CookedTexture::CookedTexture()
+{
+	width = 0;
+	height = 0;
+	channels = 0;
+	format = COOKED_FORMAT_RAW8;
+	gammaCorrect = false;
+	data = nullptr;
+}
+
+size_t CookedTexture::GetNumBytes() const
+{
+	size_t numBytes = 0;
+	for (const CookedLevel& level : levels)
+		numBytes += level.size;
+	return numBytes;
+}
+
+std::string GetCookedTexturePath(const std::string& imagePath)
+{
+	return imagePath + ".texbin";
+}
+
+bool CookTexture(const unsigned char* pixels, const int width, const int height, const int channels,
+				 const TextureCookOptions& options, CookedTexture& texture)
+{
+	if (width <= 0 || height <= 0 || (channels != 1 && channels != 3 && channels != 4))
+		return false;
+
+	texture = CookedTexture();
+	texture.width = width;
+	texture.height = height;
+	texture.channels = channels;
+	texture.format = (options.blockCompress && channels == 3) ? COOKED_FORMAT_BC1 : COOKED_FORMAT_RAW8;
+	texture.gammaCorrect = options.mips.gammaCorrect;
+
+	// Level sizes down to 1x1.
+	size_t offset = 0;
+	for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2)) {
+		CookedTexture::CookedLevel level;
+		level.width = w;
+		level.height = h;
+		level.offset = offset;
+		level.size = GetLevelSize(texture.format, w, h, channels);
+		texture.levels.push_back(level);
+		offset = AlignUp(offset + level.size, 16);
+		if (w == 1 && h == 1)
+			break;
+	}
+	texture.bytes.resize(offset);
+	texture.data = texture.bytes.data();
+
+	// Raw levels are filtered in place from the previous level; BC1 levels
+	// need the raw pixels kept aside.
+	if (texture.format == COOKED_FORMAT_RAW8) {
+		memcpy(texture.bytes.data(), pixels, texture.levels[0].size);
+		for (size_t i = 1; i < texture.levels.size(); ++i) {
+			const CookedTexture::CookedLevel& prev = texture.levels[i - 1];
+			BuildMipLevel(texture.GetLevelData(i - 1), prev.width, prev.height, channels,
+						  texture.bytes.data() + texture.levels[i].offset, options.mips);
+		}
+		return true;
+	}
+	std::vector<unsigned char> current(pixels, pixels + (size_t)width * height * channels), next;
+	for (size_t i = 0; i < texture.levels.size(); ++i) {
+		const CookedTexture::CookedLevel& level = texture.levels[i];
+		EncodeBC1(current.data(), level.width, level.height, texture.bytes.data() + level.offset);
+		if (i + 1 < texture.levels.size()) {
+			const CookedTexture::CookedLevel& nextLevel = texture.levels[i + 1];
+			next.resize((size_t)nextLevel.width * nextLevel.height * channels);
+			BuildMipLevel(current.data(), level.width, level.height, channels, next.data(), options.mips);
+			current.swap(next);
+		}
+	}
+	return true;
+}
+
+bool ReadCookedTexture(const std::string& imagePath, const uint64_t sourceHash, const TextureCookOptions& options,
+					   CookedTexture& texture)
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(GetCookedTexturePath(imagePath)) || file->GetSize() < sizeof(CookedTextureHeader))
+		return false;
+	const size_t fileSize = file->GetSize();
+
+	CookedTextureHeader header;
+	memcpy(&header, file->GetData(), sizeof(header));
+	const CookedTextureFormat wantFormat = (options.blockCompress && header.channels == 3) ? COOKED_FORMAT_BC1 : COOKED_FORMAT_RAW8;
+	const uint32_t wantFlags = options.mips.gammaCorrect ? COOKED_FLAG_GAMMA_CORRECT : 0;
+	if (memcmp(header.magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC)) != 0
+		|| header.version != COOKED_TEXTURE_VERSION
+		|| header.sourceHash != sourceHash
+		|| header.format != (uint32_t)wantFormat
+		|| header.flags != wantFlags
+		|| header.width <= 0 || header.height <= 0
+		|| (header.channels != 1 && header.channels != 3 && header.channels != 4)
+		|| header.numLevels == 0 || header.numLevels > 32
+		|| fileSize < sizeof(header) + header.numLevels * sizeof(CookedLevelRecord))
+		return false;
+
+	CookedTexture result;
+	result.width = header.width;
+	result.height = header.height;
+	result.channels = header.channels;
+	result.format = wantFormat;
+	result.gammaCorrect = options.mips.gammaCorrect;
+	const char* records = file->GetData() + sizeof(header);
+	int w = header.width, h = header.height;
+	for (uint32_t i = 0; i < header.numLevels; ++i) {
+		CookedLevelRecord record;
+		memcpy(&record, records + i * sizeof(record), sizeof(record));
+		if ((int)record.width != w || (int)record.height != h
+			|| record.size != GetLevelSize(wantFormat, w, h, header.channels)
+			|| record.offset > fileSize || record.size > fileSize - record.offset)
+			return false;
+		CookedTexture::CookedLevel level;
+		level.width = w;
+		level.height = h;
+		level.offset = (size_t)record.offset;
+		level.size = (size_t)record.size;
+		result.levels.push_back(level);
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	result.data = (const unsigned char*)file->GetData();
+	result.file = file;
+	texture = std::move(result);
+	return true;
+}
+
+bool WriteCookedTexture(const std::string& imagePath, const uint64_t sourceHash, const CookedTexture& texture)
+{
+	if (texture.IsEmpty())
+		return false;
+
+	CookedTextureHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC));
+	header.version = COOKED_TEXTURE_VERSION;
+	header.format = (uint32_t)texture.format;
+	header.sourceHash = sourceHash;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.channels = texture.channels;
+	header.numLevels = (uint32_t)texture.levels.size();
+	header.flags = texture.gammaCorrect ? COOKED_FLAG_GAMMA_CORRECT : 0;
+
+	// Level data follows the tables, 16-byte aligned.
+	const size_t dataStart = AlignUp(sizeof(header) + texture.levels.size() * sizeof(CookedLevelRecord), 16);
+	std::vector<CookedLevelRecord> records;
+	for (const CookedTexture::CookedLevel& level : texture.levels) {
+		CookedLevelRecord record;
+		record.width = (uint32_t)level.width;
+		record.height = (uint32_t)level.height;
+		record.offset = dataStart + level.offset;
+		record.size = level.size;
+		records.push_back(record);
+	}
+
+	// Several threads may cook the same image; each writes its own temp file.
+	const std::string cookedPath = GetCookedTexturePath(imagePath);
+	const std::string tempPath = cookedPath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	{
+		std::ofstream ofs(tempPath, std::ios::binary | std::ios::trunc);
+		if (!ofs.is_open())
+			return false;
+		ofs.write((const char*)&header, sizeof(header));
+		ofs.write((const char*)records.data(), records.size() * sizeof(CookedLevelRecord));
+		const size_t tablesEnd = sizeof(header) + records.size() * sizeof(CookedLevelRecord);
+		const char padding[16] = { 0 };
+		ofs.write(padding, dataStart - tablesEnd);
+		const CookedTexture::CookedLevel& last = texture.levels.back();
+		ofs.write((const char*)texture.data, AlignUp(last.offset + last.size, 16));
+		if (!ofs.good())
+			return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, cookedPath, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,93 @@
+#ifndef TEXTURECOOK_H
+#define TEXTURECOOK_H
+
+// C++ STL headers.
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "mipbuilder.h"
+
+class MappedFile;
+
+// Cooked textures (*.texbin).
+// A cooked texture sits next to its source image and holds the complete mip
+// chain, ready to be uploaded level by level with no decode and no
+// glGenerateMipmap. It is keyed by a hash of the source image, so editing the
+// image invalidates it. Pixels are stored bottom row first (GL order) with
+// the channel order of OpenCV (BGR/BGRA). Bump COOKED_TEXTURE_VERSION
+// whenever the layout or the meaning of the stored data changes.
+const uint32_t COOKED_TEXTURE_VERSION = 2;
+
+enum CookedTextureFormat
+{
+	// 8 bits per channel, 1, 3 or 4 channels, tightly packed rows.
+	COOKED_FORMAT_RAW8 = 0,
+	// BC1 (DXT1) blocks of 4x4 pixels, RGB, 8 bytes per block.
+	COOKED_FORMAT_BC1 = 1
+};
+
+// TextureCookOptions Declarations.
+struct TextureCookOptions
+{
+	TextureCookOptions() { blockCompress = false; }
+
+	// Store 3-channel images as BC1; other channel counts stay raw.
+	bool blockCompress;
+	// How the mip levels are filtered.
+	MipBuildOptions mips;
+};
+
+// CookedTexture Declarations.
+struct CookedTexture
+{
+	CookedTexture();
+
+	// CookedLevel Declarations.
+	struct CookedLevel
+	{
+		int width;
+		int height;
+		size_t offset;
+		size_t size;
+	};
+
+	const unsigned char* GetLevelData(const size_t level) const { return data + levels[level].offset; }
+	size_t GetNumBytes() const;
+	bool IsEmpty() const { return levels.empty(); }
+
+	int width;
+	int height;
+	int channels;
+	CookedTextureFormat format;
+	// The mips were filtered in linear light (MipBuildOptions::gammaCorrect).
+	bool gammaCorrect;
+	std::vector<CookedLevel> levels;
+
+	// The level data lives either in bytes (cooked in memory) or in file
+	// (a mapped *.texbin); data points into one of them.
+	std::vector<unsigned char> bytes;
+	std::shared_ptr<MappedFile> file;
+	const unsigned char* data;
+};
+
+// The cooked file used for a source image.
+std::string GetCookedTexturePath(const std::string& imagePath);
+
+// Build the full mip chain of an 8-bit image (rows tightly packed, in the
+// order they are to be uploaded) with BuildMipLevel.
+bool CookTexture(const unsigned char* pixels, const int width, const int height, const int channels,
+				 const TextureCookOptions& options, CookedTexture& texture);
+
+// Memory-map the cooked file of imagePath and use it if it matches
+// sourceHash (the HashFile of the image), the requested compression and
+// the requested mip filtering.
+bool ReadCookedTexture(const std::string& imagePath, const uint64_t sourceHash, const TextureCookOptions& options,
+					   CookedTexture& texture);
+
+// Write the cooked file of imagePath. The file is written aside and renamed into place.
+bool WriteCookedTexture(const std::string& imagePath, const uint64_t sourceHash, const CookedTexture& texture);
+
+#endif
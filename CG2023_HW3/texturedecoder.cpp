@@ -0,0 +1,86 @@
+#include "texturedecoder.h"
+#include "imagetexture.h"
+
+TextureDecoder::TextureDecoder(const int threads)
+{
+	maxThreads = (threads > 0) ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+	numBusy = 0;
+	stopping = false;
+}
+
+TextureDecoder::~TextureDecoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	jobQueued.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void TextureDecoder::Request(const std::string& filePath)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (jobs.find(filePath) != jobs.end())
+		return;
+	jobs[filePath] = DecodeJob();
+	queue.push_back(filePath);
+	// Threads are started on demand and then kept for later loads.
+	if ((int)workers.size() < maxThreads && (int)workers.size() < numBusy + (int)queue.size())
+		workers.emplace_back(&TextureDecoder::WorkerLoop, this);
+	jobQueued.notify_one();
+}
+
+bool TextureDecoder::Take(const std::string& filePath, CookedTexture& image)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	auto it = jobs.find(filePath);
+	if (it == jobs.end())
+		return false;
+	jobDone.wait(lock, [&]() { return it->second.done; });
+	image = std::move(it->second.image);
+	jobs.erase(it);
+	return true;
+}
+
+bool TextureDecoder::IsIdle()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return queue.empty() && numBusy == 0;
+}
+
+void TextureDecoder::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	queue.clear();
+	jobs.clear();
+}
+
+void TextureDecoder::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		jobQueued.wait(lock, [&]() { return stopping || !queue.empty(); });
+		if (stopping)
+			return;
+		const std::string filePath = queue.front();
+		queue.pop_front();
+		numBusy++;
+
+		lock.unlock();
+		CookedTexture image;
+		ImageTexture::LoadImageData(filePath, image);
+		lock.lock();
+
+		numBusy--;
+		// The job is gone if Clear() was called meanwhile.
+		auto it = jobs.find(filePath);
+		if (it != jobs.end()) {
+			it->second.image = std::move(image);
+			it->second.done = true;
+		}
+		jobDone.notify_all();
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef TEXTURE_DECODER_H
+#define TEXTURE_DECODER_H
+
+#include "headers.h"
+#include "texturecook.h"
+
+// C++ STL headers.
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// TextureDecoder Declarations.
+// Decodes texture images on worker threads so that the GL thread only has to
+// upload them (ImageTexture::LoadImageData: a mapped *.texbin, or decode and
+// cook). TriangleMesh::LoadMeshData requests the map_Kd images as soon
+// as the MTL files are read, so decoding overlaps with parsing the geometry;
+// the TextureCache takes the decoded images when it creates the textures.
+class TextureDecoder
+{
+public:
+	// TextureDecoder Public Methods.
+	// maxThreads == 0 uses up to one thread per hardware thread.
+	explicit TextureDecoder(const int maxThreads = 0);
+	~TextureDecoder();
+
+	// Queue the decode of an image; a path already requested is ignored.
+	void Request(const std::string& filePath);
+	// Wait for the decode of filePath and move the image out. Returns false
+	// if it was not requested. The image is empty if decoding failed.
+	bool Take(const std::string& filePath, CookedTexture& image);
+	// True when no decode is queued or running.
+	bool IsIdle();
+	// Forget all requests and images that were not taken.
+	void Clear();
+
+private:
+	// TextureDecoder Private Methods.
+	TextureDecoder(const TextureDecoder&) = delete;
+	TextureDecoder& operator=(const TextureDecoder&) = delete;
+	void WorkerLoop();
+
+	// DecodeJob Declarations.
+	struct DecodeJob
+	{
+		DecodeJob() { done = false; }
+		CookedTexture image;
+		bool done;
+	};
+
+	// TextureDecoder Private Data.
+	std::mutex mutex;
+	std::condition_variable jobQueued;
+	std::condition_variable jobDone;
+	std::unordered_map<std::string, DecodeJob> jobs;
+	std::deque<std::string> queue;
+	std::vector<std::thread> workers;
+	int maxThreads;
+	int numBusy;
+	bool stopping;
+};
+
+#endif
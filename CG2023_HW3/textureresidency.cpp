@@ -0,0 +1,153 @@
+#include "textureresidency.h"
+#include "imagetexture.h"
+
+#include <algorithm>
+
+namespace {
+
+// Demoted textures keep their mips from this level on (1/16 of the memory).
+const int DEMOTED_LEVEL = 2;
+
+} // namespace
+
+TextureResidency& TextureResidency::GetInstance()
+{
+	static TextureResidency residency;
+	return residency;
+}
+
+TextureResidency::TextureResidency()
+{
+	budget = 0;
+	residentBytes = 0;
+	frame = 0;
+	numDemotions = 0;
+	numEvictions = 0;
+	numRestores = 0;
+}
+
+void TextureResidency::SetBudget(const size_t bytes)
+{
+	budget = bytes;
+	MakeRoom(0);
+}
+
+void TextureResidency::Register(ImageTexture* texture)
+{
+	if (entries.count(texture) != 0)
+		return;
+	Entry entry;
+	entry.texture = texture;
+	// A texture just loaded is about to be used; do not evict it right away.
+	entry.lastUsedFrame = frame;
+	entry.restoreFailed = false;
+	lru.push_front(entry);
+	entries[texture] = lru.begin();
+	residentBytes += texture->GetResidentBytes();
+	MakeRoom(0);
+}
+
+void TextureResidency::Unregister(ImageTexture* texture)
+{
+	auto it = entries.find(texture);
+	if (it == entries.end())
+		return;
+	residentBytes -= texture->GetResidentBytes();
+	lru.erase(it->second);
+	entries.erase(it);
+}
+
+void TextureResidency::Touch(ImageTexture* texture)
+{
+	auto it = entries.find(texture);
+	if (it == entries.end())
+		return;
+	it->second->lastUsedFrame = frame;
+	lru.splice(lru.begin(), lru, it->second);
+	if (texture->GetBaseLevel() == 0 || it->second->restoreFailed)
+		return;
+
+	// Bring back as many levels as fit; an evicted texture gets at least
+	// its smallest mip so that it can be drawn.
+	const int numLevels = texture->GetNumLevels();
+	const int lowest = std::min(texture->GetBaseLevel(), numLevels - 1);
+	for (int level = 0; level <= lowest; ++level) {
+		const size_t extraBytes = texture->GetBytesFromLevel(level) - texture->GetResidentBytes();
+		MakeRoom(extraBytes);
+		if (Fits(extraBytes) || level == lowest) {
+			if (level == texture->GetBaseLevel())
+				return;
+			if (SetBaseLevel(texture, level))
+				numRestores++;
+			else
+				it->second->restoreFailed = true;
+			return;
+		}
+	}
+}
+
+void TextureResidency::MakeRoom(const size_t extraBytes)
+{
+	if (Fits(extraBytes))
+		return;
+	// Demoting first keeps textures drawable (if blurry) and usually frees
+	// enough; eviction is the last resort.
+	for (int pass = 0; pass < 2; ++pass) {
+		for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+			if (Fits(extraBytes))
+				return;
+			ImageTexture* texture = it->texture;
+			if (it->lastUsedFrame == frame)
+				continue;
+			if (pass == 0) {
+				const int demoted = std::min(DEMOTED_LEVEL, texture->GetNumLevels() - 1);
+				if (texture->GetBaseLevel() < demoted && SetBaseLevel(texture, demoted))
+					numDemotions++;
+			}
+			else if (texture->GetBaseLevel() < texture->GetNumLevels()) {
+				if (SetBaseLevel(texture, texture->GetNumLevels()))
+					numEvictions++;
+			}
+		}
+	}
+}
+
+bool TextureResidency::SetBaseLevel(ImageTexture* texture, const int baseLevel)
+{
+	const size_t before = texture->GetResidentBytes();
+	const bool ok = texture->SetBaseLevel(baseLevel);
+	residentBytes = residentBytes - before + texture->GetResidentBytes();
+	return ok;
+}
+
+TextureResidencyStats TextureResidency::GetStats() const
+{
+	TextureResidencyStats stats;
+	for (const Entry& entry : lru) {
+		const int baseLevel = entry.texture->GetBaseLevel();
+		if (baseLevel == 0)
+			stats.numResident++;
+		else if (baseLevel < entry.texture->GetNumLevels())
+			stats.numDemoted++;
+		else
+			stats.numEvicted++;
+	}
+	stats.numTextures = (int)lru.size();
+	stats.residentBytes = residentBytes;
+	stats.budgetBytes = budget;
+	stats.numDemotions = numDemotions;
+	stats.numEvictions = numEvictions;
+	stats.numRestores = numRestores;
+	return stats;
+}
+
+void TextureResidency::ShowStats() const
+{
+	const TextureResidencyStats stats = GetStats();
+	std::cout << "Texture residency: " << stats.residentBytes / (1024.0 * 1024.0) << " MB";
+	if (stats.budgetBytes != 0)
+		std::cout << " of " << stats.budgetBytes / (1024.0 * 1024.0) << " MB budget";
+	std::cout << ", " << stats.numResident << " resident, " << stats.numDemoted << " demoted, "
+			  << stats.numEvicted << " evicted (" << stats.numDemotions << " demotions, "
+			  << stats.numEvictions << " evictions, " << stats.numRestores << " restores)" << std::endl;
+}
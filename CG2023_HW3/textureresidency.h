@@ -0,0 +1,93 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include "headers.h"
+
+// C++ STL headers.
+#include <list>
+
+class ImageTexture;
+
+// TextureResidencyStats Declarations.
+struct TextureResidencyStats
+{
+	TextureResidencyStats() {
+		numTextures = 0; numResident = 0; numDemoted = 0; numEvicted = 0;
+		residentBytes = 0; budgetBytes = 0;
+		numDemotions = 0; numEvictions = 0; numRestores = 0;
+	}
+
+	// Textures by state: all levels on the GPU, only the smaller mips, or none.
+	int numTextures;
+	int numResident;
+	int numDemoted;
+	int numEvicted;
+	size_t residentBytes;
+	size_t budgetBytes;
+	// Since start.
+	int numDemotions;
+	int numEvictions;
+	int numRestores;
+};
+
+// TextureResidency Declarations.
+// Keeps the GPU memory of image textures within a budget. Every ImageTexture
+// loaded from a file registers here; when the total goes over the budget,
+// the least recently bound textures are first demoted to a smaller mip and
+// then evicted altogether. Binding a texture brings its full mip chain back
+// (from its cooked *.texbin) if that fits. Textures bound in the current
+// frame are never evicted, so a frame that needs more than the budget goes
+// over it rather than thrashing. GL thread only.
+class TextureResidency
+{
+public:
+	// TextureResidency Public Methods.
+	static TextureResidency& GetInstance();
+
+	// 0 = unlimited (the default).
+	void SetBudget(const size_t bytes);
+	size_t GetBudget() const { return budget; }
+	// Call once per frame before drawing.
+	void BeginFrame() { frame++; }
+
+	void Register(ImageTexture* texture);
+	void Unregister(ImageTexture* texture);
+	// Called by ImageTexture::Bind.
+	void Touch(ImageTexture* texture);
+
+	TextureResidencyStats GetStats() const;
+	void ShowStats() const;
+
+private:
+	// Entry Declarations.
+	struct Entry
+	{
+		ImageTexture* texture;
+		unsigned int lastUsedFrame;
+		// Its image could not be read back; stop trying.
+		bool restoreFailed;
+	};
+
+	// TextureResidency Private Methods.
+	TextureResidency();
+	TextureResidency(const TextureResidency&) = delete;
+	TextureResidency& operator=(const TextureResidency&) = delete;
+	// Demote, then evict, textures not used this frame (least recently
+	// bound first) until extraBytes more fit in the budget.
+	void MakeRoom(const size_t extraBytes);
+	bool Fits(const size_t extraBytes) const { return budget == 0 || residentBytes + extraBytes <= budget; }
+	bool SetBaseLevel(ImageTexture* texture, const int baseLevel);
+
+	// TextureResidency Private Data.
+	// Most recently bound first.
+	std::list<Entry> lru;
+	std::unordered_map<ImageTexture*, std::list<Entry>::iterator> entries;
+	size_t budget;
+	size_t residentBytes;
+	unsigned int frame;
+	int numDemotions;
+	int numEvictions;
+	int numRestores;
+};
+
+#endif
@@ -1,4 +1,21 @@
 #include "trianglemesh.h"
+#include "meshcache.h"
+#include "filehash.h"
+#include "decompressstream.h"
+#include "texturecache.h"
+#include "texturedecoder.h"
+#include "textureresidency.h"
+#include "glresourcetracker.h"
+#include "glstatecache.h"
+#include "uniformblocks.h"
+#include "meshsimplify.h"
+#include "vertexcache.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+bool TriangleMesh::useMultiDraw = true;
 
 // Constructor of a triangle mesh.
 TriangleMesh::TriangleMesh()
@@ -8,7 +25,22 @@ TriangleMesh::TriangleMesh()
 	numVertices = 0;
 	numTriangles = 0;
 	objCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+	vaoId = 0;
 	vboId = 0;
+	iboId = 0;
+	indirectBufferId = 0;
+	materialBufferId = 0;
+	materialTex = 0;
+	instanceBufferId = 0;
+	numInstances = 0;
+	instanceCapacity = 0;
+	for (int lod = 0; lod < MAX_MESH_LODS; ++lod) {
+		lodInstanceCounts[lod] = 0;
+		lodFirstInstances[lod] = 0;
+	}
+	attributeFirstInstance = 0;
+	commandsDirty = false;
+	allUploaded = false;
 	objExtent = glm::vec3(0.0f, 0.0f, 0.0f);
 	// -------------------------------------------------------
 }
@@ -18,7 +50,25 @@ TriangleMesh::~TriangleMesh()
 {
 	// -------------------------------------------------------
 	// Add your release code here.
+	GLResourceTracker& tracker = GLResourceTracker::GetInstance();
 	subMeshes.clear();
+	if (materialTex != 0) {
+		tracker.TrackDelete(GL_RESOURCE_TEXTURE, &materialTex, 1);
+		glDeleteTextures(1, &materialTex);
+	}
+	const GLuint buffers[] = { iboId, indirectBufferId, materialBufferId, instanceBufferId };
+	tracker.TrackDelete(GL_RESOURCE_BUFFER, buffers, 4);
+	glDeleteBuffers(4, buffers);
+	if (vaoId != 0) {
+		tracker.TrackDelete(GL_RESOURCE_VERTEX_ARRAY, &vaoId, 1);
+		glDeleteVertexArrays(1, &vaoId);
+	}
+	if (vboId != 0) {
+		tracker.TrackDelete(GL_RESOURCE_BUFFER, &vboId, 1);
+		glDeleteBuffers(1, &vboId);
+	}
+	// Dropping the materials releases their texture handles; the TextureCache
+	// deletes a GL texture once no model uses it.
 	pm.clear();
 	// -------------------------------------------------------
 }
@@ -26,267 +76,518 @@ TriangleMesh::~TriangleMesh()
 // Load the geometry and material data from an OBJ file.
 bool TriangleMesh::LoadFromFile(const std::string& filePath, const bool normalized)
 {	
+	// Texture images are decoded in the background while the OBJ is parsed.
+	TextureDecoder textureDecoder;
+	MeshCacheData meshData;
+	if (!LoadMeshData(filePath, normalized, loadOptions, meshData, nullptr, &textureDecoder))
+		exit(-1);
+	SetMeshData(meshData, &textureDecoder);
+	CreateBuffers();
+	return true;
+}
+
+// Read the mesh from its cache or parse the OBJ/MTL files. No GL calls are
+// made here, so it can run on any thread.
+bool TriangleMesh::LoadMeshData(const std::string& filePath, const bool normalized, const ObjLoadOptions& options,
+								MeshCacheData& meshData, ObjLoadProgress* progress, TextureDecoder* textures)
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point start = Clock::now();
+
+	// A valid *.meshbin cache skips both the OBJ and the MTL parser.
+	uint64_t objHash = 0;
+	const bool hashed = options.useMeshCache && HashFile(filePath, objHash);
+	if (hashed && ReadMeshCache(filePath, objHash, normalized, meshData)) {
+		std::cout << "loaded " << GetMeshCachePath(filePath) << " in "
+				  << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms" << std::endl;
+		RequestTextures(meshData.materials, textures);
+		ComputeBounds(meshData);
+		return true;
+	}
+
+	// Read the MTL files named at the top of the OBJ first, so that their
+	// textures decode while the geometry is parsed.
+	const std::vector<std::string> mtllibs = PeekObjMtllibs(filePath);
+	if (!buildMtllibs(filePath, mtllibs, meshData, textures))
+		return false;
+
 	// Parse the OBJ file.
 	// ---------------------------------------------------------------------------
-    // Add your implementation here (HW1 + read *.MTL).
-	std::ifstream ifs(filePath);
-	std::string line;
+	// Add your implementation here (HW1 + read *.MTL).
+	// The file is memory-mapped and tokenized in place (see objparser.h).
 	std::cout << "open the file\n";
-	if (!ifs.is_open()) {
-		std::cout << "failed to open the object file\n";
-		exit(-1);
+	ObjMeshData data;
+	ObjLoadStats stats;
+	if (!LoadObjFile(filePath, data, &stats, options, progress)) {
+		if (progress != nullptr && progress->IsCancelled())
+			std::cout << "loading cancelled\n";
+		else
+			std::cout << "failed to open the object file\n";
+		return false;
 	}
 	std::cout << "succeed\n";
+	const std::streamsize prec = std::cout.precision();
+	std::cout << "Parsed " << std::fixed << std::setprecision(2) << stats.numBytes / (1024.0 * 1024.0) << " MB in "
+			  << (stats.parseSeconds + stats.buildSeconds) * 1000.0 << " ms (" << stats.GetMBPerSecond() << " MB/s, "
+			  << stats.numThreads << " thread(s))"
+			  << std::defaultfloat << std::setprecision(prec) << std::endl;
 
-	float maxx = -FLT_MAX, maxy = -FLT_MAX, maxz = -FLT_MAX;
-	float minx = FLT_MAX, miny = FLT_MAX, minz = FLT_MAX;
-	std::vector<glm::vec3> positions;
-	std::vector<glm::vec3> normals;
-	std::vector<glm::vec2> uvs;
-	std::unordered_map<VertexPTN, int, hashVertex> record;
-	int next = 0, last = -1;  //will be used when dataType == 'f'
-	SubMesh* ts = new SubMesh;
-
-	while (std::getline(ifs, line)) {
-		std::stringstream iss(line);
-		std::string dataType;
-		iss >> dataType;
-		//std::cout << line << std::endl;
-		///// generate material of vertexes
-		if (dataType == "mtllib") {
-			std::string mtlName;
-			iss >> mtlName;
-			size_t part = filePath.rfind("\\");
-			mtlName = filePath.substr(0, part + 1) + mtlName;
-			if (!buildMtllib(mtlName)) {
-				std::cout << "failed to open the material file\n";
-				exit(-1);
-			}
-		}
-
-		///// generate coordinate data of vertexes
-		if (dataType == "v") { //position
-			float xp, yp, zp;
-			iss >> xp >> yp >> zp;
-
-			// find two corners of bounding box
-			maxx = std::max(maxx, xp), maxy = std::max(maxy, yp), maxz = std::max(maxz, zp);
-			minx = std::min(minx, xp), miny = std::min(miny, yp), minz = std::min(minz, zp);
-			//std::cout << xp << " " << yp << " " << zp << std::endl;
-			positions.push_back({ xp, yp, zp });
-		}
-		else if (dataType == "vt") { //texture
-			float xt, yt;
-			iss >> xt >> yt;
-			//std::cout << xt << " " << yt << " " << std::endl;
-			uvs.push_back({ xt, yt });
-		}
-		else if (dataType == "vn") { //normal
-			float xn, yn, zn;
-			iss >> xn >> yn >> zn;
-			//std::cout << xn << " " << yn << " " << zn << std::endl;
-			normals.push_back({ xn, yn, zn });
-		}
-		else if (dataType == "usemtl") {
-			std::string name;
-			iss >> name;
-			bool duplicate = false;
-
-			for (SubMesh& sm : subMeshes)
-			{
-				if (sm.material->GetName() == name)
-				{
-					duplicate = 1;
-					ts = &sm;
-					break;
-				}
-			}
-			if (!duplicate)
-			{
-				// Initialize
-
-				subMeshes.push_back(SubMesh());
-				ts = &subMeshes[subMeshes.size() - 1];
-				for (PhongMaterial& material : pm)
-				{
-					if (material.GetName() == name)
-					{
-						ts->material = &material;
-						break;
-					}
-				}
-			}
-		}
-		else if (dataType == "f") {  //face
-			std::string vertexInfo;
-			int TriangleVertex_1st = -1;
-
-			int cnt = 0;
-			while (iss >> vertexInfo) {
-				VertexPTN temp;
-				cnt++;
-				int head = 0, offset = 0, id = 0;
-
-				///// make VertexPTN 
-				// get position index
-				while (vertexInfo[head + offset] != '/') offset++;
-				std::string info = vertexInfo.substr(head, offset);
-				std::istringstream ss1(info);
-				//std::cout << info << "/";
-				ss1 >> id;
-				temp.position = positions[id - 1];
-				head += offset + 1, offset = 0;
-				// get texture index
-				while (vertexInfo[head + offset] != '/') offset++;
-				info = vertexInfo.substr(head, offset);
-				std::istringstream ss2(info);
-				//std::cout << info << "/";
-				ss2 >> id;
-				//id2 >> index;
-				temp.texcoord = uvs[id - 1];
-				head += offset + 1;
-				// get normal index
-				info = vertexInfo.substr(head, vertexInfo.size() - head);
-				std::istringstream ss3(info);
-				//std::cout << info <<" ";
-				ss3 >> id;
-				temp.normal = normals[id - 1];
-
-				if (cnt == 1) {
-					if (record.find(temp) != record.end()) {
-						TriangleVertex_1st = record[temp];
-						ts->vertexIndices.push_back(record[temp]);
-					}
-					else {
-						record[temp] = next;
-						TriangleVertex_1st = record[temp];
-						vertices.push_back(temp);
-						numVertices++;
-						ts->vertexIndices.push_back(next);
-						last = next;
-						next++;
-					}
-				}
-				else {
-					if (cnt > 3) { // polygon subvision
-						ts->vertexIndices.push_back(TriangleVertex_1st);
-						ts->vertexIndices.push_back(last);
-						//std::cout << next << " ";
-						numTriangles++;
-					}
-					if (record.find(temp) != record.end()) {
-						ts->vertexIndices.push_back(record[temp]);
-						last = record[temp];
-					}
-					else {
-						record[temp] = next;
-						vertices.push_back(temp);
-						numVertices++;
-						ts->vertexIndices.push_back(next);
-						last = next;
-						next++;
-					}
-				}
-
-			}
-			numTriangles++;
-		}
+	///// generate material of vertexes
+	// Only redone if the OBJ has mtllib lines past the peeked head.
+	if (data.mtllibs != mtllibs) {
+		meshData.materials.clear();
+		meshData.mtlPaths.clear();
+		if (!buildMtllibs(filePath, data.mtllibs, meshData, textures))
+			return false;
 	}
-    // ---------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------
 
 	// Normalize the geometry data.
-	objExtent = { maxx - minx, maxy - miny , maxz - minz };
-	objCenter = { (maxx + minx) / 2.0f, (maxy + miny) / 2.0f, (maxz + minz) / 2.0f };
+	float maxx = data.bboxMax.x, maxy = data.bboxMax.y, maxz = data.bboxMax.z;
+	float minx = data.bboxMin.x, miny = data.bboxMin.y, minz = data.bboxMin.z;
+	meshData.objExtent = { maxx - minx, maxy - miny , maxz - minz };
+	meshData.objCenter = { (maxx + minx) / 2.0f, (maxy + miny) / 2.0f, (maxz + minz) / 2.0f };
 	if (normalized) {
 		// -----------------------------------------------------------------------
 		// Add your normalization code here (HW1).
-		float maximal_extent_axis = std::max(objExtent.x, std::max(objExtent.y, objExtent.z));
-		for (int i = 0; i < vertices.size(); i++) {
-			vertices[i].position[0] = (vertices[i].position[0] - objCenter[0]) / maximal_extent_axis;
-			vertices[i].position[1] = (vertices[i].position[1] - objCenter[1]) / maximal_extent_axis;
-			vertices[i].position[2] = (vertices[i].position[2] - objCenter[2]) / maximal_extent_axis;
-		}
+		NormalizeObjPositions(data.vertices, meshData.objCenter, meshData.objExtent);
 		// -----------------------------------------------------------------------
 	}
-	ifs.close();
-	CreateBuffers();
+	meshData.vertices = std::move(data.vertices);
+	meshData.subMeshes = std::move(data.subMeshes);
+	meshData.numTriangles = data.numTriangles;
+	meshData.normalized = normalized;
+
+	// Simplified levels for drawing from afar; cached with the rest.
+	const Clock::time_point lodStart = Clock::now();
+	if (!BuildMeshLODs(meshData, progress)) {
+		std::cout << "loading cancelled\n";
+		return false;
+	}
+	if (!meshData.lods.empty()) {
+		std::cout << "Built " << meshData.lods.size() << " LODs (down to " << meshData.lods.back().numTriangles
+				  << " triangles) in " << std::chrono::duration<double, std::milli>(Clock::now() - lodStart).count()
+				  << " ms" << std::endl;
+	}
+	// Triangles in vertex cache and overdraw order, every level, and the
+	// vertices in fetch order; cached as well.
+	const Clock::time_point reorderStart = Clock::now();
+	OptimizeMeshOrder(meshData, options.numThreads);
+	std::cout << "Reordered for the vertex caches and overdraw in "
+			  << std::chrono::duration<double, std::milli>(Clock::now() - reorderStart).count() << " ms" << std::endl;
+
+	if (hashed && !WriteMeshCache(filePath, objHash, meshData))
+		std::cerr << "[WARNING] Failed to write mesh cache: " << GetMeshCachePath(filePath) << std::endl;
+	ComputeBounds(meshData);
 	return true;
 }
 
-void TriangleMesh::CreateBuffers()
+void TriangleMesh::ComputeBounds(MeshCacheData& meshData)
 {
-	// Add your code here.
-	// Generate the vertex buffer.
-	glGenBuffers(1, &vboId);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(VertexPTN), &vertices[0], GL_STATIC_DRAW);
-
-	// Generate the index buffer.
-	for (SubMesh& SM : subMeshes) {
-		glGenBuffers(1, &SM.iboId);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, SM.iboId);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * SM.vertexIndices.size(), &(SM.vertexIndices[0]), GL_STATIC_DRAW);
+	const std::vector<VertexPTN>& vertices = meshData.vertices;
+	const size_t numSubMeshes = meshData.subMeshes.size();
+	meshData.subMeshBoxes.assign(numSubMeshes, AABB());
+	meshData.subMeshSpheres.assign(numSubMeshes, BoundingSphere());
+	for (size_t i = 0; i < numSubMeshes; ++i) {
+		const std::vector<unsigned int>& indices = meshData.subMeshes[i].vertexIndices;
+		AABB& box = meshData.subMeshBoxes[i];
+		for (const unsigned int index : indices)
+			box.Expand(vertices[index].position);
+		if (box.IsEmpty())
+			continue;
+		// Centered on the box, but only as large as the farthest vertex.
+		BoundingSphere& sphere = meshData.subMeshSpheres[i];
+		sphere.center = box.GetCenter();
+		float radius2 = 0.0f;
+		for (const unsigned int index : indices) {
+			const glm::vec3 d = vertices[index].position - sphere.center;
+			radius2 = std::max(radius2, glm::dot(d, d));
+		}
+		sphere.radius = std::sqrt(radius2);
 	}
-}	
+}
 
-bool TriangleMesh::buildMtllib(const std::string& mtlpath) {
-	std::cout << mtlpath << std::endl;
-	std::ifstream m(mtlpath);
-	if (!m.is_open()) return false;
-
-	PhongMaterial temp;
-	std::string line;
-	while (getline(m, line)) {
-		std::stringstream s(line);
-		std::string info;
-		s >> info;
-		if (info == "newmtl") {
-			s >> info;
-			if (temp.GetName() != "Default") {
-				pm.push_back(temp);
+// Take over loaded mesh data and create its materials (GL thread).
+void TriangleMesh::SetMeshData(MeshCacheData& meshData, TextureDecoder* textures)
+{
+	CreateMaterials(meshData.materials, textures);
+	vertices = std::move(meshData.vertices);
+	numVertices = (int)vertices.size();
+	numTriangles = meshData.numTriangles;
+	objCenter = meshData.objCenter;
+	objExtent = meshData.objExtent;
+	vertexCacheBefore = meshData.vertexCacheBefore;
+	vertexCacheAfter = meshData.vertexCacheAfter;
+	bounds.Reset();
+	for (size_t i = 0; i < meshData.subMeshes.size(); ++i) {
+		ObjSubMesh& group = meshData.subMeshes[i];
+		subMeshes.push_back(SubMesh());
+		SubMesh& ts = subMeshes.back();
+		if (i < meshData.subMeshBoxes.size()) {
+			ts.bounds = meshData.subMeshBoxes[i];
+			ts.sphere = meshData.subMeshSpheres[i];
+			bounds.Expand(ts.bounds);
+		}
+		for (PhongMaterial& material : pm) {
+			if (material.GetName() == group.materialName) {
+				ts.material = &material;
+				break;
 			}
-			temp.SetName(info);
 		}
-		else if (info == "Ns") {
-			float f;
-			s >> f;
-			temp.SetNs(f);
+		ts.vertexIndices = std::move(group.vertexIndices);
+		for (MeshLODData& lod : meshData.lods)
+			ts.lodIndices.push_back(std::move(lod.subMeshIndices[i]));
+	}
+	lodErrors.assign(1, 0.0f);
+	lodTriangles.assign(1, numTriangles);
+	for (const MeshLODData& lod : meshData.lods) {
+		lodErrors.push_back(lod.error);
+		lodTriangles.push_back(lod.numTriangles);
+	}
+	// The sphere around the SubMesh spheres, centered on the box.
+	sphere = BoundingSphere();
+	if (!bounds.IsEmpty()) {
+		sphere.center = bounds.GetCenter();
+		for (const SubMesh& SM : subMeshes) {
+			if (!SM.bounds.IsEmpty())
+				sphere.radius = std::max(sphere.radius, glm::length(SM.sphere.center - sphere.center) + SM.sphere.radius);
 		}
-		else if (info == "Ka") {
-			glm::vec3 coord;
-			s >> coord.x;
-			s >> coord.y;
-			s >> coord.z;
-			temp.SetKa(coord);
+	}
+	BuildDrawBatches();
+}
+
+void TriangleMesh::CreateBuffers()
+{
+	// Add your code here.
+	CreateVertexBuffer();
+	CreateSubMeshBuffers((size_t)-1);
+}	
+
+void TriangleMesh::CreateVertexBuffer()
+{
+	// Generate the vertex array and buffer; the attribute setup is recorded
+	// once here instead of on every draw.
+	GLStateCache& stateCache = GLStateCache::GetInstance();
+	glGenVertexArrays(1, &vaoId);
+	GL_TRACK_CREATE(GL_RESOURCE_VERTEX_ARRAY, &vaoId, 1, "TriangleMesh");
+	stateCache.BindVertexArray(vaoId);
+	glGenBuffers(1, &vboId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &vboId, 1, "TriangleMesh vertices");
+	stateCache.BindBuffer(GL_ARRAY_BUFFER, vboId);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(VertexPTN), vertices.data(), GL_STATIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, vboId, numVertices * sizeof(VertexPTN));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), 0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), (const GLvoid*)12);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPTN), (const GLvoid*)24);
+	// The shared index buffer, all levels; CreateSubMeshBuffers fills it.
+	size_t numIndices = 0;
+	for (const DrawElementsIndirectCommand& command : drawCommands)
+		numIndices += command.count;
+	glGenBuffers(1, &iboId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &iboId, 1, "TriangleMesh indices");
+	stateCache.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * numIndices, nullptr, GL_STATIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, iboId, sizeof(unsigned int) * numIndices);
+	// The instance attributes, advancing once per instance: a mat4 and a
+	// mat3 take one location per column. Starts with one identity instance.
+	glGenBuffers(1, &instanceBufferId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &instanceBufferId, 1, "TriangleMesh instances");
+	stateCache.BindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+	MeshInstance identity;
+	identity.worldMatrix = glm::mat4x4(1.0f);
+	identity.normalMatrix = glm::mat3x3(1.0f);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(MeshInstance), &identity, GL_DYNAMIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, instanceBufferId, sizeof(MeshInstance));
+	numInstances = 1;
+	instanceCapacity = 1;
+	lodInstanceCounts[0] = 1;
+	for (int i = 0; i < 7; ++i) {
+		glEnableVertexAttribArray(3 + i);
+		glVertexAttribDivisor(3 + i, 1);
+	}
+	SetInstanceAttributes(0);
+	stateCache.BindVertexArray(0);
+	CreateDrawBuffers();
+}
+
+void TriangleMesh::BuildDrawBatches()
+{
+	// Group the SubMeshes by texture, textures in order of first use.
+	std::unordered_map<const ImageTexture*, int> textureOrder;
+	for (const SubMesh& SM : subMeshes) {
+		const ImageTexture* mapKd = (SM.material != nullptr) ? SM.material->GetMapKd() : nullptr;
+		textureOrder.emplace(mapKd, (int)textureOrder.size());
+	}
+	auto getOrder = [&textureOrder](const SubMesh& SM) {
+		return textureOrder[(SM.material != nullptr) ? SM.material->GetMapKd() : nullptr];
+	};
+	std::stable_sort(subMeshes.begin(), subMeshes.end(),
+					 [&getOrder](const SubMesh& a, const SubMesh& b) { return getOrder(a) < getOrder(b); });
+
+	// All SubMeshes at full detail, then all at LOD 1 and so on.
+	drawCommands.clear();
+	drawBatches.clear();
+	unsigned int firstIndex = 0;
+	for (int lod = 0; lod < GetNumLODs(); ++lod) {
+		for (SubMesh& SM : subMeshes) {
+			const std::vector<unsigned int>& indices = (lod == 0) ? SM.vertexIndices : SM.lodIndices[lod - 1];
+			if (lod == 0)
+				SM.firstIndex = firstIndex;
+			DrawElementsIndirectCommand command;
+			command.count = (GLuint)indices.size();
+			command.instanceCount = (lod == 0) ? 1 : 0;
+			command.firstIndex = firstIndex;
+			command.baseVertex = 0;
+			command.baseInstance = 0;
+			drawCommands.push_back(command);
+			firstIndex += command.count;
 		}
-		else if (info == "Kd") {
-			glm::vec3 coord;
-			s >> coord.x;
-			s >> coord.y;
-			s >> coord.z;
-			temp.SetKd(coord);
+	}
+	for (size_t i = 0; i < subMeshes.size(); ++i) {
+		const SubMesh& SM = subMeshes[i];
+		ImageTexture* mapKd = (SM.material != nullptr) ? SM.material->GetMapKd() : nullptr;
+		if (drawBatches.empty() || drawBatches.back().mapKd != mapKd)
+			drawBatches.push_back({ mapKd, (int)i, 0 });
+		drawBatches.back().numDraws++;
+	}
+}
+
+void TriangleMesh::CreateDrawBuffers()
+{
+	// The draw commands.
+	glGenBuffers(1, &indirectBufferId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &indirectBufferId, 1, "TriangleMesh draw commands");
+	const size_t commandBytes = sizeof(DrawElementsIndirectCommand) * drawCommands.size();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indirectBufferId);
+	glBufferData(GL_COPY_WRITE_BUFFER, commandBytes, drawCommands.data(), GL_STATIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, indirectBufferId, commandBytes);
+
+	// The material of each draw; none is black.
+	std::vector<MaterialUniforms> materials(std::max(subMeshes.size(), (size_t)1));
+	for (size_t i = 0; i < subMeshes.size(); ++i) {
+		const PhongMaterial* material = subMeshes[i].material;
+		if (material == nullptr)
+			continue;
+		materials[i].Ka = glm::vec4(material->GetKa(), 0.0f);
+		// The texture supplies the diffuse color.
+		materials[i].Kd = glm::vec4(material->GetMapKd() != nullptr ? glm::vec3(1.0f) : material->GetKd(), 0.0f);
+		materials[i].KsNs = glm::vec4(material->GetKs(), material->GetNs());
+	}
+	const size_t materialBytes = sizeof(MaterialUniforms) * materials.size();
+	glGenBuffers(1, &materialBufferId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &materialBufferId, 1, "TriangleMesh materials");
+	glBindBuffer(GL_COPY_WRITE_BUFFER, materialBufferId);
+	glBufferData(GL_COPY_WRITE_BUFFER, materialBytes, materials.data(), GL_STATIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, materialBufferId, materialBytes);
+	glGenTextures(1, &materialTex);
+	GL_TRACK_CREATE(GL_RESOURCE_TEXTURE, &materialTex, 1, "TriangleMesh materials");
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_BUFFER, materialTex);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, materialBufferId);
+}
+
+bool TriangleMesh::CreateSubMeshBuffers(const size_t maxBytes)
+{
+	// Upload the indices of SubMeshes that are not uploaded yet. At least
+	// one is uploaded per call; stop once maxBytes have been uploaded.
+	size_t uploaded = 0;
+	int numUploaded = 0;
+	for (size_t i = 0; i < subMeshes.size(); ++i) {
+		SubMesh& SM = subMeshes[i];
+		if (SM.uploaded)
+			continue;
+		if (numUploaded > 0 && uploaded >= maxBytes)
+			return false;
+		// Through the copy target: the element binding belongs to whichever
+		// vertex array is bound.
+		glBindBuffer(GL_COPY_WRITE_BUFFER, iboId);
+		for (int lod = 0; lod < GetNumLODs(); ++lod) {
+			const std::vector<unsigned int>& indices = (lod == 0) ? SM.vertexIndices : SM.lodIndices[lod - 1];
+			const DrawElementsIndirectCommand& command = drawCommands[lod * subMeshes.size() + i];
+			const size_t numBytes = sizeof(unsigned int) * indices.size();
+			glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int) * command.firstIndex, numBytes, indices.data());
+			uploaded += numBytes;
 		}
-		else if (info == "Ks") {
-			glm::vec3 coord;
-			s >> coord.x;
-			s >> coord.y;
-			s >> coord.z;
-			temp.SetKs(coord);
+		SM.uploaded = true;
+		numUploaded++;
+	}
+	allUploaded = true;
+	return true;
+}
+
+void TriangleMesh::SetInstances(const MeshInstance* instances, const int count, const int* lodCounts)
+{
+	// Orphan the old contents instead of waiting for draws still reading them.
+	glBindBuffer(GL_COPY_WRITE_BUFFER, instanceBufferId);
+	instanceCapacity = std::max(instanceCapacity, count);
+	glBufferData(GL_COPY_WRITE_BUFFER, sizeof(MeshInstance) * instanceCapacity, nullptr, GL_DYNAMIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, instanceBufferId,
+											  sizeof(MeshInstance) * instanceCapacity);
+	if (count > 0)
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(MeshInstance) * count, instances);
+	bool changed = (count != numInstances);
+	numInstances = count;
+	int firstInstance = 0;
+	for (int lod = 0; lod < GetNumLODs(); ++lod) {
+		const int lodCount = (lodCounts != nullptr) ? lodCounts[lod] : (lod == 0 ? count : 0);
+		changed = changed || lodCount != lodInstanceCounts[lod] || firstInstance != lodFirstInstances[lod];
+		lodInstanceCounts[lod] = lodCount;
+		lodFirstInstances[lod] = firstInstance;
+		firstInstance += lodCount;
+	}
+	if (!changed)
+		return;
+	for (int i = 0; i < GetNumSubMeshes(); ++i)
+		UpdateDrawCommands(i);
+	commandsDirty = true;
+}
+
+void TriangleMesh::UpdateDrawCommands(const int subMesh)
+{
+	// Hidden SubMeshes stay in the multi-draws with no instances.
+	for (int lod = 0; lod < GetNumLODs(); ++lod) {
+		DrawElementsIndirectCommand& command = drawCommands[lod * subMeshes.size() + subMesh];
+		command.instanceCount = subMeshes[subMesh].visible ? (GLuint)lodInstanceCounts[lod] : 0;
+		command.baseInstance = (GLuint)lodFirstInstances[lod];
+	}
+}
+
+void TriangleMesh::SetInstanceAttributes(const int firstInstance)
+{
+	// A mat4 and a mat3 take one location per column.
+	GLStateCache::GetInstance().BindBuffer(GL_ARRAY_BUFFER, instanceBufferId);
+	const size_t base = sizeof(MeshInstance) * firstInstance;
+	for (int i = 0; i < 7; ++i) {
+		const size_t offset = (i < 4) ? sizeof(glm::vec4) * i : sizeof(glm::mat4x4) + sizeof(glm::vec3) * (i - 4);
+		glVertexAttribPointer(3 + i, (i < 4) ? 4 : 3, GL_FLOAT, GL_FALSE, sizeof(MeshInstance),
+							  (const GLvoid*)(base + offset));
+	}
+	attributeFirstInstance = firstInstance;
+}
+
+void TriangleMesh::SetSubMeshVisible(const int subMesh, const bool visible)
+{
+	SubMesh& SM = subMeshes[subMesh];
+	if (SM.visible == visible)
+		return;
+	SM.visible = visible;
+	UpdateDrawCommands(subMesh);
+	commandsDirty = true;
+}
+
+void TriangleMesh::Draw(const PhongShadingDemoShaderProg* shader)
+{
+	if (numInstances == 0)
+		return;
+	GLStateCache& stateCache = GLStateCache::GetInstance();
+	stateCache.SetUniform1i(shader->GetLocMapKd(), 0);
+	stateCache.SetUniform1i(shader->GetLocDrawMaterials(), 1);
+	stateCache.BindTexture(GL_TEXTURE1, GL_TEXTURE_BUFFER, materialTex);
+	stateCache.BindVertexArray(vaoId);
+	const bool multiDraw = allUploaded && CanMultiDraw();
+	if (commandsDirty) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, indirectBufferId);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * drawCommands.size(),
+						drawCommands.data());
+		commandsDirty = false;
+	}
+	if (multiDraw) {
+		stateCache.BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBufferId);
+		// The commands' baseInstance picks each level's instances.
+		if (attributeFirstInstance != 0)
+			SetInstanceAttributes(0);
+	}
+	const int numSubMeshes = GetNumSubMeshes();
+	for (int lod = 0; lod < GetNumLODs(); ++lod) {
+		if (lodInstanceCounts[lod] == 0)
+			continue;
+		// Without base instances, the attributes start at the level's first.
+		if (!multiDraw && attributeFirstInstance != lodFirstInstances[lod])
+			SetInstanceAttributes(lodFirstInstances[lod]);
+		for (const DrawBatch& batch : drawBatches) {
+			ImageTexture* mapKd = (batch.mapKd != nullptr) ? batch.mapKd : ImageTexture::GetDefaultWhite();
+			mapKd->Bind(GL_TEXTURE0);
+			if (multiDraw) {
+				// gl_DrawIDARB counts from 0 in each call.
+				stateCache.SetUniform1i(shader->GetLocDrawBase(), batch.firstDraw);
+				const size_t firstCommand = (size_t)lod * numSubMeshes + batch.firstDraw;
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+											(const GLvoid*)(sizeof(DrawElementsIndirectCommand) * firstCommand),
+											batch.numDraws, 0);
+				continue;
+			}
+			for (int i = batch.firstDraw; i < batch.firstDraw + batch.numDraws; ++i) {
+				const DrawElementsIndirectCommand& command = drawCommands[(size_t)lod * numSubMeshes + i];
+				if (!subMeshes[i].uploaded || command.instanceCount == 0)
+					continue;
+				stateCache.SetUniform1i(shader->GetLocDrawBase(), i);
+				glDrawElementsInstanced(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+										(const GLvoid*)(sizeof(unsigned int) * command.firstIndex),
+										command.instanceCount);
+			}
 		}
-		else if (info == "map_Kd") {
-			std::string imageName;
-			s >> imageName;
-			size_t part = mtlpath.rfind("\\");
-			std::string rp = mtlpath.substr(0, part + 1) + imageName;
-			ImageTexture *im = new ImageTexture(rp);
-			temp.SetMapKd(im);
+	}
+}
+
+bool TriangleMesh::CanMultiDraw()
+{
+	return useMultiDraw && GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_draw_parameters;
+}
+
+bool TriangleMesh::buildMtllib(const std::string& mtlpath, std::vector<ObjMaterial>& materials) {
+	std::cout << mtlpath << std::endl;
+	return LoadMtlFile(mtlpath, materials);
+}
+
+bool TriangleMesh::buildMtllibs(const std::string& objPath, const std::vector<std::string>& mtllibs,
+								MeshCacheData& meshData, TextureDecoder* textures)
+{
+	for (const std::string& mtllib : mtllibs) {
+		size_t part = objPath.rfind("\\");
+		// The MTL file may be stored compressed next to the OBJ file.
+		std::string mtlName = FindInputFile(objPath.substr(0, part + 1) + mtllib);
+		if (!buildMtllib(mtlName, meshData.materials)) {
+			std::cout << "failed to open the material file\n";
+			return false;
 		}
+		meshData.mtlPaths.push_back(mtlName);
 	}
-	pm.push_back(temp);
-	m.close();
+	RequestTextures(meshData.materials, textures);
 	return true;
 }
 
+void TriangleMesh::RequestTextures(const std::vector<ObjMaterial>& materials, TextureDecoder* textures)
+{
+	if (textures == nullptr)
+		return;
+	TextureCache& textureCache = TextureCache::GetInstance();
+	for (const ObjMaterial& m : materials) {
+		if (!m.mapKd.empty() && !textureCache.IsResident(m.mapKd))
+			textures->Request(m.mapKd);
+	}
+}
+
+void TriangleMesh::CreateMaterials(const std::vector<ObjMaterial>& materials, TextureDecoder* textures)
+{
+	// Materials that share an image (e.g. inherited map_Kd, or an atlas used by
+	// several models) share one texture through the TextureCache.
+	TextureCache& textureCache = TextureCache::GetInstance();
+	pm.reserve(pm.size() + materials.size());
+	for (const ObjMaterial& m : materials) {
+		PhongMaterial temp;
+		temp.SetName(m.name);
+		temp.SetKa(m.Ka);
+		temp.SetKd(m.Kd);
+		temp.SetKs(m.Ks);
+		temp.SetNs(m.Ns);
+		if (!m.mapKd.empty())
+			temp.SetMapKd(textureCache.Acquire(m.mapKd, textures));
+		pm.push_back(temp);
+	}
+}
+
 
 // Show model information.
 void TriangleMesh::ShowInfo()
@@ -294,6 +595,15 @@ void TriangleMesh::ShowInfo()
 	std::cout << "# Vertices: " << numVertices << std::endl;
 	std::cout << "# Triangles: " << numTriangles << std::endl;
 	std::cout << "Total " << subMeshes.size() << " subMeshes loaded" << std::endl;
+	std::cout << "Drawn in " << drawBatches.size() << " texture batches, "
+			  << (CanMultiDraw() ? "one multi-draw each" : "one draw per subMesh") << std::endl;
+	std::cout << "Vertex cache (" << VERTEX_CACHE_SIZE << "-entry FIFO): ACMR " << vertexCacheBefore.acmr << " -> "
+			  << vertexCacheAfter.acmr << ", ATVR " << vertexCacheBefore.atvr << " -> " << vertexCacheAfter.atvr
+			  << std::endl;
+	for (int lod = 1; lod < GetNumLODs(); ++lod) {
+		std::cout << "LOD " << lod << ": " << lodTriangles[lod] << " triangles, error " << lodErrors[lod]
+				  << std::endl;
+	}
 	for (unsigned int i = 0; i < subMeshes.size(); ++i) {
 		const SubMesh& g = subMeshes[i];
 		std::cout << "SubMesh " << i << " with material: " << g.material->GetName() << std::endl;
@@ -301,5 +611,7 @@ void TriangleMesh::ShowInfo()
 	}
 	std::cout << "Model Center: " << objCenter.x << ", " << objCenter.y << ", " << objCenter.z << std::endl;
 	std::cout << "Model Extent: " << objExtent.x << " x " << objExtent.y << " x " << objExtent.z << std::endl;
+	TextureCache::GetInstance().ShowStats();
+	TextureResidency::GetInstance().ShowStats();
 }
 
@@ -3,38 +3,66 @@
 
 #include "headers.h"
 #include "material.h"
+#include "objparser.h"
+#include "meshcache.h"
+#include "bounds.h"
+#include "meshsimplify.h"
+#include "vertexcache.h"
 
-// VertexPTN Declarations.
-struct VertexPTN
-{
-	VertexPTN() {
-		position = glm::vec3(0.0f, 0.0f, 0.0f);
-		normal = glm::vec3(0.0f, 1.0f, 0.0f);
-		texcoord = glm::vec2(0.0f, 0.0f);
-	}
-	VertexPTN(glm::vec3 p, glm::vec3 n, glm::vec2 uv) {
-		position = p;
-		normal = n;
-		texcoord = uv;
-	}
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 texcoord;
-	bool operator==(const VertexPTN& v2) const {
-		return (position == v2.position) && (normal == v2.normal) && (texcoord == v2.texcoord);
-	}
-};
+class TextureDecoder;
 
 // SubMesh Declarations.
 struct SubMesh
 {
 	SubMesh() {
 		material = nullptr;
-		iboId = 0;
+		firstIndex = 0;
+		uploaded = false;
+		visible = true;
 	}
 	PhongMaterial* material;
-	GLuint iboId;
+	// Where its indices start in the mesh's shared index buffer.
+	unsigned int firstIndex;
+	// False until CreateSubMeshBuffers has uploaded the indices.
+	bool uploaded;
+	// Drawn by TriangleMesh::Draw (see SetSubMeshVisible).
+	bool visible;
 	std::vector<unsigned int> vertexIndices;
+	// Indices of the simplified levels 1, 2, ... (see TriangleMesh::GetNumLODs).
+	std::vector<std::vector<unsigned int>> lodIndices;
+	// In model space.
+	AABB bounds;
+	BoundingSphere sphere;
+};
+
+// DrawElementsIndirectCommand Declarations.
+// One draw of glMultiDrawElementsIndirect; the layout is fixed by GL.
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// MeshInstance Declarations.
+// One placed copy of a mesh: the per-instance vertex attributes of
+// phong_shading_demo.vs (locations 3-6 and 7-9).
+struct MeshInstance
+{
+	glm::mat4x4 worldMatrix;
+	// Inverse transpose of the upper 3x3 of worldMatrix.
+	glm::mat3x3 normalMatrix;
+};
+
+// DrawBatch Declarations.
+// Consecutive SubMeshes that share a map_Kd texture (nullptr: none).
+struct DrawBatch
+{
+	ImageTexture* mapKd;
+	int firstDraw;
+	int numDraws;
 };
 
 
@@ -48,6 +76,20 @@ public:
 	
 	// Load the model from an *.OBJ file.
 	bool LoadFromFile(const std::string& filePath, const bool normalized = true);
+	// Thread count and serial fallback used by LoadFromFile.
+	void SetLoadOptions(const ObjLoadOptions& options) { loadOptions = options; }
+	// The two halves of LoadFromFile: LoadMeshData does all file work without
+	// touching GL (safe on a worker thread); SetMeshData takes the result over
+	// on the GL thread. Buffers are then made with CreateBuffers, or
+	// incrementally with CreateVertexBuffer + CreateSubMeshBuffers.
+	// Given a TextureDecoder, LoadMeshData starts decoding the map_Kd images
+	// as soon as the MTL files are read and SetMeshData uploads them.
+	// SetMeshData orders the SubMeshes by texture, so that each texture is
+	// bound once per Draw.
+	static bool LoadMeshData(const std::string& filePath, const bool normalized, const ObjLoadOptions& options,
+							 MeshCacheData& meshData, ObjLoadProgress* progress = nullptr,
+							 TextureDecoder* textures = nullptr);
+	void SetMeshData(MeshCacheData& meshData, TextureDecoder* textures = nullptr);
 	
 	// Show model information.
 	void ShowInfo();
@@ -55,7 +97,41 @@ public:
 	// -------------------------------------------------------
 	// Feel free to add your methods or data here.
 	void CreateBuffers();
+	// Also allocates the shared index buffer and uploads the draw commands
+	// and materials.
+	void CreateVertexBuffer();
+	// Upload pending SubMesh indices, about maxBytes per call. Returns true
+	// once all are uploaded; SubMeshes not uploaded yet are not drawn.
+	bool CreateSubMeshBuffers(const size_t maxBytes);
 	GLuint Get_vbo() const { return vboId; }
+	// Vertex layout of vboId with the shared index buffer.
+	GLuint Get_vao() const { return vaoId; }
+	// Draw with shader (already in use): one glMultiDrawElementsIndirect per
+	// DrawBatch once all SubMeshes are uploaded and GL supports it, else one
+	// draw per SubMesh; each draws all instances.
+	void Draw(const PhongShadingDemoShaderProg* shader);
+
+	// Replace the instances drawn by Draw, each SubMesh once per instance
+	// (initially one, untransformed). Needs CreateVertexBuffer first. With
+	// lodCounts (GetNumLODs entries), the first lodCounts[0] instances are
+	// drawn at full detail, the next lodCounts[1] at LOD 1 and so on;
+	// without, all are drawn at full detail.
+	void SetInstances(const MeshInstance* instances, const int count, const int* lodCounts = nullptr);
+	int GetNumInstances() const { return numInstances; }
+	// Levels of detail, 0 being the full mesh; made by LoadMeshData for
+	// large meshes (see meshsimplify.h).
+	int GetNumLODs() const { return (int)lodErrors.size(); }
+	// Geometric error of a level in model units, 0 for the full mesh.
+	float GetLODError(const int lod) const { return lodErrors[lod]; }
+	int GetLODTriangles(const int lod) const { return lodTriangles[lod]; }
+	// Hide SubMeshes that no instance shows (e.g. outside the view); all are
+	// visible initially.
+	void SetSubMeshVisible(const int subMesh, const bool visible);
+
+	// Multi-draw needs GL_ARB_multi_draw_indirect and, for gl_DrawIDARB,
+	// GL_ARB_shader_draw_parameters. On by default where supported.
+	static void SetUseMultiDraw(const bool enable) { useMultiDraw = enable; }
+	static bool CanMultiDraw();
 	// -------------------------------------------------------
 
 	int GetNumVertices() const { return numVertices; }
@@ -64,16 +140,61 @@ public:
 
 	glm::vec3 GetObjCenter() const { return objCenter; }
 	glm::vec3 GetObjExtent() const { return objExtent; }
+	// Bounds of all SubMeshes, in model space.
+	const AABB& GetBounds() const { return bounds; }
+	const BoundingSphere& GetBoundingSphere() const { return sphere; }
 	std::vector<SubMesh>& GetsubMeshes() { return subMeshes; }
 
 private:
 	// -------------------------------------------------------
 	// Feel free to add your methods or data here.
-	bool buildMtllib(const std::string& mtlpath);
+	static bool buildMtllib(const std::string& mtlpath, std::vector<ObjMaterial>& materials);
+	static bool buildMtllibs(const std::string& objPath, const std::vector<std::string>& mtllibs,
+							 MeshCacheData& meshData, TextureDecoder* textures);
+	static void RequestTextures(const std::vector<ObjMaterial>& materials, TextureDecoder* textures);
+	void CreateMaterials(const std::vector<ObjMaterial>& materials, TextureDecoder* textures);
+	// Fill meshData.subMeshBoxes and subMeshSpheres.
+	static void ComputeBounds(MeshCacheData& meshData);
+	// Group the SubMeshes by texture and build drawCommands and drawBatches.
+	void BuildDrawBatches();
+	void CreateDrawBuffers();
+	// Instance counts of the commands of a SubMesh, after it or the
+	// instances changed.
+	void UpdateDrawCommands(const int subMesh);
+	// Point the instance attributes at instance firstInstance.
+	void SetInstanceAttributes(const int firstInstance);
 	// -------------------------------------------------------
 
 	// TriangleMesh Private Data.
+	GLuint vaoId;
 	GLuint vboId;
+	// Indices of all SubMeshes, one after the other.
+	GLuint iboId;
+	// drawCommands, and the MaterialUniforms of each draw as a buffer
+	// texture read by the shader at drawBase + gl_DrawIDARB.
+	GLuint indirectBufferId;
+	GLuint materialBufferId;
+	GLuint materialTex;
+	// MeshInstances, room for instanceCapacity.
+	GLuint instanceBufferId;
+	int numInstances;
+	int instanceCapacity;
+	// Instances of each level, one range after the other.
+	int lodInstanceCounts[MAX_MESH_LODS];
+	int lodFirstInstances[MAX_MESH_LODS];
+	// Where the instance attributes start (per-draw fallback only).
+	int attributeFirstInstance;
+	std::vector<float> lodErrors;
+	std::vector<int> lodTriangles;
+	// Full detail in file order and as drawn.
+	VertexCacheStats vertexCacheBefore;
+	VertexCacheStats vertexCacheAfter;
+	// Draw lod * GetNumSubMeshes() + i is SubMesh i at that level.
+	std::vector<DrawElementsIndirectCommand> drawCommands;
+	std::vector<DrawBatch> drawBatches;
+	// drawCommands changed since they were uploaded.
+	bool commandsDirty;
+	bool allUploaded;
 	
 	std::vector<VertexPTN> vertices;
 	// For supporting multiple materials per object, move to SubMesh.
@@ -85,16 +206,10 @@ private:
 	int numTriangles;
 	glm::vec3 objCenter;
 	glm::vec3 objExtent;
-};
-
-//write a special hash function to hash VertexPTN in unordered_map; 
-struct hashVertex
-{
-	size_t operator()(const VertexPTN& v) const {
-		return std::hash<float>() (v.position[0]) ^ std::hash<float>() (v.position[1]) ^ std::hash<float>() (v.position[2])
-			^ std::hash<float>() (v.normal[0]) ^ std::hash<float>() (v.normal[1]) ^ std::hash<float>() (v.normal[2])
-			^ std::hash<float>() (v.texcoord[0]) ^ std::hash<float>() (v.texcoord[1]);
-	}
+	AABB bounds;
+	BoundingSphere sphere;
+	ObjLoadOptions loadOptions;
+	static bool useMultiDraw;
 };
 
 #endif
@@ -0,0 +1,75 @@
+#include "uniformblocks.h"
+#include "glresourcetracker.h"
+#include "glstatecache.h"
+
+// C++ STL headers.
+#include <cstring>
+
+UniformBuffer::UniformBuffer()
+{
+	bufferId = 0;
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	Release();
+}
+
+void UniformBuffer::Create(const size_t numBytes, const void* data, const std::string& owner)
+{
+	Release();
+	contents.assign(numBytes, 0);
+	if (data != nullptr)
+		memcpy(contents.data(), data, numBytes);
+	glGenBuffers(1, &bufferId);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, &bufferId, 1, owner);
+	// Through the copy target, as no uniform binding point is meant.
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+	glBufferData(GL_COPY_WRITE_BUFFER, numBytes, contents.data(), data != nullptr ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, bufferId, numBytes);
+}
+
+void UniformBuffer::Release()
+{
+	if (bufferId == 0)
+		return;
+	GLResourceTracker::GetInstance().TrackDelete(GL_RESOURCE_BUFFER, &bufferId, 1);
+	glDeleteBuffers(1, &bufferId);
+	bufferId = 0;
+	contents.clear();
+}
+
+bool UniformBuffer::Update(const size_t offset, const void* data, const size_t numBytes)
+{
+	if (bufferId == 0 || offset + numBytes > contents.size())
+		return false;
+	if (memcmp(&contents[offset], data, numBytes) == 0)
+		return false;
+	memcpy(&contents[offset], data, numBytes);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, numBytes, data);
+	return true;
+}
+
+void UniformBuffer::Bind(const GLuint binding, const size_t offset, const size_t numBytes) const
+{
+	GLStateCache::GetInstance().BindBufferRange(GL_UNIFORM_BUFFER, binding, bufferId, offset, numBytes);
+}
+
+size_t UniformBuffer::GetOffsetAlignment()
+{
+	static GLint alignment = 0;
+	if (alignment <= 0) {
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		// The largest value GL allows.
+		if (alignment <= 0)
+			alignment = 256;
+	}
+	return (size_t)alignment;
+}
+
+size_t UniformBuffer::AlignOffset(const size_t offset)
+{
+	const size_t alignment = GetOffsetAlignment();
+	return (offset + alignment - 1) / alignment * alignment;
+}
@@ -0,0 +1,86 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include "headers.h"
+
+// C++ STL headers.
+#include <cstring>
+
+// Binding points of the uniform blocks in shaders/phong_shading_demo.*.
+enum UniformBlockBinding
+{
+	UNIFORM_BLOCK_FRAME = 0
+};
+
+// FrameUniforms Declarations.
+// Camera and light data, set once per frame. Mirrors the std140 layout of
+// the FrameData block: every vec3 takes a vec4, a mat3 three vec4 columns.
+struct FrameUniforms
+{
+	FrameUniforms() { memset(this, 0, sizeof(FrameUniforms)); }
+
+	glm::vec4 cameraPos;
+	glm::vec4 dirLightDir;
+	glm::vec4 dirLightRadiance;
+	glm::vec4 pointLightPos;
+	glm::vec4 pointLightIntensity;
+	glm::vec4 spotLightPos;
+	glm::vec4 spotLightIntensity;
+	// Normalized.
+	glm::vec4 spotLightDir;
+	// x = cos(cutoff), y = cos(total width).
+	glm::vec4 spotLightCos;
+	// Ambient light as SH (see sphericalharmonics.h), in the frame of the
+	// skybox panorama; ambientRotation takes world normals into it.
+	glm::vec4 ambientSH[9];
+	glm::vec4 ambientRotation[3];
+};
+
+// MaterialUniforms Declarations.
+// The material of one draw: three RGBA32F texels of the drawMaterials
+// buffer texture in phong_shading_demo.fs.
+struct MaterialUniforms
+{
+	MaterialUniforms() { memset(this, 0, sizeof(MaterialUniforms)); }
+
+	glm::vec4 Ka;
+	// Kd, or white when a map_Kd texture supplies the color.
+	glm::vec4 Kd;
+	// w = Ns.
+	glm::vec4 KsNs;
+};
+
+// UniformBuffer Declarations.
+// A GL uniform buffer with a copy of its contents, so that uploading data
+// it already holds costs nothing.
+class UniformBuffer
+{
+public:
+	// UniformBuffer Public Methods.
+	UniformBuffer();
+	~UniformBuffer();
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	// Allocate numBytes, filled from data if given.
+	void Create(const size_t numBytes, const void* data, const std::string& owner);
+	void Release();
+	// Upload numBytes at offset unless the buffer holds them already.
+	// Returns true if anything was uploaded.
+	bool Update(const size_t offset, const void* data, const size_t numBytes);
+	// Bind numBytes from offset to a UniformBlockBinding.
+	void Bind(const GLuint binding, const size_t offset, const size_t numBytes) const;
+
+	GLuint GetId() const { return bufferId; }
+	size_t GetSize() const { return contents.size(); }
+	// Offsets passed to Bind must be multiples of this.
+	static size_t GetOffsetAlignment();
+	static size_t AlignOffset(const size_t offset);
+
+private:
+	// UniformBuffer Private Data.
+	GLuint bufferId;
+	std::vector<unsigned char> contents;
+};
+
+#endif
@@ -0,0 +1,417 @@
+#include "vertexcache.h"
+#include "meshcache.h"
+
+// C++ STL headers.
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// VertexCacheScratch Declarations.
+// Working arrays of one thread, reused from list to list.
+struct VertexCacheScratch
+{
+	// Mesh vertex -> list vertex, all -1 between lists.
+	std::vector<int> localIndices;
+	// List vertex -> mesh vertex, and the list in list vertices.
+	std::vector<unsigned int> meshIndices;
+	std::vector<unsigned int> local;
+	// Triangles around each list vertex, and how many are not emitted yet.
+	std::vector<int> adjacencyOffsets;
+	std::vector<int> adjacency;
+	std::vector<int> liveCounts;
+	// Time stamp of each vertex's last cache miss.
+	std::vector<int> cacheTimes;
+	std::vector<char> emitted;
+	std::vector<int> deadEnds;
+	std::vector<int> candidates;
+	std::vector<unsigned int> output;
+	// Overdraw clusters: first triangles, and (sort key, cluster) pairs.
+	std::vector<int> hardBoundaries;
+	std::vector<int> clusters;
+	std::vector<std::pair<float, int>> clusterKeys;
+	std::vector<unsigned int> sorted;
+};
+
+// Renumber the vertices of indices 0, 1, ... in order of first use into
+// scratch.local. Returns the number of distinct vertices.
+size_t ToLocal(const std::vector<unsigned int>& indices, const size_t numVertices, VertexCacheScratch& scratch)
+{
+	if (scratch.localIndices.size() < numVertices)
+		scratch.localIndices.resize(numVertices, -1);
+	scratch.meshIndices.clear();
+	scratch.local.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		int& localIndex = scratch.localIndices[indices[i]];
+		if (localIndex < 0) {
+			localIndex = (int)scratch.meshIndices.size();
+			scratch.meshIndices.push_back(indices[i]);
+		}
+		scratch.local[i] = (unsigned int)localIndex;
+	}
+	for (const unsigned int index : scratch.meshIndices)
+		scratch.localIndices[index] = -1;
+	return scratch.meshIndices.size();
+}
+
+// A vertex is in the FIFO cache if fewer than VERTEX_CACHE_SIZE misses came
+// after its own.
+bool IsCached(const int time, const int cacheTime)
+{
+	return time - cacheTime <= VERTEX_CACHE_SIZE;
+}
+
+// Misses of one triangle, updating the cache.
+int CountTriangleMisses(const unsigned int* tri, int& time, std::vector<int>& cacheTimes)
+{
+	int misses = 0;
+	for (int k = 0; k < 3; ++k) {
+		if (!IsCached(time, cacheTimes[tri[k]])) {
+			cacheTimes[tri[k]] = time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+size_t CountCacheMisses(const std::vector<unsigned int>& local, const size_t numLocal, VertexCacheScratch& scratch)
+{
+	scratch.cacheTimes.assign(numLocal, 0);
+	int time = VERTEX_CACHE_SIZE + 1;
+	for (const unsigned int v : local) {
+		if (!IsCached(time, scratch.cacheTimes[v]))
+			scratch.cacheTimes[v] = time++;
+	}
+	return (size_t)(time - (VERTEX_CACHE_SIZE + 1));
+}
+
+// The next vertex to fan around when the last fan left no candidate: the
+// latest vertex emitted that still has triangles, else the first one in
+// list order.
+int SkipDeadEnd(VertexCacheScratch& scratch, size_t& cursor)
+{
+	while (!scratch.deadEnds.empty()) {
+		const int v = scratch.deadEnds.back();
+		scratch.deadEnds.pop_back();
+		if (scratch.liveCounts[v] > 0)
+			return v;
+	}
+	for (; cursor < scratch.liveCounts.size(); ++cursor) {
+		if (scratch.liveCounts[cursor] > 0)
+			return (int)cursor;
+	}
+	return -1;
+}
+
+// Tipsify scratch.local (numLocal vertices) into scratch.output.
+void Tipsify(const size_t numLocal, VertexCacheScratch& scratch)
+{
+	const std::vector<unsigned int>& local = scratch.local;
+	const size_t numTris = local.size() / 3;
+	std::vector<int>& liveCounts = scratch.liveCounts;
+	std::vector<int>& offsets = scratch.adjacencyOffsets;
+	liveCounts.assign(numLocal, 0);
+	for (size_t i = 0; i < 3 * numTris; ++i)
+		liveCounts[local[i]]++;
+	offsets.resize(numLocal + 1);
+	offsets[0] = 0;
+	for (size_t v = 0; v < numLocal; ++v)
+		offsets[v + 1] = offsets[v] + liveCounts[v];
+	// cacheTimes serves as the fill cursor here.
+	scratch.adjacency.resize(3 * numTris);
+	scratch.cacheTimes.assign(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < 3 * numTris; ++i)
+		scratch.adjacency[scratch.cacheTimes[local[i]]++] = (int)(i / 3);
+
+	scratch.cacheTimes.assign(numLocal, 0);
+	scratch.emitted.assign(numTris, 0);
+	scratch.deadEnds.clear();
+	scratch.output.clear();
+	int time = VERTEX_CACHE_SIZE + 1;
+	size_t cursor = 0;
+	int fan = (numTris > 0) ? (int)local[0] : -1;
+	while (fan >= 0) {
+		// Emit the remaining triangles around fan.
+		scratch.candidates.clear();
+		for (int a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+			const int t = scratch.adjacency[a];
+			if (scratch.emitted[t])
+				continue;
+			scratch.emitted[t] = 1;
+			for (int k = 0; k < 3; ++k) {
+				const int v = (int)local[3 * t + k];
+				scratch.output.push_back((unsigned int)v);
+				scratch.deadEnds.push_back(v);
+				scratch.candidates.push_back(v);
+				liveCounts[v]--;
+				if (!IsCached(time, scratch.cacheTimes[v]))
+					scratch.cacheTimes[v] = time++;
+			}
+		}
+		// Of the vertices just used, the one longest in the cache that will
+		// still be in it after fanning its own triangles (each adding up to
+		// two misses); others only if none will.
+		int next = -1;
+		int bestPriority = -1;
+		for (const int v : scratch.candidates) {
+			if (liveCounts[v] <= 0)
+				continue;
+			const int age = time - scratch.cacheTimes[v];
+			const int priority = (age + 2 * liveCounts[v] <= VERTEX_CACHE_SIZE) ? age : 0;
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+		fan = (next >= 0) ? next : SkipDeadEnd(scratch, cursor);
+	}
+}
+
+// Cut scratch.output (cache order, numLocal vertices) into clusters and sort
+// them by how far they face away from center.
+void SortClusters(const size_t numLocal, const std::vector<VertexPTN>& vertices, const glm::vec3& center,
+				  VertexCacheScratch& scratch)
+{
+	const std::vector<unsigned int>& order = scratch.output;
+	const int numTris = (int)(order.size() / 3);
+	if (numTris == 0)
+		return;
+	std::vector<int>& cacheTimes = scratch.cacheTimes;
+	// Hard boundaries: triangles missing on all their vertices, where the
+	// order restarted.
+	scratch.hardBoundaries.clear();
+	cacheTimes.assign(numLocal, 0);
+	int time = VERTEX_CACHE_SIZE + 1;
+	for (int t = 0; t < numTris; ++t) {
+		if (CountTriangleMisses(&order[3 * t], time, cacheTimes) == 3 || t == 0)
+			scratch.hardBoundaries.push_back(t);
+	}
+	scratch.hardBoundaries.push_back(numTris);
+
+	// Soft boundaries: within each run, a cluster ends as soon as its own
+	// ACMR (on a flushed cache) comes within the threshold of the run's; the
+	// incomplete last one joins the one before.
+	std::vector<int>& clusters = scratch.clusters;
+	clusters.clear();
+	for (size_t h = 0; h + 1 < scratch.hardBoundaries.size(); ++h) {
+		const int start = scratch.hardBoundaries[h], end = scratch.hardBoundaries[h + 1];
+		time += VERTEX_CACHE_SIZE + 1;
+		int runMisses = 0;
+		for (int t = start; t < end; ++t)
+			runMisses += CountTriangleMisses(&order[3 * t], time, cacheTimes);
+		const float threshold = OVERDRAW_ACMR_THRESHOLD * (float)runMisses / (float)(end - start);
+		clusters.push_back(start);
+		time += VERTEX_CACHE_SIZE + 1;
+		int misses = 0, count = 0;
+		for (int t = start; t < end; ++t) {
+			misses += CountTriangleMisses(&order[3 * t], time, cacheTimes);
+			count++;
+			if ((float)misses <= threshold * (float)count) {
+				clusters.push_back(t + 1);
+				time += VERTEX_CACHE_SIZE + 1;
+				misses = 0;
+				count = 0;
+			}
+		}
+		if (clusters.back() != start)
+			clusters.pop_back();
+	}
+	clusters.push_back(numTris);
+
+	// Outward-facing clusters far from the center first.
+	const int numClusters = (int)clusters.size() - 1;
+	scratch.clusterKeys.resize(numClusters);
+	for (int c = 0; c < numClusters; ++c) {
+		glm::vec3 centroid(0.0f, 0.0f, 0.0f), normal(0.0f, 0.0f, 0.0f);
+		float area = 0.0f;
+		for (int t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const glm::vec3& p0 = vertices[scratch.meshIndices[order[3 * t]]].position;
+			const glm::vec3& p1 = vertices[scratch.meshIndices[order[3 * t + 1]]].position;
+			const glm::vec3& p2 = vertices[scratch.meshIndices[order[3 * t + 2]]].position;
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float a = glm::length(n);
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+		const float length = glm::length(normal);
+		float key = 0.0f;
+		if (area > 0.0f && length > 0.0f)
+			key = glm::dot(centroid / area - center, normal / length);
+		scratch.clusterKeys[c] = std::make_pair(key, c);
+	}
+	std::stable_sort(scratch.clusterKeys.begin(), scratch.clusterKeys.end(),
+					 [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+	scratch.sorted.clear();
+	for (const std::pair<float, int>& clusterKey : scratch.clusterKeys) {
+		const int c = clusterKey.second;
+		scratch.sorted.insert(scratch.sorted.end(), order.begin() + 3 * clusters[c], order.begin() + 3 * clusters[c + 1]);
+	}
+	scratch.output.swap(scratch.sorted);
+}
+
+// The area-weighted center of the triangles of the lists.
+glm::vec3 GetCentroid(const std::vector<std::vector<unsigned int>*>& lists, const std::vector<VertexPTN>& vertices)
+{
+	glm::dvec3 centroid(0.0, 0.0, 0.0);
+	double area = 0.0;
+	for (const std::vector<unsigned int>* list : lists) {
+		for (size_t i = 0; i + 2 < list->size(); i += 3) {
+			const glm::vec3& p0 = vertices[(*list)[i]].position;
+			const glm::vec3& p1 = vertices[(*list)[i + 1]].position;
+			const glm::vec3& p2 = vertices[(*list)[i + 2]].position;
+			const double a = glm::length(glm::cross(p1 - p0, p2 - p0));
+			centroid += glm::dvec3(p0 + p1 + p2) * (a / 3.0);
+			area += a;
+		}
+	}
+	return (area > 0.0) ? glm::vec3(centroid / area) : glm::vec3(0.0f, 0.0f, 0.0f);
+}
+
+// Renumber vertices in order of first use by the lists, unused ones last.
+void RenumberVertices(std::vector<VertexPTN>& vertices, const std::vector<std::vector<unsigned int>*>& lists)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	unsigned int next = 0;
+	for (const std::vector<unsigned int>* list : lists) {
+		for (const unsigned int index : *list) {
+			if (remap[index] == unused)
+				remap[index] = next++;
+		}
+	}
+	for (unsigned int& index : remap) {
+		if (index == unused)
+			index = next++;
+	}
+	std::vector<VertexPTN> renumbered(vertices.size());
+	for (size_t v = 0; v < vertices.size(); ++v)
+		renumbered[remap[v]] = vertices[v];
+	vertices.swap(renumbered);
+	for (std::vector<unsigned int>* list : lists) {
+		for (unsigned int& index : *list)
+			index = remap[index];
+	}
+}
+
+// Reorder indices in place for the cache and, with vertices, for overdraw
+// around center; the FIFO misses before and after are added to the counts.
+void OptimizeList(std::vector<unsigned int>& indices, const std::vector<VertexPTN>& vertices, const glm::vec3& center,
+				  VertexCacheScratch& scratch, size_t& missesBefore, size_t& missesAfter, size_t& numDistinct)
+{
+	const size_t numLocal = ToLocal(indices, vertices.size(), scratch);
+	numDistinct += numLocal;
+	missesBefore += CountCacheMisses(scratch.local, numLocal, scratch);
+	Tipsify(numLocal, scratch);
+	SortClusters(numLocal, vertices, center, scratch);
+	missesAfter += CountCacheMisses(scratch.output, numLocal, scratch);
+	for (size_t i = 0; i < scratch.output.size(); ++i)
+		indices[i] = scratch.meshIndices[scratch.output[i]];
+}
+
+VertexCacheStats MakeStats(const size_t misses, const size_t numIndices, const size_t numDistinct)
+{
+	VertexCacheStats stats;
+	if (numIndices >= 3)
+		stats.acmr = (float)((double)misses / (double)(numIndices / 3));
+	if (numDistinct > 0)
+		stats.atvr = (float)((double)misses / (double)numDistinct);
+	return stats;
+}
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, const size_t numVertices)
+{
+	VertexCacheScratch scratch;
+	const size_t numLocal = ToLocal(indices, numVertices, scratch);
+	return MakeStats(CountCacheMisses(scratch.local, numLocal, scratch), indices.size(), numLocal);
+}
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, const size_t numVertices)
+{
+	VertexCacheScratch scratch;
+	const size_t numLocal = ToLocal(indices, numVertices, scratch);
+	Tipsify(numLocal, scratch);
+	for (size_t i = 0; i < scratch.output.size(); ++i)
+		indices[i] = scratch.meshIndices[scratch.output[i]];
+}
+
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<VertexPTN>& vertices)
+{
+	VertexCacheScratch scratch;
+	const size_t numLocal = ToLocal(indices, vertices.size(), scratch);
+	scratch.output = scratch.local;
+	std::vector<std::vector<unsigned int>*> lists(1, &indices);
+	SortClusters(numLocal, vertices, GetCentroid(lists, vertices), scratch);
+	for (size_t i = 0; i < scratch.output.size(); ++i)
+		indices[i] = scratch.meshIndices[scratch.output[i]];
+}
+
+void OptimizeVertexFetch(std::vector<VertexPTN>& vertices, std::vector<unsigned int>& indices)
+{
+	RenumberVertices(vertices, std::vector<std::vector<unsigned int>*>(1, &indices));
+}
+
+void OptimizeMeshOrder(MeshCacheData& meshData, const int numThreads)
+{
+	// One job per index list, largest first so that the threads end together.
+	// Full detail comes first in lists, so jobs below numSubMeshes are its.
+	const size_t numSubMeshes = meshData.subMeshes.size();
+	std::vector<std::vector<unsigned int>*> lists;
+	size_t numIndices = 0;
+	for (ObjSubMesh& subMesh : meshData.subMeshes) {
+		lists.push_back(&subMesh.vertexIndices);
+		numIndices += subMesh.vertexIndices.size();
+	}
+	for (MeshLODData& lod : meshData.lods) {
+		for (std::vector<unsigned int>& indices : lod.subMeshIndices)
+			lists.push_back(&indices);
+	}
+	std::vector<int> jobs(lists.size());
+	for (size_t i = 0; i < jobs.size(); ++i)
+		jobs[i] = (int)i;
+	std::stable_sort(jobs.begin(), jobs.end(), [&lists](const int a, const int b) {
+		return lists[a]->size() > lists[b]->size();
+	});
+
+	// Small meshes stay on one thread.
+	const int numJobs = (int)jobs.size();
+	int threads = (numThreads > 0) ? numThreads : (int)std::thread::hardware_concurrency();
+	if (numIndices < ((size_t)1 << 18))
+		threads = 1;
+	threads = std::max(1, std::min(threads, numJobs));
+
+	// Overdraw clusters face away from the center of the full mesh.
+	const std::vector<std::vector<unsigned int>*> fullLists(lists.begin(), lists.begin() + numSubMeshes);
+	const glm::vec3 center = GetCentroid(fullLists, meshData.vertices);
+	std::vector<size_t> missesBefore(lists.size(), 0), missesAfter(lists.size(), 0), numDistinct(lists.size(), 0);
+	std::atomic<int> nextJob(0);
+	const auto worker = [&]() {
+		VertexCacheScratch scratch;
+		for (int job = nextJob++; job < numJobs; job = nextJob++) {
+			const int list = jobs[job];
+			OptimizeList(*lists[list], meshData.vertices, center, scratch, missesBefore[list], missesAfter[list],
+						 numDistinct[list]);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; ++t)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread& th : pool)
+		th.join();
+
+	size_t totalBefore = 0, totalAfter = 0, totalDistinct = 0;
+	for (size_t i = 0; i < numSubMeshes; ++i) {
+		totalBefore += missesBefore[i];
+		totalAfter += missesAfter[i];
+		totalDistinct += numDistinct[i];
+	}
+	meshData.vertexCacheBefore = MakeStats(totalBefore, numIndices, totalDistinct);
+	meshData.vertexCacheAfter = MakeStats(totalAfter, numIndices, totalDistinct);
+
+	// Full detail first; the coarser levels mostly reuse its vertices.
+	RenumberVertices(meshData.vertices, lists);
+}
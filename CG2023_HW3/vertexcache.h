@@ -0,0 +1,69 @@
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include "objparser.h"
+
+// C++ STL headers.
+#include <cstddef>
+#include <vector>
+
+struct MeshCacheData;
+
+// Mesh reordering for the GPU's vertex caches and for overdraw.
+// Triangles are reordered with Tipsify (Sander, Nehab and Barczak): fanning
+// around one vertex at a time, so that consecutive triangles share vertices.
+// The next fan is around the vertex just used that has been in the cache
+// longest and will still be in it after its own triangles are emitted
+// (age + 2 * triangles left <= VERTEX_CACHE_SIZE); if none will, around any
+// vertex just used that has triangles left, and at a dead end around the
+// latest vertex emitted with triangles left, else the next in list order.
+// The order is then cut into clusters where it restarts or where the cache
+// hit rate allows, and the clusters are sorted outside in (facing away from
+// the mesh center first) so that, from most viewpoints, near surfaces are
+// drawn before the ones they hide. Finally the vertices are renumbered in
+// order of first use so that fetching them streams through the vertex
+// buffer; the same numbering is applied to every SubMesh and LOD list.
+// Each triangle keeps its vertex order (and so its winding). No GL calls,
+// so it is safe on any thread.
+
+// Entries of the FIFO cache the order is made for and measured with.
+const int VERTEX_CACHE_SIZE = 16;
+// Overdraw clusters may end once their ACMR is within this factor of the
+// run they are cut from; larger values give more, smaller clusters (less
+// overdraw) for more vertex transforms.
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+// VertexCacheStats Declarations.
+// Vertices transformed per triangle (ACMR: 0.5 at best for a large regular
+// mesh, 3 at worst) and per distinct vertex (ATVR: 1 at best), with each
+// index list starting on an empty cache. Zero when nothing was measured.
+struct VertexCacheStats
+{
+	VertexCacheStats() { acmr = 0.0f; atvr = 0.0f; }
+
+	float acmr;
+	float atvr;
+};
+
+// Measure indices (triangles into numVertices vertices) in the cache.
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, const size_t numVertices);
+
+// Reorder the triangles of indices for the cache.
+void OptimizeVertexCache(std::vector<unsigned int>& indices, const size_t numVertices);
+
+// Reorder the clusters of indices, already in cache order, for less
+// overdraw, sorting them around the center of the triangles.
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<VertexPTN>& vertices);
+
+// Renumber vertices in order of first use by indices and update indices;
+// unused vertices are moved last.
+void OptimizeVertexFetch(std::vector<VertexPTN>& vertices, std::vector<unsigned int>& indices);
+
+// All three passes over meshData: every SubMesh and LOD index list is
+// reordered, the lists split across numThreads threads (0 = one per
+// hardware thread), then the vertices are renumbered by the full-detail
+// lists. The full-detail statistics before and after are recorded in
+// meshData.
+void OptimizeMeshOrder(MeshCacheData& meshData, const int numThreads);
+
+#endif
@@ -0,0 +1,576 @@
+#include "virtualtexture.h"
+#include "glresourcetracker.h"
+#include "glstatecache.h"
+
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+namespace {
+
+// The page cache holds up to CACHE_PAGES_PER_SIDE^2 pages (256 pages of
+// 132x132 texels, 13 MB as RGB).
+const int CACHE_PAGES_PER_SIDE = 16;
+// Limits per frame, to keep the frame time steady while streaming.
+const int MAX_UPLOADS_PER_FRAME = 8;
+const size_t MAX_REQUESTS = 256;
+// Pages read ahead by the loader thread and not uploaded yet.
+const size_t MAX_LOADED_PAGES = 64;
+// The feedback target is 1/FEEDBACK_SCALE of the viewport on each side.
+const int FEEDBACK_SCALE = 8;
+// The shaders have room for this many levels, and the feedback pass writes
+// tile coordinates in 10 bits (images up to 128K texels wide).
+const int MAX_LEVELS = 16;
+const int MAX_TILES_PER_SIDE = 1024;
+
+} // namespace
+
+int VirtualTexture::streamingSize = 8192;
+
+VirtualTexture::VirtualTexture()
+{
+	pageCacheTex = 0;
+	indirectionTex = 0;
+	pagesPerSide = 0;
+	indirectionWidth = 0;
+	indirectionHeight = 0;
+	indirectionDirty = false;
+	frame = 0;
+	feedbackFbo = 0;
+	feedbackTex = 0;
+	feedbackWidth = 0;
+	feedbackHeight = 0;
+	for (int i = 0; i < 2; ++i) {
+		readbackPbo[i] = 0;
+		readbackWidth[i] = 0;
+		readbackHeight[i] = 0;
+	}
+	readbackIndex = 0;
+	for (int i = 0; i < 4; ++i) {
+		savedViewport[i] = 0;
+		savedClearColor[i] = 0.0f;
+	}
+	savedDepthTest = GL_FALSE;
+	stopLoader = false;
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	StopLoader();
+	GLResourceTracker& tracker = GLResourceTracker::GetInstance();
+	if (pageCacheTex != 0) {
+		tracker.TrackDelete(GL_RESOURCE_TEXTURE, &pageCacheTex, 1);
+		glDeleteTextures(1, &pageCacheTex);
+	}
+	if (indirectionTex != 0) {
+		tracker.TrackDelete(GL_RESOURCE_TEXTURE, &indirectionTex, 1);
+		glDeleteTextures(1, &indirectionTex);
+	}
+	if (feedbackTex != 0) {
+		tracker.TrackDelete(GL_RESOURCE_TEXTURE, &feedbackTex, 1);
+		glDeleteTextures(1, &feedbackTex);
+	}
+	if (feedbackFbo != 0) {
+		tracker.TrackDelete(GL_RESOURCE_FRAMEBUFFER, &feedbackFbo, 1);
+		glDeleteFramebuffers(1, &feedbackFbo);
+	}
+	if (readbackPbo[0] != 0) {
+		tracker.TrackDelete(GL_RESOURCE_BUFFER, readbackPbo, 2);
+		glDeleteBuffers(2, readbackPbo);
+	}
+}
+
+bool VirtualTexture::Load(const std::string& imagePath, const uint64_t sourceHash)
+{
+	if (!pageFile.Open(imagePath, sourceHash)) {
+		// First use: cut the page file. The image is not flipped, pages are
+		// stored top row first.
+		std::cout << "Cutting " << imagePath << " into pages ..." << std::endl;
+		cv::Mat image = cv::imread(imagePath);
+		if (image.rows == 0 || image.cols == 0 || image.depth() != CV_8U)
+			return false;
+		if (!image.isContinuous())
+			image = image.clone();
+		if (!WritePageFile(imagePath, sourceHash, image.ptr(), image.cols, image.rows, image.channels())
+			|| !pageFile.Open(imagePath, sourceHash)) {
+			std::cerr << "[ERROR] Failed to write page file: " << GetPageFilePath(imagePath) << std::endl;
+			return false;
+		}
+	}
+	if (pageFile.GetNumLevels() > MAX_LEVELS || pageFile.GetLevel(0).tilesX > MAX_TILES_PER_SIDE
+		|| pageFile.GetLevel(0).tilesY > MAX_TILES_PER_SIDE || !CreateTextures()) {
+		pageFile.Close();
+		return false;
+	}
+
+	// The coarsest level is loaded right away and never evicted, so that
+	// every tile has something to show.
+	const int coarsest = pageFile.GetNumLevels() - 1;
+	const PageFile::PageLevel& level = pageFile.GetLevel(coarsest);
+	for (int ty = 0; ty < level.tilesY; ++ty)
+		for (int tx = 0; tx < level.tilesX; ++tx)
+			UploadPage(MakeKey(coarsest, tx, ty), pageFile.GetPage(coarsest, tx, ty), true);
+	UpdateIndirection();
+
+	// Scratch buffers of Update, sized once so that frames do not allocate.
+	// A page is missing at most once per frame.
+	uploads.reserve(MAX_UPLOADS_PER_FRAME);
+	missing.reserve(pageSlots.size());
+	requests.reserve(MAX_REQUESTS);
+
+	StartLoader();
+	return true;
+}
+
+bool VirtualTexture::ShouldStream(const std::string& imagePath)
+{
+	std::error_code ec;
+	if (std::filesystem::exists(GetPageFilePath(imagePath), ec))
+		return true;
+	int width = 0, height = 0;
+	return ReadImageSize(imagePath, width, height) && std::max(width, height) >= streamingSize;
+}
+
+bool VirtualTexture::CreateTextures()
+{
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	const int pageSize = PageFile::GetPageSize();
+	pagesPerSide = std::min(CACHE_PAGES_PER_SIDE, (int)maxSize / pageSize);
+
+	// Indirection tables of all levels side by side, finest on the left.
+	const int numLevels = pageFile.GetNumLevels();
+	levelSizes.clear();
+	levelOffsets.clear();
+	indirectionWidth = 0;
+	indirectionHeight = pageFile.GetLevel(0).tilesY;
+	for (int i = 0; i < numLevels; ++i) {
+		const PageFile::PageLevel& level = pageFile.GetLevel(i);
+		levelSizes.push_back(glm::vec2((float)level.width, (float)level.height));
+		levelOffsets.push_back(glm::ivec2(indirectionWidth, 0));
+		indirectionWidth += level.tilesX;
+	}
+	if (pagesPerSide < 2 || indirectionWidth > maxSize || indirectionHeight > maxSize) {
+		std::cerr << "[ERROR] Virtual texture too large for this GPU" << std::endl;
+		return false;
+	}
+
+	const PageFile::PageLevel& last = pageFile.GetLevel(numLevels - 1);
+	const size_t numPages = last.firstPage + (size_t)last.tilesX * last.tilesY;
+	pageSlots.assign(numPages, -1);
+	requestedFrame.assign(numPages, 0);
+	inFlight.assign(numPages, 0);
+	Slot freeSlot;
+	freeSlot.level = -1;
+	freeSlot.tileX = 0;
+	freeSlot.tileY = 0;
+	freeSlot.lastUsedFrame = 0;
+	freeSlot.pinned = false;
+	slots.assign((size_t)pagesPerSide * pagesPerSide, freeSlot);
+	indirection.assign((size_t)indirectionWidth * indirectionHeight * 4, 0);
+	stats.numSlots = (int)slots.size();
+
+	GLenum internalFormat = GL_RGB8;
+	if (pageFile.GetChannels() == 1)
+		internalFormat = GL_R8;
+	else if (pageFile.GetChannels() == 4)
+		internalFormat = GL_RGBA8;
+	const int cacheSize = pagesPerSide * pageSize;
+	glGenTextures(1, &pageCacheTex);
+	GL_TRACK_CREATE(GL_RESOURCE_TEXTURE, &pageCacheTex, 1, "VirtualTexture page cache");
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, pageCacheTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, cacheSize, cacheSize, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_TEXTURE, pageCacheTex,
+											  (size_t)cacheSize * cacheSize * pageFile.GetChannels());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (pageFile.GetChannels() == 1) {
+		// Gray images: show the one channel as gray, not red.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+	}
+
+	glGenTextures(1, &indirectionTex);
+	GL_TRACK_CREATE(GL_RESOURCE_TEXTURE, &indirectionTex, 1, "VirtualTexture indirection");
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, indirectionTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, indirectionWidth, indirectionHeight, 0,
+					GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+	GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_TEXTURE, indirectionTex,
+											  (size_t)indirectionWidth * indirectionHeight * 4 * sizeof(uint16_t));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(2, readbackPbo);
+	GL_TRACK_CREATE(GL_RESOURCE_BUFFER, readbackPbo, 2, "VirtualTexture feedback readback");
+	return true;
+}
+
+void VirtualTexture::Update()
+{
+	if (!pageFile.IsOpen())
+		return;
+	++frame;
+	ReadFeedback();
+
+	// Upload what the loader thread has read so far.
+	uploads.clear();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!loaded.empty() && uploads.size() < (size_t)MAX_UPLOADS_PER_FRAME) {
+			uploads.push_back(std::move(loaded.front()));
+			loaded.pop_front();
+		}
+	}
+	if (!uploads.empty())
+		wakeLoader.notify_one();
+	for (const LoadedPage& page : uploads) {
+		int level, tileX, tileY;
+		SplitKey(page.key, level, tileX, tileY);
+		const size_t index = GetPageIndex(level, tileX, tileY);
+		inFlight[index] = 0;
+		if (pageSlots[index] >= 0)
+			continue;
+		if (!UploadPage(page.key, page.pixels.data(), false))
+			stats.numDropped++;
+	}
+
+	if (indirectionDirty)
+		UpdateIndirection();
+	stats.numResident = 0;
+	for (const Slot& slot : slots)
+		if (slot.level >= 0)
+			stats.numResident++;
+}
+
+void VirtualTexture::ReadFeedback()
+{
+	// The buffer read here was filled two frames ago, so mapping it does not
+	// wait for the GPU.
+	const int index = readbackIndex;
+	if (readbackWidth[index] == 0)
+		return;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackPbo[index]);
+	const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+		(GLsizeiptr)readbackWidth[index] * readbackHeight[index] * 4, GL_MAP_READ_BIT);
+	if (pixels == nullptr) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		return;
+	}
+
+	// Every requested tile and its parents, which are needed to fall back on
+	// while it loads.
+	const int numLevels = pageFile.GetNumLevels();
+	missing.clear();
+	int numRequested = 0;
+	const size_t numPixels = (size_t)readbackWidth[index] * readbackHeight[index];
+	for (size_t i = 0; i < numPixels; ++i) {
+		const unsigned char* p = pixels + i * 4;
+		if (p[3] == 0)
+			continue;
+		int level = p[2] & 15;
+		int tileX = p[0] | (((p[2] >> 4) & 3) << 8);
+		int tileY = p[1] | (((p[2] >> 6) & 3) << 8);
+		if (level >= numLevels || tileX >= pageFile.GetLevel(level).tilesX || tileY >= pageFile.GetLevel(level).tilesY)
+			continue;
+		for (; level < numLevels; ++level, tileX /= 2, tileY /= 2) {
+			const PageFile::PageLevel& l = pageFile.GetLevel(level);
+			tileX = std::min(tileX, l.tilesX - 1);
+			tileY = std::min(tileY, l.tilesY - 1);
+			const size_t page = GetPageIndex(level, tileX, tileY);
+			// Its parents have been seen too.
+			if (requestedFrame[page] == frame)
+				break;
+			requestedFrame[page] = frame;
+			numRequested++;
+			if (pageSlots[page] >= 0)
+				slots[pageSlots[page]].lastUsedFrame = frame;
+			else if (!inFlight[page])
+				missing.push_back(MakeKey(level, tileX, tileY));
+		}
+	}
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Replace what is still queued from earlier frames, keeping the pages
+	// this frame needs too; the view has moved on from the others.
+	int numPending;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const uint64_t key : requests) {
+			int level, tileX, tileY;
+			SplitKey(key, level, tileX, tileY);
+			const size_t page = GetPageIndex(level, tileX, tileY);
+			if (requestedFrame[page] == frame)
+				missing.push_back(key);
+			else
+				inFlight[page] = 0;
+		}
+		// Coarse levels first: they cover more of the view per page.
+		std::sort(missing.begin(), missing.end(), [](const uint64_t a, const uint64_t b) { return a > b; });
+		for (size_t i = MAX_REQUESTS; i < missing.size(); ++i) {
+			int level, tileX, tileY;
+			SplitKey(missing[i], level, tileX, tileY);
+			inFlight[GetPageIndex(level, tileX, tileY)] = 0;
+		}
+		if (missing.size() > MAX_REQUESTS)
+			missing.resize(MAX_REQUESTS);
+		// The loader takes from the back.
+		requests.assign(missing.rbegin(), missing.rend());
+		for (const uint64_t key : missing) {
+			int level, tileX, tileY;
+			SplitKey(key, level, tileX, tileY);
+			inFlight[GetPageIndex(level, tileX, tileY)] = 1;
+		}
+		numPending = (int)(missing.size() + loaded.size());
+	}
+	if (!missing.empty())
+		wakeLoader.notify_one();
+	stats.numRequested = numRequested;
+	stats.numPending = numPending;
+}
+
+bool VirtualTexture::UploadPage(const uint64_t key, const unsigned char* pixels, const bool pinned)
+{
+	// A free slot, else the least recently used one not needed this frame.
+	int best = -1;
+	for (int i = 0; i < (int)slots.size(); ++i) {
+		const Slot& slot = slots[i];
+		if (slot.level < 0) {
+			best = i;
+			break;
+		}
+		if (slot.pinned || slot.lastUsedFrame == frame)
+			continue;
+		if (best < 0 || slot.lastUsedFrame < slots[best].lastUsedFrame)
+			best = i;
+	}
+	if (best < 0)
+		return false;
+
+	Slot& slot = slots[best];
+	if (slot.level >= 0) {
+		pageSlots[GetPageIndex(slot.level, slot.tileX, slot.tileY)] = -1;
+		stats.numEvictions++;
+	}
+	SplitKey(key, slot.level, slot.tileX, slot.tileY);
+	slot.lastUsedFrame = frame;
+	slot.pinned = pinned;
+	pageSlots[GetPageIndex(slot.level, slot.tileX, slot.tileY)] = best;
+
+	GLenum format = GL_BGR;
+	if (pageFile.GetChannels() == 1)
+		format = GL_RED;
+	else if (pageFile.GetChannels() == 4)
+		format = GL_BGRA;
+	const int pageSize = PageFile::GetPageSize();
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, pageCacheTex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (best % pagesPerSide) * pageSize, (best / pagesPerSide) * pageSize,
+					pageSize, pageSize, format, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	// Left bound; the state cache knows and Bind may then skip it.
+
+	indirectionDirty = true;
+	stats.numUploads++;
+	return true;
+}
+
+void VirtualTexture::UpdateIndirection()
+{
+	// Coarse to fine, so that a tile that is not resident can take the
+	// entry of its parent.
+	const int numLevels = pageFile.GetNumLevels();
+	for (int i = numLevels - 1; i >= 0; --i) {
+		const PageFile::PageLevel& level = pageFile.GetLevel(i);
+		for (int ty = 0; ty < level.tilesY; ++ty) {
+			for (int tx = 0; tx < level.tilesX; ++tx) {
+				uint16_t* entry = &indirection[((size_t)ty * indirectionWidth + levelOffsets[i].x + tx) * 4];
+				const int slot = pageSlots[GetPageIndex(i, tx, ty)];
+				if (slot >= 0 || i == numLevels - 1) {
+					entry[0] = (uint16_t)std::max(slot, 0);
+					entry[1] = (uint16_t)i;
+					entry[2] = (uint16_t)tx;
+					entry[3] = (uint16_t)ty;
+					continue;
+				}
+				const PageFile::PageLevel& parent = pageFile.GetLevel(i + 1);
+				const int px = std::min(tx / 2, parent.tilesX - 1), py = std::min(ty / 2, parent.tilesY - 1);
+				const uint16_t* parentEntry = &indirection[((size_t)py * indirectionWidth + levelOffsets[i + 1].x + px) * 4];
+				std::copy(parentEntry, parentEntry + 4, entry);
+			}
+		}
+	}
+
+	GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, indirectionTex);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, indirectionWidth, indirectionHeight,
+					GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, indirection.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	indirectionDirty = false;
+}
+
+void VirtualTexture::BeginFeedback()
+{
+	glGetIntegerv(GL_VIEWPORT, savedViewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, savedClearColor);
+	savedDepthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	const int width = std::max(1, savedViewport[2] / FEEDBACK_SCALE);
+	const int height = std::max(1, savedViewport[3] / FEEDBACK_SCALE);
+	if (feedbackFbo == 0 || width != feedbackWidth || height != feedbackHeight) {
+		if (feedbackFbo == 0) {
+			glGenFramebuffers(1, &feedbackFbo);
+			GL_TRACK_CREATE(GL_RESOURCE_FRAMEBUFFER, &feedbackFbo, 1, "VirtualTexture feedback");
+			glGenTextures(1, &feedbackTex);
+			GL_TRACK_CREATE(GL_RESOURCE_TEXTURE, &feedbackTex, 1, "VirtualTexture feedback");
+		}
+		GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, feedbackTex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_TEXTURE, feedbackTex, (size_t)width * height * 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GLStateCache::GetInstance().BindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackTex, 0);
+		feedbackWidth = width;
+		feedbackHeight = height;
+	}
+
+	// Requests are wanted for the whole sky, hidden parts included, so that
+	// moving objects do not make tiles pop in.
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+	glViewport(0, 0, feedbackWidth, feedbackHeight);
+	glDisable(GL_DEPTH_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void VirtualTexture::EndFeedback()
+{
+	// Start an asynchronous read into the free buffer; Update maps it two
+	// frames from now.
+	const int index = readbackIndex;
+	const GLsizeiptr size = (GLsizeiptr)feedbackWidth * feedbackHeight * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackPbo[index]);
+	if (readbackWidth[index] != feedbackWidth || readbackHeight[index] != feedbackHeight) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		GLResourceTracker::GetInstance().SetBytes(GL_RESOURCE_BUFFER, readbackPbo[index], (size_t)size);
+	}
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readbackWidth[index] = feedbackWidth;
+	readbackHeight[index] = feedbackHeight;
+	readbackIndex = 1 - index;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+	glClearColor(savedClearColor[0], savedClearColor[1], savedClearColor[2], savedClearColor[3]);
+	if (savedDepthTest)
+		glEnable(GL_DEPTH_TEST);
+}
+
+void VirtualTexture::Bind(VirtualSkyboxShaderProg* shader, const bool feedback)
+{
+	GLStateCache& stateCache = GLStateCache::GetInstance();
+	stateCache.BindTexture(GL_TEXTURE1, GL_TEXTURE_2D, indirectionTex);
+	stateCache.BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, pageCacheTex);
+
+	const int numLevels = pageFile.GetNumLevels();
+	const float cacheSize = (float)(pagesPerSide * PageFile::GetPageSize());
+	stateCache.SetUniform1i(shader->GetLocPageCache(), 0);
+	stateCache.SetUniform1i(shader->GetLocIndirection(), 1);
+	glUniform2fv(shader->GetLocLevelSize(), numLevels, glm::value_ptr(levelSizes[0]));
+	glUniform2iv(shader->GetLocLevelOffset(), numLevels, glm::value_ptr(levelOffsets[0]));
+	stateCache.SetUniform1i(shader->GetLocNumLevels(), numLevels);
+	stateCache.SetUniform1i(shader->GetLocPagesPerSide(), pagesPerSide);
+	glUniform2f(shader->GetLocCacheSize(), cacheSize, cacheSize);
+	stateCache.SetUniform1f(shader->GetLocTileSize(), (float)PAGE_TILE_SIZE);
+	stateCache.SetUniform1f(shader->GetLocPageBorder(), (float)PAGE_BORDER);
+	// The feedback target has larger pixels; ask for the level the full
+	// resolution view will use.
+	stateCache.SetUniform1f(shader->GetLocLodBias(), feedback ? -std::log2((float)FEEDBACK_SCALE) : 0.0f);
+}
+
+void VirtualTexture::ShowStats() const
+{
+	std::cout << "Virtual texture: " << pageFile.GetWidth() << " x " << pageFile.GetHeight() << ", "
+			  << pageFile.GetNumLevels() << " levels, " << stats.numResident << " of " << stats.numSlots
+			  << " pages resident, " << stats.numRequested << " requested, " << stats.numPending << " pending ("
+			  << stats.numUploads << " uploads, " << stats.numEvictions << " evictions, "
+			  << stats.numDropped << " dropped)" << std::endl;
+}
+
+void VirtualTexture::StartLoader()
+{
+	stopLoader = false;
+	loader = std::thread(&VirtualTexture::LoaderThread, this);
+}
+
+void VirtualTexture::StopLoader()
+{
+	if (!loader.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopLoader = true;
+	}
+	wakeLoader.notify_all();
+	loader.join();
+}
+
+void VirtualTexture::LoaderThread()
+{
+	for (;;) {
+		uint64_t key = 0;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeLoader.wait(lock, [this]() {
+				return stopLoader || (!requests.empty() && loaded.size() < MAX_LOADED_PAGES);
+			});
+			if (stopLoader)
+				return;
+			key = requests.back();
+			requests.pop_back();
+		}
+
+		// Touching the mapped page is what reads it from disk.
+		int level, tileX, tileY;
+		SplitKey(key, level, tileX, tileY);
+		const unsigned char* pixels = pageFile.GetPage(level, tileX, tileY);
+		LoadedPage page;
+		page.key = key;
+		page.pixels.assign(pixels, pixels + pageFile.GetPageBytes());
+
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded.push_back(std::move(page));
+	}
+}
+
+size_t VirtualTexture::GetPageIndex(const int level, const int tileX, const int tileY) const
+{
+	const PageFile::PageLevel& l = pageFile.GetLevel(level);
+	return l.firstPage + (size_t)tileY * l.tilesX + tileX;
+}
+
+uint64_t VirtualTexture::MakeKey(const int level, const int tileX, const int tileY)
+{
+	// The level in the high bits, so that coarser tiles sort first.
+	return ((uint64_t)level << 40) | ((uint64_t)tileY << 20) | (uint64_t)tileX;
+}
+
+void VirtualTexture::SplitKey(const uint64_t key, int& level, int& tileX, int& tileY)
+{
+	level = (int)(key >> 40);
+	tileY = (int)((key >> 20) & 0xfffff);
+	tileX = (int)(key & 0xfffff);
+}
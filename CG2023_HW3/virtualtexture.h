@@ -0,0 +1,166 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include "headers.h"
+#include "pagefile.h"
+#include "shaderprog.h"
+
+// C++ STL headers.
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// VirtualTextureStats Declarations.
+struct VirtualTextureStats
+{
+	VirtualTextureStats() {
+		numSlots = 0; numResident = 0; numRequested = 0; numPending = 0;
+		numUploads = 0; numEvictions = 0; numDropped = 0;
+	}
+
+	// Page cache slots and how many hold a page.
+	int numSlots;
+	int numResident;
+	// Tiles asked for by the last feedback pass (with their parents) and
+	// those of them not resident yet.
+	int numRequested;
+	int numPending;
+	// Since start. Dropped: read from disk but no slot could be freed.
+	int numUploads;
+	int numEvictions;
+	int numDropped;
+};
+
+// VirtualTexture Declarations.
+// Streams a huge image (e.g. a 16K or 32K panorama) through a fixed-size
+// page cache instead of uploading it whole. The image is pre-cut into a page
+// file (*.vtpages, see pagefile.h) the first time it is used. On the GPU
+// there is a page cache texture and an indirection texture that maps every
+// tile of every level to the page drawn for it, which is the tile itself
+// when resident or else its closest resident parent; the coarsest level is
+// always resident. Each frame the geometry is also drawn into a small
+// feedback target that records the tile each pixel needs; that is read back
+// asynchronously, and a loader thread reads the missing pages from the page
+// file for Update to upload, a few per frame, evicting the least recently
+// needed ones. GL calls on the GL thread only.
+class VirtualTexture
+{
+public:
+	// VirtualTexture Public Methods.
+	VirtualTexture();
+	~VirtualTexture();
+
+	// Open the page file of imagePath, cutting it from the image first if it
+	// is missing or not made from sourceHash (the HashFile of the image).
+	// Returns false if neither works.
+	bool Load(const std::string& imagePath, const uint64_t sourceHash);
+	// True for images at least GetStreamingSize() on their longer side, or
+	// that already have a page file.
+	static bool ShouldStream(const std::string& imagePath);
+	static void SetStreamingSize(const int size) { streamingSize = size; }
+	static int GetStreamingSize() { return streamingSize; }
+
+	// Once per frame before drawing: take the last feedback, queue the tiles
+	// it asks for and upload pages the loader thread has read.
+	void Update();
+	// Draw the geometry between these two for the feedback pass, with
+	// Bind(shader, true).
+	void BeginFeedback();
+	void EndFeedback();
+	// Bind the textures to units 0 (pages) and 1 (indirection) and set the
+	// uniforms of a bound shader, for drawing or for the feedback pass.
+	void Bind(VirtualSkyboxShaderProg* shader, const bool feedback);
+
+	const PageFile& GetPageFile() const { return pageFile; }
+	const VirtualTextureStats& GetStats() const { return stats; }
+	void ShowStats() const;
+
+private:
+	// Slot Declarations.
+	// A place for one page in the cache texture.
+	struct Slot
+	{
+		int level;
+		int tileX;
+		int tileY;
+		unsigned int lastUsedFrame;
+		bool pinned;
+	};
+
+	// LoadedPage Declarations.
+	struct LoadedPage
+	{
+		uint64_t key;
+		std::vector<unsigned char> pixels;
+	};
+
+	// VirtualTexture Private Methods.
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+	bool CreateTextures();
+	void ReadFeedback();
+	// Put a page in a free or least recently used slot; false if all slots
+	// are in use this frame.
+	bool UploadPage(const uint64_t key, const unsigned char* pixels, const bool pinned);
+	void UpdateIndirection();
+	void StartLoader();
+	void StopLoader();
+	void LoaderThread();
+	// Index of a tile among all pages of the file.
+	size_t GetPageIndex(const int level, const int tileX, const int tileY) const;
+	static uint64_t MakeKey(const int level, const int tileX, const int tileY);
+	static void SplitKey(const uint64_t key, int& level, int& tileX, int& tileY);
+
+	// VirtualTexture Private Data.
+	PageFile pageFile;
+	GLuint pageCacheTex;
+	GLuint indirectionTex;
+	int pagesPerSide;
+	int indirectionWidth;
+	int indirectionHeight;
+	// Per level: its size in texels and where its table starts in the
+	// indirection texture.
+	std::vector<glm::vec2> levelSizes;
+	std::vector<glm::ivec2> levelOffsets;
+	std::vector<Slot> slots;
+	// Per page of the file: its cache slot (-1 if not resident), the last
+	// frame it was asked for and whether the loader has it.
+	std::vector<int> pageSlots;
+	std::vector<unsigned int> requestedFrame;
+	std::vector<unsigned char> inFlight;
+	std::vector<uint16_t> indirection;
+	bool indirectionDirty;
+	unsigned int frame;
+	// Reused every frame by Update.
+	std::vector<LoadedPage> uploads;
+	std::vector<uint64_t> missing;
+
+	// Feedback target and the pixel buffers it is read back through; the
+	// buffer written in one frame is read in the next.
+	GLuint feedbackFbo;
+	GLuint feedbackTex;
+	int feedbackWidth;
+	int feedbackHeight;
+	GLuint readbackPbo[2];
+	int readbackWidth[2];
+	int readbackHeight[2];
+	int readbackIndex;
+	GLint savedViewport[4];
+	GLfloat savedClearColor[4];
+	GLboolean savedDepthTest;
+
+	// Loader thread: takes keys from the back of requests (coarsest first),
+	// reads the pages and hands them over in loaded.
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wakeLoader;
+	std::vector<uint64_t> requests;
+	std::deque<LoadedPage> loaded;
+	bool stopLoader;
+
+	VirtualTextureStats stats;
+	static int streamingSize;
+};
+
+#endif